@@ -108,8 +108,38 @@ struct _KmsBaseHubPortData
   gint id;
   GstPad *audio_sink_target;
   GstPad *video_sink_target;
+
+  /* Ghost pads exposed by the hub for this port, so they are not looked up
+   * by name on every link, unlink or retarget */
+  GstPad *audio_src_pad;
+  GstPad *video_src_pad;
+  GstPad *audio_sink_pad;
+  GstPad *video_sink_pad;
 };
 
+/* Retargets of a ghost pad. Each call to set_target supersedes the
+ * pending one, whose probe is removed or, if already running, ignored */
+typedef struct _KmsBaseHubPadRetarget
+{
+  GRecMutex mutex;
+  guint generation;
+  GstPad *probe_pad;
+  gulong probe_id;
+  gboolean ret;
+} KmsBaseHubPadRetarget;
+
+typedef struct _KmsBaseHubRetarget
+{
+  GstPad *gp;
+  GstPad *target;
+  guint generation;
+} KmsBaseHubRetarget;
+
+#define PAD_RETARGET_DATA "kms-base-hub-pad-retarget"
+G_DEFINE_QUARK (PAD_RETARGET_DATA, pad_retarget_data);
+
+G_LOCK_DEFINE_STATIC (pad_retarget);
+
 /* class initialization */
 
 G_DEFINE_TYPE_WITH_CODE (KmsBaseHub, kms_base_hub,
@@ -117,30 +147,189 @@ G_DEFINE_TYPE_WITH_CODE (KmsBaseHub, kms_base_hub,
     GST_DEBUG_CATEGORY_INIT (kms_base_hub_debug_category, PLUGIN_NAME,
         0, "debug category for basehub element"));
 
+static void
+kms_base_hub_pad_retarget_destroy (gpointer data)
+{
+  KmsBaseHubPadRetarget *state = data;
+
+  /* Pending probes keep a reference to the ghost pad, so none is left */
+  g_rec_mutex_clear (&state->mutex);
+  g_slice_free (KmsBaseHubPadRetarget, state);
+}
+
+static KmsBaseHubPadRetarget *
+kms_base_hub_get_pad_retarget (GstPad * gp)
+{
+  KmsBaseHubPadRetarget *state;
+
+  G_LOCK (pad_retarget);
+
+  state = g_object_get_qdata (G_OBJECT (gp), pad_retarget_data_quark ());
+  if (state == NULL) {
+    state = g_slice_new0 (KmsBaseHubPadRetarget);
+    g_rec_mutex_init (&state->mutex);
+    g_object_set_qdata_full (G_OBJECT (gp), pad_retarget_data_quark (),
+        state, kms_base_hub_pad_retarget_destroy);
+  }
+
+  G_UNLOCK (pad_retarget);
+
+  return state;
+}
+
+static void
+kms_base_hub_retarget_destroy (gpointer data)
+{
+  KmsBaseHubRetarget *retarget = data;
+
+  g_object_unref (retarget->gp);
+  g_object_unref (retarget->target);
+  g_slice_free (KmsBaseHubRetarget, retarget);
+}
+
+static GstPadProbeReturn
+retarget_idle_probe (GstPad * pad, GstPadProbeInfo * info, gpointer data)
+{
+  KmsBaseHubRetarget *retarget = data;
+  KmsBaseHubPadRetarget *state;
+
+  state = kms_base_hub_get_pad_retarget (retarget->gp);
+
+  g_rec_mutex_lock (&state->mutex);
+
+  if (retarget->generation != state->generation) {
+    GST_DEBUG_OBJECT (retarget->gp, "Retarget to %" GST_PTR_FORMAT
+        " superseded", retarget->target);
+    goto end;
+  }
+
+  GST_DEBUG_OBJECT (retarget->gp, "Retargeting from %" GST_PTR_FORMAT
+      " to %" GST_PTR_FORMAT, pad, retarget->target);
+
+  state->ret = gst_ghost_pad_set_target (GST_GHOST_PAD (retarget->gp),
+      retarget->target);
+  if (!state->ret) {
+    GST_WARNING_OBJECT (retarget->gp, "Cannot set target %" GST_PTR_FORMAT,
+        retarget->target);
+  }
+
+  g_clear_object (&state->probe_pad);
+  state->probe_id = 0;
+
+end:
+  g_rec_mutex_unlock (&state->mutex);
+
+  return GST_PAD_PROBE_REMOVE;
+}
+
+/* Must be called with the retarget mutex held */
+static void
+kms_base_hub_cancel_retarget (KmsBaseHubPadRetarget * state)
+{
+  /* A running probe sees the new generation and does nothing */
+  state->generation++;
+
+  if (state->probe_pad != NULL) {
+    gst_pad_remove_probe (state->probe_pad, state->probe_id);
+    g_clear_object (&state->probe_pad);
+    state->probe_id = 0;
+  }
+}
+
+/* Whether target can replace the current target of gp */
+static gboolean
+kms_base_hub_can_retarget (GstPad * gp, GstPad * target)
+{
+  GstCaps *templ_caps, *caps;
+  gboolean ret;
+
+  if (gst_pad_get_direction (gp) != gst_pad_get_direction (target)) {
+    GST_WARNING_OBJECT (gp, "Wrong direction for %" GST_PTR_FORMAT, target);
+    return FALSE;
+  }
+
+  if (gst_pad_is_linked (target)) {
+    GST_WARNING_OBJECT (gp, "%" GST_PTR_FORMAT " is already linked", target);
+    return FALSE;
+  }
+
+  templ_caps = gst_pad_get_pad_template_caps (gp);
+  caps = gst_pad_query_caps (target, templ_caps);
+  ret = !gst_caps_is_empty (caps);
+  gst_caps_unref (caps);
+  gst_caps_unref (templ_caps);
+
+  if (!ret) {
+    GST_WARNING_OBJECT (gp, "No common caps with %" GST_PTR_FORMAT, target);
+  }
+
+  return ret;
+}
+
 static gboolean
 set_target (GstPad * gp, GstPad * target)
 {
+  KmsBaseHubPadRetarget *state;
+  KmsBaseHubRetarget *retarget;
   GstPad *old_target;
-  GstPad *peer;
+  gulong probe_id;
+  gboolean ret;
+
+  state = kms_base_hub_get_pad_retarget (gp);
+
+  g_rec_mutex_lock (&state->mutex);
+
+  kms_base_hub_cancel_retarget (state);
 
   old_target = gst_ghost_pad_get_target (GST_GHOST_PAD (gp));
-  if (old_target == NULL) {
+
+  if (old_target == target) {
+    /* Already linked, nothing to relink */
+    g_clear_object (&old_target);
+    ret = TRUE;
     goto end;
   }
-  peer = gst_pad_get_peer (old_target);
 
-  if (peer != NULL) {
-    if (peer->direction == GST_PAD_SINK) {
-      gst_pad_unlink (old_target, peer);
-    } else {
-      gst_pad_unlink (peer, old_target);
-    }
-    g_object_unref (peer);
+  if (old_target == NULL || target == NULL) {
+    /* Setting the target unlinks the old one, no data to wait for */
+    g_clear_object (&old_target);
+    ret = gst_ghost_pad_set_target (GST_GHOST_PAD (gp), target);
+    goto end;
+  }
+
+  /* Failures are reported now, not when the probe runs */
+  if (!kms_base_hub_can_retarget (gp, target)) {
+    g_object_unref (old_target);
+    ret = FALSE;
+    goto end;
+  }
+
+  /* Switch targets once no buffer is going through the old one, so the
+   * stream is not cut in the middle of a chain call */
+  retarget = g_slice_new (KmsBaseHubRetarget);
+  retarget->gp = g_object_ref (gp);
+  retarget->target = g_object_ref (target);
+  retarget->generation = state->generation;
+
+  state->ret = TRUE;
+  probe_id = gst_pad_add_probe (old_target, GST_PAD_PROBE_TYPE_IDLE,
+      retarget_idle_probe, retarget, kms_base_hub_retarget_destroy);
+
+  if (probe_id != 0) {
+    /* Old target busy, retargeted from its streaming thread */
+    state->probe_pad = old_target;
+    state->probe_id = probe_id;
+    ret = TRUE;
+  } else {
+    /* Old target idle, already retargeted */
+    g_object_unref (old_target);
+    ret = state->ret;
   }
-  g_object_unref (old_target);
 
 end:
-  return gst_ghost_pad_set_target (GST_GHOST_PAD (gp), target);
+  g_rec_mutex_unlock (&state->mutex);
+
+  return ret;
 }
 
 static KmsBaseHubPortData *
@@ -168,6 +357,11 @@ kms_base_hub_port_data_destroy (gpointer data)
   g_clear_object (&port_data->audio_sink_target);
   g_clear_object (&port_data->video_sink_target);
 
+  g_clear_object (&port_data->audio_src_pad);
+  g_clear_object (&port_data->video_src_pad);
+  g_clear_object (&port_data->audio_sink_pad);
+  g_clear_object (&port_data->video_sink_pad);
+
   g_clear_object (&port_data->port);
   g_slice_free (KmsBaseHubPortData, data);
 }
@@ -264,13 +458,66 @@ release_gint (gpointer data)
   g_slice_free (gint, data);
 }
 
+#define PORT_PAD_OFFSET(member) G_STRUCT_OFFSET (KmsBaseHubPortData, member)
+
+static GstPad *
+kms_base_hub_get_port_pad (KmsBaseHub * hub, gint id, gulong pad_offset,
+    const gchar * pad_prefix)
+{
+  KmsBaseHubPortData *port_data;
+  GstPad *gp = NULL;
+
+  KMS_BASE_HUB_LOCK (hub);
+
+  port_data = g_hash_table_lookup (hub->priv->ports, &id);
+  if (port_data != NULL) {
+    GstPad **cached = G_STRUCT_MEMBER_P (port_data, pad_offset);
+
+    if (*cached != NULL) {
+      gp = g_object_ref (*cached);
+    }
+  }
+
+  KMS_BASE_HUB_UNLOCK (hub);
+
+  if (port_data == NULL) {
+    /* Pads linked for an id that is not handled are only known by name */
+    gchar *gp_name = g_strdup_printf ("%s%d", pad_prefix, id);
+
+    gp = gst_element_get_static_pad (GST_ELEMENT (hub), gp_name);
+    g_free (gp_name);
+  }
+
+  return gp;
+}
+
+static void
+kms_base_hub_cache_port_pad (KmsBaseHub * hub, gint id, gulong pad_offset,
+    GstPad * gp)
+{
+  KmsBaseHubPortData *port_data;
+
+  KMS_BASE_HUB_LOCK (hub);
+
+  port_data = g_hash_table_lookup (hub->priv->ports, &id);
+  if (port_data != NULL) {
+    GstPad **cached = G_STRUCT_MEMBER_P (port_data, pad_offset);
+
+    g_clear_object (cached);
+    *cached = g_object_ref (gp);
+  }
+
+  KMS_BASE_HUB_UNLOCK (hub);
+}
+
 static gboolean
-kms_base_hub_unlink_pad (KmsBaseHub * hub, const gchar * gp_name)
+kms_base_hub_unlink_pad (KmsBaseHub * hub, gint id, gulong pad_offset,
+    const gchar * pad_prefix)
 {
   GstPad *gp;
   gboolean ret;
 
-  gp = gst_element_get_static_pad (GST_ELEMENT (hub), gp_name);
+  gp = kms_base_hub_get_port_pad (hub, id, pad_offset, pad_prefix);
 
   if (gp == NULL) {
     return TRUE;
@@ -284,53 +531,29 @@ kms_base_hub_unlink_pad (KmsBaseHub * hub, const gchar * gp_name)
 static gboolean
 kms_base_hub_unlink_video_src_default (KmsBaseHub * hub, gint id)
 {
-  gboolean ret;
-  gchar *gp_name = g_strdup_printf (VIDEO_SRC_PAD_PREFIX "%d", id);
-
-  ret = kms_base_hub_unlink_pad (hub, gp_name);
-
-  g_free (gp_name);
-
-  return ret;
+  return kms_base_hub_unlink_pad (hub, id, PORT_PAD_OFFSET (video_src_pad),
+      VIDEO_SRC_PAD_PREFIX);
 }
 
 static gboolean
 kms_base_hub_unlink_audio_src_default (KmsBaseHub * hub, gint id)
 {
-  gboolean ret;
-  gchar *gp_name = g_strdup_printf (AUDIO_SRC_PAD_PREFIX "%d", id);
-
-  ret = kms_base_hub_unlink_pad (hub, gp_name);
-
-  g_free (gp_name);
-
-  return ret;
+  return kms_base_hub_unlink_pad (hub, id, PORT_PAD_OFFSET (audio_src_pad),
+      AUDIO_SRC_PAD_PREFIX);
 }
 
 static gboolean
 kms_base_hub_unlink_video_sink_default (KmsBaseHub * hub, gint id)
 {
-  gboolean ret;
-  gchar *gp_name = g_strdup_printf (VIDEO_SINK_PAD_PREFIX "%d", id);
-
-  ret = kms_base_hub_unlink_pad (hub, gp_name);
-
-  g_free (gp_name);
-
-  return ret;
+  return kms_base_hub_unlink_pad (hub, id, PORT_PAD_OFFSET (video_sink_pad),
+      VIDEO_SINK_PAD_PREFIX);
 }
 
 static gboolean
 kms_base_hub_unlink_audio_sink_default (KmsBaseHub * hub, gint id)
 {
-  gboolean ret;
-  gchar *gp_name = g_strdup_printf (AUDIO_SINK_PAD_PREFIX "%d", id);
-
-  ret = kms_base_hub_unlink_pad (hub, gp_name);
-
-  g_free (gp_name);
-
-  return ret;
+  return kms_base_hub_unlink_pad (hub, id, PORT_PAD_OFFSET (audio_sink_pad),
+      AUDIO_SINK_PAD_PREFIX);
 }
 
 static void
@@ -362,9 +585,10 @@ remove_target_cb (GstPad * pad, GstPad * peer, gpointer data)
 }
 
 static gboolean
-kms_base_hub_link_src_pad (KmsBaseHub * hub, const gchar * gp_name,
-    const gchar * template_name, GstElement * internal_element,
-    const gchar * pad_name, gboolean remove_on_unlink)
+kms_base_hub_link_src_pad (KmsBaseHub * hub, gint id, gulong pad_offset,
+    const gchar * pad_prefix, const gchar * template_name,
+    GstElement * internal_element, const gchar * pad_name,
+    gboolean remove_on_unlink)
 {
   GstPad *gp, *target;
   gboolean ret;
@@ -390,15 +614,17 @@ kms_base_hub_link_src_pad (KmsBaseHub * hub, const gchar * gp_name,
     return FALSE;
   }
 
-  gp = gst_element_get_static_pad (GST_ELEMENT (hub), gp_name);
+  gp = kms_base_hub_get_port_pad (hub, id, pad_offset, pad_prefix);
 
   if (gp == NULL) {
     GstPadTemplate *templ;
+    gchar *gp_name = g_strdup_printf ("%s%d", pad_prefix, id);
 
     templ =
         gst_element_class_get_pad_template (GST_ELEMENT_CLASS
         (G_OBJECT_GET_CLASS (hub)), template_name);
     gp = gst_ghost_pad_new_no_target_from_template (gp_name, templ);
+    g_free (gp_name);
     g_signal_connect_object (gp, "linked", G_CALLBACK (set_target_cb), target,
         0);
     g_signal_connect (gp, "unlinked", G_CALLBACK (remove_target_cb), NULL);
@@ -410,7 +636,9 @@ kms_base_hub_link_src_pad (KmsBaseHub * hub, const gchar * gp_name,
     }
 
     ret = gst_element_add_pad (GST_ELEMENT (hub), gp);
-    if (!ret) {
+    if (ret) {
+      kms_base_hub_cache_port_pad (hub, id, pad_offset, gp);
+    } else {
       g_object_unref (gp);
     }
   } else {
@@ -428,15 +656,9 @@ kms_base_hub_link_audio_src_default (KmsBaseHub * hub, gint id,
     GstElement * internal_element, const gchar * pad_name,
     gboolean remove_on_unlink)
 {
-  gchar *gp_name = g_strdup_printf (AUDIO_SRC_PAD_PREFIX "%d", id);
-  gboolean ret;
-
-  ret =
-      kms_base_hub_link_src_pad (hub, gp_name, AUDIO_SRC_PAD_NAME,
-      internal_element, pad_name, remove_on_unlink);
-  g_free (gp_name);
-
-  return ret;
+  return kms_base_hub_link_src_pad (hub, id, PORT_PAD_OFFSET (audio_src_pad),
+      AUDIO_SRC_PAD_PREFIX, AUDIO_SRC_PAD_NAME, internal_element, pad_name,
+      remove_on_unlink);
 }
 
 static gboolean
@@ -444,30 +666,30 @@ kms_base_hub_link_video_src_default (KmsBaseHub * hub, gint id,
     GstElement * internal_element, const gchar * pad_name,
     gboolean remove_on_unlink)
 {
-  gchar *gp_name = g_strdup_printf (VIDEO_SRC_PAD_PREFIX "%d", id);
-  gboolean ret;
-
-  ret =
-      kms_base_hub_link_src_pad (hub, gp_name, VIDEO_SRC_PAD_NAME,
-      internal_element, pad_name, remove_on_unlink);
-  g_free (gp_name);
-
-  return ret;
+  return kms_base_hub_link_src_pad (hub, id, PORT_PAD_OFFSET (video_src_pad),
+      VIDEO_SRC_PAD_PREFIX, VIDEO_SRC_PAD_NAME, internal_element, pad_name,
+      remove_on_unlink);
 }
 
+/* Must be called with the hub lock held */
 static gboolean
-kms_base_hub_create_and_link_ghost_pad (KmsBaseHub * hub,
-    GstPad * src_pad, const gchar * gp_name, const gchar * gp_template_name,
-    GstPad * target)
+kms_base_hub_create_and_link_ghost_pad (KmsBaseHubPortData * port_data,
+    GstPad * src_pad, const gchar * gp_prefix, const gchar * gp_template_name,
+    gulong pad_offset, GstPad * target)
 {
+  KmsBaseHub *hub = port_data->hub;
   GstPadTemplate *templ;
   GstPad *gp;
+  GstPad **cached;
+  gchar *gp_name;
   gboolean ret;
 
   templ =
       gst_element_class_get_pad_template (GST_ELEMENT_CLASS
       (G_OBJECT_GET_CLASS (hub)), gp_template_name);
+  gp_name = g_strdup_printf ("%s%d", gp_prefix, port_data->id);
   gp = gst_ghost_pad_new_from_template (gp_name, target, templ);
+  g_free (gp_name);
 
   if (GST_STATE (hub) >= GST_STATE_PAUSED
       || GST_STATE_PENDING (hub) >= GST_STATE_PAUSED
@@ -478,6 +700,10 @@ kms_base_hub_create_and_link_ghost_pad (KmsBaseHub * hub,
   ret = gst_element_add_pad (GST_ELEMENT (hub), gp);
 
   if (ret) {
+    cached = G_STRUCT_MEMBER_P (port_data, pad_offset);
+    g_clear_object (cached);
+    *cached = g_object_ref (gp);
+
     gst_pad_link (src_pad, gp);
   } else {
     g_object_unref (gp);
@@ -488,10 +714,10 @@ kms_base_hub_create_and_link_ghost_pad (KmsBaseHub * hub,
 
 static gboolean
 kms_base_hub_link_sink_pad (KmsBaseHub * hub, gint id,
-    const gchar * gp_name, const gchar * gp_template_name,
+    const gchar * gp_prefix, const gchar * gp_template_name,
     GstElement * internal_element, const gchar * pad_name,
     const gchar * port_src_pad_name, gulong target_offset,
-    gboolean remove_on_unlink)
+    gulong pad_offset, gboolean remove_on_unlink)
 {
   KmsBaseHubPortData *port_data;
   gboolean ret;
@@ -534,17 +760,16 @@ kms_base_hub_link_sink_pad (KmsBaseHub * hub, gint id,
   }
   *port_data_target = g_object_ref (target);
 
-  gp = gst_element_get_static_pad (GST_ELEMENT (hub), gp_name);
+  gp = *(GstPad **) G_STRUCT_MEMBER_P (port_data, pad_offset);
   if (gp != NULL) {
     ret = set_target (gp, target);
-    g_object_unref (gp);
   } else {
     GstPad *src_pad = gst_element_get_static_pad (port_data->port,
         port_src_pad_name);
 
     if (src_pad != NULL) {
-      ret = kms_base_hub_create_and_link_ghost_pad (hub, src_pad,
-          gp_name, gp_template_name, target);
+      ret = kms_base_hub_create_and_link_ghost_pad (port_data, src_pad,
+          gp_prefix, gp_template_name, pad_offset, target);
       g_object_unref (src_pad);
     } else {
       ret = TRUE;
@@ -570,17 +795,10 @@ kms_base_hub_link_video_sink_default (KmsBaseHub * hub, gint id,
     GstElement * internal_element, const gchar * pad_name,
     gboolean remove_on_unlink)
 {
-  gboolean ret;
-  gchar *gp_name = g_strdup_printf (VIDEO_SINK_PAD_PREFIX "%d", id);
-
-  ret = kms_base_hub_link_sink_pad (hub, id, gp_name, VIDEO_SINK_PAD_NAME,
-      internal_element, pad_name, HUB_VIDEO_SRC_PAD,
-      G_STRUCT_OFFSET (KmsBaseHubPortData, video_sink_target),
+  return kms_base_hub_link_sink_pad (hub, id, VIDEO_SINK_PAD_PREFIX,
+      VIDEO_SINK_PAD_NAME, internal_element, pad_name, HUB_VIDEO_SRC_PAD,
+      PORT_PAD_OFFSET (video_sink_target), PORT_PAD_OFFSET (video_sink_pad),
       remove_on_unlink);
-
-  g_free (gp_name);
-
-  return ret;
 }
 
 static gboolean
@@ -588,44 +806,37 @@ kms_base_hub_link_audio_sink_default (KmsBaseHub * hub, gint id,
     GstElement * internal_element, const gchar * pad_name,
     gboolean remove_on_unlink)
 {
-  gboolean ret;
-  gchar *gp_name = g_strdup_printf (AUDIO_SINK_PAD_PREFIX "%d", id);
-
-  ret = kms_base_hub_link_sink_pad (hub, id, gp_name, AUDIO_SINK_PAD_NAME,
-      internal_element, pad_name, HUB_AUDIO_SRC_PAD,
-      G_STRUCT_OFFSET (KmsBaseHubPortData, audio_sink_target),
+  return kms_base_hub_link_sink_pad (hub, id, AUDIO_SINK_PAD_PREFIX,
+      AUDIO_SINK_PAD_NAME, internal_element, pad_name, HUB_AUDIO_SRC_PAD,
+      PORT_PAD_OFFSET (audio_sink_target), PORT_PAD_OFFSET (audio_sink_pad),
       remove_on_unlink);
-
-  g_free (gp_name);
-
-  return ret;
 }
 
+/* Must be called with the hub lock held */
 static void
-kms_base_hub_remove_port_pad (KmsBaseHub * hub, gint id,
-    const gchar * pad_prefix)
+kms_base_hub_remove_port_pad (KmsBaseHubPortData * port_data,
+    gulong pad_offset)
 {
-  gchar *pad_name = g_strdup_printf ("%s%d", pad_prefix, id);
-  GstPad *pad = gst_element_get_static_pad (GST_ELEMENT (hub), pad_name);
+  GstPad **pad = G_STRUCT_MEMBER_P (port_data, pad_offset);
 
-  GST_DEBUG_OBJECT (hub, "Trying to remove pad: %s -> %" GST_PTR_FORMAT,
-      pad_name, pad);
-
-  if (pad != NULL) {
-    set_target (pad, NULL);
-    gst_element_remove_pad (GST_ELEMENT (hub), pad);
-    g_object_unref (pad);
+  if (*pad == NULL) {
+    return;
   }
-  g_free (pad_name);
+
+  GST_DEBUG_OBJECT (port_data->hub, "Removing pad %" GST_PTR_FORMAT, *pad);
+
+  set_target (*pad, NULL);
+  gst_element_remove_pad (GST_ELEMENT (port_data->hub), *pad);
+  g_clear_object (pad);
 }
 
 static void
-kms_base_hub_remove_port_pads (KmsBaseHub * hub, gint id)
+kms_base_hub_remove_port_pads (KmsBaseHubPortData * port_data)
 {
-  kms_base_hub_remove_port_pad (hub, id, AUDIO_SRC_PAD_PREFIX);
-  kms_base_hub_remove_port_pad (hub, id, AUDIO_SINK_PAD_PREFIX);
-  kms_base_hub_remove_port_pad (hub, id, VIDEO_SRC_PAD_PREFIX);
-  kms_base_hub_remove_port_pad (hub, id, VIDEO_SINK_PAD_PREFIX);
+  kms_base_hub_remove_port_pad (port_data, PORT_PAD_OFFSET (audio_src_pad));
+  kms_base_hub_remove_port_pad (port_data, PORT_PAD_OFFSET (audio_sink_pad));
+  kms_base_hub_remove_port_pad (port_data, PORT_PAD_OFFSET (video_src_pad));
+  kms_base_hub_remove_port_pad (port_data, PORT_PAD_OFFSET (video_sink_pad));
 }
 
 static void
@@ -647,7 +858,7 @@ kms_base_hub_unhandle_port (KmsBaseHub * hub, gint id)
   GST_DEBUG ("Removing element: %" GST_PTR_FORMAT, port_data->port);
 
   kms_hub_port_unhandled (KMS_HUB_PORT (port_data->port));
-  kms_base_hub_remove_port_pads (hub, id);
+  kms_base_hub_remove_port_pads (port_data);
 
   g_hash_table_remove (hub->priv->ports, &id);
 
@@ -669,36 +880,47 @@ kms_base_hub_generate_port_id (KmsBaseHub * hub)
 static void
 hub_pad_added (KmsBaseHub * hub, GstPad * pad, gpointer data)
 {
+  KmsBaseHubPortData *port;
+  const gchar *pad_name, *port_pad_name;
+  GstPad *sink;
+  gint id;
+
   if (gst_pad_get_direction (pad) != GST_PAD_SRC) {
     return;
   }
 
-  KMS_BASE_HUB_LOCK (hub);
-
-  if (g_str_has_prefix (GST_OBJECT_NAME (pad), VIDEO_SRC_PAD_PREFIX)) {
-    KmsBaseHubPortData *port;
-    gint64 id;
-    const gchar *pad_name;
+  pad_name = GST_OBJECT_NAME (pad);
 
-    pad_name = GST_OBJECT_NAME (pad);
+  if (g_str_has_prefix (pad_name, VIDEO_SRC_PAD_PREFIX)) {
     id = g_ascii_strtoll (pad_name + LENGTH_VIDEO_SRC_PAD_PREFIX, NULL, 10);
-    port = g_hash_table_lookup (hub->priv->ports, &id);
+    port_pad_name = HUB_VIDEO_SINK_PAD;
+  } else if (g_str_has_prefix (pad_name, AUDIO_SRC_PAD_PREFIX)) {
+    id = g_ascii_strtoll (pad_name + LENGTH_AUDIO_SRC_PAD_PREFIX, NULL, 10);
+    port_pad_name = HUB_AUDIO_SINK_PAD;
+  } else {
+    return;
+  }
 
-    gst_element_link_pads (GST_ELEMENT (hub), GST_OBJECT_NAME (pad),
-        port->port, "hub_video_sink");
-  } else if (g_str_has_prefix (GST_OBJECT_NAME (pad), AUDIO_SRC_PAD_PREFIX)) {
-    KmsBaseHubPortData *port;
-    gint64 id;
-    const gchar *pad_name;
+  KMS_BASE_HUB_LOCK (hub);
 
-    pad_name = GST_OBJECT_NAME (pad);
-    id = g_ascii_strtoll (pad_name + LENGTH_AUDIO_SRC_PAD_PREFIX, NULL, 10);
-    port = g_hash_table_lookup (hub->priv->ports, &id);
+  port = g_hash_table_lookup (hub->priv->ports, &id);
+
+  if (port == NULL) {
+    GST_DEBUG_OBJECT (hub, "No port %d for pad %" GST_PTR_FORMAT, id, pad);
+    goto end;
+  }
+
+  sink = gst_element_get_static_pad (port->port, port_pad_name);
+  if (sink == NULL) {
+    sink = gst_element_get_request_pad (port->port, port_pad_name);
+  }
 
-    gst_element_link_pads (GST_ELEMENT (hub), GST_OBJECT_NAME (pad),
-        port->port, "hub_audio_sink");
+  if (sink != NULL) {
+    gst_pad_link (pad, sink);
+    g_object_unref (sink);
   }
 
+end:
   KMS_BASE_HUB_UNLOCK (hub);
 }
 
@@ -715,28 +937,22 @@ endpoint_pad_added (GstElement * endpoint, GstPad * pad,
 
   if (port_data->video_sink_target != NULL
       && g_strstr_len (GST_OBJECT_NAME (pad), -1, "video")) {
-    gchar *gp_name = g_strdup_printf (VIDEO_SINK_PAD_PREFIX "%d",
-        port_data->id);
-
     GST_DEBUG_OBJECT (port_data->hub,
         "Connect %" GST_PTR_FORMAT " to %" GST_PTR_FORMAT, pad,
         port_data->video_sink_target);
 
-    kms_base_hub_create_and_link_ghost_pad (port_data->hub, pad, gp_name,
-        VIDEO_SINK_PAD_NAME, port_data->video_sink_target);
-    g_free (gp_name);
-  } else if (port_data->video_sink_target != NULL
+    kms_base_hub_create_and_link_ghost_pad (port_data, pad,
+        VIDEO_SINK_PAD_PREFIX, VIDEO_SINK_PAD_NAME,
+        PORT_PAD_OFFSET (video_sink_pad), port_data->video_sink_target);
+  } else if (port_data->audio_sink_target != NULL
       && g_strstr_len (GST_OBJECT_NAME (pad), -1, "audio")) {
-    gchar *gp_name = g_strdup_printf (AUDIO_SINK_PAD_PREFIX "%d",
-        port_data->id);
-
     GST_DEBUG_OBJECT (port_data->hub,
         "Connect %" GST_PTR_FORMAT " to %" GST_PTR_FORMAT, pad,
         port_data->audio_sink_target);
 
-    kms_base_hub_create_and_link_ghost_pad (port_data->hub, pad, gp_name,
-        AUDIO_SINK_PAD_NAME, port_data->audio_sink_target);
-    g_free (gp_name);
+    kms_base_hub_create_and_link_ghost_pad (port_data, pad,
+        AUDIO_SINK_PAD_PREFIX, AUDIO_SINK_PAD_NAME,
+        PORT_PAD_OFFSET (audio_sink_pad), port_data->audio_sink_target);
   }
 
   KMS_BASE_HUB_UNLOCK (port_data->hub);
@@ -41,6 +41,11 @@
 #include <gst/video/video-event.h>
 #include "kmsbufferlacentymeta.h"
 #include "kmsstats.h"
+#include "kmsrtpallocator.h"
+#include "kmslatencycontroller.h"
+#include "kmsrtpbatcher.h"
+#include "kmsfecenc.h"
+#include "kmsfecdec.h"
 
 #include <glib/gstdio.h>
 #include <gio/gio.h>
@@ -54,6 +59,9 @@ GST_DEBUG_CATEGORY_STATIC (kms_base_rtp_endpoint_debug);
 
 static const gchar *stats_files_dir = NULL;
 
+/* Only 1 in N buffers are tracked for latency stats when set */
+#define LATENCY_SAMPLING_ENV_VAR "KURENTO_LATENCY_SAMPLING"
+
 static void
 kms_i_rtp_session_manager_interface_init (KmsIRtpSessionManagerInterface *
     iface);
@@ -75,6 +83,19 @@ G_DEFINE_TYPE_WITH_CODE (KmsBaseRtpEndpoint, kms_base_rtp_endpoint,
 #define JB_INITIAL_LATENCY 0
 #define JB_READY_AUDIO_LATENCY 100
 #define JB_READY_VIDEO_LATENCY 500
+#define JB_BYPASS_LATENCY 50
+
+#define DEFAULT_JB_ADAPTIVE FALSE
+#define DEFAULT_JB_MIN_LATENCY 20
+#define DEFAULT_JB_MAX_LATENCY 1000
+#define DEFAULT_JB_BYPASS FALSE
+
+#define JB_LATENCY_DATA "kms-jb-latency-data"
+G_DEFINE_QUARK (JB_LATENCY_DATA, jb_latency_data);
+
+#define DEFAULT_RTP_BATCHING TRUE
+
+#define DEFAULT_FEC_GENERATION FALSE
 
 #define DEFAULT_MIN_PORT 1
 #define DEFAULT_MAX_PORT G_MAXUINT16
@@ -121,31 +142,6 @@ typedef struct _ExtData
   gint red_pt;
 } ExtData;
 
-typedef struct _E2EProbeData
-{
-  gchar *id;
-  StreamE2EAvgStat *stat;
-} E2EProbeData;
-
-static E2EProbeData *
-e2e_probe_data_new ()
-{
-  E2EProbeData *data;
-
-  data = g_slice_new0 (E2EProbeData);
-
-  return data;
-}
-
-static void
-e2e_probe_data_destroy (E2EProbeData * data)
-{
-  g_free (data->id);
-  kms_stats_stream_e2e_avg_stat_unref (data->stat);
-
-  g_slice_free (E2EProbeData, data);
-}
-
 /* RtpMediaConfig begin */
 
 typedef struct _RtpMediaConfig
@@ -234,6 +230,22 @@ struct _KmsBaseRtpEndpointPrivate
   guint min_port;
   guint max_port;
 
+  /* Jitter buffer latency */
+  gboolean jb_adaptive;
+  guint jb_min_latency;
+  guint jb_max_latency;
+
+  /* Forward packets as they arrive, without buffering nor lip-sync */
+  gboolean jb_bypass;
+
+  /* Send video packets of each frame in a buffer list */
+  gboolean rtp_batching;
+
+  /* Send ULPFEC packets when negotiated */
+  gboolean fec_generation;
+  /* Fraction lost of the sent video, from the remote receiver reports */
+  guint rr_fraction_lost;
+
   /* RTP statistics */
   KmsBaseRTPStats stats;
 
@@ -284,6 +296,12 @@ enum
   PROP_MIN_PORT,
   PROP_MAX_PORT,
   PROP_SUPPORT_FEC,
+  PROP_JB_ADAPTIVE,
+  PROP_JB_MIN_LATENCY,
+  PROP_JB_MAX_LATENCY,
+  PROP_JB_BYPASS,
+  PROP_RTP_BATCHING,
+  PROP_FEC_GENERATION,
   PROP_LAST
 };
 
@@ -419,7 +437,7 @@ kms_base_rtp_endpoint_add_rtp_hdr_ext_bufflist (GstBuffer ** buf, guint idx,
     HdrExtData * data)
 {
   if (data->add_hdr) {
-    *buf = gst_buffer_make_writable (*buf);
+    *buf = kms_rtp_buffer_make_header_writable (*buf);
   }
   kms_base_rtp_endpoint_add_rtp_hdr_ext (data, *buf);
 
@@ -436,7 +454,7 @@ kms_base_rtp_endpoint_add_rtp_hdr_ext_probe (GstPad * pad,
     GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
 
     if (data->add_hdr) {
-      buffer = gst_buffer_make_writable (buffer);
+      buffer = kms_rtp_buffer_make_header_writable (buffer);
     }
     kms_base_rtp_endpoint_add_rtp_hdr_ext (data, buffer);
     GST_PAD_PROBE_INFO_DATA (info) = buffer;
@@ -488,6 +506,91 @@ kms_base_rtp_endpoint_config_rtp_hdr_ext (KmsBaseRtpEndpoint * self,
   g_object_unref (pad);
 }
 
+typedef struct _RecvHdrExtData
+{
+  KmsBaseRtpEndpoint *self;
+  gint abs_send_time_id;
+  GstClockTime arrival_time;
+} RecvHdrExtData;
+
+static RecvHdrExtData *
+recv_hdr_ext_data_new (KmsBaseRtpEndpoint * self, gint abs_send_time_id)
+{
+  RecvHdrExtData *data;
+
+  data = g_slice_new0 (RecvHdrExtData);
+  data->self = self;
+  data->abs_send_time_id = abs_send_time_id;
+
+  return data;
+}
+
+static void
+recv_hdr_ext_data_destroy (gpointer data)
+{
+  g_slice_free (RecvHdrExtData, data);
+}
+
+static gboolean
+kms_base_rtp_endpoint_recv_rtp_hdr_ext (GstBuffer ** buf, guint idx,
+    RecvHdrExtData * data)
+{
+  KmsRembLocal *rl = g_atomic_pointer_get (&data->self->priv->rl);
+  GstRTPBuffer rtp = { NULL, };
+  guint8 *time;
+  guint size;
+
+  if (rl == NULL || !rl->delay_based) {
+    /* REMB not negotiated (yet) or only loss-based, nothing to feed */
+    return FALSE;
+  }
+
+  if (!gst_rtp_buffer_map (*buf, GST_MAP_READ, &rtp)) {
+    return TRUE;
+  }
+
+  if (gst_rtp_buffer_get_extension_onebyte_header (&rtp,
+          data->abs_send_time_id, 0, (gpointer) & time, &size)
+      && size == RTP_HDR_EXT_ABS_SEND_TIME_SIZE) {
+    kms_remb_local_incoming_packet (rl,
+        (time[0] << 16) | (time[1] << 8) | time[2], data->arrival_time,
+        gst_buffer_get_size (*buf));
+  }
+
+  gst_rtp_buffer_unmap (&rtp);
+
+  return TRUE;
+}
+
+static GstPadProbeReturn
+kms_base_rtp_endpoint_recv_rtp_hdr_ext_probe (GstPad * pad,
+    GstPadProbeInfo * info, gpointer gp)
+{
+  RecvHdrExtData *data = (RecvHdrExtData *) gp;
+  KmsRembLocal *rl = g_atomic_pointer_get (&data->self->priv->rl);
+
+  if (rl == NULL || !rl->delay_based) {
+    /* Delay-based estimation can be enabled later, so the probe stays */
+    return GST_PAD_PROBE_OK;
+  }
+
+  /* Buffers of the same list arrived together */
+  data->arrival_time = kms_utils_get_time_nsecs ();
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+    kms_base_rtp_endpoint_recv_rtp_hdr_ext (&buffer, 0, data);
+  } else if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    GstBufferList *bufflist = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
+
+    gst_buffer_list_foreach (bufflist,
+        (GstBufferListFunc) kms_base_rtp_endpoint_recv_rtp_hdr_ext, data);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
 /* RTP hdrext end */
 
 /* Media handler management begin */
@@ -856,9 +959,24 @@ kms_base_rtp_endpoint_request_rtp_sink (KmsIRtpSessionManager * manager,
         gst_element_get_request_pad (self->priv->rtpbin,
         AUDIO_RTPBIN_RECV_RTP_SINK);
   } else if (g_strcmp0 (VIDEO_STREAM_NAME, media_str) == 0) {
+    gint abs_send_time_id;
+
     pad =
         gst_element_get_request_pad (self->priv->rtpbin,
         VIDEO_RTPBIN_RECV_RTP_SINK);
+
+    abs_send_time_id = sdp_utils_get_abs_send_time_id (media);
+    if (abs_send_time_id != -1) {
+      RecvHdrExtData *data = recv_hdr_ext_data_new (self, abs_send_time_id);
+
+      GST_DEBUG_OBJECT (self,
+          "Add probe for reading abs-send-time (id: %d, %" GST_PTR_FORMAT ").",
+          abs_send_time_id, pad);
+      gst_pad_add_probe (pad,
+          GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+          kms_base_rtp_endpoint_recv_rtp_hdr_ext_probe, data,
+          recv_hdr_ext_data_destroy);
+    }
   } else {
     GST_ERROR_OBJECT (self, "'%s' not valid", media_str);
     return NULL;
@@ -987,6 +1105,7 @@ static void
 kms_base_rtp_endpoint_create_remb_manager (KmsBaseRtpEndpoint *self,
     KmsBaseRtpSession *sess)
 {
+  KmsRembLocal *rl;
   GstPad *pad;
   int max_recv_bw;
 
@@ -1020,11 +1139,11 @@ kms_base_rtp_endpoint_create_remb_manager (KmsBaseRtpEndpoint *self,
   }
 
   g_object_get (self, "max-video-recv-bandwidth", &max_recv_bw, NULL);
-  self->priv->rl =
-      kms_remb_local_create (rtpsession, self->priv->min_video_recv_bw,
+  rl = kms_remb_local_create (rtpsession, self->priv->min_video_recv_bw,
       max_recv_bw);
-  kms_remb_local_add_remote_session (self->priv->rl, rtpsession,
-      sess->remote_video_ssrc);
+  kms_remb_local_add_remote_session (rl, rtpsession, sess->remote_video_ssrc);
+  /* Published atomically, it is read from the streaming thread */
+  g_atomic_pointer_set (&self->priv->rl, rl);
 
   pad = gst_element_get_static_pad (self->priv->rtpbin, VIDEO_RTPBIN_SEND_RTP_SINK);
   self->priv->rm =
@@ -1230,31 +1349,11 @@ end:
   return depayloader;
 }
 
-static void
-add_mark_data_cb (GstPad * pad, KmsMediaType type, GstClockTimeDiff t,
-    KmsList * meta_data, gpointer user_data)
-{
-  E2EProbeData *data = (E2EProbeData *) user_data;
-  StreamE2EAvgStat *stat;
-
-  stat = kms_list_lookup (meta_data, data->id);
-
-  if (stat != NULL) {
-    GST_WARNING_OBJECT (pad, "Can not mark buffer for e2e latency. "
-        "Already used ID: %s", data->id);
-  } else {
-    /* add mark data to this meta */
-    kms_list_prepend (meta_data, g_strdup (data->id),
-        kms_stats_stream_e2e_avg_stat_ref (data->stat));
-  }
-}
-
 static void
 kms_base_rtp_endpoint_configure_2e2_latency (KmsBaseRtpEndpoint * self,
     GstPad * pad, KmsElementPadType padtype)
 {
   StreamE2EAvgStat *stat;
-  E2EProbeData *data;
   KmsMediaType type;
   gchar *id;
 
@@ -1282,14 +1381,15 @@ kms_base_rtp_endpoint_configure_2e2_latency (KmsBaseRtpEndpoint * self,
     g_hash_table_insert (self->priv->stats.avg_e2e, g_strdup (id), stat);
   }
 
-  data = e2e_probe_data_new ();
-  data->id = id;
-  data->stat = kms_stats_stream_e2e_avg_stat_ref (stat);
+  stat = kms_stats_stream_e2e_avg_stat_ref (stat);
 
   KMS_ELEMENT_UNLOCK (self);
 
-  kms_stats_add_buffer_latency_notification_probe (pad, add_mark_data_cb,
-      TRUE /* lock the data */ , data, (GDestroyNotify) e2e_probe_data_destroy);
+  /* The mark keeps the stat alive until the buffer reaches the connection */
+  kms_stats_add_buffer_latency_mark_probe (pad, id, KMS_REF_STRUCT_CAST (stat));
+
+  kms_stats_stream_e2e_avg_stat_unref (stat);
+  g_free (id);
 }
 
 static void
@@ -1361,15 +1461,23 @@ kms_base_rtp_endpoint_connect_payloader_async (KmsBaseRtpEndpoint * self,
 static void
 kms_base_rtp_endpoint_connect_payloader (KmsBaseRtpEndpoint * self,
     KmsIRtpConnection * conn, KmsElementPadType type, GstElement * payloader,
-    const gchar * rtpbin_pad_name)
+    GstElement * batcher, const gchar * rtpbin_pad_name)
 {
   GstElement *rtpbin = self->priv->rtpbin;
 
-  gst_bin_add (GST_BIN (self), payloader);
+  if (batcher != NULL) {
+    gst_bin_add_many (GST_BIN (self), payloader, batcher, NULL);
+    gst_element_sync_state_with_parent (batcher);
+    gst_element_sync_state_with_parent (payloader);
 
-  gst_element_sync_state_with_parent (payloader);
+    gst_element_link (payloader, batcher);
+    gst_element_link_pads (batcher, "src", rtpbin, rtpbin_pad_name);
+  } else {
+    gst_bin_add (GST_BIN (self), payloader);
+    gst_element_sync_state_with_parent (payloader);
 
-  gst_element_link_pads (payloader, "src", rtpbin, rtpbin_pad_name);
+    gst_element_link_pads (payloader, "src", rtpbin, rtpbin_pad_name);
+  }
 
   kms_base_rtp_endpoint_connect_payloader_async (self, conn, payloader, type);
 }
@@ -1380,19 +1488,22 @@ kms_base_rtp_endpoint_set_media_payloader (KmsBaseRtpEndpoint * self,
     const GstSDPMedia * media)
 {
   const gchar *media_str = gst_sdp_media_get_media (media);
-  GstElement *payloader;
+  GstElement *payloader, *batcher = NULL;
   GstCaps *caps = NULL;
+  SdpMediaIndex *index;
   guint j, f_len;
   const gchar *rtpbin_pad_name;
   KmsElementPadType type;
 
+  index = sdp_utils_media_index_new (media);
   f_len = gst_sdp_media_formats_len (media);
   for (j = 0; j < f_len && caps == NULL; j++) {
     const gchar *pt = gst_sdp_media_get_format (media, j);
-    const gchar *rtpmap = sdp_utils_sdp_media_get_rtpmap (media, pt);
+    const gchar *rtpmap = sdp_utils_media_index_get_rtpmap (index, pt);
 
     caps = kms_base_rtp_endpoint_get_caps_from_rtpmap (media_str, pt, rtpmap);
   }
+  sdp_utils_media_index_free (index);
 
   if (caps == NULL) {
     GST_WARNING_OBJECT (self, "Caps not found for media '%s'", media_str);
@@ -1415,8 +1526,14 @@ kms_base_rtp_endpoint_set_media_payloader (KmsBaseRtpEndpoint * self,
     type = KMS_ELEMENT_PAD_TYPE_AUDIO;
     rtpbin_pad_name = AUDIO_RTPBIN_SEND_RTP_SINK;
   } else if (g_strcmp0 (VIDEO_STREAM_NAME, media_str) == 0) {
+    if (self->priv->rtp_batching) {
+      /* Packets of each frame travel as one buffer list to the connection */
+      batcher = g_object_new (KMS_TYPE_RTP_BATCHER, NULL);
+    }
+
     /* TODO: check if is needed for audio  */
-    kms_base_rtp_endpoint_config_rtp_hdr_ext (self, media, payloader);
+    kms_base_rtp_endpoint_config_rtp_hdr_ext (self, media,
+        batcher != NULL ? batcher : payloader);
     type = KMS_ELEMENT_PAD_TYPE_VIDEO;
     rtpbin_pad_name = VIDEO_RTPBIN_SEND_RTP_SINK;
   } else {
@@ -1429,11 +1546,12 @@ kms_base_rtp_endpoint_set_media_payloader (KmsBaseRtpEndpoint * self,
 
     conn = kms_base_rtp_session_get_connection (sess, handler);
     if (conn == NULL) {
+      g_clear_object (&batcher);
       return;
     }
 
     kms_base_rtp_endpoint_connect_payloader (self, conn, type, payloader,
-        rtpbin_pad_name);
+        batcher, rtpbin_pad_name);
   }
 }
 
@@ -1895,6 +2013,196 @@ rtcp_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
   return GST_PAD_PROBE_OK;
 }
 
+/* Adaptive jitter buffer latency begin */
+
+typedef struct _JbLatencyData
+{
+  GMutex mutex;
+  GstElement *jitterbuffer;     /* Not referenced, it owns this data */
+  KmsLatencyController *ctl;
+  guint clock_rate;
+  GstClockTime now;
+} JbLatencyData;
+
+static JbLatencyData *
+jb_latency_data_new (GstElement * jitterbuffer, guint min_latency,
+    guint max_latency, guint initial_latency)
+{
+  JbLatencyData *data;
+
+  data = g_slice_new0 (JbLatencyData);
+  g_mutex_init (&data->mutex);
+  data->jitterbuffer = jitterbuffer;
+  data->ctl = kms_latency_controller_new (min_latency, max_latency,
+      initial_latency);
+  data->now = GST_CLOCK_TIME_NONE;
+
+  return data;
+}
+
+static void
+jb_latency_data_destroy (JbLatencyData * data)
+{
+  kms_latency_controller_free (data->ctl);
+  g_mutex_clear (&data->mutex);
+  g_slice_free (JbLatencyData, data);
+}
+
+static guint
+jb_latency_data_get_clock_rate (GstPad * pad)
+{
+  GstStructure *st;
+  gint clock_rate = 0;
+  GstCaps *caps;
+
+  caps = gst_pad_get_current_caps (pad);
+  if (caps == NULL) {
+    return 0;
+  }
+
+  st = gst_caps_get_structure (caps, 0);
+  if (!gst_structure_get_int (st, "clock-rate", &clock_rate)) {
+    clock_rate = 0;
+  }
+
+  gst_caps_unref (caps);
+
+  return clock_rate;
+}
+
+static gboolean
+jb_latency_data_process_buffer (GstBuffer ** buf, guint idx,
+    JbLatencyData * data)
+{
+  GstRTPBuffer rtp = { NULL, };
+  GstClockTime arrival;
+  guint32 ts;
+
+  /* rtpbin timestamps incoming packets with their arrival time */
+  arrival = GST_BUFFER_DTS (*buf);
+  if (!GST_CLOCK_TIME_IS_VALID (arrival)) {
+    return TRUE;
+  }
+
+  if (!gst_rtp_buffer_map (*buf, GST_MAP_READ, &rtp)) {
+    return TRUE;
+  }
+
+  ts = gst_rtp_buffer_get_timestamp (&rtp);
+  gst_rtp_buffer_unmap (&rtp);
+
+  kms_latency_controller_process_packet (data->ctl, arrival, ts,
+      data->clock_rate);
+  data->now = arrival;
+
+  return TRUE;
+}
+
+static void
+jb_latency_data_process_rtx_stats (JbLatencyData * data)
+{
+  guint64 rtx_count, rtx_success_count, rtx_rtt;
+  GstStructure *stats;
+
+  g_object_get (data->jitterbuffer, "stats", &stats, NULL);
+  if (stats == NULL) {
+    return;
+  }
+
+  if (gst_structure_get_uint64 (stats, "rtx-count", &rtx_count)
+      && gst_structure_get_uint64 (stats, "rtx-success-count",
+          &rtx_success_count)
+      && gst_structure_get_uint64 (stats, "rtx-rtt", &rtx_rtt)) {
+    g_mutex_lock (&data->mutex);
+    kms_latency_controller_process_rtx_stats (data->ctl, rtx_count,
+        rtx_success_count, rtx_rtt);
+    g_mutex_unlock (&data->mutex);
+  }
+
+  gst_structure_free (stats);
+}
+
+static GstPadProbeReturn
+jb_latency_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  JbLatencyData *data = user_data;
+  gboolean update;
+  guint latency;
+
+  if (data->clock_rate == 0) {
+    data->clock_rate = jb_latency_data_get_clock_rate (pad);
+  }
+
+  g_mutex_lock (&data->mutex);
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+    jb_latency_data_process_buffer (&buffer, 0, data);
+  } else if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    GstBufferList *bufflist = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
+
+    gst_buffer_list_foreach (bufflist,
+        (GstBufferListFunc) jb_latency_data_process_buffer, data);
+  }
+
+  update = kms_latency_controller_needs_update (data->ctl, data->now);
+
+  g_mutex_unlock (&data->mutex);
+
+  if (!update) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  /* Stats are read out of the lock, they take the jitter buffer one */
+  jb_latency_data_process_rtx_stats (data);
+
+  g_mutex_lock (&data->mutex);
+  update = kms_latency_controller_update (data->ctl, data->now, &latency);
+  g_mutex_unlock (&data->mutex);
+
+  if (update) {
+    GST_DEBUG_OBJECT (data->jitterbuffer, "Adapting latency to: %u", latency);
+    g_object_set (data->jitterbuffer, "latency", latency, NULL);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static guint
+kms_base_rtp_endpoint_config_adaptive_latency (KmsBaseRtpEndpoint * self,
+    GstElement * jitterbuffer, guint latency)
+{
+  JbLatencyData *data;
+  GstPad *sink_pad;
+
+  KMS_ELEMENT_LOCK (self);
+
+  if (!self->priv->jb_adaptive) {
+    KMS_ELEMENT_UNLOCK (self);
+    return latency;
+  }
+
+  data = jb_latency_data_new (jitterbuffer, self->priv->jb_min_latency,
+      self->priv->jb_max_latency, latency);
+
+  KMS_ELEMENT_UNLOCK (self);
+
+  g_object_set_qdata_full (G_OBJECT (jitterbuffer), jb_latency_data_quark (),
+      data, (GDestroyNotify) jb_latency_data_destroy);
+
+  sink_pad = gst_element_get_static_pad (jitterbuffer, "sink");
+  gst_pad_add_probe (sink_pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      jb_latency_probe, data, NULL);
+  g_object_unref (sink_pad);
+
+  /* Initial latency within the configured bounds */
+  return kms_latency_controller_get_latency (data->ctl);
+}
+
+/* Adaptive jitter buffer latency end */
+
 static void
 pad_added_jb (GstElement * jitterbuffer, GstPad * new_pad, gpointer sync)
 {
@@ -1907,24 +2215,72 @@ pad_added_jb (GstElement * jitterbuffer, GstPad * new_pad, gpointer sync)
       rtcp_probe, sync, NULL);
 }
 
+static void
+kms_base_rtp_endpoint_add_ssrc_stats (KmsBaseRtpEndpoint * self,
+    GstElement * jitterbuffer, guint session, guint ssrc)
+{
+  KmsRTPSessionStats *rtp_stats;
+  KmsSSRCStats *ssrc_stats;
+
+  KMS_ELEMENT_LOCK (self);
+
+  rtp_stats =
+      g_hash_table_lookup (self->priv->stats.rtp_stats,
+      GUINT_TO_POINTER (session));
+
+  if (rtp_stats != NULL) {
+    ssrc_stats = ssrc_stats_new (ssrc, jitterbuffer);
+    rtp_stats->ssrcs = g_slist_prepend (rtp_stats->ssrcs, ssrc_stats);
+  } else {
+    GST_ERROR_OBJECT (self, "Session %u exists for SSRC %u", session, ssrc);
+  }
+
+  KMS_ELEMENT_UNLOCK (self);
+}
+
 static void
 kms_base_rtp_endpoint_rtpbin_new_jitterbuffer (GstElement * rtpbin,
     GstElement * jitterbuffer,
     guint session, guint ssrc, KmsBaseRtpEndpoint * self)
 {
-  KmsRTPSessionStats *rtp_stats;
-  KmsSSRCStats *ssrc_stats;
   GstPad *src_pad;
+  gboolean bypass;
+  guint latency;
+
+  KMS_ELEMENT_LOCK (self);
+  bypass = self->priv->jb_bypass;
+  KMS_ELEMENT_UNLOCK (self);
+
+  if (bypass) {
+    /* Packets are pushed as they arrive, after a short wait that absorbs */
+    /* reordering and lets retransmitted ones arrive. Ingress losses can  */
+    /* only be repaired here, as the forwarded stream is re-packetized.   */
+    GST_DEBUG_OBJECT (self, "Bypassing jitter buffer of SSRC %u", ssrc);
+    g_object_set (jitterbuffer, "mode", 0 /* none */ ,
+        "latency", JB_BYPASS_LATENCY, NULL);
+    kms_base_rtp_endpoint_add_ssrc_stats (self, jitterbuffer, session, ssrc);
+
+    if (session == VIDEO_RTP_SESSION) {
+      gboolean rtcp_nack = kms_base_rtp_endpoint_is_video_rtcp_nack (self);
+
+      g_object_set (jitterbuffer, "do-lost", TRUE,
+          "do-retransmission", rtcp_nack, "rtx-next-seqnum", FALSE, NULL);
+    }
+
+    return;
+  }
 
   g_object_set (jitterbuffer, "mode", 4 /* synced */ ,
       "latency", JB_INITIAL_LATENCY, NULL);
 
+  latency = kms_base_rtp_endpoint_config_adaptive_latency (self, jitterbuffer,
+      session ==
+      VIDEO_RTP_SESSION ? JB_READY_VIDEO_LATENCY : JB_READY_AUDIO_LATENCY);
+
   src_pad = gst_element_get_static_pad (jitterbuffer, "src");
   gst_pad_add_probe (src_pad,
       GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
-      kms_base_rtp_endpoint_change_latency_probe,
-      GINT_TO_POINTER (session ==
-          VIDEO_RTP_SESSION ? JB_READY_VIDEO_LATENCY : JB_READY_AUDIO_LATENCY),
+      kms_base_rtp_endpoint_change_latency_probe, GINT_TO_POINTER (latency),
       NULL);
   gst_pad_add_probe (src_pad,
       GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
@@ -1940,20 +2296,7 @@ kms_base_rtp_endpoint_rtpbin_new_jitterbuffer (GstElement * rtpbin,
             priv->sync_audio));
   }
 
-  KMS_ELEMENT_LOCK (self);
-
-  rtp_stats =
-      g_hash_table_lookup (self->priv->stats.rtp_stats,
-      GUINT_TO_POINTER (session));
-
-  if (rtp_stats != NULL) {
-    ssrc_stats = ssrc_stats_new (ssrc, jitterbuffer);
-    rtp_stats->ssrcs = g_slist_prepend (rtp_stats->ssrcs, ssrc_stats);
-  } else {
-    GST_ERROR_OBJECT (self, "Session %u exists for SSRC %u", session, ssrc);
-  }
-
-  KMS_ELEMENT_UNLOCK (self);
+  kms_base_rtp_endpoint_add_ssrc_stats (self, jitterbuffer, session, ssrc);
 
   if (session == VIDEO_RTP_SESSION) {
     gboolean rtcp_nack = kms_base_rtp_endpoint_is_video_rtcp_nack (self);
@@ -2005,6 +2348,7 @@ ssrc_stats_add_jitter_stats (GstStructure * ssrc_stats,
 {
   GstStructure *jitter_stats;
   guint percent, latency;
+  JbLatencyData *data;
 
   g_object_get (jitter_buffer, "percent", &percent, "latency", &latency,
       "stats", &jitter_stats, NULL);
@@ -2016,6 +2360,16 @@ ssrc_stats_add_jitter_stats (GstStructure * ssrc_stats,
   gst_structure_set (jitter_stats, "latency", G_TYPE_UINT, latency, "percent",
       G_TYPE_UINT, percent, NULL);
 
+  data = g_object_get_qdata (G_OBJECT (jitter_buffer),
+      jb_latency_data_quark ());
+  if (data != NULL) {
+    g_mutex_lock (&data->mutex);
+    gst_structure_set (jitter_stats, "jitter", G_TYPE_UINT,
+        kms_latency_controller_get_jitter (data->ctl), "target-latency",
+        G_TYPE_UINT, kms_latency_controller_get_target (data->ctl), NULL);
+    g_mutex_unlock (&data->mutex);
+  }
+
   /* Append jitter buffer stats to the ssrc stats */
   gst_structure_set (ssrc_stats, "jitter-buffer", GST_TYPE_STRUCTURE,
       jitter_stats, NULL);
@@ -2341,6 +2695,42 @@ kms_base_rtp_endpoint_set_property (GObject * object, guint property_id,
       self->priv->max_port = v;
       break;
     }
+    case PROP_JB_ADAPTIVE:
+      self->priv->jb_adaptive = g_value_get_boolean (value);
+      break;
+    case PROP_JB_MIN_LATENCY:{
+      guint v = g_value_get_uint (value);
+
+      if (v > self->priv->jb_max_latency) {
+        v = self->priv->jb_max_latency;
+        GST_WARNING_OBJECT (object,
+            "Trying to set min > max. Setting %" G_GUINT32_FORMAT, v);
+      }
+
+      self->priv->jb_min_latency = v;
+      break;
+    }
+    case PROP_JB_MAX_LATENCY:{
+      guint v = g_value_get_uint (value);
+
+      if (v < self->priv->jb_min_latency) {
+        v = self->priv->jb_min_latency;
+        GST_WARNING_OBJECT (object,
+            "Trying to set max < min. Setting %" G_GUINT32_FORMAT, v);
+      }
+
+      self->priv->jb_max_latency = v;
+      break;
+    }
+    case PROP_JB_BYPASS:
+      self->priv->jb_bypass = g_value_get_boolean (value);
+      break;
+    case PROP_RTP_BATCHING:
+      self->priv->rtp_batching = g_value_get_boolean (value);
+      break;
+    case PROP_FEC_GENERATION:
+      self->priv->fec_generation = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -2404,6 +2794,24 @@ kms_base_rtp_endpoint_get_property (GObject * object, guint property_id,
     case PROP_SUPPORT_FEC:
       g_value_set_boolean (value, self->priv->support_fec);
       break;
+    case PROP_JB_ADAPTIVE:
+      g_value_set_boolean (value, self->priv->jb_adaptive);
+      break;
+    case PROP_JB_MIN_LATENCY:
+      g_value_set_uint (value, self->priv->jb_min_latency);
+      break;
+    case PROP_JB_MAX_LATENCY:
+      g_value_set_uint (value, self->priv->jb_max_latency);
+      break;
+    case PROP_JB_BYPASS:
+      g_value_set_boolean (value, self->priv->jb_bypass);
+      break;
+    case PROP_RTP_BATCHING:
+      g_value_set_boolean (value, self->priv->rtp_batching);
+      break;
+    case PROP_FEC_GENERATION:
+      g_value_set_boolean (value, self->priv->fec_generation);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -2741,6 +3149,7 @@ kms_base_rtp_endpoint_class_init (KmsBaseRtpEndpointClass * klass)
   GstElementClass *gstelement_class;
   KmsElementClass *kmselement_class;
   GObjectClass *object_class;
+  const gchar *sampling;
 
   object_class = G_OBJECT_CLASS (klass);
   object_class->constructed = kms_base_rtp_endpoint_constructed;
@@ -2850,6 +3259,47 @@ kms_base_rtp_endpoint_class_init (KmsBaseRtpEndpointClass * klass)
           "Forward error correction supported", FALSE,
           G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (object_class, PROP_JB_ADAPTIVE,
+      g_param_spec_boolean ("jitter-buffer-adaptive",
+          "Adaptive jitter buffer latency",
+          "Retune the latency of new jitter buffers to the measured network "
+          "jitter and retransmission times",
+          DEFAULT_JB_ADAPTIVE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (object_class, PROP_JB_MIN_LATENCY,
+      g_param_spec_uint ("jitter-buffer-min-latency",
+          "Minimum adaptive jitter buffer latency",
+          "Minimum latency (ms) of adaptive jitter buffers",
+          0, G_MAXUINT, DEFAULT_JB_MIN_LATENCY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (object_class, PROP_JB_MAX_LATENCY,
+      g_param_spec_uint ("jitter-buffer-max-latency",
+          "Maximum adaptive jitter buffer latency",
+          "Maximum latency (ms) of adaptive jitter buffers",
+          0, G_MAXUINT, DEFAULT_JB_MAX_LATENCY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (object_class, PROP_JB_BYPASS,
+      g_param_spec_boolean ("jitter-buffer-bypass",
+          "Jitter buffer bypass",
+          "Forward received packets after a short fixed latency, without "
+          "adaptive buffering nor lip-sync timestamping. Meant for endpoints "
+          "whose media is only forwarded to other RTP endpoints",
+          DEFAULT_JB_BYPASS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (object_class, PROP_RTP_BATCHING,
+      g_param_spec_boolean ("rtp-batching", "RTP batching",
+          "Send the video packets of each frame as a single buffer list",
+          DEFAULT_RTP_BATCHING, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (object_class, PROP_FEC_GENERATION,
+      g_param_spec_boolean ("fec-generation", "FEC generation",
+          "Send ULPFEC packets inside RED for the video when they are "
+          "negotiated. Experimental, browsers interoperability is not "
+          "verified yet", DEFAULT_FEC_GENERATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   /* set signals */
   obj_signals[GET_CONNECTION_STATE] =
       g_signal_new ("get-connection_state",
@@ -2901,6 +3351,15 @@ kms_base_rtp_endpoint_class_init (KmsBaseRtpEndpointClass * klass)
   g_type_class_add_private (klass, sizeof (KmsBaseRtpEndpointPrivate));
 
   stats_files_dir = g_getenv ("KURENTO_GENERATE_RTP_PTS_STATS");
+
+  sampling = g_getenv (LATENCY_SAMPLING_ENV_VAR);
+  if (sampling != NULL) {
+    guint64 n = g_ascii_strtoull (sampling, NULL, 10);
+
+    if (n > 0 && n <= G_MAXUINT) {
+      kms_stats_set_latency_sampling (n);
+    }
+  }
 }
 
 static void
@@ -3043,14 +3502,58 @@ kms_base_rtp_endpoint_rtpbin_on_timeout (GstElement * rtpbin,
       KMS_MEDIA_STATE_DISCONNECTED);
 }
 
+static void
+kms_base_rtp_endpoint_update_rr_fraction_lost (KmsBaseRtpEndpoint * self,
+    GstElement * rtpbin, guint ssrc)
+{
+  GObject *rtpsession, *source = NULL;
+  GstStructure *stats;
+  gboolean have_rb = FALSE;
+  guint fraction_lost;
+
+  g_signal_emit_by_name (rtpbin, "get-internal-session", VIDEO_RTP_SESSION,
+      &rtpsession);
+  if (rtpsession == NULL) {
+    return;
+  }
+
+  g_signal_emit_by_name (rtpsession, "get-source-by-ssrc", ssrc, &source);
+  g_object_unref (rtpsession);
+
+  if (source == NULL) {
+    return;
+  }
+
+  g_object_get (source, "stats", &stats, NULL);
+  g_object_unref (source);
+
+  /* Report block about our stream sent by the remote receiver */
+  gst_structure_get (stats, "have-rb", G_TYPE_BOOLEAN, &have_rb, NULL);
+  if (have_rb && gst_structure_get_uint (stats, "rb-fractionlost",
+          &fraction_lost)) {
+    g_atomic_int_set (&self->priv->rr_fraction_lost, fraction_lost);
+  }
+
+  gst_structure_free (stats);
+}
+
 static void
 kms_base_rtp_endpoint_rtpbin_on_ssrc_active (GstElement * rtpbin,
     guint session, guint ssrc, gpointer user_data)
 {
   KmsBaseRtpEndpoint *self = KMS_BASE_RTP_ENDPOINT (user_data);
+  gboolean fec_generation;
 
   kms_base_rtp_endpoint_set_media_state (self, session,
       KMS_MEDIA_STATE_CONNECTED);
+
+  KMS_ELEMENT_LOCK (self);
+  fec_generation = self->priv->fec_generation;
+  KMS_ELEMENT_UNLOCK (self);
+
+  if (fec_generation && session == VIDEO_RTP_SESSION) {
+    kms_base_rtp_endpoint_update_rr_fraction_lost (self, rtpbin, ssrc);
+  }
 }
 
 static GstElement *
@@ -3116,8 +3619,7 @@ kms_base_rtp_endpoint_create_aux_receiver (KmsBaseRtpEndpoint * self,
   }
 
   if (edata->ulpfec_pt != 0) {
-    e = gst_element_factory_make ("ulpfecdec", NULL);
-    g_object_set (e, "pt", edata->ulpfec_pt, NULL);
+    e = g_object_new (KMS_TYPE_FEC_DEC, "pt", edata->ulpfec_pt, NULL);
     list = g_slist_prepend (list, e);
   }
 
@@ -3167,6 +3669,24 @@ kms_base_rtp_endpoint_rtpbin_request_aux_receiver (GstElement * rtpbin,
   return receiver;
 }
 
+static guint
+kms_base_rtp_endpoint_get_fraction_lost (gpointer user_data)
+{
+  KmsBaseRtpEndpoint *self = KMS_BASE_RTP_ENDPOINT (user_data);
+  KmsRembLocal *rl = g_atomic_pointer_get (&self->priv->rl);
+  guint fraction_lost;
+
+  /* Losses reported by the receiver of this stream */
+  fraction_lost = g_atomic_int_get (&self->priv->rr_fraction_lost);
+
+  if (rl != NULL) {
+    /* Losses of the received video, only measured with REMB */
+    fraction_lost = MAX (fraction_lost, kms_remb_local_get_fraction_lost (rl));
+  }
+
+  return fraction_lost;
+}
+
 static GstElement *
 kms_base_rtp_endpoint_create_aux_sender (KmsBaseRtpEndpoint * self,
     guint session, ExtData * edata)
@@ -3190,10 +3710,20 @@ kms_base_rtp_endpoint_create_aux_sender (KmsBaseRtpEndpoint * self,
   }
 
   if (edata->ulpfec_pt != 0) {
-    e = gst_element_factory_make ("ulpfecenc", NULL);
+    e = g_object_new (KMS_TYPE_FEC_ENC, NULL);
+
     /* FIXME: Chrome does not seem to work well with FEC packages generated */
-    /* in our side. Uncomment this when this issue is fixed.                */
-//    g_object_set (e, "pt", edata->ulpfec_pt, NULL);
+    /* in our side. Keep them behind fec-generation until this is verified. */
+    /* Browsers only accept FEC packets inside RED. Protection follows the  */
+    /* losses reported for this stream and the ones of the received video, */
+    /* so nothing is added while there are none.                           */
+    if (self->priv->fec_generation && edata->red_pt != 0 &&
+        session == VIDEO_RTP_SESSION) {
+      g_object_set (e, "pt", edata->ulpfec_pt, NULL);
+      kms_fec_enc_set_loss_func (KMS_FEC_ENC (e),
+          kms_base_rtp_endpoint_get_fraction_lost, self, NULL);
+    }
+
     list = g_slist_prepend (list, e);
   }
 
@@ -3277,6 +3807,14 @@ kms_base_rtp_endpoint_init (KmsBaseRtpEndpoint * self)
   self->priv->min_video_send_bw = MIN_VIDEO_SEND_BW_DEFAULT;
   self->priv->max_video_send_bw = MAX_VIDEO_SEND_BW_DEFAULT;
 
+  self->priv->jb_adaptive = DEFAULT_JB_ADAPTIVE;
+  self->priv->jb_min_latency = DEFAULT_JB_MIN_LATENCY;
+  self->priv->jb_max_latency = DEFAULT_JB_MAX_LATENCY;
+  self->priv->jb_bypass = DEFAULT_JB_BYPASS;
+
+  self->priv->rtp_batching = DEFAULT_RTP_BATCHING;
+  self->priv->fec_generation = DEFAULT_FEC_GENERATION;
+
   self->priv->rtpbin = gst_element_factory_make ("rtpbin", NULL);
 
   g_signal_connect (self->priv->rtpbin, "request-pt-map",
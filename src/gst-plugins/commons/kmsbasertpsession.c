@@ -188,30 +188,45 @@ kms_base_rtp_session_create_bundle_connection_default (KmsBaseRtpSession *
   return NULL;
 }
 
+typedef struct _E2ELatencyData
+{
+  const gchar *name;
+  GstClockTimeDiff t;
+} E2ELatencyData;
+
+static void
+kms_base_rtp_session_update_e2e_stat (GQuark id, GstClockTime ts,
+    KmsRefStruct * data, E2ELatencyData * e2e)
+{
+  StreamE2EAvgStat *stat;
+
+  if (data == NULL || !g_str_has_prefix (g_quark_to_string (id), e2e->name)) {
+    /* This element did not add this mark to the metada */
+    return;
+  }
+
+  stat = (StreamE2EAvgStat *) data;
+  stat->avg = KMS_STATS_CALCULATE_LATENCY_AVG (e2e->t, stat->avg);
+}
+
 static void
 kms_base_rtp_session_e2e_latency_cb (GstPad * pad, KmsMediaType type,
-    GstClockTimeDiff t, KmsList * mdata, gpointer user_data)
+    GstClockTimeDiff t, KmsBufferLatencyMeta * meta, gpointer user_data)
 {
   KmsBaseRtpSession *self = KMS_BASE_RTP_SESSION (user_data);
-  KmsListIter iter;
-  gpointer key, value;
+  E2ELatencyData e2e;
   gchar *name;
 
   name = gst_element_get_name (KMS_SDP_SESSION (self)->ep);
 
-  kms_list_iter_init (&iter, mdata);
-  while (kms_list_iter_next (&iter, &key, &value)) {
-    gchar *id = (gchar *) key;
-    StreamE2EAvgStat *stat;
+  e2e.name = name;
+  e2e.t = t;
 
-    if (!g_str_has_prefix (id, name)) {
-      /* This element did not add this mark to the metada */
-      continue;
-    }
+  /* Marks are read lock-free */
+  kms_buffer_latency_meta_foreach_mark (meta,
+      (KmsBufferLatencyMarkFunc) kms_base_rtp_session_update_e2e_stat, &e2e);
 
-    stat = (StreamE2EAvgStat *) value;
-    stat->avg = KMS_STATS_CALCULATE_LATENCY_AVG (t, stat->avg);
-  }
+  g_free (name);
 }
 
 static void
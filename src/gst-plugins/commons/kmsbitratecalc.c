@@ -0,0 +1,133 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "kmsbitratecalc.h"
+
+#define KMS_BITRATE_CALC_INDEX(calc, i) \
+  (((calc)->first + (i)) % KMS_BITRATE_CALC_WINDOW_SIZE)
+
+static void
+kms_bitrate_calc_remove_first (KmsBitrateCalc * calc)
+{
+  calc->total_size -= calc->sizes[calc->first];
+  calc->first = KMS_BITRATE_CALC_INDEX (calc, 1);
+  calc->count--;
+}
+
+static void
+kms_bitrate_calc_compute (KmsBitrateCalc * calc)
+{
+  GstClockTime first, last, diff;
+
+  first = calc->times[calc->first];
+  last = calc->times[KMS_BITRATE_CALC_INDEX (calc, calc->count - 1)];
+
+  /* Remove samples out of the window */
+  while (calc->count > 1 && last - first > calc->interval) {
+    kms_bitrate_calc_remove_first (calc);
+    first = calc->times[calc->first];
+  }
+
+  /* The first sample only opens the interval, the data sent during it is
+   * the one of the following samples */
+  diff = last - first;
+  if (diff == 0) {
+    calc->bitrate = 0;
+  } else {
+    calc->bitrate = gst_util_uint64_scale ((calc->total_size -
+            calc->sizes[calc->first]) * 8, GST_SECOND, diff);
+  }
+}
+
+void
+kms_bitrate_calc_init (KmsBitrateCalc * calc, GstClockTime interval)
+{
+  calc->interval = interval;
+  kms_bitrate_calc_reset (calc);
+}
+
+void
+kms_bitrate_calc_reset (KmsBitrateCalc * calc)
+{
+  calc->first = 0;
+  calc->count = 0;
+  calc->total_size = 0;
+  calc->bitrate = 0;
+}
+
+void
+kms_bitrate_calc_update (KmsBitrateCalc * calc, GstClockTime time, gsize size)
+{
+  guint last;
+
+  if (calc->count > 0) {
+    last = KMS_BITRATE_CALC_INDEX (calc, calc->count - 1);
+
+    if (!GST_CLOCK_TIME_IS_VALID (time) || time <= calc->times[last]) {
+      /* Not timestamped or not increasing: account it in the last sample */
+      calc->sizes[last] += size;
+      calc->total_size += size;
+      kms_bitrate_calc_compute (calc);
+      return;
+    }
+  } else if (!GST_CLOCK_TIME_IS_VALID (time)) {
+    return;
+  }
+
+  if (calc->count == KMS_BITRATE_CALC_WINDOW_SIZE) {
+    kms_bitrate_calc_remove_first (calc);
+  }
+
+  last = KMS_BITRATE_CALC_INDEX (calc, calc->count);
+  calc->times[last] = time;
+  calc->sizes[last] = size;
+  calc->total_size += size;
+  calc->count++;
+
+  kms_bitrate_calc_compute (calc);
+}
+
+void
+kms_bitrate_calc_update_buffer (KmsBitrateCalc * calc, GstBuffer * buffer)
+{
+  GstClockTime time = GST_BUFFER_DTS (buffer);
+
+  if (!GST_CLOCK_TIME_IS_VALID (time)) {
+    time = GST_BUFFER_PTS (buffer);
+  }
+
+  kms_bitrate_calc_update (calc, time, gst_buffer_get_size (buffer));
+}
+
+void
+kms_bitrate_calc_update_buffer_list (KmsBitrateCalc * calc,
+    GstBufferList * list)
+{
+  guint i, len;
+
+  len = gst_buffer_list_length (list);
+
+  for (i = 0; i < len; i++) {
+    kms_bitrate_calc_update_buffer (calc, gst_buffer_list_get (list, i));
+  }
+}
+
+guint
+kms_bitrate_calc_get_bitrate (KmsBitrateCalc * calc)
+{
+  return calc->bitrate;
+}
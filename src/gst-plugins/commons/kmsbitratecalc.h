@@ -0,0 +1,64 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_BITRATE_CALC_H__
+#define __KMS_BITRATE_CALC_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define KMS_BITRATE_CALC_WINDOW_SIZE 128
+
+typedef struct _KmsBitrateCalc KmsBitrateCalc;
+
+/**
+ * KmsBitrateCalc:
+ *
+ * Sliding window bitrate estimator. Samples are kept in a fixed-size ring
+ * so updates are O(1) and never allocate. It is meant to be embedded in
+ * the private structure of the element using it.
+ */
+struct _KmsBitrateCalc
+{
+  /*< private >*/
+  GstClockTime interval;
+
+  GstClockTime times[KMS_BITRATE_CALC_WINDOW_SIZE];
+  gsize sizes[KMS_BITRATE_CALC_WINDOW_SIZE];
+  guint first;
+  guint count;
+
+  guint64 total_size;
+  guint bitrate;                /* bps */
+};
+
+void kms_bitrate_calc_init (KmsBitrateCalc * calc, GstClockTime interval);
+void kms_bitrate_calc_reset (KmsBitrateCalc * calc);
+
+void kms_bitrate_calc_update (KmsBitrateCalc * calc, GstClockTime time,
+    gsize size);
+void kms_bitrate_calc_update_buffer (KmsBitrateCalc * calc,
+    GstBuffer * buffer);
+void kms_bitrate_calc_update_buffer_list (KmsBitrateCalc * calc,
+    GstBufferList * list);
+
+guint kms_bitrate_calc_get_bitrate (KmsBitrateCalc * calc);
+
+G_END_DECLS
+
+#endif /* __KMS_BITRATE_CALC_H__ */
@@ -18,6 +18,8 @@
 #include "kmsrefstruct.h"
 #include "kmsbufferlacentymeta.h"
 
+#include <string.h>
+
 GType
 kms_buffer_latency_meta_api_get_type (void)
 {
@@ -42,18 +44,29 @@ kms_buffer_latency_meta_init (GstMeta * meta, gpointer params,
   lmeta->ts = GST_CLOCK_TIME_NONE;
   lmeta->valid = FALSE;
 
-  g_rec_mutex_init (&lmeta->datamutex);
-  lmeta->data = kms_list_new_full (g_str_equal, g_free,
-      (GDestroyNotify) kms_ref_struct_unref);
+  /* No allocation, it only costs clearing a word */
+  g_mutex_init (&lmeta->mutex);
+  lmeta->data = NULL;
+  lmeta->n_marks = 0;
+  memset (lmeta->marks, 0, sizeof (lmeta->marks));
+  lmeta->overflow = NULL;
 
   return TRUE;
 }
 
+static void
+copy_mark (GQuark id, GstClockTime ts, KmsRefStruct * data,
+    KmsBufferLatencyMeta * new_meta)
+{
+  kms_buffer_latency_meta_add_mark_full (new_meta, id, ts, data);
+}
+
 static gboolean
 kms_buffer_latency_meta_transform (GstBuffer * transbuf, GstMeta * meta,
     GstBuffer * buffer, GQuark type, gpointer data)
 {
   KmsBufferLatencyMeta *new_meta, *lmeta;
+  KmsList *mdata;
 
   /* we always copy no matter what transform */
   if (!GST_META_TRANSFORM_IS_COPY (type)) {
@@ -68,13 +81,13 @@ kms_buffer_latency_meta_transform (GstBuffer * transbuf, GstMeta * meta,
     return FALSE;
   }
 
-  if (new_meta->data != NULL) {
-    kms_list_unref (new_meta->data);
+  mdata = g_atomic_pointer_get (&lmeta->data);
+  if (mdata != NULL) {
+    new_meta->data = kms_list_ref (mdata);
   }
 
-  KMS_BUFFER_LATENCY_DATA_LOCK (lmeta);
-  new_meta->data = kms_list_ref (lmeta->data);
-  KMS_BUFFER_LATENCY_DATA_UNLOCK (lmeta);
+  kms_buffer_latency_meta_foreach_mark (lmeta,
+      (KmsBufferLatencyMarkFunc) copy_mark, new_meta);
 
   return TRUE;
 }
@@ -83,12 +96,33 @@ static void
 kms_buffer_latency_meta_free (GstMeta * meta, GstBuffer * buffer)
 {
   KmsBufferLatencyMeta *lmeta = (KmsBufferLatencyMeta *) meta;
+  KmsBufferLatencyMark *mark;
+  gint i, n;
+
+  if (lmeta->data != NULL) {
+    kms_list_unref (lmeta->data);
+  }
 
-  KMS_BUFFER_LATENCY_DATA_LOCK (lmeta);
-  kms_list_unref (lmeta->data);
-  KMS_BUFFER_LATENCY_DATA_UNLOCK (lmeta);
+  /* Nobody else can be adding marks to a buffer being freed */
+  n = MIN (lmeta->n_marks, KMS_BUFFER_LATENCY_MAX_MARKS);
+  for (i = 0; i < n; i++) {
+    if (lmeta->marks[i].data != NULL) {
+      kms_ref_struct_unref (lmeta->marks[i].data);
+    }
+  }
 
-  g_rec_mutex_clear (&lmeta->datamutex);
+  while (lmeta->overflow != NULL) {
+    mark = lmeta->overflow;
+    lmeta->overflow = mark->next;
+
+    if (mark->data != NULL) {
+      kms_ref_struct_unref (mark->data);
+    }
+
+    g_slice_free (KmsBufferLatencyMark, mark);
+  }
+
+  g_mutex_clear (&lmeta->mutex);
 }
 
 const GstMetaInfo *
@@ -127,3 +161,129 @@ kms_buffer_add_buffer_latency_meta (GstBuffer * buffer, GstClockTime ts,
 
   return meta;
 }
+
+KmsList *
+kms_buffer_latency_meta_get_data (KmsBufferLatencyMeta * meta)
+{
+  KmsList *mdata;
+
+  mdata = g_atomic_pointer_get (&meta->data);
+  if (mdata != NULL) {
+    return mdata;
+  }
+
+  mdata = kms_list_new_full (g_str_equal, g_free,
+      (GDestroyNotify) kms_ref_struct_unref);
+
+  if (!g_atomic_pointer_compare_and_exchange (&meta->data, NULL, mdata)) {
+    /* Created by other thread meanwhile */
+    kms_list_unref (mdata);
+    mdata = g_atomic_pointer_get (&meta->data);
+  }
+
+  return mdata;
+}
+
+gboolean
+kms_buffer_latency_meta_add_mark (KmsBufferLatencyMeta * meta, GQuark id,
+    GstClockTime ts)
+{
+  return kms_buffer_latency_meta_add_mark_full (meta, id, ts, NULL);
+}
+
+static void
+kms_buffer_latency_meta_push_overflow (KmsBufferLatencyMeta * meta,
+    GQuark id, GstClockTime ts, KmsRefStruct * data)
+{
+  KmsBufferLatencyMark *mark;
+
+  mark = g_slice_new (KmsBufferLatencyMark);
+  mark->id = id;
+  mark->ts = ts;
+  mark->data = data;
+
+  /* Marks are never removed while the meta is alive, so there is no ABA */
+  do {
+    mark->next = g_atomic_pointer_get (&meta->overflow);
+  } while (!g_atomic_pointer_compare_and_exchange (&meta->overflow, mark->next,
+          mark));
+}
+
+gboolean
+kms_buffer_latency_meta_add_mark_full (KmsBufferLatencyMeta * meta, GQuark id,
+    GstClockTime ts, KmsRefStruct * data)
+{
+  gint idx;
+
+  g_return_val_if_fail (id != 0, FALSE);
+
+  if (data != NULL) {
+    data = kms_ref_struct_ref (data);
+  }
+
+  idx = g_atomic_int_add (&meta->n_marks, 1);
+  if (idx >= KMS_BUFFER_LATENCY_MAX_MARKS) {
+    /* Buffers shared by many branches, such as tee outputs */
+    kms_buffer_latency_meta_push_overflow (meta, id, ts, data);
+    return TRUE;
+  }
+
+  /* Readers skip the slot until its id is published */
+  meta->marks[idx].ts = ts;
+  meta->marks[idx].data = data;
+  g_atomic_int_set ((gint *) & meta->marks[idx].id, (gint) id);
+
+  return TRUE;
+}
+
+void
+kms_buffer_latency_meta_foreach_mark (KmsBufferLatencyMeta * meta,
+    KmsBufferLatencyMarkFunc func, gpointer user_data)
+{
+  KmsBufferLatencyMark *mark;
+  gint i, n;
+
+  n = MIN (g_atomic_int_get (&meta->n_marks), KMS_BUFFER_LATENCY_MAX_MARKS);
+
+  for (i = 0; i < n; i++) {
+    GQuark id = (GQuark) g_atomic_int_get ((gint *) & meta->marks[i].id);
+
+    if (id != 0) {
+      func (id, meta->marks[i].ts, meta->marks[i].data, user_data);
+    }
+  }
+
+  for (mark = g_atomic_pointer_get (&meta->overflow); mark != NULL;
+      mark = mark->next) {
+    func (mark->id, mark->ts, mark->data, user_data);
+  }
+}
+
+typedef struct _FindMarkData
+{
+  GQuark id;
+  GstClockTime ts;
+} FindMarkData;
+
+static void
+find_mark (GQuark id, GstClockTime ts, KmsRefStruct * data,
+    FindMarkData * fdata)
+{
+  if (id == fdata->id && !GST_CLOCK_TIME_IS_VALID (fdata->ts)) {
+    fdata->ts = ts;
+  }
+}
+
+GstClockTime
+kms_buffer_latency_meta_get_mark (KmsBufferLatencyMeta * meta, GQuark id)
+{
+  FindMarkData fdata;
+
+  fdata.id = id;
+  fdata.ts = GST_CLOCK_TIME_NONE;
+
+  kms_buffer_latency_meta_foreach_mark (meta,
+      (KmsBufferLatencyMarkFunc) find_mark, &fdata);
+
+  return fdata.ts;
+}
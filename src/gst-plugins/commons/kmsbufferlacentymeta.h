@@ -22,15 +22,39 @@
 
 #include "kmsmediatype.h"
 #include "kmslist.h"
+#include "kmsrefstruct.h"
 
 G_BEGIN_DECLS
 
 typedef struct _KmsBufferLatencyMeta KmsBufferLatencyMeta;
+typedef struct _KmsBufferLatencyMark KmsBufferLatencyMark;
+
+#define KMS_BUFFER_LATENCY_MAX_MARKS 8
+
+/**
+ * KmsBufferLatencyMark:
+ * @id: quark identifying who set the mark, 0 while it is being written
+ * @ts: The time stamp
+ * @data: optional data of who set the mark, kept alive by the mark
+ * @next: next mark that did not fit in the meta array
+ */
+struct _KmsBufferLatencyMark {
+  GQuark id;
+  GstClockTime ts;
+  KmsRefStruct *data;
+  KmsBufferLatencyMark *next;
+};
 
 /**
  * KmsBufferLatencyMeta:
  * @meta: the parent type
  * @ts: The time stamp
+ * @mutex: protects @data
+ * @data: extra data, created on first use by
+ * kms_buffer_latency_meta_get_data()
+ * @n_marks: number of marks appended, it can exceed the array size
+ * @marks: timestamps set by the elements the buffer went through
+ * @overflow: marks added once @marks is full, newest first
  *
  * Buffer metadata for measuring buffer latency since the buffer is generated
  * until it is processed by a sink.
@@ -42,14 +66,18 @@ struct _KmsBufferLatencyMeta {
   KmsMediaType type;
   gboolean valid;
 
-  GRecMutex datamutex;
+  GMutex mutex;
   KmsList *data; /* <string, refstruct> */
+
+  gint n_marks;
+  KmsBufferLatencyMark marks[KMS_BUFFER_LATENCY_MAX_MARKS];
+  KmsBufferLatencyMark *overflow;
 };
 
 #define KMS_BUFFER_LATENCY_DATA_LOCK(mdata) \
-  (g_rec_mutex_lock (&((KmsBufferLatencyMeta *)mdata)->datamutex))
+  (g_mutex_lock (&((KmsBufferLatencyMeta *)mdata)->mutex))
 #define KMS_BUFFER_LATENCY_DATA_UNLOCK(mdata) \
-  (g_rec_mutex_unlock (&((KmsBufferLatencyMeta *)mdata)->datamutex))
+  (g_mutex_unlock (&((KmsBufferLatencyMeta *)mdata)->mutex))
 
 GType kms_buffer_latency_meta_api_get_type (void);
 #define KMS_BUFFER_LATENCY_META_API_TYPE \
@@ -65,6 +93,22 @@ const GstMetaInfo *kms_buffer_latency_meta_get_info (void);
 KmsBufferLatencyMeta * kms_buffer_add_buffer_latency_meta (GstBuffer *buffer,
   GstClockTime ts, gboolean valid, KmsMediaType type);
 
+KmsList * kms_buffer_latency_meta_get_data (KmsBufferLatencyMeta *meta);
+
+typedef void (*KmsBufferLatencyMarkFunc) (GQuark id, GstClockTime ts,
+  KmsRefStruct *data, gpointer user_data);
+
+/* Lock-free, marks beyond KMS_BUFFER_LATENCY_MAX_MARKS are allocated */
+gboolean kms_buffer_latency_meta_add_mark (KmsBufferLatencyMeta *meta,
+  GQuark id, GstClockTime ts);
+/* The mark takes a reference to data, which can be NULL */
+gboolean kms_buffer_latency_meta_add_mark_full (KmsBufferLatencyMeta *meta,
+  GQuark id, GstClockTime ts, KmsRefStruct *data);
+GstClockTime kms_buffer_latency_meta_get_mark (KmsBufferLatencyMeta *meta,
+  GQuark id);
+void kms_buffer_latency_meta_foreach_mark (KmsBufferLatencyMeta *meta,
+  KmsBufferLatencyMarkFunc func, gpointer user_data);
+
 G_END_DECLS
 
 #endif /* __KMS_BUFFER_LATENCY_META_H__ */
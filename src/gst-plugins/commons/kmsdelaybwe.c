@@ -0,0 +1,431 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "kmsdelaybwe.h"
+#include "kmsbitratecalc.h"
+
+/* Packets sent within this interval belong to the same group */
+#define BURST_INTERVAL (5 * GST_MSECOND)
+/* Groups arriving further apart than this restart the trendline */
+#define STREAM_TIMEOUT (2 * GST_SECOND)
+#define INCOMING_BITRATE_INTERVAL (500 * GST_MSECOND)
+
+#define TRENDLINE_WINDOW_SIZE 20
+#define TRENDLINE_SMOOTHING 0.9
+#define TRENDLINE_THRESHOLD_GAIN 4.0
+#define TRENDLINE_MAX_DELTAS 60
+
+#define OVERUSE_TIME_THRESHOLD 10.0     /* ms */
+#define THRESHOLD_INITIAL 12.5  /* ms */
+#define THRESHOLD_MIN 6.0       /* ms */
+#define THRESHOLD_MAX 600.0     /* ms */
+#define THRESHOLD_K_UP 0.0087
+#define THRESHOLD_K_DOWN 0.039
+#define THRESHOLD_MAX_ADAPT_TIME 100.0  /* ms */
+#define THRESHOLD_MAX_ADAPT_DIFF 15.0   /* ms */
+
+#define RATE_DECREASE_FACTOR 0.85
+#define RATE_DECREASE_INTERVAL (200 * GST_MSECOND)
+#define RATE_MULTIPLICATIVE_INCREASE 0.08       /* per second */
+#define RATE_ADDITIVE_INCREASE 48000    /* bps per second */
+#define RATE_MIN_INCREASE 1000  /* bps per second */
+#define RATE_NEAR_CAPACITY_FACTOR 0.9
+#define RATE_MAX_INCOMING_FACTOR 1.5
+#define RATE_MAX_INCOMING_MARGIN 10000  /* bps */
+
+typedef enum
+{
+  RATE_HOLD,
+  RATE_INCREASE,
+  RATE_DECREASE
+} RateState;
+
+typedef struct _PacketGroup
+{
+  gboolean valid;
+  GstClockTime first_send;
+  GstClockTime last_send;
+  GstClockTime last_arrival;
+} PacketGroup;
+
+struct _KmsDelayBwe
+{
+  guint min_bitrate;
+  guint max_bitrate;
+
+  PacketGroup current;
+  PacketGroup previous;
+
+  /* Trendline filter */
+  GstClockTime first_arrival;
+  gdouble accumulated_delay;
+  gdouble smoothed_delay;
+  gdouble times[TRENDLINE_WINDOW_SIZE];
+  gdouble delays[TRENDLINE_WINDOW_SIZE];
+  guint first;
+  guint count;
+  guint num_deltas;
+
+  /* Overuse detector */
+  KmsDelayBweUsage usage;
+  gdouble threshold;
+  gdouble prev_trend;
+  gdouble time_over_using;
+  gint overuse_counter;
+  GstClockTime last_threshold_update;
+
+  /* AIMD rate controller */
+  RateState state;
+  guint estimate;
+  guint link_capacity;
+  GstClockTime last_rate_update;
+  GstClockTime last_decrease;
+
+  KmsBitrateCalc incoming;
+};
+
+static void
+kms_delay_bwe_reset_trendline (KmsDelayBwe * bwe)
+{
+  bwe->first_arrival = GST_CLOCK_TIME_NONE;
+  bwe->accumulated_delay = 0;
+  bwe->smoothed_delay = 0;
+  bwe->first = 0;
+  bwe->count = 0;
+  bwe->num_deltas = 0;
+  bwe->prev_trend = 0;
+}
+
+/* Returns the modified trend: slope scaled by gain and number of deltas */
+static gdouble
+kms_delay_bwe_update_trendline (KmsDelayBwe * bwe, gdouble delay_delta,
+    GstClockTime arrival_time)
+{
+  gdouble avg_x = 0, avg_y = 0, num = 0, den = 0, slope;
+  guint i, idx;
+
+  if (!GST_CLOCK_TIME_IS_VALID (bwe->first_arrival)) {
+    bwe->first_arrival = arrival_time;
+  }
+
+  bwe->num_deltas = MIN (bwe->num_deltas + 1, TRENDLINE_MAX_DELTAS);
+  bwe->accumulated_delay += delay_delta;
+  bwe->smoothed_delay = TRENDLINE_SMOOTHING * bwe->smoothed_delay +
+      (1 - TRENDLINE_SMOOTHING) * bwe->accumulated_delay;
+
+  if (bwe->count == TRENDLINE_WINDOW_SIZE) {
+    bwe->first = (bwe->first + 1) % TRENDLINE_WINDOW_SIZE;
+    bwe->count--;
+  }
+
+  idx = (bwe->first + bwe->count) % TRENDLINE_WINDOW_SIZE;
+  bwe->times[idx] =
+      (gdouble) (arrival_time - bwe->first_arrival) / GST_MSECOND;
+  bwe->delays[idx] = bwe->smoothed_delay;
+  bwe->count++;
+
+  if (bwe->count < TRENDLINE_WINDOW_SIZE) {
+    return 0;
+  }
+
+  /* Least squares fit of the smoothed delay against arrival time */
+  for (i = 0; i < bwe->count; i++) {
+    avg_x += bwe->times[i];
+    avg_y += bwe->delays[i];
+  }
+  avg_x /= bwe->count;
+  avg_y /= bwe->count;
+
+  for (i = 0; i < bwe->count; i++) {
+    num += (bwe->times[i] - avg_x) * (bwe->delays[i] - avg_y);
+    den += (bwe->times[i] - avg_x) * (bwe->times[i] - avg_x);
+  }
+
+  if (den == 0) {
+    return 0;
+  }
+
+  slope = num / den;
+
+  return slope * bwe->num_deltas * TRENDLINE_THRESHOLD_GAIN;
+}
+
+static void
+kms_delay_bwe_update_threshold (KmsDelayBwe * bwe, gdouble trend,
+    GstClockTime now)
+{
+  gdouble abs_trend = ABS (trend);
+  gdouble k, elapsed;
+
+  if (!GST_CLOCK_TIME_IS_VALID (bwe->last_threshold_update)) {
+    bwe->last_threshold_update = now;
+  }
+
+  if (abs_trend > bwe->threshold + THRESHOLD_MAX_ADAPT_DIFF) {
+    /* Spikes are not allowed to move the threshold */
+    bwe->last_threshold_update = now;
+    return;
+  }
+
+  k = abs_trend < bwe->threshold ? THRESHOLD_K_DOWN : THRESHOLD_K_UP;
+  elapsed = (gdouble) (now - bwe->last_threshold_update) / GST_MSECOND;
+  elapsed = MIN (elapsed, THRESHOLD_MAX_ADAPT_TIME);
+
+  bwe->threshold += k * (abs_trend - bwe->threshold) * elapsed;
+  bwe->threshold = CLAMP (bwe->threshold, THRESHOLD_MIN, THRESHOLD_MAX);
+  bwe->last_threshold_update = now;
+}
+
+static void
+kms_delay_bwe_detect (KmsDelayBwe * bwe, gdouble trend, gdouble send_delta,
+    GstClockTime now)
+{
+  if (trend > bwe->threshold) {
+    if (bwe->time_over_using < 0) {
+      bwe->time_over_using = send_delta / 2;
+    } else {
+      bwe->time_over_using += send_delta;
+    }
+    bwe->overuse_counter++;
+
+    if (bwe->time_over_using > OVERUSE_TIME_THRESHOLD
+        && bwe->overuse_counter > 1 && trend >= bwe->prev_trend) {
+      bwe->time_over_using = 0;
+      bwe->overuse_counter = 0;
+      bwe->usage = KMS_DELAY_BWE_OVERUSING;
+    }
+  } else if (trend < -bwe->threshold) {
+    bwe->time_over_using = -1;
+    bwe->overuse_counter = 0;
+    bwe->usage = KMS_DELAY_BWE_UNDERUSING;
+  } else {
+    bwe->time_over_using = -1;
+    bwe->overuse_counter = 0;
+    bwe->usage = KMS_DELAY_BWE_NORMAL;
+  }
+
+  bwe->prev_trend = trend;
+  kms_delay_bwe_update_threshold (bwe, trend, now);
+}
+
+static guint
+kms_delay_bwe_clamp (KmsDelayBwe * bwe, gdouble bitrate)
+{
+  if (bwe->max_bitrate > 0 && bitrate > bwe->max_bitrate) {
+    bitrate = bwe->max_bitrate;
+  }
+
+  return MAX (bitrate, bwe->min_bitrate);
+}
+
+static void
+kms_delay_bwe_update_rate (KmsDelayBwe * bwe, GstClockTime now)
+{
+  guint incoming = kms_bitrate_calc_get_bitrate (&bwe->incoming);
+  gdouble elapsed, bitrate;
+
+  switch (bwe->usage) {
+    case KMS_DELAY_BWE_OVERUSING:
+      if (!GST_CLOCK_TIME_IS_VALID (bwe->last_decrease)
+          || now - bwe->last_decrease >= RATE_DECREASE_INTERVAL) {
+        bwe->state = RATE_DECREASE;
+      }
+      break;
+    case KMS_DELAY_BWE_UNDERUSING:
+      /* Queues are draining, do not add more traffic yet */
+      bwe->state = RATE_HOLD;
+      break;
+    case KMS_DELAY_BWE_NORMAL:
+      if (bwe->state == RATE_HOLD) {
+        bwe->state = RATE_INCREASE;
+      }
+      break;
+  }
+
+  if (!GST_CLOCK_TIME_IS_VALID (bwe->last_rate_update)) {
+    bwe->last_rate_update = now;
+  }
+  elapsed = (gdouble) MIN (now - bwe->last_rate_update, GST_SECOND)
+      / GST_SECOND;
+  bwe->last_rate_update = now;
+
+  switch (bwe->state) {
+    case RATE_HOLD:
+      break;
+    case RATE_INCREASE:
+      if (bwe->estimate == 0) {
+        /* No congestion seen yet, the estimate is not limiting */
+        break;
+      }
+
+      bitrate = bwe->estimate;
+      if (bitrate > bwe->link_capacity * RATE_NEAR_CAPACITY_FACTOR) {
+        bitrate += RATE_ADDITIVE_INCREASE * elapsed;
+      } else {
+        bitrate += MAX (bitrate * RATE_MULTIPLICATIVE_INCREASE,
+            RATE_MIN_INCREASE) * elapsed;
+      }
+
+      if (incoming > 0) {
+        bitrate = MIN (bitrate,
+            incoming * RATE_MAX_INCOMING_FACTOR + RATE_MAX_INCOMING_MARGIN);
+      }
+
+      /* The incoming cap only limits increases, never lowers the rate */
+      bwe->estimate = MAX (bwe->estimate, kms_delay_bwe_clamp (bwe, bitrate));
+      break;
+    case RATE_DECREASE:
+      if (incoming == 0) {
+        break;
+      }
+
+      bwe->link_capacity = incoming;
+      bwe->estimate =
+          kms_delay_bwe_clamp (bwe, incoming * RATE_DECREASE_FACTOR);
+      bwe->last_decrease = now;
+      bwe->state = RATE_HOLD;
+      break;
+  }
+}
+
+static void
+kms_delay_bwe_group_complete (KmsDelayBwe * bwe)
+{
+  GstClockTimeDiff send_delta, arrival_delta;
+  gdouble trend;
+
+  send_delta = GST_CLOCK_DIFF (bwe->previous.last_send, bwe->current.last_send);
+  arrival_delta =
+      GST_CLOCK_DIFF (bwe->previous.last_arrival, bwe->current.last_arrival);
+
+  if (arrival_delta > (GstClockTimeDiff) STREAM_TIMEOUT) {
+    kms_delay_bwe_reset_trendline (bwe);
+    return;
+  }
+
+  trend = kms_delay_bwe_update_trendline (bwe,
+      (gdouble) (arrival_delta - send_delta) / GST_MSECOND,
+      bwe->current.last_arrival);
+  kms_delay_bwe_detect (bwe, trend, (gdouble) send_delta / GST_MSECOND,
+      bwe->current.last_arrival);
+  kms_delay_bwe_update_rate (bwe, bwe->current.last_arrival);
+}
+
+static void
+packet_group_start (PacketGroup * group, GstClockTime send_time,
+    GstClockTime arrival_time)
+{
+  group->valid = TRUE;
+  group->first_send = send_time;
+  group->last_send = send_time;
+  group->last_arrival = arrival_time;
+}
+
+void
+kms_delay_bwe_incoming_packet (KmsDelayBwe * bwe, GstClockTime send_time,
+    GstClockTime arrival_time, gsize size)
+{
+  if (!GST_CLOCK_TIME_IS_VALID (send_time)
+      || !GST_CLOCK_TIME_IS_VALID (arrival_time)) {
+    return;
+  }
+
+  kms_bitrate_calc_update (&bwe->incoming, arrival_time, size);
+
+  if (!bwe->current.valid) {
+    packet_group_start (&bwe->current, send_time, arrival_time);
+    return;
+  }
+
+  if (send_time < bwe->current.first_send) {
+    /* Reordered packet from an already completed group */
+    return;
+  }
+
+  if (send_time - bwe->current.first_send <= BURST_INTERVAL) {
+    bwe->current.last_send = MAX (bwe->current.last_send, send_time);
+    bwe->current.last_arrival = MAX (bwe->current.last_arrival, arrival_time);
+    return;
+  }
+
+  if (bwe->previous.valid) {
+    kms_delay_bwe_group_complete (bwe);
+  }
+
+  bwe->previous = bwe->current;
+  packet_group_start (&bwe->current, send_time, arrival_time);
+}
+
+guint
+kms_delay_bwe_get_estimate (KmsDelayBwe * bwe)
+{
+  return bwe->estimate;
+}
+
+guint
+kms_delay_bwe_get_incoming_bitrate (KmsDelayBwe * bwe)
+{
+  return kms_bitrate_calc_get_bitrate (&bwe->incoming);
+}
+
+KmsDelayBweUsage
+kms_delay_bwe_get_usage (KmsDelayBwe * bwe)
+{
+  return bwe->usage;
+}
+
+void
+kms_delay_bwe_set_bounds (KmsDelayBwe * bwe, guint min_bitrate,
+    guint max_bitrate)
+{
+  bwe->min_bitrate = min_bitrate;
+  bwe->max_bitrate = max_bitrate;
+
+  if (bwe->estimate > 0) {
+    bwe->estimate = kms_delay_bwe_clamp (bwe, bwe->estimate);
+  }
+}
+
+KmsDelayBwe *
+kms_delay_bwe_new (guint min_bitrate, guint max_bitrate)
+{
+  KmsDelayBwe *bwe = g_slice_new0 (KmsDelayBwe);
+
+  bwe->min_bitrate = min_bitrate;
+  bwe->max_bitrate = max_bitrate;
+
+  kms_delay_bwe_reset_trendline (bwe);
+
+  bwe->usage = KMS_DELAY_BWE_NORMAL;
+  bwe->threshold = THRESHOLD_INITIAL;
+  bwe->time_over_using = -1;
+  bwe->last_threshold_update = GST_CLOCK_TIME_NONE;
+
+  bwe->state = RATE_HOLD;
+  bwe->last_rate_update = GST_CLOCK_TIME_NONE;
+  bwe->last_decrease = GST_CLOCK_TIME_NONE;
+
+  kms_bitrate_calc_init (&bwe->incoming, INCOMING_BITRATE_INTERVAL);
+
+  return bwe;
+}
+
+void
+kms_delay_bwe_free (KmsDelayBwe * bwe)
+{
+  g_slice_free (KmsDelayBwe, bwe);
+}
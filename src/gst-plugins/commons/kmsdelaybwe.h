@@ -0,0 +1,64 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_DELAY_BWE_H__
+#define __KMS_DELAY_BWE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  KMS_DELAY_BWE_NORMAL,
+  KMS_DELAY_BWE_UNDERUSING,
+  KMS_DELAY_BWE_OVERUSING
+} KmsDelayBweUsage;
+
+typedef struct _KmsDelayBwe KmsDelayBwe;
+
+/**
+ * KmsDelayBwe:
+ *
+ * Delay-based bandwidth estimator. Packets are grouped by send time, the
+ * one-way delay variation between groups is smoothed and fed to a
+ * trendline filter, and an adaptive threshold detector drives an AIMD
+ * rate controller.
+ *
+ * It only sees (send time, arrival time, size) triplets and never reads a
+ * clock by itself, so the same instance can be driven from live traffic
+ * (abs-send-time or transport-wide feedback) or replayed offline from a
+ * packet trace with deterministic results. It is not thread safe.
+ */
+
+KmsDelayBwe * kms_delay_bwe_new (guint min_bitrate, guint max_bitrate);
+void kms_delay_bwe_free (KmsDelayBwe * bwe);
+
+void kms_delay_bwe_set_bounds (KmsDelayBwe * bwe, guint min_bitrate,
+    guint max_bitrate);
+
+void kms_delay_bwe_incoming_packet (KmsDelayBwe * bwe,
+    GstClockTime send_time, GstClockTime arrival_time, gsize size);
+
+/* Returns 0 while the link has not shown any congestion yet */
+guint kms_delay_bwe_get_estimate (KmsDelayBwe * bwe);
+guint kms_delay_bwe_get_incoming_bitrate (KmsDelayBwe * bwe);
+KmsDelayBweUsage kms_delay_bwe_get_usage (KmsDelayBwe * bwe);
+
+G_END_DECLS
+
+#endif /* __KMS_DELAY_BWE_H__ */
@@ -26,6 +26,7 @@
 #include "kmsagnosticcaps.h"
 #include "kmsstats.h"
 #include "kmsutils.h"
+#include "kmskeyframecoordinator.h"
 #include "kmsrefstruct.h"
 #include "constants.h"
 
@@ -893,7 +894,7 @@ get_sink_pad_name (KmsElementPadType type, const gchar * description)
 
 static void
 kms_element_calculate_stats (GstPad * pad, KmsMediaType type,
-    GstClockTimeDiff t, KmsList * mdata, gpointer user_data)
+    GstClockTimeDiff t, KmsBufferLatencyMeta * meta, gpointer user_data)
 {
   StreamInputAvgStat *sstat = (StreamInputAvgStat *) user_data;
 
@@ -1667,6 +1668,47 @@ kms_element_get_input_latency_stats (KmsElement * self, gchar * selector)
   return stats;
 }
 
+static GstStructure *
+kms_element_get_keyframe_stats (KmsElement * self)
+{
+  gpointer key, value;
+  GHashTableIter iter;
+  GstStructure *stats;
+
+  stats = gst_structure_new_empty (KMS_KEYFRAME_COORDINATOR_STATS_NAME);
+
+  KMS_ELEMENT_LOCK (self);
+
+  g_hash_table_iter_init (&iter, self->priv->output_elements);
+
+  while (g_hash_table_iter_next (&iter, &key, &value)) {
+    KmsOutputElementData *odata = value;
+    GstStructure *requests;
+    GstPad *sink;
+
+    if (odata->type != KMS_ELEMENT_PAD_TYPE_VIDEO || odata->element == NULL) {
+      continue;
+    }
+
+    sink = gst_element_get_static_pad (odata->element, "sink");
+    if (sink == NULL) {
+      continue;
+    }
+
+    requests = kms_keyframe_coordinator_get_stats (sink);
+    g_object_unref (sink);
+
+    if (requests != NULL) {
+      gst_structure_set (stats, key, GST_TYPE_STRUCTURE, requests, NULL);
+      gst_structure_free (requests);
+    }
+  }
+
+  KMS_ELEMENT_UNLOCK (self);
+
+  return stats;
+}
+
 static GstStructure *
 kms_element_stats_impl (KmsElement * self, gchar * selector)
 {
@@ -1684,6 +1726,14 @@ kms_element_stats_impl (KmsElement * self, gchar * selector)
         "input-latencies", GST_TYPE_STRUCTURE, l_stats, NULL);
     gst_structure_free (l_stats);
 
+    if (g_strcmp0 (selector, AUDIO_STREAM_NAME) != 0) {
+      GstStructure *k_stats = kms_element_get_keyframe_stats (self);
+
+      gst_structure_set (e_stats, KMS_KEYFRAME_COORDINATOR_STATS_NAME,
+          GST_TYPE_STRUCTURE, k_stats, NULL);
+      gst_structure_free (k_stats);
+    }
+
     gst_structure_set (stats, KMS_MEDIA_ELEMENT_FIELD, GST_TYPE_STRUCTURE,
         e_stats, NULL);
 
@@ -40,6 +40,49 @@ G_DEFINE_TYPE (KmsEncTreeBin, kms_enc_tree_bin, KMS_TYPE_TREE_BIN);
 #define KMS_ENC_TREE_BIN_LIMIT(obj, value) \
   MAX((obj)->priv->min_bitrate,MIN((obj)->priv->max_bitrate, (value)))
 
+#define KMS_ENC_TREE_BIN_LOCK(obj) (                  \
+  g_mutex_lock (&KMS_ENC_TREE_BIN (obj)->priv->mutex) \
+)
+
+#define KMS_ENC_TREE_BIN_UNLOCK(obj) (                  \
+  g_mutex_unlock (&KMS_ENC_TREE_BIN (obj)->priv->mutex) \
+)
+
+#define ENCODER_CONTROLLER_CONFIG "encoder-controller"
+#define DEFAULT_CONTROLLER_ENABLED FALSE
+#define DEFAULT_MAX_THREADS 1
+#define DEFAULT_FRAME_DURATION (GST_SECOND / 30)
+
+/* Pixels per frame that a single encoding thread is expected to handle */
+#define PIXELS_PER_THREAD (640 * 480)
+
+#define VP8_DEFAULT_DEADLINE G_GINT64_CONSTANT (200000)
+#define VP8_REALTIME_DEADLINE G_GINT64_CONSTANT (1)
+
+/* Load is the encoding time relative to the frame duration */
+#define CONTROLLER_HIGH_LOAD 0.85
+#define CONTROLLER_LOW_LOAD 0.4
+#define CONTROLLER_DEGRADE_INTERVAL (2 * G_USEC_PER_SEC)
+#define CONTROLLER_RECOVER_INTERVAL (10 * G_USEC_PER_SEC)
+/* Frames that may be inside the encoder at the same time */
+#define ENCODE_START_WINDOW 8
+
+/* Degradation steps, applied in order when the encoder cannot keep up */
+typedef enum
+{
+  DEGRADATION_NONE,
+  DEGRADATION_SPEED,
+  DEGRADATION_RESOLUTION_3_4,
+  DEGRADATION_RESOLUTION_1_2,
+  DEGRADATION_FRAMERATE_1_2
+} DegradationLevel;
+
+#define DEGRADATION_MAX DEGRADATION_FRAMERATE_1_2
+
+/* Video encoders alive in the process, they share the host CPUs */
+static GSList *video_encoders = NULL;
+G_LOCK_DEFINE_STATIC (video_encoders);
+
 typedef enum
 {
   VP8,
@@ -62,6 +105,28 @@ struct _KmsEncTreeBinPrivate
 
   gint max_bitrate;
   gint min_bitrate;
+
+  /* Encoder resource controller */
+  gboolean counted;
+  gboolean auto_threads;
+  gint max_threads;
+  gint threads;                 /* Protected by video_encoders lock */
+  gboolean controller_enabled;
+  gint64 deadline;
+  GstElement *rate;
+  GstElement *capsfilter;
+  GstCaps *filter_caps;
+
+  /* Protected by mutex */
+  GMutex mutex;
+  gint width, height;
+  gint fps_n, fps_d;
+  GstClockTime start_pts[ENCODE_START_WINDOW];
+  gint64 start_time[ENCODE_START_WINDOW];
+  guint start_next;
+  gdouble load;
+  DegradationLevel level;
+  gint64 last_level_change;
 };
 
 static const gchar *
@@ -133,9 +198,72 @@ set_encoder_configuration (GstElement * encoder, GstStructure * codec_config,
   }
 }
 
+/* Call this function with video_encoders lock held */
+static gint
+kms_enc_tree_bin_get_threads (KmsEncTreeBin * self)
+{
+  gint threads, width, height;
+
+  KMS_ENC_TREE_BIN_LOCK (self);
+  width = self->priv->width;
+  height = self->priv->height;
+  KMS_ENC_TREE_BIN_UNLOCK (self);
+
+  /* Share the host CPUs among all the video encoders in the process */
+  threads = g_get_num_processors () / MAX (1, g_slist_length (video_encoders));
+
+  if (width > 0 && height > 0) {
+    threads = MIN (threads, (width * height) / PIXELS_PER_THREAD + 1);
+  }
+
+  return CLAMP (threads, 1, MAX (1, self->priv->max_threads));
+}
+
+/* Sets the new number of threads on the running encoder */
+/* Call this function with video_encoders lock held */
+static void
+kms_enc_tree_bin_update_threads (KmsEncTreeBin * self)
+{
+  gint threads;
+
+  if (!self->priv->auto_threads) {
+    return;
+  }
+
+  threads = kms_enc_tree_bin_get_threads (self);
+  if (threads == self->priv->threads) {
+    return;
+  }
+
+  GST_DEBUG_OBJECT (self, "Encoding threads: %d", threads);
+  self->priv->threads = threads;
+
+  switch (self->priv->enc_type) {
+    case VP8:
+      g_object_set (self->priv->enc, "threads", threads, NULL);
+      break;
+    case X264:
+      g_object_set (self->priv->enc, "threads", (guint) threads, NULL);
+      break;
+    default:
+      break;
+  }
+}
+
+/* Call this function with video_encoders lock held */
+static void
+kms_enc_tree_bin_rebalance_threads (void)
+{
+  GSList *l;
+
+  for (l = video_encoders; l != NULL; l = l->next) {
+    kms_enc_tree_bin_update_threads (KMS_ENC_TREE_BIN (l->data));
+  }
+}
+
 static void
 configure_encoder (GstElement * encoder, EncoderType type, gint target_bitrate,
-    GstStructure * codec_configs)
+    gint threads, GstStructure * codec_configs)
 {
   GST_DEBUG ("Configure encoder: %" GST_PTR_FORMAT, encoder);
   switch (type) {
@@ -143,8 +271,8 @@ configure_encoder (GstElement * encoder, EncoderType type, gint target_bitrate,
     {
       /* *INDENT-OFF* */
       g_object_set (G_OBJECT (encoder),
-                    "deadline", G_GINT64_CONSTANT (200000),
-                    "threads", 1,
+                    "deadline", VP8_DEFAULT_DEADLINE,
+                    "threads", threads,
                     "cpu-used", 16,
                     "resize-allowed", TRUE,
                     "target-bitrate", target_bitrate,
@@ -158,7 +286,7 @@ configure_encoder (GstElement * encoder, EncoderType type, gint target_bitrate,
       /* *INDENT-OFF* */
       g_object_set (G_OBJECT (encoder),
                     "speed-preset", /* veryfast */ 3,
-                    "threads", (guint) 1,
+                    "threads", (guint) threads,
                     "bitrate", target_bitrate / 1000,
                     "key-int-max", 60,
                     "tune", /* zero-latency */ 4,
@@ -213,6 +341,52 @@ kms_enc_tree_bin_set_encoder_type (KmsEncTreeBin * self)
   g_free (name);
 }
 
+static gboolean
+encoder_config_has_field (GstStructure * codec_configs, EncoderType type,
+    const gchar * field)
+{
+  const gchar *name = kms_enc_tree_bin_get_name_from_type (type);
+  GstStructure *config;
+  gboolean ret;
+
+  if (codec_configs == NULL || name == NULL ||
+      !gst_structure_has_field_typed (codec_configs, name,
+          GST_TYPE_STRUCTURE)) {
+    return FALSE;
+  }
+
+  gst_structure_get (codec_configs, name, GST_TYPE_STRUCTURE, &config, NULL);
+  ret = gst_structure_has_field (config, field);
+  gst_structure_free (config);
+
+  return ret;
+}
+
+static void
+kms_enc_tree_bin_read_controller_config (KmsEncTreeBin * self,
+    GstStructure * codec_configs)
+{
+  GstStructure *config;
+
+  if (codec_configs == NULL ||
+      !gst_structure_has_field_typed (codec_configs,
+          ENCODER_CONTROLLER_CONFIG, GST_TYPE_STRUCTURE)) {
+    return;
+  }
+
+  gst_structure_get (codec_configs, ENCODER_CONTROLLER_CONFIG,
+      GST_TYPE_STRUCTURE, &config, NULL);
+
+  gst_structure_get_boolean (config, "enabled",
+      &self->priv->controller_enabled);
+  gst_structure_get_int (config, "max-threads", &self->priv->max_threads);
+
+  GST_DEBUG_OBJECT (self, "Encoder controller config: %" GST_PTR_FORMAT,
+      config);
+
+  gst_structure_free (config);
+}
+
 static void
 kms_enc_tree_bin_create_encoder_for_caps (KmsEncTreeBin * self,
     const GstCaps * caps, gint target_bitrate, GstStructure * codec_configs)
@@ -248,8 +422,24 @@ kms_enc_tree_bin_create_encoder_for_caps (KmsEncTreeBin * self,
   if (encoder_factory != NULL) {
     self->priv->enc = gst_element_factory_create (encoder_factory, NULL);
     kms_enc_tree_bin_set_encoder_type (self);
+
+    self->priv->auto_threads = !encoder_config_has_field (codec_configs,
+        self->priv->enc_type, "threads");
     configure_encoder (self->priv->enc, self->priv->enc_type, target_bitrate,
-        codec_configs);
+        self->priv->threads, codec_configs);
+
+    if (kms_utils_caps_are_video (caps)) {
+      /* Other encoders give up some of their threads to this one */
+      G_LOCK (video_encoders);
+      video_encoders = g_slist_prepend (video_encoders, self);
+      self->priv->counted = TRUE;
+      kms_enc_tree_bin_rebalance_threads ();
+      G_UNLOCK (video_encoders);
+    }
+
+    if (self->priv->enc_type == VP8) {
+      g_object_get (self->priv->enc, "deadline", &self->priv->deadline, NULL);
+    }
   }
 
   gst_plugin_feature_list_free (filtered_list);
@@ -389,6 +579,262 @@ tag_event_probe (GstPad * pad, GstPadProbeInfo * info, gpointer data)
   return GST_PAD_PROBE_OK;
 }
 
+static gboolean
+kms_enc_tree_bin_degradation_applies (KmsEncTreeBin * self,
+    DegradationLevel level)
+{
+  switch (level) {
+    case DEGRADATION_SPEED:
+      /* Only vp8enc allows changing its speed while playing */
+      return self->priv->enc_type == VP8;
+    case DEGRADATION_RESOLUTION_3_4:
+    case DEGRADATION_RESOLUTION_1_2:
+      return self->priv->width > 0 && self->priv->height > 0;
+    case DEGRADATION_FRAMERATE_1_2:
+      return self->priv->rate != NULL && self->priv->fps_n > 0
+          && self->priv->fps_d > 0;
+    case DEGRADATION_NONE:
+    default:
+      return TRUE;
+  }
+}
+
+static void
+kms_enc_tree_bin_apply_resolution (KmsEncTreeBin * self, gint num, gint den)
+{
+  GstCaps *caps;
+
+  caps = gst_caps_copy (self->priv->filter_caps);
+
+  if (num != den) {
+    /* Encoders need even dimensions */
+    gst_caps_set_simple (caps,
+        "width", G_TYPE_INT, MAX (2, (self->priv->width * num / den) & ~1),
+        "height", G_TYPE_INT, MAX (2, (self->priv->height * num / den) & ~1),
+        NULL);
+  }
+
+  GST_DEBUG_OBJECT (self, "Setting encoding caps: %" GST_PTR_FORMAT, caps);
+  g_object_set (self->priv->capsfilter, "caps", caps, NULL);
+  gst_caps_unref (caps);
+}
+
+static void
+kms_enc_tree_bin_apply_degradation (KmsEncTreeBin * self)
+{
+  DegradationLevel level = self->priv->level;
+
+  GST_INFO_OBJECT (self, "Encoder degradation level: %d (load %.2f)", level,
+      self->priv->load);
+
+  if (self->priv->enc_type == VP8) {
+    g_object_set (self->priv->enc, "deadline",
+        level >= DEGRADATION_SPEED ? VP8_REALTIME_DEADLINE :
+        self->priv->deadline, NULL);
+  }
+
+  if (self->priv->capsfilter != NULL && self->priv->width > 0
+      && self->priv->height > 0) {
+    if (level >= DEGRADATION_RESOLUTION_1_2) {
+      kms_enc_tree_bin_apply_resolution (self, 1, 2);
+    } else if (level >= DEGRADATION_RESOLUTION_3_4) {
+      kms_enc_tree_bin_apply_resolution (self, 3, 4);
+    } else {
+      kms_enc_tree_bin_apply_resolution (self, 1, 1);
+    }
+  }
+
+  if (self->priv->rate != NULL && self->priv->fps_n > 0
+      && self->priv->fps_d > 0) {
+    g_object_set (self->priv->rate, "max-rate",
+        level >= DEGRADATION_FRAMERATE_1_2 ?
+        MAX (1, self->priv->fps_n / (2 * self->priv->fps_d)) : G_MAXINT, NULL);
+  }
+}
+
+static void
+kms_enc_tree_bin_controller_update (KmsEncTreeBin * self, gint64 now)
+{
+  gint64 elapsed = now - self->priv->last_level_change;
+  gint level = self->priv->level, step;
+
+  if (self->priv->load > CONTROLLER_HIGH_LOAD
+      && elapsed > CONTROLLER_DEGRADE_INTERVAL) {
+    step = 1;
+  } else if (self->priv->load < CONTROLLER_LOW_LOAD
+      && elapsed > CONTROLLER_RECOVER_INTERVAL) {
+    step = -1;
+  } else {
+    return;
+  }
+
+  /* Skip the steps that cannot be applied to this encoder */
+  do {
+    level += step;
+  } while (level > DEGRADATION_NONE && level < DEGRADATION_MAX
+      && !kms_enc_tree_bin_degradation_applies (self, level));
+
+  if (level < DEGRADATION_NONE || level > DEGRADATION_MAX
+      || !kms_enc_tree_bin_degradation_applies (self, level)) {
+    return;
+  }
+
+  self->priv->level = level;
+  self->priv->last_level_change = now;
+  kms_enc_tree_bin_apply_degradation (self);
+}
+
+static GstClockTime
+kms_enc_tree_bin_get_frame_duration (KmsEncTreeBin * self)
+{
+  GstClockTime duration;
+
+  if (self->priv->fps_n <= 0 || self->priv->fps_d <= 0) {
+    return DEFAULT_FRAME_DURATION;
+  }
+
+  duration = gst_util_uint64_scale_int (GST_SECOND, self->priv->fps_d,
+      self->priv->fps_n);
+
+  if (self->priv->level >= DEGRADATION_FRAMERATE_1_2) {
+    duration *= 2;
+  }
+
+  return duration;
+}
+
+static GstPadProbeReturn
+encode_start_probe (GstPad * pad, GstPadProbeInfo * info, gpointer data)
+{
+  KmsEncTreeBin *self = data;
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+  if (!GST_BUFFER_PTS_IS_VALID (buffer)) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  KMS_ENC_TREE_BIN_LOCK (self);
+  self->priv->start_pts[self->priv->start_next] = GST_BUFFER_PTS (buffer);
+  self->priv->start_time[self->priv->start_next] = g_get_monotonic_time ();
+  self->priv->start_next = (self->priv->start_next + 1) % ENCODE_START_WINDOW;
+  KMS_ENC_TREE_BIN_UNLOCK (self);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+encode_end_probe (GstPad * pad, GstPadProbeInfo * info, gpointer data)
+{
+  KmsEncTreeBin *self = data;
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+  gint64 now, start = 0;
+  gdouble ratio;
+  guint i;
+
+  if (!GST_BUFFER_PTS_IS_VALID (buffer)) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  now = g_get_monotonic_time ();
+
+  KMS_ENC_TREE_BIN_LOCK (self);
+
+  /* Encoders keep timestamps, so output frames match their input ones */
+  for (i = 0; i < ENCODE_START_WINDOW; i++) {
+    if (self->priv->start_pts[i] == GST_BUFFER_PTS (buffer)) {
+      start = self->priv->start_time[i];
+      self->priv->start_pts[i] = GST_CLOCK_TIME_NONE;
+      break;
+    }
+  }
+
+  if (start <= 0) {
+    goto end;
+  }
+
+  ratio = (gdouble) ((now - start) * GST_USECOND) /
+      kms_enc_tree_bin_get_frame_duration (self);
+  self->priv->load = (self->priv->load * 7 + ratio) / 8;
+
+  GST_TRACE_OBJECT (self, "Encoding load: %.2f", self->priv->load);
+
+  kms_enc_tree_bin_controller_update (self, now);
+
+end:
+  KMS_ENC_TREE_BIN_UNLOCK (self);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+input_caps_probe (GstPad * pad, GstPadProbeInfo * info, gpointer data)
+{
+  KmsEncTreeBin *self = data;
+  GstEvent *event = gst_pad_probe_info_get_event (info);
+  GstStructure *st;
+  GstCaps *caps;
+
+  if (GST_EVENT_TYPE (event) != GST_EVENT_CAPS) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  gst_event_parse_caps (event, &caps);
+  st = gst_caps_get_structure (caps, 0);
+
+  KMS_ENC_TREE_BIN_LOCK (self);
+
+  gst_structure_get_int (st, "width", &self->priv->width);
+  gst_structure_get_int (st, "height", &self->priv->height);
+  if (!gst_structure_get_fraction (st, "framerate", &self->priv->fps_n,
+          &self->priv->fps_d)) {
+    self->priv->fps_n = self->priv->fps_d = 0;
+  }
+
+  GST_DEBUG_OBJECT (self, "Input resolution %dx%d, framerate %d/%d",
+      self->priv->width, self->priv->height, self->priv->fps_n,
+      self->priv->fps_d);
+
+  if (self->priv->level >= DEGRADATION_RESOLUTION_3_4) {
+    kms_enc_tree_bin_apply_degradation (self);
+  }
+
+  KMS_ENC_TREE_BIN_UNLOCK (self);
+
+  /* The encoder picks up its threads when it is configured with the caps */
+  if (self->priv->counted) {
+    G_LOCK (video_encoders);
+    kms_enc_tree_bin_update_threads (self);
+    G_UNLOCK (video_encoders);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+kms_enc_tree_bin_add_controller (KmsEncTreeBin * self)
+{
+  GstPad *pad;
+
+  pad = gst_element_get_static_pad (self->priv->rate, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      input_caps_probe, self, NULL);
+  g_object_unref (pad);
+
+  if (!self->priv->controller_enabled) {
+    return;
+  }
+
+  pad = gst_element_get_static_pad (self->priv->enc, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, encode_start_probe, self,
+      NULL);
+  g_object_unref (pad);
+
+  pad = gst_element_get_static_pad (self->priv->enc, "src");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, encode_end_probe, self,
+      NULL);
+  g_object_unref (pad);
+}
+
 /*
  * FIXME: This is a hack to make x264 work.
  *
@@ -456,6 +902,7 @@ kms_enc_tree_bin_configure (KmsEncTreeBin * self, const GstCaps * caps,
 
   self->priv->current_bitrate = target_bitrate;
 
+  kms_enc_tree_bin_read_controller_config (self, codec_configs);
   kms_enc_tree_bin_create_encoder_for_caps (self, caps, target_bitrate,
       codec_configs);
 
@@ -473,6 +920,8 @@ kms_enc_tree_bin_configure (KmsEncTreeBin * self, const GstCaps * caps,
       bitrate_callback, self, NULL);
   gst_pad_add_probe (enc_src, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
       tag_event_probe, self, NULL);
+  /* Viewers of this encoding share the keyframes of the encoder */
+  kms_utils_control_key_frames_request_duplicates (enc_src);
   g_object_unref (enc_src);
 
   rate = kms_utils_create_rate_for_caps (caps);
@@ -497,22 +946,32 @@ kms_enc_tree_bin_configure (KmsEncTreeBin * self, const GstCaps * caps,
   // properly with some raw formats, this should be fixed in gstreamer
   // but until this is done this hack makes it work
   if (self->priv->enc_type == X264) {
-    GstCaps *filter_caps = gst_caps_from_string ("video/x-raw,format=I420");
     GstPad *sink;
 
+    self->priv->filter_caps = gst_caps_from_string ("video/x-raw,format=I420");
     capsfilter = gst_element_factory_make ("capsfilter", NULL);
     sink = gst_element_get_static_pad (capsfilter, "sink");
     gst_pad_add_probe (sink, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
         check_caps_probe, NULL, NULL);
     g_object_unref (sink);
+  } else if (rate) {
+    /* Used by the controller to reduce the encoding resolution */
+    self->priv->filter_caps = gst_caps_from_string ("video/x-raw");
+    capsfilter = gst_element_factory_make ("capsfilter", NULL);
+  }
 
-    g_object_set (capsfilter, "caps", filter_caps, NULL);
-    gst_caps_unref (filter_caps);
-
+  if (capsfilter) {
+    g_object_set (capsfilter, "caps", self->priv->filter_caps, NULL);
     gst_bin_add (GST_BIN (self), capsfilter);
     gst_element_sync_state_with_parent (capsfilter);
   }
 
+  if (rate) {
+    self->priv->rate = rate;
+    self->priv->capsfilter = capsfilter;
+    kms_enc_tree_bin_add_controller (self);
+  }
+
   if (rate) {
     kms_tree_bin_set_input_element (tree_bin, rate);
   } else {
@@ -522,7 +981,7 @@ kms_enc_tree_bin_configure (KmsEncTreeBin * self, const GstCaps * caps,
   if (rate) {
     gst_element_link (rate, convert);
   }
-  if (self->priv->enc_type == X264) {
+  if (capsfilter) {
     gst_element_link_many (convert, mediator, capsfilter, queue,
         self->priv->enc, output_tee, NULL);
   } else {
@@ -555,6 +1014,8 @@ kms_enc_tree_bin_new (const GstCaps * caps, gint target_bitrate,
 static void
 kms_enc_tree_bin_init (KmsEncTreeBin * self)
 {
+  guint i;
+
   self->priv = KMS_ENC_TREE_BIN_GET_PRIVATE (self);
 
   self->priv->remb_manager = NULL;
@@ -564,6 +1025,17 @@ kms_enc_tree_bin_init (KmsEncTreeBin * self)
 
   self->priv->max_bitrate = G_MAXINT;
   self->priv->min_bitrate = 0;
+
+  self->priv->max_threads = DEFAULT_MAX_THREADS;
+  self->priv->threads = 1;
+  self->priv->controller_enabled = DEFAULT_CONTROLLER_ENABLED;
+
+  g_mutex_init (&self->priv->mutex);
+  for (i = 0; i < ENCODE_START_WINDOW; i++) {
+    self->priv->start_pts[i] = GST_CLOCK_TIME_NONE;
+  }
+  self->priv->level = DEGRADATION_NONE;
+  self->priv->last_level_change = g_get_monotonic_time ();
 }
 
 static void
@@ -578,10 +1050,37 @@ kms_enc_tree_bin_dispose (GObject * object)
     self->priv->remb_manager = NULL;
   }
 
+  if (self->priv->counted) {
+    /* Remaining encoders get the threads released by this one */
+    G_LOCK (video_encoders);
+    video_encoders = g_slist_remove (video_encoders, self);
+    self->priv->counted = FALSE;
+    kms_enc_tree_bin_rebalance_threads ();
+    G_UNLOCK (video_encoders);
+  }
+
+  if (self->priv->filter_caps) {
+    gst_caps_unref (self->priv->filter_caps);
+    self->priv->filter_caps = NULL;
+  }
+
   /* chain up */
   G_OBJECT_CLASS (kms_enc_tree_bin_parent_class)->dispose (object);
 }
 
+static void
+kms_enc_tree_bin_finalize (GObject * object)
+{
+  KmsEncTreeBin *self = KMS_ENC_TREE_BIN (object);
+
+  GST_DEBUG_OBJECT (object, "finalize");
+
+  g_mutex_clear (&self->priv->mutex);
+
+  /* chain up */
+  G_OBJECT_CLASS (kms_enc_tree_bin_parent_class)->finalize (object);
+}
+
 static void
 kms_enc_tree_bin_class_init (KmsEncTreeBinClass * klass)
 {
@@ -598,6 +1097,7 @@ kms_enc_tree_bin_class_init (KmsEncTreeBinClass * klass)
       GST_DEFAULT_NAME);
 
   gobject_class->dispose = kms_enc_tree_bin_dispose;
+  gobject_class->finalize = kms_enc_tree_bin_finalize;
 
   g_type_class_add_private (klass, sizeof (KmsEncTreeBinPrivate));
 }
@@ -0,0 +1,499 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+#include <gst/rtp/gstrtpbuffer.h>
+
+#include "kmsfec.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KMS_FEC_X86 1
+#include <immintrin.h>
+#define KMS_TARGET(isa) __attribute__ ((target (isa)))
+#endif
+
+#define GST_DEFAULT_NAME "fec"
+#define GST_CAT_DEFAULT kms_fec_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+#define RTP_HEADER_LEN 12
+
+/* RFC 5109 FEC header and level 0 ULP header */
+#define FEC_HEADER_LEN 10
+#define ULP_HEADER_LEN_SHORT 4
+#define ULP_HEADER_LEN_LONG 8
+#define FEC_E_BIT 0x80
+#define FEC_L_BIT 0x40
+
+/* Offset of a packet in the mask, bit 47 is the base sequence number */
+#define MASK_BIT(offset) (G_GUINT64_CONSTANT (1) << (47 - (offset)))
+#define MASK_LONG_BITS G_GUINT64_CONSTANT (0xffffffff)
+
+typedef void (*KmsFecXorFunc) (guint8 * dst, const guint8 * src, gsize len);
+
+/* XOR kernels */
+
+static void
+xor_c (guint8 * dst, const guint8 * src, gsize len)
+{
+  gsize i = 0;
+
+  for (; i + sizeof (guint64) <= len; i += sizeof (guint64)) {
+    guint64 a, b;
+
+    memcpy (&a, dst + i, sizeof (a));
+    memcpy (&b, src + i, sizeof (b));
+    a ^= b;
+    memcpy (dst + i, &a, sizeof (a));
+  }
+
+  for (; i < len; i++) {
+    dst[i] ^= src[i];
+  }
+}
+
+#ifdef KMS_FEC_X86
+
+static void xor_sse2 (guint8 * dst, const guint8 * src, gsize len)
+    KMS_TARGET ("sse2");
+static void xor_avx2 (guint8 * dst, const guint8 * src, gsize len)
+    KMS_TARGET ("avx2");
+
+static void
+xor_sse2 (guint8 * dst, const guint8 * src, gsize len)
+{
+  gsize i = 0;
+
+  for (; i + 64 <= len; i += 64) {
+    __m128i a0 = _mm_loadu_si128 ((const __m128i *) (dst + i));
+    __m128i a1 = _mm_loadu_si128 ((const __m128i *) (dst + i + 16));
+    __m128i a2 = _mm_loadu_si128 ((const __m128i *) (dst + i + 32));
+    __m128i a3 = _mm_loadu_si128 ((const __m128i *) (dst + i + 48));
+
+    a0 = _mm_xor_si128 (a0, _mm_loadu_si128 ((const __m128i *) (src + i)));
+    a1 = _mm_xor_si128 (a1, _mm_loadu_si128 ((const __m128i *) (src + i +
+                16)));
+    a2 = _mm_xor_si128 (a2, _mm_loadu_si128 ((const __m128i *) (src + i +
+                32)));
+    a3 = _mm_xor_si128 (a3, _mm_loadu_si128 ((const __m128i *) (src + i +
+                48)));
+
+    _mm_storeu_si128 ((__m128i *) (dst + i), a0);
+    _mm_storeu_si128 ((__m128i *) (dst + i + 16), a1);
+    _mm_storeu_si128 ((__m128i *) (dst + i + 32), a2);
+    _mm_storeu_si128 ((__m128i *) (dst + i + 48), a3);
+  }
+
+  for (; i + 16 <= len; i += 16) {
+    __m128i a = _mm_loadu_si128 ((const __m128i *) (dst + i));
+
+    a = _mm_xor_si128 (a, _mm_loadu_si128 ((const __m128i *) (src + i)));
+    _mm_storeu_si128 ((__m128i *) (dst + i), a);
+  }
+
+  xor_c (dst + i, src + i, len - i);
+}
+
+static void
+xor_avx2 (guint8 * dst, const guint8 * src, gsize len)
+{
+  gsize i = 0;
+
+  for (; i + 128 <= len; i += 128) {
+    __m256i a0 = _mm256_loadu_si256 ((const __m256i *) (dst + i));
+    __m256i a1 = _mm256_loadu_si256 ((const __m256i *) (dst + i + 32));
+    __m256i a2 = _mm256_loadu_si256 ((const __m256i *) (dst + i + 64));
+    __m256i a3 = _mm256_loadu_si256 ((const __m256i *) (dst + i + 96));
+
+    a0 = _mm256_xor_si256 (a0,
+        _mm256_loadu_si256 ((const __m256i *) (src + i)));
+    a1 = _mm256_xor_si256 (a1,
+        _mm256_loadu_si256 ((const __m256i *) (src + i + 32)));
+    a2 = _mm256_xor_si256 (a2,
+        _mm256_loadu_si256 ((const __m256i *) (src + i + 64)));
+    a3 = _mm256_xor_si256 (a3,
+        _mm256_loadu_si256 ((const __m256i *) (src + i + 96)));
+
+    _mm256_storeu_si256 ((__m256i *) (dst + i), a0);
+    _mm256_storeu_si256 ((__m256i *) (dst + i + 32), a1);
+    _mm256_storeu_si256 ((__m256i *) (dst + i + 64), a2);
+    _mm256_storeu_si256 ((__m256i *) (dst + i + 96), a3);
+  }
+
+  for (; i + 32 <= len; i += 32) {
+    __m256i a = _mm256_loadu_si256 ((const __m256i *) (dst + i));
+
+    a = _mm256_xor_si256 (a, _mm256_loadu_si256 ((const __m256i *) (src + i)));
+    _mm256_storeu_si256 ((__m256i *) (dst + i), a);
+  }
+
+  xor_c (dst + i, src + i, len - i);
+}
+
+#endif /* KMS_FEC_X86 */
+
+/* Dispatch */
+
+static KmsFecImpl best_impl = KMS_FEC_SCALAR;
+static KmsFecImpl current_impl = KMS_FEC_SCALAR;
+static KmsFecXorFunc xor_func = xor_c;
+
+static KmsFecXorFunc
+kms_fec_get_xor_func (KmsFecImpl impl)
+{
+  switch (impl) {
+#ifdef KMS_FEC_X86
+    case KMS_FEC_AVX2:
+      return xor_avx2;
+    case KMS_FEC_SSE2:
+      return xor_sse2;
+#endif
+    default:
+      return xor_c;
+  }
+}
+
+static gpointer
+kms_fec_detect (gpointer data)
+{
+#ifdef KMS_FEC_X86
+  __builtin_cpu_init ();
+
+  if (__builtin_cpu_supports ("avx2")) {
+    best_impl = KMS_FEC_AVX2;
+  } else if (__builtin_cpu_supports ("sse2")) {
+    best_impl = KMS_FEC_SSE2;
+  }
+#endif
+
+  current_impl = best_impl;
+  xor_func = kms_fec_get_xor_func (best_impl);
+
+  GST_INFO ("Using %s FEC kernels", kms_fec_impl_get_name (best_impl));
+
+  return NULL;
+}
+
+static inline KmsFecXorFunc
+kms_fec_xor_func (void)
+{
+  static GOnce once = G_ONCE_INIT;
+
+  g_once (&once, kms_fec_detect, NULL);
+
+  return xor_func;
+}
+
+KmsFecImpl
+kms_fec_get_impl (void)
+{
+  kms_fec_xor_func ();
+
+  return current_impl;
+}
+
+KmsFecImpl
+kms_fec_set_impl (KmsFecImpl impl)
+{
+  kms_fec_xor_func ();
+
+  current_impl = MIN (impl, best_impl);
+  xor_func = kms_fec_get_xor_func (current_impl);
+
+  return current_impl;
+}
+
+const gchar *
+kms_fec_impl_get_name (KmsFecImpl impl)
+{
+  switch (impl) {
+    case KMS_FEC_AVX2:
+      return "avx2";
+    case KMS_FEC_SSE2:
+      return "sse2";
+    default:
+      return "scalar";
+  }
+}
+
+void
+kms_fec_xor (guint8 * dst, const guint8 * src, gsize len)
+{
+  kms_fec_xor_func () (dst, src, len);
+}
+
+/* ULPFEC */
+
+/* XOR of the header fields protected by FEC: P, X, CC, M, PT and TS */
+static inline void
+xor_header (guint8 * rec, const guint8 * header)
+{
+  rec[0] ^= header[0];
+  rec[1] ^= header[1];
+  rec[4] ^= header[4];
+  rec[5] ^= header[5];
+  rec[6] ^= header[6];
+  rec[7] ^= header[7];
+}
+
+GstBuffer *
+kms_fec_protect (GstBuffer ** packets, guint n_packets, guint8 pt,
+    guint16 seq)
+{
+  KmsFecXorFunc xor_bytes = kms_fec_xor_func ();
+  guint8 rec[8] = { 0, };
+  guint16 base_seq = 0, len_rec = 0;
+  GstMapInfo info, out;
+  GstBuffer *fec = NULL;
+  guint8 *fec_header, *ulp_header, *payload;
+  gsize prot_len = 0, ulp_len;
+  guint64 mask = 0;
+  guint i;
+
+  g_return_val_if_fail (n_packets > 0 && n_packets <= KMS_FEC_MAX_PACKETS,
+      NULL);
+
+  /* Sizes first, so packets are mapped only once */
+  for (i = 0; i < n_packets; i++) {
+    gsize size = gst_buffer_get_size (packets[i]);
+
+    if (size < RTP_HEADER_LEN || size - RTP_HEADER_LEN > G_MAXUINT16) {
+      GST_WARNING ("Cannot protect a packet of %" G_GSIZE_FORMAT " bytes",
+          size);
+      return NULL;
+    }
+
+    prot_len = MAX (prot_len, size - RTP_HEADER_LEN);
+  }
+
+  for (i = 0; i < n_packets; i++) {
+    guint8 header[RTP_HEADER_LEN];
+    guint16 offset;
+
+    gst_buffer_extract (packets[i], 0, header, RTP_HEADER_LEN);
+
+    if (i == 0) {
+      base_seq = GST_READ_UINT16_BE (header + 2);
+    }
+
+    offset = GST_READ_UINT16_BE (header + 2) - base_seq;
+    if (offset >= KMS_FEC_MAX_PACKETS) {
+      GST_DEBUG ("Packet %u too far from %u", base_seq + offset, base_seq);
+      return NULL;
+    }
+
+    mask |= MASK_BIT (offset);
+  }
+
+  ulp_len = (mask & MASK_LONG_BITS) ? ULP_HEADER_LEN_LONG :
+      ULP_HEADER_LEN_SHORT;
+
+  fec = gst_buffer_new_allocate (NULL, RTP_HEADER_LEN + FEC_HEADER_LEN +
+      ulp_len + prot_len, NULL);
+  gst_buffer_map (fec, &out, GST_MAP_WRITE);
+  memset (out.data, 0, out.size);
+
+  fec_header = out.data + RTP_HEADER_LEN;
+  ulp_header = fec_header + FEC_HEADER_LEN;
+  payload = ulp_header + ulp_len;
+
+  for (i = 0; i < n_packets; i++) {
+    gst_buffer_map (packets[i], &info, GST_MAP_READ);
+
+    xor_header (rec, info.data);
+    len_rec ^= info.size - RTP_HEADER_LEN;
+    xor_bytes (payload, info.data + RTP_HEADER_LEN,
+        info.size - RTP_HEADER_LEN);
+
+    if (i == n_packets - 1) {
+      /* Timestamp of the last protected packet, same SSRC */
+      memcpy (out.data + 4, info.data + 4, 8);
+    }
+
+    gst_buffer_unmap (packets[i], &info);
+  }
+
+  out.data[0] = 0x80;
+  out.data[1] = pt & 0x7f;
+  GST_WRITE_UINT16_BE (out.data + 2, seq);
+
+  fec_header[0] = (rec[0] & 0x3f) | (ulp_len == ULP_HEADER_LEN_LONG ?
+      FEC_L_BIT : 0);
+  fec_header[1] = rec[1];
+  GST_WRITE_UINT16_BE (fec_header + 2, base_seq);
+  memcpy (fec_header + 4, rec + 4, 4);
+  GST_WRITE_UINT16_BE (fec_header + 8, len_rec);
+
+  GST_WRITE_UINT16_BE (ulp_header, prot_len);
+  GST_WRITE_UINT16_BE (ulp_header + 2, mask >> 32);
+  if (ulp_len == ULP_HEADER_LEN_LONG) {
+    GST_WRITE_UINT32_BE (ulp_header + 4, mask & MASK_LONG_BITS);
+  }
+
+  gst_buffer_unmap (fec, &out);
+
+  GST_BUFFER_PTS (fec) = GST_BUFFER_PTS (packets[n_packets - 1]);
+  GST_BUFFER_DTS (fec) = GST_BUFFER_DTS (packets[n_packets - 1]);
+
+  return fec;
+}
+
+GstBuffer *
+kms_fec_recover (GstBuffer * fec, KmsFecLookupFunc lookup,
+    gpointer user_data, guint * n_missing)
+{
+  KmsFecXorFunc xor_bytes = kms_fec_xor_func ();
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstBuffer *protected[KMS_FEC_MAX_PACKETS];
+  GstBuffer *recovered = NULL;
+  guint8 rec[8] = { 0, };
+  const guint8 *fec_header, *ulp_header;
+  guint16 base_seq, missing_seq = 0, len_rec, prot_len;
+  guint n_protected = 0, missing = 0, ulp_len, len, i;
+  GstMapInfo info, out;
+  guint64 mask;
+
+  if (n_missing != NULL) {
+    *n_missing = 0;
+  }
+
+  if (!gst_rtp_buffer_map (fec, GST_MAP_READ, &rtp)) {
+    return NULL;
+  }
+
+  fec_header = gst_rtp_buffer_get_payload (&rtp);
+  len = gst_rtp_buffer_get_payload_len (&rtp);
+
+  if (len < FEC_HEADER_LEN + ULP_HEADER_LEN_SHORT
+      || (fec_header[0] & FEC_E_BIT)) {
+    GST_DEBUG ("Invalid FEC packet");
+    goto end;
+  }
+
+  ulp_len = (fec_header[0] & FEC_L_BIT) ? ULP_HEADER_LEN_LONG :
+      ULP_HEADER_LEN_SHORT;
+  ulp_header = fec_header + FEC_HEADER_LEN;
+
+  if (len < FEC_HEADER_LEN + ulp_len) {
+    GST_DEBUG ("Invalid FEC packet");
+    goto end;
+  }
+
+  base_seq = GST_READ_UINT16_BE (fec_header + 2);
+  len_rec = GST_READ_UINT16_BE (fec_header + 8);
+  prot_len = GST_READ_UINT16_BE (ulp_header);
+  mask = (guint64) GST_READ_UINT16_BE (ulp_header + 2) << 32;
+  if (ulp_len == ULP_HEADER_LEN_LONG) {
+    mask |= GST_READ_UINT32_BE (ulp_header + 4);
+  }
+
+  if (len < FEC_HEADER_LEN + ulp_len + prot_len) {
+    GST_DEBUG ("Truncated FEC packet");
+    goto end;
+  }
+
+  for (i = 0; i < KMS_FEC_MAX_PACKETS; i++) {
+    GstBuffer *packet;
+
+    if (!(mask & MASK_BIT (i))) {
+      continue;
+    }
+
+    packet = lookup (base_seq + i, user_data);
+    if (packet == NULL) {
+      missing_seq = base_seq + i;
+      missing++;
+    } else {
+      protected[n_protected++] = packet;
+    }
+  }
+
+  if (n_missing != NULL) {
+    *n_missing = missing;
+  }
+
+  if (missing != 1) {
+    goto end;
+  }
+
+  rec[0] = fec_header[0];
+  rec[1] = fec_header[1];
+  memcpy (rec + 4, fec_header + 4, 4);
+
+  /* Protection covers up to the longest packet, payload is recovered
+   * there and trimmed once its length is known */
+  recovered = gst_buffer_new_allocate (NULL, RTP_HEADER_LEN + prot_len, NULL);
+  gst_buffer_map (recovered, &out, GST_MAP_WRITE);
+  memcpy (out.data + RTP_HEADER_LEN, ulp_header + ulp_len, prot_len);
+
+  for (i = 0; i < n_protected; i++) {
+    gsize size;
+
+    gst_buffer_map (protected[i], &info, GST_MAP_READ);
+
+    if (info.size < RTP_HEADER_LEN) {
+      gst_buffer_unmap (protected[i], &info);
+      continue;
+    }
+
+    size = MIN (info.size - RTP_HEADER_LEN, prot_len);
+    xor_header (rec, info.data);
+    len_rec ^= info.size - RTP_HEADER_LEN;
+    xor_bytes (out.data + RTP_HEADER_LEN, info.data + RTP_HEADER_LEN, size);
+
+    gst_buffer_unmap (protected[i], &info);
+  }
+
+  if (len_rec > prot_len) {
+    GST_DEBUG ("Packet %u not fully protected", missing_seq);
+    gst_buffer_unmap (recovered, &out);
+    gst_buffer_unref (recovered);
+    recovered = NULL;
+    goto end;
+  }
+
+  out.data[0] = 0x80 | (rec[0] & 0x3f);
+  out.data[1] = rec[1];
+  GST_WRITE_UINT16_BE (out.data + 2, missing_seq);
+  memcpy (out.data + 4, rec + 4, 4);
+  GST_WRITE_UINT32_BE (out.data + 8, gst_rtp_buffer_get_ssrc (&rtp));
+
+  gst_buffer_unmap (recovered, &out);
+  gst_buffer_resize (recovered, 0, RTP_HEADER_LEN + len_rec);
+
+  GST_BUFFER_PTS (recovered) = GST_BUFFER_PTS (fec);
+  GST_BUFFER_DTS (recovered) = GST_BUFFER_DTS (fec);
+
+  GST_LOG ("Recovered packet %u", missing_seq);
+
+end:
+  gst_rtp_buffer_unmap (&rtp);
+
+  return recovered;
+}
+
+static void init_debug (void) __attribute__ ((constructor));
+
+static void
+init_debug (void)
+{
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+}
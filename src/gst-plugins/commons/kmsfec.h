@@ -0,0 +1,88 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_FEC_H__
+#define __KMS_FEC_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Packets covered by one FEC packet with the long ULP mask */
+#define KMS_FEC_MAX_PACKETS 48
+
+/**
+ * KmsFecImpl:
+ *
+ * Instruction set used by the XOR kernel. The best one supported by the CPU
+ * is selected the first time it is used.
+ */
+typedef enum
+{
+  KMS_FEC_SCALAR,
+  KMS_FEC_SSE2,
+  KMS_FEC_AVX2
+} KmsFecImpl;
+
+KmsFecImpl kms_fec_get_impl (void);
+
+/* Selects a lower implementation, mainly for tests and benchmarks. It is not
+ * thread safe and returns the implementation actually in use */
+KmsFecImpl kms_fec_set_impl (KmsFecImpl impl);
+
+const gchar * kms_fec_impl_get_name (KmsFecImpl impl);
+
+/* dst[i] ^= src[i] for the first len bytes */
+void kms_fec_xor (guint8 * dst, const guint8 * src, gsize len);
+
+/**
+ * kms_fec_protect:
+ * @packets: (array length=n_packets): RTP packets of the same stream
+ * @n_packets: number of packets, up to %KMS_FEC_MAX_PACKETS
+ * @pt: payload type of the FEC packet
+ * @seq: sequence number of the FEC packet
+ *
+ * Builds an RFC 5109 ULPFEC packet with a single level 0 protection over
+ * @packets, so any one of them can be recovered from the others. Sequence
+ * numbers of @packets must be within %KMS_FEC_MAX_PACKETS of the first one.
+ *
+ * Returns: (transfer full) (nullable): the FEC packet, or %NULL if @packets
+ * cannot be protected together
+ */
+GstBuffer * kms_fec_protect (GstBuffer ** packets, guint n_packets,
+    guint8 pt, guint16 seq);
+
+/* Returns the packet with sequence number seq, if received, without giving
+ * a reference */
+typedef GstBuffer * (*KmsFecLookupFunc) (guint16 seq, gpointer user_data);
+
+/**
+ * kms_fec_recover:
+ * @fec: an ULPFEC packet
+ * @lookup: returns the received packets protected by @fec
+ * @user_data: data for @lookup
+ * @n_missing: (out) (optional): protected packets not received
+ *
+ * Returns: (transfer full) (nullable): the protected packet that was not
+ * received, or %NULL if none or more than one were lost
+ */
+GstBuffer * kms_fec_recover (GstBuffer * fec, KmsFecLookupFunc lookup,
+    gpointer user_data, guint * n_missing);
+
+G_END_DECLS
+
+#endif /* __KMS_FEC_H__ */
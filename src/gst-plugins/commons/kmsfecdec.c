@@ -0,0 +1,387 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <gst/rtp/gstrtpbuffer.h>
+
+#include "kmsfecdec.h"
+#include "kmsfec.h"
+
+#define GST_DEFAULT_NAME "fecdec"
+#define GST_CAT_DEFAULT kms_fec_dec_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+#define kms_fec_dec_parent_class parent_class
+G_DEFINE_TYPE (KmsFecDec, kms_fec_dec, GST_TYPE_ELEMENT);
+
+#define KMS_FEC_DEC_GET_PRIVATE(obj) (  \
+  G_TYPE_INSTANCE_GET_PRIVATE (         \
+    (obj),                              \
+    KMS_TYPE_FEC_DEC,                   \
+    KmsFecDecPrivate                    \
+  )                                     \
+)
+
+/* Payload types above 127 disable FEC */
+#define DEFAULT_PT 255
+
+/* Received packets kept to recover others, power of two and enough for
+ * the longest ULP mask with some reordering */
+#define HISTORY_SIZE 128
+#define HISTORY_MASK (HISTORY_SIZE - 1)
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-rtp"));
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-rtp"));
+
+enum
+{
+  PROP_0,
+  PROP_PT,
+  PROP_STATS,
+  N_PROPERTIES
+};
+
+typedef struct _KmsFecDecEntry
+{
+  GstBuffer *buffer;
+  guint32 ssrc;
+  guint16 seq;
+} KmsFecDecEntry;
+
+typedef struct _KmsFecDecLookup
+{
+  KmsFecDec *self;
+  guint32 ssrc;
+} KmsFecDecLookup;
+
+struct _KmsFecDecPrivate
+{
+  GstPad *sinkpad;
+  GstPad *srcpad;
+
+  /* Protected by the object lock */
+  guint pt;
+  guint64 fec_packets;
+  guint64 recovered;
+  guint64 unrecoverable;
+
+  /* Only used from the streaming thread */
+  KmsFecDecEntry history[HISTORY_SIZE];
+};
+
+static void
+kms_fec_dec_clear_history (KmsFecDec * self)
+{
+  guint i;
+
+  for (i = 0; i < HISTORY_SIZE; i++) {
+    gst_buffer_replace (&self->priv->history[i].buffer, NULL);
+  }
+}
+
+static void
+kms_fec_dec_store (KmsFecDec * self, GstBuffer * buffer, guint32 ssrc,
+    guint16 seq)
+{
+  KmsFecDecEntry *entry = &self->priv->history[seq & HISTORY_MASK];
+
+  gst_buffer_replace (&entry->buffer, buffer);
+  entry->ssrc = ssrc;
+  entry->seq = seq;
+}
+
+static GstBuffer *
+kms_fec_dec_lookup (guint16 seq, gpointer user_data)
+{
+  KmsFecDecLookup *lookup = user_data;
+  KmsFecDecEntry *entry = &lookup->self->priv->history[seq & HISTORY_MASK];
+
+  /* Packets of other streams must not be taken as protected ones */
+  if (entry->buffer == NULL || entry->seq != seq ||
+      entry->ssrc != lookup->ssrc) {
+    return NULL;
+  }
+
+  return entry->buffer;
+}
+
+/* Returns the buffer to push instead of buffer, which is consumed. It is
+ * buffer itself for media packets and the recovered one, if any, for FEC
+ * packets */
+static GstBuffer *
+kms_fec_dec_process (KmsFecDec * self, GstBuffer * buffer)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  KmsFecDecLookup lookup;
+  GstBuffer *recovered;
+  guint pt, n_missing;
+  guint32 ssrc;
+  guint16 seq;
+
+  if (!gst_rtp_buffer_map (buffer, GST_MAP_READ, &rtp)) {
+    GST_WARNING_OBJECT (self, "Not an RTP buffer, pushing as is");
+    return buffer;
+  }
+
+  seq = gst_rtp_buffer_get_seq (&rtp);
+  ssrc = gst_rtp_buffer_get_ssrc (&rtp);
+  pt = gst_rtp_buffer_get_payload_type (&rtp);
+  gst_rtp_buffer_unmap (&rtp);
+
+  GST_OBJECT_LOCK (self);
+  if (pt != self->priv->pt) {
+    GST_OBJECT_UNLOCK (self);
+    kms_fec_dec_store (self, buffer, ssrc, seq);
+
+    return buffer;
+  }
+  self->priv->fec_packets++;
+  GST_OBJECT_UNLOCK (self);
+
+  lookup.self = self;
+  lookup.ssrc = ssrc;
+  recovered = kms_fec_recover (buffer, kms_fec_dec_lookup, &lookup,
+      &n_missing);
+  gst_buffer_unref (buffer);
+
+  GST_OBJECT_LOCK (self);
+  if (recovered != NULL) {
+    self->priv->recovered++;
+  } else if (n_missing > 1) {
+    self->priv->unrecoverable++;
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  if (recovered == NULL) {
+    if (n_missing > 1) {
+      GST_DEBUG_OBJECT (self, "Cannot recover %u packets", n_missing);
+    }
+
+    return NULL;
+  }
+
+  if (gst_rtp_buffer_map (recovered, GST_MAP_READ, &rtp)) {
+    seq = gst_rtp_buffer_get_seq (&rtp);
+    gst_rtp_buffer_unmap (&rtp);
+
+    /* It may protect others in a later FEC packet */
+    kms_fec_dec_store (self, recovered, ssrc, seq);
+    GST_LOG_OBJECT (self, "Recovered packet %u", seq);
+  }
+
+  return recovered;
+}
+
+static GstFlowReturn
+kms_fec_dec_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  KmsFecDec *self = KMS_FEC_DEC (parent);
+
+  buffer = kms_fec_dec_process (self, buffer);
+
+  if (buffer == NULL) {
+    return GST_FLOW_OK;
+  }
+
+  return gst_pad_push (self->priv->srcpad, buffer);
+}
+
+static GstFlowReturn
+kms_fec_dec_chain_list (GstPad * pad, GstObject * parent,
+    GstBufferList * list)
+{
+  KmsFecDec *self = KMS_FEC_DEC (parent);
+  GstBufferList *out;
+  guint i, len;
+
+  len = gst_buffer_list_length (list);
+  out = gst_buffer_list_new_sized (len);
+
+  for (i = 0; i < len; i++) {
+    GstBuffer *buffer = gst_buffer_ref (gst_buffer_list_get (list, i));
+
+    buffer = kms_fec_dec_process (self, buffer);
+    if (buffer != NULL) {
+      gst_buffer_list_add (out, buffer);
+    }
+  }
+
+  gst_buffer_list_unref (list);
+
+  if (gst_buffer_list_length (out) == 0) {
+    gst_buffer_list_unref (out);
+    return GST_FLOW_OK;
+  }
+
+  return gst_pad_push_list (self->priv->srcpad, out);
+}
+
+static gboolean
+kms_fec_dec_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  KmsFecDec *self = KMS_FEC_DEC (parent);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP) {
+    kms_fec_dec_clear_history (self);
+  }
+
+  return gst_pad_event_default (pad, parent, event);
+}
+
+static GstStateChangeReturn
+kms_fec_dec_change_state (GstElement * element, GstStateChange transition)
+{
+  KmsFecDec *self = KMS_FEC_DEC (element);
+  GstStateChangeReturn ret;
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+
+  if (transition == GST_STATE_CHANGE_PAUSED_TO_READY) {
+    /* Streaming thread is stopped */
+    kms_fec_dec_clear_history (self);
+  }
+
+  return ret;
+}
+
+static void
+kms_fec_dec_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  KmsFecDec *self = KMS_FEC_DEC (object);
+
+  switch (property_id) {
+    case PROP_PT:
+      GST_OBJECT_LOCK (self);
+      self->priv->pt = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+kms_fec_dec_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  KmsFecDec *self = KMS_FEC_DEC (object);
+
+  GST_OBJECT_LOCK (self);
+
+  switch (property_id) {
+    case PROP_PT:
+      g_value_set_uint (value, self->priv->pt);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_structure_new (KMS_FEC_DEC_STATS_NAME,
+              "fec-packets", G_TYPE_UINT64, self->priv->fec_packets,
+              "recovered", G_TYPE_UINT64, self->priv->recovered,
+              "unrecoverable", G_TYPE_UINT64, self->priv->unrecoverable,
+              NULL));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+
+  GST_OBJECT_UNLOCK (self);
+}
+
+static void
+kms_fec_dec_finalize (GObject * object)
+{
+  KmsFecDec *self = KMS_FEC_DEC (object);
+
+  kms_fec_dec_clear_history (self);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+kms_fec_dec_class_init (KmsFecDecClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+
+  gobject_class->finalize = kms_fec_dec_finalize;
+  gobject_class->set_property = kms_fec_dec_set_property;
+  gobject_class->get_property = kms_fec_dec_get_property;
+
+  gstelement_class->change_state = kms_fec_dec_change_state;
+
+  gst_element_class_set_details_simple (gstelement_class,
+      "FEC decoder",
+      "Codec/Depayloader/Network/RTP",
+      "Recovers lost RTP packets from ULPFEC packets",
+      "Kurento <kurento@googlegroups.com>");
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&src_template));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&sink_template));
+
+  g_object_class_install_property (gobject_class, PROP_PT,
+      g_param_spec_uint ("pt", "Payload type",
+          "Payload type of FEC packets, above 127 to disable FEC", 0, 255,
+          DEFAULT_PT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "FEC packets received and packets recovered", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+
+  g_type_class_add_private (klass, sizeof (KmsFecDecPrivate));
+}
+
+static void
+kms_fec_dec_init (KmsFecDec * self)
+{
+  self->priv = KMS_FEC_DEC_GET_PRIVATE (self);
+
+  self->priv->sinkpad = gst_pad_new_from_static_template (&sink_template,
+      "sink");
+  gst_pad_set_chain_function (self->priv->sinkpad,
+      GST_DEBUG_FUNCPTR (kms_fec_dec_chain));
+  gst_pad_set_chain_list_function (self->priv->sinkpad,
+      GST_DEBUG_FUNCPTR (kms_fec_dec_chain_list));
+  gst_pad_set_event_function (self->priv->sinkpad,
+      GST_DEBUG_FUNCPTR (kms_fec_dec_sink_event));
+  GST_PAD_SET_PROXY_CAPS (self->priv->sinkpad);
+  GST_PAD_SET_PROXY_ALLOCATION (self->priv->sinkpad);
+  gst_element_add_pad (GST_ELEMENT (self), self->priv->sinkpad);
+
+  self->priv->srcpad = gst_pad_new_from_static_template (&src_template,
+      "src");
+  GST_PAD_SET_PROXY_CAPS (self->priv->srcpad);
+  gst_element_add_pad (GST_ELEMENT (self), self->priv->srcpad);
+
+  self->priv->pt = DEFAULT_PT;
+}
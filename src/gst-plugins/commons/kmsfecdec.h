@@ -0,0 +1,69 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_FEC_DEC_H__
+#define __KMS_FEC_DEC_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define KMS_TYPE_FEC_DEC \
+  (kms_fec_dec_get_type())
+#define KMS_FEC_DEC(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),KMS_TYPE_FEC_DEC,KmsFecDec))
+#define KMS_FEC_DEC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),KMS_TYPE_FEC_DEC,KmsFecDecClass))
+#define KMS_IS_FEC_DEC(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),KMS_TYPE_FEC_DEC))
+#define KMS_IS_FEC_DEC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),KMS_TYPE_FEC_DEC))
+
+#define KMS_FEC_DEC_STATS_NAME "fec-stats"
+
+typedef struct _KmsFecDec KmsFecDec;
+typedef struct _KmsFecDecClass KmsFecDecClass;
+typedef struct _KmsFecDecPrivate KmsFecDecPrivate;
+
+/**
+ * KmsFecDec:
+ *
+ * Recovers lost RTP packets from the RFC 5109 ULPFEC packets with payload
+ * type "pt" of the stream, which are not pushed downstream. Recovered
+ * packets are pushed as soon as their FEC packet arrives, so it must be
+ * placed before the jitter buffer. Buffer lists are pushed as lists. The
+ * "stats" property counts the "fec-packets" received, the packets
+ * "recovered" and the FEC packets that were "unrecoverable" because of
+ * several losses.
+ */
+struct _KmsFecDec
+{
+  GstElement parent;
+
+  KmsFecDecPrivate *priv;
+};
+
+struct _KmsFecDecClass
+{
+  GstElementClass parent_class;
+};
+
+GType kms_fec_dec_get_type (void);
+
+G_END_DECLS
+
+#endif /* __KMS_FEC_DEC_H__ */
@@ -0,0 +1,495 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <gst/rtp/gstrtpbuffer.h>
+
+#include "kmsfecenc.h"
+#include "kmsfec.h"
+
+#define GST_DEFAULT_NAME "fecenc"
+#define GST_CAT_DEFAULT kms_fec_enc_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+#define kms_fec_enc_parent_class parent_class
+G_DEFINE_TYPE (KmsFecEnc, kms_fec_enc, GST_TYPE_ELEMENT);
+
+#define KMS_FEC_ENC_GET_PRIVATE(obj) (  \
+  G_TYPE_INSTANCE_GET_PRIVATE (         \
+    (obj),                              \
+    KMS_TYPE_FEC_ENC,                   \
+    KmsFecEncPrivate                    \
+  )                                     \
+)
+
+/* Payload types above 127 disable FEC */
+#define DEFAULT_PT 255
+#define DEFAULT_PERCENTAGE 0
+#define DEFAULT_MAX_PERCENTAGE 50
+
+/* Media packets between two queries of the measured losses */
+#define LOSS_UPDATE_PACKETS 64
+
+/* A single loss per group can be recovered, so groups are made small
+ * enough to expect about one loss every two of them */
+#define LOSS_PROTECTION_FACTOR 2
+
+/* Each media packet earns its percentage of a FEC packet. A frame is closed
+ * with a FEC packet when it has earned at least half of one, otherwise its
+ * group goes on with the next frame */
+#define FEC_PACKET_CREDIT 100
+#define FRAME_END_CREDIT (FEC_PACKET_CREDIT / 2)
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-rtp"));
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-rtp"));
+
+enum
+{
+  PROP_0,
+  PROP_PT,
+  PROP_PERCENTAGE,
+  PROP_MAX_PERCENTAGE,
+  PROP_CURRENT_PERCENTAGE,
+  N_PROPERTIES
+};
+
+typedef struct _KmsFecEncInsertion
+{
+  guint idx;
+  GstBuffer *fec;
+} KmsFecEncInsertion;
+
+struct _KmsFecEncPrivate
+{
+  GstPad *sinkpad;
+  GstPad *srcpad;
+
+  /* Protected by the object lock */
+  guint pt;
+  guint percentage;
+  guint max_percentage;
+  guint current_percentage;
+  guint packets_to_update;
+  KmsFecEncLossFunc loss_func;
+  gpointer loss_data;
+  GDestroyNotify loss_notify;
+
+  /* Only used from the streaming thread */
+  GstBuffer *group[KMS_FEC_MAX_PACKETS];
+  guint n_group;
+  guint16 base_seq;
+  guint32 ssrc;
+  guint16 seq_offset;
+  gint credit;
+};
+
+static void
+kms_fec_enc_clear_group (KmsFecEnc * self)
+{
+  guint i;
+
+  for (i = 0; i < self->priv->n_group; i++) {
+    gst_buffer_unref (self->priv->group[i]);
+  }
+
+  self->priv->n_group = 0;
+}
+
+/* Must be called with the object lock held */
+static void
+kms_fec_enc_update_percentage (KmsFecEnc * self)
+{
+  guint percentage = self->priv->percentage;
+
+  if (self->priv->loss_func != NULL) {
+    guint loss = self->priv->loss_func (self->priv->loss_data) * 100 / 256;
+
+    percentage = CLAMP (LOSS_PROTECTION_FACTOR * loss, self->priv->percentage,
+        MAX (self->priv->max_percentage, self->priv->percentage));
+  }
+
+  if (percentage != self->priv->current_percentage) {
+    GST_DEBUG_OBJECT (self, "Protection changed from %u%% to %u%%",
+        self->priv->current_percentage, percentage);
+    self->priv->current_percentage = percentage;
+  }
+}
+
+/* Shifts the sequence number of buffer and returns the FEC packet to send
+ * after it, if any */
+static GstBuffer *
+kms_fec_enc_process (KmsFecEnc * self, GstBuffer ** buffer)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstBuffer *fec;
+  guint pt, percentage;
+  gboolean marker, is_fec;
+  guint32 ssrc;
+  guint16 seq;
+
+  GST_OBJECT_LOCK (self);
+  if (self->priv->packets_to_update == 0) {
+    kms_fec_enc_update_percentage (self);
+    self->priv->packets_to_update = LOSS_UPDATE_PACKETS;
+  }
+  self->priv->packets_to_update--;
+  pt = self->priv->pt;
+  percentage = self->priv->current_percentage;
+  GST_OBJECT_UNLOCK (self);
+
+  if (self->priv->seq_offset != 0) {
+    *buffer = gst_buffer_make_writable (*buffer);
+
+    if (!gst_rtp_buffer_map (*buffer, GST_MAP_READWRITE, &rtp)) {
+      GST_WARNING_OBJECT (self, "Not an RTP buffer, pushing as is");
+      return NULL;
+    }
+
+    gst_rtp_buffer_set_seq (&rtp,
+        gst_rtp_buffer_get_seq (&rtp) + self->priv->seq_offset);
+  } else if (!gst_rtp_buffer_map (*buffer, GST_MAP_READ, &rtp)) {
+    GST_WARNING_OBJECT (self, "Not an RTP buffer, pushing as is");
+    return NULL;
+  }
+
+  seq = gst_rtp_buffer_get_seq (&rtp);
+  ssrc = gst_rtp_buffer_get_ssrc (&rtp);
+  marker = gst_rtp_buffer_get_marker (&rtp);
+  is_fec = gst_rtp_buffer_get_payload_type (&rtp) == pt;
+  gst_rtp_buffer_unmap (&rtp);
+
+  if (percentage == 0 || pt > 127 || is_fec) {
+    kms_fec_enc_clear_group (self);
+    self->priv->credit = 0;
+    return NULL;
+  }
+
+  if (self->priv->n_group > 0 && (ssrc != self->priv->ssrc
+          || (guint16) (seq - self->priv->base_seq) >= KMS_FEC_MAX_PACKETS)) {
+    GST_DEBUG_OBJECT (self, "Stream discontinuity, dropping FEC group");
+    kms_fec_enc_clear_group (self);
+    self->priv->credit = 0;
+  }
+
+  if (self->priv->n_group == 0) {
+    self->priv->base_seq = seq;
+    self->priv->ssrc = ssrc;
+  }
+
+  self->priv->group[self->priv->n_group++] = gst_buffer_ref (*buffer);
+  self->priv->credit += percentage;
+
+  /* Small frames share groups, so the overhead follows the percentage */
+  if (self->priv->credit < FEC_PACKET_CREDIT &&
+      self->priv->n_group < KMS_FEC_MAX_PACKETS &&
+      !(marker && self->priv->credit >= FRAME_END_CREDIT)) {
+    return NULL;
+  }
+
+  fec = kms_fec_protect (self->priv->group, self->priv->n_group, pt, seq + 1);
+  kms_fec_enc_clear_group (self);
+  self->priv->credit = MAX (self->priv->credit - FEC_PACKET_CREDIT,
+      -FRAME_END_CREDIT);
+
+  if (fec != NULL) {
+    /* Following media packets leave room for this one */
+    self->priv->seq_offset++;
+  }
+
+  return fec;
+}
+
+static GstFlowReturn
+kms_fec_enc_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  KmsFecEnc *self = KMS_FEC_ENC (parent);
+  GstFlowReturn ret;
+  GstBuffer *fec;
+
+  fec = kms_fec_enc_process (self, &buffer);
+  ret = gst_pad_push (self->priv->srcpad, buffer);
+
+  if (fec == NULL) {
+    return ret;
+  }
+
+  if (ret != GST_FLOW_OK) {
+    gst_buffer_unref (fec);
+    return ret;
+  }
+
+  return gst_pad_push (self->priv->srcpad, fec);
+}
+
+static gboolean
+kms_fec_enc_process_list_item (GstBuffer ** buffer, guint idx,
+    gpointer user_data)
+{
+  KmsFecEnc *self = ((gpointer *) user_data)[0];
+  GArray *insertions = ((gpointer *) user_data)[1];
+  KmsFecEncInsertion insertion;
+
+  insertion.fec = kms_fec_enc_process (self, buffer);
+
+  if (insertion.fec != NULL) {
+    insertion.idx = idx + 1;
+    g_array_append_val (insertions, insertion);
+  }
+
+  return TRUE;
+}
+
+static GstFlowReturn
+kms_fec_enc_chain_list (GstPad * pad, GstObject * parent,
+    GstBufferList * list)
+{
+  KmsFecEnc *self = KMS_FEC_ENC (parent);
+  GArray *insertions;
+  gpointer data[2];
+  guint i;
+
+  /* Buffers are rewritten in place, FEC packets are inserted afterwards
+   * because the list cannot grow while it is iterated */
+  list = gst_buffer_list_make_writable (list);
+  insertions = g_array_new (FALSE, FALSE, sizeof (KmsFecEncInsertion));
+
+  data[0] = self;
+  data[1] = insertions;
+  gst_buffer_list_foreach (list, kms_fec_enc_process_list_item, data);
+
+  for (i = insertions->len; i > 0; i--) {
+    KmsFecEncInsertion *insertion =
+        &g_array_index (insertions, KmsFecEncInsertion, i - 1);
+
+    gst_buffer_list_insert (list, insertion->idx, insertion->fec);
+  }
+
+  g_array_free (insertions, TRUE);
+
+  return gst_pad_push_list (self->priv->srcpad, list);
+}
+
+static gboolean
+kms_fec_enc_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  KmsFecEnc *self = KMS_FEC_ENC (parent);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP) {
+    kms_fec_enc_clear_group (self);
+  }
+
+  return gst_pad_event_default (pad, parent, event);
+}
+
+static GstStateChangeReturn
+kms_fec_enc_change_state (GstElement * element, GstStateChange transition)
+{
+  KmsFecEnc *self = KMS_FEC_ENC (element);
+  GstStateChangeReturn ret;
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+
+  if (transition == GST_STATE_CHANGE_PAUSED_TO_READY) {
+    /* Streaming thread is stopped */
+    kms_fec_enc_clear_group (self);
+    self->priv->seq_offset = 0;
+    self->priv->credit = 0;
+  }
+
+  return ret;
+}
+
+void
+kms_fec_enc_set_loss_func (KmsFecEnc * self, KmsFecEncLossFunc func,
+    gpointer user_data, GDestroyNotify notify)
+{
+  GDestroyNotify old_notify;
+  gpointer old_data;
+
+  g_return_if_fail (KMS_IS_FEC_ENC (self));
+
+  GST_OBJECT_LOCK (self);
+  old_notify = self->priv->loss_notify;
+  old_data = self->priv->loss_data;
+  self->priv->loss_func = func;
+  self->priv->loss_data = user_data;
+  self->priv->loss_notify = notify;
+  self->priv->packets_to_update = 0;
+  GST_OBJECT_UNLOCK (self);
+
+  if (old_notify != NULL) {
+    old_notify (old_data);
+  }
+}
+
+static void
+kms_fec_enc_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  KmsFecEnc *self = KMS_FEC_ENC (object);
+
+  GST_OBJECT_LOCK (self);
+
+  switch (property_id) {
+    case PROP_PT:
+      self->priv->pt = g_value_get_uint (value);
+      break;
+    case PROP_PERCENTAGE:
+      self->priv->percentage = g_value_get_uint (value);
+      self->priv->packets_to_update = 0;
+      break;
+    case PROP_MAX_PERCENTAGE:
+      self->priv->max_percentage = g_value_get_uint (value);
+      self->priv->packets_to_update = 0;
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+
+  GST_OBJECT_UNLOCK (self);
+}
+
+static void
+kms_fec_enc_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  KmsFecEnc *self = KMS_FEC_ENC (object);
+
+  GST_OBJECT_LOCK (self);
+
+  switch (property_id) {
+    case PROP_PT:
+      g_value_set_uint (value, self->priv->pt);
+      break;
+    case PROP_PERCENTAGE:
+      g_value_set_uint (value, self->priv->percentage);
+      break;
+    case PROP_MAX_PERCENTAGE:
+      g_value_set_uint (value, self->priv->max_percentage);
+      break;
+    case PROP_CURRENT_PERCENTAGE:
+      g_value_set_uint (value, self->priv->current_percentage);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+
+  GST_OBJECT_UNLOCK (self);
+}
+
+static void
+kms_fec_enc_finalize (GObject * object)
+{
+  KmsFecEnc *self = KMS_FEC_ENC (object);
+
+  kms_fec_enc_clear_group (self);
+
+  if (self->priv->loss_notify != NULL) {
+    self->priv->loss_notify (self->priv->loss_data);
+  }
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+kms_fec_enc_class_init (KmsFecEncClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+
+  gobject_class->finalize = kms_fec_enc_finalize;
+  gobject_class->set_property = kms_fec_enc_set_property;
+  gobject_class->get_property = kms_fec_enc_get_property;
+
+  gstelement_class->change_state = kms_fec_enc_change_state;
+
+  gst_element_class_set_details_simple (gstelement_class,
+      "FEC encoder",
+      "Codec/Payloader/Network/RTP",
+      "Adds ULPFEC packets to an RTP stream",
+      "Kurento <kurento@googlegroups.com>");
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&src_template));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&sink_template));
+
+  g_object_class_install_property (gobject_class, PROP_PT,
+      g_param_spec_uint ("pt", "Payload type",
+          "Payload type of FEC packets, above 127 to disable FEC", 0, 255,
+          DEFAULT_PT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PERCENTAGE,
+      g_param_spec_uint ("percentage", "Protection percentage",
+          "FEC packets per 100 media packets, or the minimum when losses "
+          "are measured", 0, 100, DEFAULT_PERCENTAGE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_PERCENTAGE,
+      g_param_spec_uint ("max-percentage", "Maximum protection percentage",
+          "Maximum FEC packets per 100 media packets when losses are "
+          "measured", 0, 100, DEFAULT_MAX_PERCENTAGE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_CURRENT_PERCENTAGE,
+      g_param_spec_uint ("current-percentage", "Current protection percentage",
+          "FEC packets per 100 media packets being sent", 0, 100, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+
+  g_type_class_add_private (klass, sizeof (KmsFecEncPrivate));
+}
+
+static void
+kms_fec_enc_init (KmsFecEnc * self)
+{
+  self->priv = KMS_FEC_ENC_GET_PRIVATE (self);
+
+  self->priv->sinkpad = gst_pad_new_from_static_template (&sink_template,
+      "sink");
+  gst_pad_set_chain_function (self->priv->sinkpad,
+      GST_DEBUG_FUNCPTR (kms_fec_enc_chain));
+  gst_pad_set_chain_list_function (self->priv->sinkpad,
+      GST_DEBUG_FUNCPTR (kms_fec_enc_chain_list));
+  gst_pad_set_event_function (self->priv->sinkpad,
+      GST_DEBUG_FUNCPTR (kms_fec_enc_sink_event));
+  GST_PAD_SET_PROXY_CAPS (self->priv->sinkpad);
+  GST_PAD_SET_PROXY_ALLOCATION (self->priv->sinkpad);
+  gst_element_add_pad (GST_ELEMENT (self), self->priv->sinkpad);
+
+  self->priv->srcpad = gst_pad_new_from_static_template (&src_template,
+      "src");
+  GST_PAD_SET_PROXY_CAPS (self->priv->srcpad);
+  gst_element_add_pad (GST_ELEMENT (self), self->priv->srcpad);
+
+  self->priv->pt = DEFAULT_PT;
+  self->priv->percentage = DEFAULT_PERCENTAGE;
+  self->priv->max_percentage = DEFAULT_MAX_PERCENTAGE;
+}
@@ -0,0 +1,85 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_FEC_ENC_H__
+#define __KMS_FEC_ENC_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define KMS_TYPE_FEC_ENC \
+  (kms_fec_enc_get_type())
+#define KMS_FEC_ENC(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),KMS_TYPE_FEC_ENC,KmsFecEnc))
+#define KMS_FEC_ENC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),KMS_TYPE_FEC_ENC,KmsFecEncClass))
+#define KMS_IS_FEC_ENC(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),KMS_TYPE_FEC_ENC))
+#define KMS_IS_FEC_ENC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),KMS_TYPE_FEC_ENC))
+
+typedef struct _KmsFecEnc KmsFecEnc;
+typedef struct _KmsFecEncClass KmsFecEncClass;
+typedef struct _KmsFecEncPrivate KmsFecEncPrivate;
+
+/**
+ * KmsFecEnc:
+ *
+ * Adds RFC 5109 ULPFEC packets with payload type "pt" to an RTP stream.
+ * Every group of consecutive packets is followed by one FEC packet, so a
+ * single loss per group can be recovered. Groups get the size given by the
+ * protection "percentage" and are closed at the end of a frame when it
+ * is due about one FEC packet. Smaller frames share their group with the
+ * next ones, so the FEC overhead stays near the percentage. Sequence
+ * numbers of the media packets are shifted to make room for the FEC ones.
+ * Buffer lists are pushed as lists with the FEC packets inserted.
+ */
+struct _KmsFecEnc
+{
+  GstElement parent;
+
+  KmsFecEncPrivate *priv;
+};
+
+struct _KmsFecEncClass
+{
+  GstElementClass parent_class;
+};
+
+GType kms_fec_enc_get_type (void);
+
+/* Returns the measured losses as an RTCP fraction lost, 0 to 255 */
+typedef guint (*KmsFecEncLossFunc) (gpointer user_data);
+
+/**
+ * kms_fec_enc_set_loss_func:
+ * @self: a #KmsFecEnc
+ * @func: (nullable): source of the measured losses
+ * @user_data: data for @func
+ * @notify: (nullable): called when @user_data is not needed anymore
+ *
+ * Makes the protection follow the losses returned by @func, between the
+ * "percentage" and "max-percentage" properties. @func is called from the
+ * streaming thread every few packets.
+ */
+void kms_fec_enc_set_loss_func (KmsFecEnc * self, KmsFecEncLossFunc func,
+    gpointer user_data, GDestroyNotify notify);
+
+G_END_DECLS
+
+#endif /* __KMS_FEC_ENC_H__ */
@@ -0,0 +1,379 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "kmsioreactor.h"
+
+#define GST_DEFAULT_NAME "ioreactor"
+#define GST_CAT_DEFAULT kms_io_reactor_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+#define MAX_EVENTS 64
+#define MAX_DEFAULT_THREADS 4
+
+/* Epoll data of the wakeup descriptor, source ids start at 1 */
+#define WAKEUP_ID 0
+
+typedef struct _KmsIoReactorThread
+{
+  KmsIoReactor *reactor;
+  GThread *thread;
+  gint epoll_fd;
+  gint wakeup_fd;
+  guint n_sources;
+} KmsIoReactorThread;
+
+typedef struct _KmsIoSource
+{
+  gint ref;
+  guint id;
+  gint fd;
+  KmsIoReactorThread *thread;
+
+  KmsIoReactorFunc func;
+  gpointer user_data;
+  GDestroyNotify notify;
+
+  /* Thread running the callback, if any */
+  GThread *dispatching;
+  gboolean removed;
+} KmsIoSource;
+
+struct _KmsIoReactor
+{
+  GMutex mutex;
+  GCond cond;
+
+  /* id -> KmsIoSource, protected by mutex */
+  GHashTable *sources;
+  guint next_id;
+
+  guint n_threads;
+  KmsIoReactorThread *threads;
+  gint stopping;
+};
+
+static KmsIoSource *
+kms_io_source_ref (KmsIoSource * source)
+{
+  g_atomic_int_inc (&source->ref);
+
+  return source;
+}
+
+static void
+kms_io_source_unref (KmsIoSource * source)
+{
+  if (!g_atomic_int_dec_and_test (&source->ref)) {
+    return;
+  }
+
+  if (source->notify != NULL) {
+    source->notify (source->user_data);
+  }
+
+  g_slice_free (KmsIoSource, source);
+}
+
+static void
+kms_io_source_arm (KmsIoSource * source, gint op)
+{
+  struct epoll_event ev = { 0 };
+
+  ev.events = EPOLLIN | EPOLLONESHOT;
+  ev.data.u64 = source->id;
+
+  if (epoll_ctl (source->thread->epoll_fd, op, source->fd, &ev) < 0) {
+    GST_ERROR ("Cannot watch fd %d: %s", source->fd, g_strerror (errno));
+  }
+}
+
+/* Must be called with the reactor mutex held */
+static void
+kms_io_reactor_detach_source (KmsIoReactor * reactor, KmsIoSource * source)
+{
+  g_hash_table_remove (reactor->sources, GUINT_TO_POINTER (source->id));
+  source->removed = TRUE;
+  source->thread->n_sources--;
+  epoll_ctl (source->thread->epoll_fd, EPOLL_CTL_DEL, source->fd, NULL);
+}
+
+static void
+kms_io_reactor_dispatch (KmsIoReactor * reactor, guint id)
+{
+  KmsIoSource *source;
+  gboolean keep, detached = FALSE;
+
+  g_mutex_lock (&reactor->mutex);
+  source = g_hash_table_lookup (reactor->sources, GUINT_TO_POINTER (id));
+  if (source == NULL) {
+    /* Removed after epoll_wait returned */
+    g_mutex_unlock (&reactor->mutex);
+    return;
+  }
+
+  kms_io_source_ref (source);
+  source->dispatching = g_thread_self ();
+  g_mutex_unlock (&reactor->mutex);
+
+  keep = source->func (source->fd, source->user_data);
+
+  g_mutex_lock (&reactor->mutex);
+  source->dispatching = NULL;
+
+  if (source->removed) {
+    g_cond_broadcast (&reactor->cond);
+  } else if (keep) {
+    kms_io_source_arm (source, EPOLL_CTL_MOD);
+  } else {
+    kms_io_reactor_detach_source (reactor, source);
+    detached = TRUE;
+  }
+  g_mutex_unlock (&reactor->mutex);
+
+  if (detached) {
+    /* Reference owned by the sources table */
+    kms_io_source_unref (source);
+  }
+
+  kms_io_source_unref (source);
+}
+
+static gpointer
+kms_io_reactor_thread_func (gpointer data)
+{
+  KmsIoReactorThread *thread = data;
+  KmsIoReactor *reactor = thread->reactor;
+  struct epoll_event events[MAX_EVENTS];
+
+  while (!g_atomic_int_get (&reactor->stopping)) {
+    gint i, n;
+
+    n = epoll_wait (thread->epoll_fd, events, MAX_EVENTS, -1);
+    if (n < 0) {
+      if (errno != EINTR) {
+        GST_ERROR ("epoll_wait failed: %s", g_strerror (errno));
+      }
+      continue;
+    }
+
+    for (i = 0; i < n; i++) {
+      if (events[i].data.u64 == WAKEUP_ID) {
+        guint64 value;
+
+        if (read (thread->wakeup_fd, &value, sizeof (value)) < 0) {
+          GST_TRACE ("Nothing to read from wakeup fd");
+        }
+        continue;
+      }
+
+      kms_io_reactor_dispatch (reactor, (guint) events[i].data.u64);
+    }
+  }
+
+  return NULL;
+}
+
+KmsIoReactor *
+kms_io_reactor_new (guint n_threads)
+{
+  KmsIoReactor *reactor;
+  guint i;
+
+  g_return_val_if_fail (n_threads > 0, NULL);
+
+  reactor = g_slice_new0 (KmsIoReactor);
+  g_mutex_init (&reactor->mutex);
+  g_cond_init (&reactor->cond);
+  reactor->sources = g_hash_table_new (NULL, NULL);
+  reactor->next_id = WAKEUP_ID + 1;
+  reactor->n_threads = n_threads;
+  reactor->threads = g_new0 (KmsIoReactorThread, n_threads);
+
+  for (i = 0; i < n_threads; i++) {
+    KmsIoReactorThread *thread = &reactor->threads[i];
+    struct epoll_event ev = { 0 };
+    gchar *name;
+
+    thread->reactor = reactor;
+    thread->epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+    thread->wakeup_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (thread->epoll_fd < 0 || thread->wakeup_fd < 0) {
+      g_error ("Cannot create I/O reactor: %s", g_strerror (errno));
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.u64 = WAKEUP_ID;
+    epoll_ctl (thread->epoll_fd, EPOLL_CTL_ADD, thread->wakeup_fd, &ev);
+
+    name = g_strdup_printf ("kmsioreactor%u", i);
+    thread->thread = g_thread_new (name, kms_io_reactor_thread_func, thread);
+    g_free (name);
+  }
+
+  GST_DEBUG ("Created I/O reactor with %u threads", n_threads);
+
+  return reactor;
+}
+
+void
+kms_io_reactor_free (KmsIoReactor * reactor)
+{
+  GHashTableIter iter;
+  gpointer value;
+  guint i;
+
+  g_atomic_int_set (&reactor->stopping, TRUE);
+
+  for (i = 0; i < reactor->n_threads; i++) {
+    KmsIoReactorThread *thread = &reactor->threads[i];
+    guint64 one = 1;
+
+    if (write (thread->wakeup_fd, &one, sizeof (one)) < 0) {
+      GST_WARNING ("Cannot wake up reactor thread: %s", g_strerror (errno));
+    }
+
+    g_thread_join (thread->thread);
+    close (thread->epoll_fd);
+    close (thread->wakeup_fd);
+  }
+
+  g_hash_table_iter_init (&iter, reactor->sources);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    GST_WARNING ("Source %u still attached to the reactor",
+        ((KmsIoSource *) value)->id);
+    kms_io_source_unref (value);
+  }
+
+  g_hash_table_unref (reactor->sources);
+  g_free (reactor->threads);
+  g_cond_clear (&reactor->cond);
+  g_mutex_clear (&reactor->mutex);
+  g_slice_free (KmsIoReactor, reactor);
+}
+
+static gpointer
+create_default_reactor (gpointer data)
+{
+  return kms_io_reactor_new (CLAMP (g_get_num_processors (), 1,
+          MAX_DEFAULT_THREADS));
+}
+
+KmsIoReactor *
+kms_io_reactor_get_default (void)
+{
+  static GOnce once = G_ONCE_INIT;
+
+  g_once (&once, create_default_reactor, NULL);
+
+  return once.retval;
+}
+
+guint
+kms_io_reactor_get_n_threads (KmsIoReactor * reactor)
+{
+  return reactor->n_threads;
+}
+
+guint
+kms_io_reactor_add_fd (KmsIoReactor * reactor, gint fd, KmsIoReactorFunc func,
+    gpointer user_data, GDestroyNotify notify)
+{
+  KmsIoReactorThread *thread;
+  KmsIoSource *source;
+  guint i;
+
+  g_return_val_if_fail (fd >= 0 && func != NULL, 0);
+
+  source = g_slice_new0 (KmsIoSource);
+  source->ref = 1;
+  source->fd = fd;
+  source->func = func;
+  source->user_data = user_data;
+  source->notify = notify;
+
+  g_mutex_lock (&reactor->mutex);
+
+  thread = &reactor->threads[0];
+  for (i = 1; i < reactor->n_threads; i++) {
+    if (reactor->threads[i].n_sources < thread->n_sources) {
+      thread = &reactor->threads[i];
+    }
+  }
+
+  do {
+    source->id = reactor->next_id++;
+  } while (source->id == WAKEUP_ID
+      || g_hash_table_contains (reactor->sources,
+          GUINT_TO_POINTER (source->id)));
+
+  source->thread = thread;
+  thread->n_sources++;
+  g_hash_table_insert (reactor->sources, GUINT_TO_POINTER (source->id),
+      source);
+  kms_io_source_arm (source, EPOLL_CTL_ADD);
+
+  g_mutex_unlock (&reactor->mutex);
+
+  GST_DEBUG ("Watching fd %d as source %u", fd, source->id);
+
+  return source->id;
+}
+
+void
+kms_io_reactor_remove (KmsIoReactor * reactor, guint id)
+{
+  KmsIoSource *source;
+
+  g_mutex_lock (&reactor->mutex);
+
+  source = g_hash_table_lookup (reactor->sources, GUINT_TO_POINTER (id));
+  if (source == NULL) {
+    g_mutex_unlock (&reactor->mutex);
+    return;
+  }
+
+  kms_io_reactor_detach_source (reactor, source);
+
+  while (source->dispatching != NULL
+      && source->dispatching != g_thread_self ()) {
+    g_cond_wait (&reactor->cond, &reactor->mutex);
+  }
+
+  g_mutex_unlock (&reactor->mutex);
+
+  GST_DEBUG ("Source %u removed", id);
+
+  kms_io_source_unref (source);
+}
+
+static void init_debug (void) __attribute__ ((constructor));
+
+static void
+init_debug (void)
+{
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+}
@@ -0,0 +1,67 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_IO_REACTOR_H__
+#define __KMS_IO_REACTOR_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _KmsIoReactor KmsIoReactor;
+
+/**
+ * KmsIoReactorFunc:
+ * @fd: the readable descriptor
+ * @user_data: data given when adding the descriptor
+ *
+ * Called from a reactor thread when @fd is readable. It should read a
+ * bounded amount of data and return, so other descriptors served by the
+ * same thread are not starved.
+ *
+ * Returns: %FALSE to stop watching @fd
+ */
+typedef gboolean (*KmsIoReactorFunc) (gint fd, gpointer user_data);
+
+/**
+ * KmsIoReactor:
+ *
+ * Small set of epoll threads that wait for incoming data on the sockets
+ * of all the connections of the process. Each descriptor is assigned to
+ * the least loaded thread and armed in one-shot mode, so its callback is
+ * never run concurrently and every ready descriptor gets one turn per
+ * wakeup.
+ */
+
+KmsIoReactor * kms_io_reactor_new (guint n_threads);
+void kms_io_reactor_free (KmsIoReactor * reactor);
+
+/* Process-wide reactor, never freed */
+KmsIoReactor * kms_io_reactor_get_default (void);
+
+guint kms_io_reactor_get_n_threads (KmsIoReactor * reactor);
+
+guint kms_io_reactor_add_fd (KmsIoReactor * reactor, gint fd,
+    KmsIoReactorFunc func, gpointer user_data, GDestroyNotify notify);
+
+/* When it returns the callback is not running and will not be called again,
+ * unless it is called from the callback itself */
+void kms_io_reactor_remove (KmsIoReactor * reactor, guint id);
+
+G_END_DECLS
+
+#endif /* __KMS_IO_REACTOR_H__ */
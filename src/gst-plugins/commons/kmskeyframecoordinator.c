@@ -0,0 +1,262 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <gst/video/video-event.h>
+
+#include "kmskeyframecoordinator.h"
+
+#define GST_DEFAULT_NAME "keyframecoordinator"
+#define GST_CAT_DEFAULT kms_keyframe_coordinator_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+#define KEYFRAME_COORDINATOR "kms-keyframe-coordinator"
+G_DEFINE_QUARK (KEYFRAME_COORDINATOR, keyframe_coordinator);
+
+#define buffer_is_keyframe(buffer) \
+    (!GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT))
+
+typedef struct _KmsKeyframeCoordinator
+{
+  GMutex mutex;
+
+  GstClockTime window;
+  GstClockTime last_forward;
+
+  /* A request was forwarded and no keyframe has been seen yet */
+  gboolean awaiting;
+
+  /* Requests held until the window expires */
+  gboolean pending;
+  gboolean pending_all_headers;
+
+  /* Seqnum of the request sent by the coordinator itself */
+  guint32 own_seqnum;
+
+  guint64 requests;
+  guint64 forwarded;
+  guint64 coalesced;
+  guint64 served;
+} KmsKeyframeCoordinator;
+
+static void
+kms_keyframe_coordinator_free (KmsKeyframeCoordinator * self)
+{
+  g_mutex_clear (&self->mutex);
+  g_slice_free (KmsKeyframeCoordinator, self);
+}
+
+static gboolean
+kms_keyframe_coordinator_window_expired (KmsKeyframeCoordinator * self,
+    GstClockTime now)
+{
+  return !GST_CLOCK_TIME_IS_VALID (self->last_forward)
+      || now >= self->last_forward + self->window;
+}
+
+static GstPadProbeReturn
+kms_keyframe_coordinator_event_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  KmsKeyframeCoordinator *self = user_data;
+  GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+  GstPadProbeReturn ret = GST_PAD_PROBE_OK;
+  gboolean all_headers = FALSE;
+  GstClockTime now;
+
+  if (!gst_video_event_is_force_key_unit (event)) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  gst_video_event_parse_upstream_force_key_unit (event, NULL, &all_headers,
+      NULL);
+  now = gst_util_get_timestamp ();
+
+  g_mutex_lock (&self->mutex);
+
+  if (gst_event_get_seqnum (event) == self->own_seqnum) {
+    g_mutex_unlock (&self->mutex);
+    return GST_PAD_PROBE_OK;
+  }
+
+  self->requests++;
+
+  if (kms_keyframe_coordinator_window_expired (self, now)) {
+    GST_TRACE_OBJECT (pad, "Forwarding keyframe request");
+    self->last_forward = now;
+    self->awaiting = TRUE;
+    self->pending = FALSE;
+    self->pending_all_headers = FALSE;
+    self->forwarded++;
+  } else {
+    GST_TRACE_OBJECT (pad, "Coalescing keyframe request");
+    self->pending = TRUE;
+    self->pending_all_headers |= all_headers;
+    self->coalesced++;
+    ret = GST_PAD_PROBE_DROP;
+  }
+
+  g_mutex_unlock (&self->mutex);
+
+  return ret;
+}
+
+static gboolean
+find_keyframe (GstBuffer ** buf, guint idx, gpointer user_data)
+{
+  if (buffer_is_keyframe (*buf)) {
+    *(gboolean *) user_data = TRUE;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static GstPadProbeReturn
+kms_keyframe_coordinator_data_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  KmsKeyframeCoordinator *self = user_data;
+  GstEvent *event = NULL;
+  gboolean keyframe = FALSE;
+  GstClockTime now;
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    keyframe = buffer_is_keyframe (GST_PAD_PROBE_INFO_BUFFER (info));
+  } else if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    gst_buffer_list_foreach (GST_PAD_PROBE_INFO_BUFFER_LIST (info),
+        (GstBufferListFunc) find_keyframe, &keyframe);
+  }
+
+  g_mutex_lock (&self->mutex);
+
+  if (keyframe) {
+    /* Serves the forwarded request and every request held after it */
+    if (self->awaiting || self->pending) {
+      GST_TRACE_OBJECT (pad, "Keyframe received");
+      self->served++;
+    }
+
+    self->awaiting = FALSE;
+    self->pending = FALSE;
+    self->pending_all_headers = FALSE;
+  } else if (self->pending) {
+    now = gst_util_get_timestamp ();
+
+    if (kms_keyframe_coordinator_window_expired (self, now)) {
+      event =
+          gst_video_event_new_upstream_force_key_unit (GST_CLOCK_TIME_NONE,
+          self->pending_all_headers, 0);
+      self->own_seqnum = gst_event_get_seqnum (event);
+      self->last_forward = now;
+      self->awaiting = TRUE;
+      self->pending = FALSE;
+      self->pending_all_headers = FALSE;
+      self->forwarded++;
+    }
+  }
+
+  g_mutex_unlock (&self->mutex);
+
+  if (event != NULL) {
+    GST_DEBUG_OBJECT (pad, "Sending held keyframe request");
+
+    if (GST_PAD_DIRECTION (pad) == GST_PAD_SRC) {
+      gst_pad_send_event (pad, event);
+    } else {
+      gst_pad_push_event (pad, event);
+    }
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+void
+kms_keyframe_coordinator_attach (GstPad * pad, GstClockTime window)
+{
+  KmsKeyframeCoordinator *self;
+
+  g_return_if_fail (GST_IS_PAD (pad));
+
+  GST_OBJECT_LOCK (pad);
+
+  self = g_object_get_qdata (G_OBJECT (pad), keyframe_coordinator_quark ());
+  if (self != NULL) {
+    GST_OBJECT_UNLOCK (pad);
+
+    g_mutex_lock (&self->mutex);
+    self->window = window;
+    g_mutex_unlock (&self->mutex);
+
+    return;
+  }
+
+  self = g_slice_new0 (KmsKeyframeCoordinator);
+  g_mutex_init (&self->mutex);
+  self->window = window;
+  self->last_forward = GST_CLOCK_TIME_NONE;
+
+  g_object_set_qdata_full (G_OBJECT (pad), keyframe_coordinator_quark (),
+      self, (GDestroyNotify) kms_keyframe_coordinator_free);
+
+  GST_OBJECT_UNLOCK (pad);
+
+  /* Both probes are removed with the pad, before the qdata is released */
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM,
+      kms_keyframe_coordinator_event_probe, self, NULL);
+  gst_pad_add_probe (pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      kms_keyframe_coordinator_data_probe, self, NULL);
+
+  GST_DEBUG_OBJECT (pad, "Coordinating keyframe requests every %"
+      GST_TIME_FORMAT, GST_TIME_ARGS (window));
+}
+
+GstStructure *
+kms_keyframe_coordinator_get_stats (GstPad * pad)
+{
+  KmsKeyframeCoordinator *self;
+  GstStructure *stats;
+
+  g_return_val_if_fail (GST_IS_PAD (pad), NULL);
+
+  self = g_object_get_qdata (G_OBJECT (pad), keyframe_coordinator_quark ());
+  if (self == NULL) {
+    return NULL;
+  }
+
+  g_mutex_lock (&self->mutex);
+  stats = gst_structure_new (KMS_KEYFRAME_COORDINATOR_STATS_NAME,
+      "requests", G_TYPE_UINT64, self->requests,
+      "forwarded", G_TYPE_UINT64, self->forwarded,
+      "coalesced", G_TYPE_UINT64, self->coalesced,
+      "served", G_TYPE_UINT64, self->served, NULL);
+  g_mutex_unlock (&self->mutex);
+
+  return stats;
+}
+
+static void init_debug (void) __attribute__ ((constructor));
+
+static void
+init_debug (void)
+{
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+}
@@ -0,0 +1,54 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_KEYFRAME_COORDINATOR_H__
+#define __KMS_KEYFRAME_COORDINATOR_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define KMS_KEYFRAME_COORDINATOR_DEFAULT_WINDOW GST_SECOND
+
+#define KMS_KEYFRAME_COORDINATOR_STATS_NAME "keyframe-requests"
+
+/**
+ * kms_keyframe_coordinator_attach:
+ * @pad: the pad every keyframe request of a source goes through
+ * @window: minimum time between two requests sent upstream
+ *
+ * Aggregates the upstream force-key-unit events crossing @pad, so at most
+ * one of them reaches the encoder or the remote sender per @window. The
+ * first request of a window is forwarded right away, later ones are held
+ * and sent when the window expires, unless a keyframe flows through @pad
+ * before. Attaching twice to the same pad only updates @window.
+ */
+void kms_keyframe_coordinator_attach (GstPad * pad, GstClockTime window);
+
+/**
+ * kms_keyframe_coordinator_get_stats:
+ * @pad: a pad with a coordinator attached
+ *
+ * Returns: (transfer full) (nullable): a #GstStructure with the "requests"
+ * received, "forwarded" upstream, "coalesced" with a previous one and
+ * "served" by a keyframe, or %NULL if @pad has no coordinator
+ */
+GstStructure * kms_keyframe_coordinator_get_stats (GstPad * pad);
+
+G_END_DECLS
+
+#endif /* __KMS_KEYFRAME_COORDINATOR_H__ */
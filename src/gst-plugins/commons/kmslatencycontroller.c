@@ -0,0 +1,265 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "kmslatencycontroller.h"
+
+#define UPDATE_INTERVAL GST_SECOND
+/* Do not touch the latency until the estimation is meaningful */
+#define WARMUP_TIME (2 * GST_SECOND)
+/* Time the target must stay below the latency before lowering it */
+#define DECREASE_HOLD_TIME (5 * GST_SECOND)
+/* Retransmissions are accounted while seen within this time */
+#define RTX_ACTIVE_TIME (10 * GST_SECOND)
+
+#define JITTER_FACTOR 4
+#define PEAK_DECAY_PER_SECOND (20 * GST_MSECOND)
+#define LATENCY_MARGIN (10 * GST_MSECOND)
+#define LATENCY_HYSTERESIS 10   /* ms */
+
+#define RTX_FACTOR_MIN 1.0
+#define RTX_FACTOR_MAX 3.0
+#define RTX_FACTOR_UP 0.5
+#define RTX_FACTOR_DOWN 0.25
+#define RTX_SUCCESS_LOW 0.8
+#define RTX_SUCCESS_HIGH 0.95
+
+struct _KmsLatencyController
+{
+  guint min_latency;
+  guint max_latency;
+  guint latency;
+  guint target;
+
+  /* Inter-arrival jitter */
+  gboolean have_last;
+  GstClockTime last_arrival;
+  guint32 last_rtp_ts;
+  GstClockTime jitter;
+  GstClockTime peak;
+  GstClockTime first_arrival;
+
+  /* Retransmissions */
+  guint64 rtx_count;
+  guint64 rtx_success_count;
+  GstClockTime rtx_rtt;
+  gdouble rtx_factor;
+  GstClockTime last_rtx;
+
+  GstClockTime last_update;
+  GstClockTime decrease_since;
+};
+
+void
+kms_latency_controller_process_packet (KmsLatencyController * ctl,
+    GstClockTime arrival_time, guint32 rtp_ts, guint clock_rate)
+{
+  GstClockTimeDiff transit_diff, arrival_diff, ts_diff;
+  GstClockTime d, decay;
+
+  if (!GST_CLOCK_TIME_IS_VALID (arrival_time) || clock_rate == 0) {
+    return;
+  }
+
+  if (!ctl->have_last) {
+    ctl->have_last = TRUE;
+    ctl->first_arrival = arrival_time;
+    goto done;
+  }
+
+  /* Reordered packets are accounted too, as RFC 3550 does */
+  arrival_diff = GST_CLOCK_DIFF (ctl->last_arrival, arrival_time);
+  ts_diff = (gint64) ((gint32) (rtp_ts - ctl->last_rtp_ts)) * GST_SECOND /
+      clock_rate;
+  transit_diff = arrival_diff - ts_diff;
+  d = ABS (transit_diff);
+
+  /* RFC 3550 A.8 */
+  if (d > ctl->jitter) {
+    ctl->jitter += (d - ctl->jitter) / 16;
+  } else {
+    ctl->jitter -= (ctl->jitter - d) / 16;
+  }
+
+  if (arrival_time > ctl->last_arrival) {
+    decay = gst_util_uint64_scale (arrival_time - ctl->last_arrival,
+        PEAK_DECAY_PER_SECOND, GST_SECOND);
+    ctl->peak = ctl->peak > decay ? ctl->peak - decay : 0;
+  }
+  ctl->peak = MAX (ctl->peak, d);
+
+done:
+  ctl->last_arrival = arrival_time;
+  ctl->last_rtp_ts = rtp_ts;
+}
+
+void
+kms_latency_controller_process_rtx_stats (KmsLatencyController * ctl,
+    guint64 rtx_count, guint64 rtx_success_count, GstClockTime rtx_rtt)
+{
+  guint64 requested, recovered;
+  gdouble ratio;
+
+  if (rtx_count < ctl->rtx_count
+      || rtx_success_count < ctl->rtx_success_count) {
+    /* Counters restarted */
+    ctl->rtx_count = rtx_count;
+    ctl->rtx_success_count = rtx_success_count;
+    return;
+  }
+
+  requested = rtx_count - ctl->rtx_count;
+  recovered = rtx_success_count - ctl->rtx_success_count;
+  ctl->rtx_count = rtx_count;
+  ctl->rtx_success_count = rtx_success_count;
+
+  if (GST_CLOCK_TIME_IS_VALID (rtx_rtt) && rtx_rtt > 0) {
+    ctl->rtx_rtt = rtx_rtt;
+  }
+
+  if (requested == 0) {
+    return;
+  }
+
+  ctl->last_rtx = ctl->last_arrival;
+  ratio = (gdouble) MIN (recovered, requested) / requested;
+
+  /* Retransmissions arriving too late need more buffering */
+  if (ratio < RTX_SUCCESS_LOW) {
+    ctl->rtx_factor = MIN (ctl->rtx_factor + RTX_FACTOR_UP, RTX_FACTOR_MAX);
+  } else if (ratio > RTX_SUCCESS_HIGH) {
+    ctl->rtx_factor = MAX (ctl->rtx_factor - RTX_FACTOR_DOWN, RTX_FACTOR_MIN);
+  }
+}
+
+static guint
+kms_latency_controller_compute_target (KmsLatencyController * ctl)
+{
+  GstClockTime target;
+
+  target = MAX (ctl->jitter * JITTER_FACTOR, ctl->peak) + LATENCY_MARGIN;
+
+  if (GST_CLOCK_TIME_IS_VALID (ctl->last_rtx)
+      && GST_CLOCK_DIFF (ctl->last_rtx, ctl->last_arrival) <
+      (GstClockTimeDiff) RTX_ACTIVE_TIME) {
+    target += ctl->rtx_rtt * ctl->rtx_factor;
+  }
+
+  return CLAMP (GST_TIME_AS_MSECONDS (target), ctl->min_latency,
+      ctl->max_latency);
+}
+
+gboolean
+kms_latency_controller_needs_update (KmsLatencyController * ctl,
+    GstClockTime now)
+{
+  if (!ctl->have_last || now < ctl->first_arrival + WARMUP_TIME) {
+    return FALSE;
+  }
+
+  return !GST_CLOCK_TIME_IS_VALID (ctl->last_update)
+      || now - ctl->last_update >= UPDATE_INTERVAL;
+}
+
+gboolean
+kms_latency_controller_update (KmsLatencyController * ctl, GstClockTime now,
+    guint * latency)
+{
+  guint new_latency;
+
+  if (!kms_latency_controller_needs_update (ctl, now)) {
+    return FALSE;
+  }
+
+  ctl->last_update = now;
+  ctl->target = kms_latency_controller_compute_target (ctl);
+
+  if (ctl->target > ctl->latency) {
+    ctl->decrease_since = GST_CLOCK_TIME_NONE;
+
+    if (ctl->target < ctl->latency + LATENCY_HYSTERESIS) {
+      return FALSE;
+    }
+
+    /* Grow at once, late packets are already being dropped */
+    new_latency = ctl->target;
+  } else {
+    if (ctl->target + LATENCY_HYSTERESIS > ctl->latency) {
+      ctl->decrease_since = GST_CLOCK_TIME_NONE;
+      return FALSE;
+    }
+
+    if (!GST_CLOCK_TIME_IS_VALID (ctl->decrease_since)) {
+      ctl->decrease_since = now;
+      return FALSE;
+    }
+
+    if (now - ctl->decrease_since < DECREASE_HOLD_TIME) {
+      return FALSE;
+    }
+
+    /* Shrink half of the way, so a wrong estimation does not hurt much */
+    new_latency = ctl->target + (ctl->latency - ctl->target) / 2;
+  }
+
+  ctl->latency = new_latency;
+  *latency = new_latency;
+
+  return TRUE;
+}
+
+guint
+kms_latency_controller_get_latency (KmsLatencyController * ctl)
+{
+  return ctl->latency;
+}
+
+guint
+kms_latency_controller_get_target (KmsLatencyController * ctl)
+{
+  return ctl->target;
+}
+
+guint
+kms_latency_controller_get_jitter (KmsLatencyController * ctl)
+{
+  return GST_TIME_AS_MSECONDS (ctl->jitter);
+}
+
+KmsLatencyController *
+kms_latency_controller_new (guint min_latency, guint max_latency,
+    guint initial_latency)
+{
+  KmsLatencyController *ctl = g_slice_new0 (KmsLatencyController);
+
+  ctl->min_latency = min_latency;
+  ctl->max_latency = MAX (min_latency, max_latency);
+  ctl->latency = CLAMP (initial_latency, ctl->min_latency, ctl->max_latency);
+  ctl->target = ctl->latency;
+
+  ctl->rtx_factor = RTX_FACTOR_MIN;
+  ctl->last_rtx = GST_CLOCK_TIME_NONE;
+  ctl->last_update = GST_CLOCK_TIME_NONE;
+  ctl->decrease_since = GST_CLOCK_TIME_NONE;
+
+  return ctl;
+}
+
+void
+kms_latency_controller_free (KmsLatencyController * ctl)
+{
+  g_slice_free (KmsLatencyController, ctl);
+}
@@ -0,0 +1,60 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_LATENCY_CONTROLLER_H__
+#define __KMS_LATENCY_CONTROLLER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _KmsLatencyController KmsLatencyController;
+
+/**
+ * KmsLatencyController:
+ *
+ * Computes the jitter buffer latency needed by one RTP source. It tracks
+ * the RFC 3550 inter-arrival jitter plus a slowly decaying peak of the
+ * transit delay variation and, when NACK is in use, leaves room for
+ * retransmissions based on their round trip time and success ratio.
+ *
+ * Latencies are in milliseconds. Time is always given by the caller, and
+ * it is not thread safe.
+ */
+
+KmsLatencyController * kms_latency_controller_new (guint min_latency,
+    guint max_latency, guint initial_latency);
+void kms_latency_controller_free (KmsLatencyController * ctl);
+
+void kms_latency_controller_process_packet (KmsLatencyController * ctl,
+    GstClockTime arrival_time, guint32 rtp_ts, guint clock_rate);
+void kms_latency_controller_process_rtx_stats (KmsLatencyController * ctl,
+    guint64 rtx_count, guint64 rtx_success_count, GstClockTime rtx_rtt);
+
+/* Returns TRUE and the new latency when the jitter buffer must be retuned */
+gboolean kms_latency_controller_update (KmsLatencyController * ctl,
+    GstClockTime now, guint * latency);
+gboolean kms_latency_controller_needs_update (KmsLatencyController * ctl,
+    GstClockTime now);
+
+guint kms_latency_controller_get_latency (KmsLatencyController * ctl);
+guint kms_latency_controller_get_target (KmsLatencyController * ctl);
+guint kms_latency_controller_get_jitter (KmsLatencyController * ctl);
+
+G_END_DECLS
+
+#endif /* __KMS_LATENCY_CONTROLLER_H__ */
@@ -20,26 +20,41 @@
 #include "kmslist.h"
 #include "kmsrefstruct.h"
 
-typedef struct _KmsListForeachData
+/* Shorter lists are scanned, hashing does not pay off for them */
+#define INDEX_THRESHOLD 8
+
+typedef struct _KmsListNode KmsListNode;
+
+struct _KmsListNode
 {
-  GHFunc func;
-  gpointer user_data;
-} KmsListForeachData;
+  gpointer key;
+  gpointer value;
+
+  /* Insertion order */
+  KmsListNode *prev;
+  KmsListNode *next;
+
+  /* Next node with an equal key, in insertion order. Only kept while the
+   * list is indexed */
+  KmsListNode *same_key;
+};
 
 struct _KmsList
 {
   KmsRefStruct ref;
+  GHashFunc key_hash_func;
   GEqualFunc key_equal_func;
   GDestroyNotify key_destroy_func;
   GDestroyNotify value_destroy_func;
-  GSList *l;
-};
 
-typedef struct _KmsListNode
-{
-  gpointer key;
-  gpointer value;
-} KmsListNode;
+  KmsListNode *head;
+  KmsListNode *tail;
+  guint length;
+
+  /* key -> first node with that key. Built once the list grows past
+   * INDEX_THRESHOLD, never when keys cannot be hashed */
+  GHashTable *index;
+};
 
 static void
 kms_list_node_destroy (KmsListNode * n)
@@ -76,25 +91,44 @@ kms_list_node_free_data (KmsList * list, KmsListNode * node)
 static void
 kms_list_destroy (KmsList * list)
 {
-  GSList *tmp, *l = list->l;
+  KmsListNode *node = list->head;
 
-  while (l != NULL) {
-    KmsListNode *node;
+  if (list->index != NULL) {
+    g_hash_table_unref (list->index);
+  }
 
-    node = l->data;
-    tmp = l;
-    l = g_slist_next (l);
+  while (node != NULL) {
+    KmsListNode *next = node->next;
 
     kms_list_node_free_data (list, node);
-    g_slist_free_1 (tmp);
+    node = next;
   }
 
   g_slice_free (KmsList, list);
 }
 
+static GHashFunc
+kms_list_get_hash_func (GEqualFunc key_equal_func)
+{
+  if (key_equal_func == g_str_equal) {
+    return g_str_hash;
+  } else if (key_equal_func == g_direct_equal) {
+    return g_direct_hash;
+  } else if (key_equal_func == g_int_equal) {
+    return g_int_hash;
+  } else if (key_equal_func == g_int64_equal) {
+    return g_int64_hash;
+  } else if (key_equal_func == g_double_equal) {
+    return g_double_hash;
+  }
+
+  /* Unknown equality, lookups scan the list */
+  return NULL;
+}
+
 KmsList *
-kms_list_new_full (GEqualFunc key_equal_func, GDestroyNotify key_destroy_func,
-    GDestroyNotify value_destroy_func)
+kms_list_new_hash_full (GHashFunc key_hash_func, GEqualFunc key_equal_func,
+    GDestroyNotify key_destroy_func, GDestroyNotify value_destroy_func)
 {
   KmsList *list;
 
@@ -102,6 +136,7 @@ kms_list_new_full (GEqualFunc key_equal_func, GDestroyNotify key_destroy_func,
   kms_ref_struct_init (KMS_REF_STRUCT_CAST (list),
       (GDestroyNotify) kms_list_destroy);
 
+  list->key_hash_func = key_hash_func;
   list->key_equal_func = key_equal_func;
   list->key_destroy_func = key_destroy_func;
   list->value_destroy_func = value_destroy_func;
@@ -109,19 +144,71 @@ kms_list_new_full (GEqualFunc key_equal_func, GDestroyNotify key_destroy_func,
   return list;
 }
 
+static void
+kms_list_build_index (KmsList * list)
+{
+  KmsListNode *n;
+
+  if (list->index != NULL || list->key_hash_func == NULL ||
+      list->key_equal_func == NULL || list->length <= INDEX_THRESHOLD) {
+    return;
+  }
+
+  list->index = g_hash_table_new (list->key_hash_func, list->key_equal_func);
+
+  /* Backwards, so each node ends up first for its key and links the
+   * following ones */
+  for (n = list->tail; n != NULL; n = n->prev) {
+    n->same_key = g_hash_table_lookup (list->index, n->key);
+    g_hash_table_replace (list->index, n->key, n);
+  }
+}
+
+KmsList *
+kms_list_new_full (GEqualFunc key_equal_func, GDestroyNotify key_destroy_func,
+    GDestroyNotify value_destroy_func)
+{
+  return kms_list_new_hash_full (kms_list_get_hash_func (key_equal_func),
+      key_equal_func, key_destroy_func, value_destroy_func);
+}
+
 guint
 kms_list_length (KmsList * list)
 {
-  return g_slist_length (list->l);
+  return list->length;
 }
 
 void
 kms_list_append (KmsList * list, gpointer key, gpointer value)
 {
-  KmsListNode *n;
+  KmsListNode *n, *first;
 
   n = kms_list_node_new (key, value);
-  list->l = g_slist_append (list->l, n);
+
+  n->prev = list->tail;
+  if (list->tail != NULL) {
+    list->tail->next = n;
+  } else {
+    list->head = n;
+  }
+  list->tail = n;
+  list->length++;
+
+  if (list->index == NULL) {
+    kms_list_build_index (list);
+    return;
+  }
+
+  first = g_hash_table_lookup (list->index, key);
+  if (first == NULL) {
+    g_hash_table_insert (list->index, key, n);
+  } else {
+    /* Duplicated key, it goes after the others */
+    while (first->same_key != NULL) {
+      first = first->same_key;
+    }
+    first->same_key = n;
+  }
 }
 
 void
@@ -130,103 +217,119 @@ kms_list_prepend (KmsList * list, gpointer key, gpointer value)
   KmsListNode *n;
 
   n = kms_list_node_new (key, value);
-  list->l = g_slist_prepend (list->l, n);
+
+  n->next = list->head;
+  if (list->head != NULL) {
+    list->head->prev = n;
+  } else {
+    list->tail = n;
+  }
+  list->head = n;
+  list->length++;
+
+  if (list->index == NULL) {
+    kms_list_build_index (list);
+    return;
+  }
+
+  /* Now it is the first node with this key */
+  n->same_key = g_hash_table_lookup (list->index, key);
+  g_hash_table_replace (list->index, key, n);
 }
 
-void
-kms_list_remove (KmsList * list, gpointer key)
+static KmsListNode *
+kms_list_get_node (KmsList * list, gpointer key)
 {
-  GSList *prev = NULL, *tmp = list->l;
+  KmsListNode *n;
 
   if (list->key_equal_func == NULL) {
-    return;
+    return NULL;
   }
 
-  while (tmp != NULL) {
-    KmsListNode *node;
+  if (list->index != NULL) {
+    return g_hash_table_lookup (list->index, key);
+  }
 
-    node = tmp->data;
-    if (list->key_equal_func (node->key, key)) {
-      if (prev) {
-        prev->next = tmp->next;
-      } else {
-        list->l = tmp->next;
-      }
+  for (n = list->head; n != NULL; n = n->next) {
+    if (list->key_equal_func (n->key, key)) {
+      return n;
+    }
+  }
+
+  return NULL;
+}
 
-      kms_list_node_free_data (list, node);
-      g_slist_free_1 (tmp);
-      break;
+void
+kms_list_remove (KmsList * list, gpointer key)
+{
+  KmsListNode *n;
+
+  n = kms_list_get_node (list, key);
+  if (n == NULL) {
+    return;
+  }
+
+  if (list->index != NULL) {
+    if (n->same_key != NULL) {
+      /* The stored key is released with its node, use the one left */
+      g_hash_table_replace (list->index, n->same_key->key, n->same_key);
+    } else {
+      g_hash_table_remove (list->index, key);
     }
+  }
 
-    prev = tmp;
-    tmp = prev->next;
+  if (n->prev != NULL) {
+    n->prev->next = n->next;
+  } else {
+    list->head = n->next;
   }
+
+  if (n->next != NULL) {
+    n->next->prev = n->prev;
+  } else {
+    list->tail = n->prev;
+  }
+
+  list->length--;
+
+  kms_list_node_free_data (list, n);
 }
 
 void
 kms_list_iter_init (KmsListIter * iter, KmsList * list)
 {
-  iter->item = list->l;
+  iter->item = list->head;
 }
 
 gboolean
 kms_list_iter_next (KmsListIter * iter, gpointer * key, gpointer * value)
 {
-  KmsListNode *n;
+  KmsListNode *n = iter->item;
 
-  if (iter->item == NULL) {
+  if (n == NULL) {
     return FALSE;
   }
 
-  n = (KmsListNode *) iter->item->data;
   *key = n->key;
   *value = n->value;
 
-  iter->item = g_slist_next (iter->item);
+  iter->item = n->next;
 
   return TRUE;
 }
 
-static void
-foreach_cb (gpointer node, gpointer user_data)
-{
-  KmsListForeachData *data = (KmsListForeachData *) user_data;
-  KmsListNode *n = (KmsListNode *) node;
-
-  if (data->func != NULL) {
-    data->func (n->key, n->value, data->user_data);
-  }
-}
-
 void
 kms_list_foreach (KmsList * list, GHFunc func, gpointer user_data)
 {
-  KmsListForeachData tmp;
-
-  tmp.func = func;
-  tmp.user_data = user_data;
-
-  g_slist_foreach (list->l, foreach_cb, &tmp);
-}
-
-static KmsListNode *
-kms_list_get_node (KmsList * list, gpointer key)
-{
-  GSList *l = list->l;
+  KmsListNode *n;
 
-  if (list->key_equal_func == NULL) {
-    return NULL;
+  if (func == NULL) {
+    return;
   }
 
-  for (l = list->l; l != NULL; l = g_slist_next (l)) {
-    KmsListNode *n = l->data;
-
-    if (list->key_equal_func (n->key, key)) {
-      return n;
-    }
+  for (n = list->head; n != NULL; n = n->next) {
+    func (n->key, n->value, user_data);
   }
-
-  return NULL;
 }
 
 gboolean
@@ -28,10 +28,17 @@ typedef struct _KmsList KmsList;
 #define kms_list_new(key_equal_func) \
   kms_list_new_full (key_equal_func, NULL, NULL);
 
+/* Lookups in long lists are indexed when key_equal_func is one of the GLib
+ * equal functions, they scan the list otherwise */
 KmsList * kms_list_new_full (GEqualFunc key_equal_func,
                       GDestroyNotify key_destroy_func,
                       GDestroyNotify value_destroy_func);
 
+KmsList * kms_list_new_hash_full (GHashFunc key_hash_func,
+                      GEqualFunc key_equal_func,
+                      GDestroyNotify key_destroy_func,
+                      GDestroyNotify value_destroy_func);
+
 guint kms_list_length (KmsList *list);
 
 void kms_list_append (KmsList *list, gpointer key, gpointer value);
@@ -53,7 +60,7 @@ void kms_list_unref (KmsList *list);
 struct _KmsListIter
 {
   /*< private >*/
-  GSList *item;
+  gpointer item;
 };
 
 G_END_DECLS
@@ -31,6 +31,15 @@ G_DEFINE_TYPE_WITH_CODE (KmsLoop, kms_loop,
     GST_DEBUG_CATEGORY_INIT (kms_loop_debug_category, NAME,
         0, "debug category for kurento loop"));
 
+/*
+ * Setting this variable to a positive number makes kms_loop_new return
+ * pooled loops sharing that number of threads
+ */
+#define KMS_LOOP_POOL_SIZE_ENV_VAR "KURENTO_LOOP_POOL_SIZE"
+
+/* Destroyed sources are pruned from a loop when this many are tracked */
+#define PRUNE_SOURCES_THRESHOLD 64
+
 #define KMS_LOOP_GET_PRIVATE(obj) ( \
   G_TYPE_INSTANCE_GET_PRIVATE (     \
     (obj),                          \
@@ -39,6 +48,22 @@ G_DEFINE_TYPE_WITH_CODE (KmsLoop, kms_loop,
   )                                 \
 )
 
+typedef struct _KmsLoopWorker
+{
+  GThread *thread;
+  GMainContext *context;
+  GMainLoop *loop;
+  guint n_loops;
+} KmsLoopWorker;
+
+typedef struct _KmsLoopPool
+{
+  GMutex mutex;
+  KmsLoopWorker *workers;
+  guint n_workers;
+  guint n_started;
+} KmsLoopPool;
+
 struct _KmsLoopPrivate
 {
   GThread *thread;
@@ -48,6 +73,13 @@ struct _KmsLoopPrivate
   GCond cond;
   GMutex mutex;
   gboolean initialized;
+
+  /* Pooled loops only */
+  gboolean pooled;
+  KmsLoopWorker *worker;
+  GHashTable *sources;
+  guint prune_threshold;
+  gboolean waiting_worker;
 };
 
 #define KMS_LOOP_LOCK(elem) \
@@ -60,11 +92,217 @@ enum
 {
   PROP_0,
   PROP_CONTEXT,
+  PROP_POOLED,
   N_PROPERTIES
 };
 
 static GParamSpec *obj_properties[N_PROPERTIES] = { NULL, };
 
+static guint
+kms_loop_get_env_pool_size (void)
+{
+  static gsize init = 0;
+  static guint size = 0;
+
+  if (g_once_init_enter (&init)) {
+    const gchar *value = g_getenv (KMS_LOOP_POOL_SIZE_ENV_VAR);
+
+    if (value != NULL) {
+      size = (guint) g_ascii_strtoull (value, NULL, 10);
+    }
+
+    g_once_init_leave (&init, 1);
+  }
+
+  return size;
+}
+
+static gpointer
+pool_worker_thread (gpointer data)
+{
+  KmsLoopWorker *worker = data;
+
+  g_main_context_push_thread_default (worker->context);
+  GST_DEBUG ("Running pooled main loop");
+  g_main_loop_run (worker->loop);
+  g_main_context_pop_thread_default (worker->context);
+
+  return NULL;
+}
+
+static gpointer
+kms_loop_pool_init (gpointer data)
+{
+  KmsLoopPool *pool = g_slice_new0 (KmsLoopPool);
+
+  g_mutex_init (&pool->mutex);
+  pool->n_workers = kms_loop_get_env_pool_size ();
+
+  if (pool->n_workers == 0) {
+    pool->n_workers = g_get_num_processors ();
+  }
+
+  GST_INFO ("Pool of up to %u loop threads, started on demand",
+      pool->n_workers);
+
+  pool->workers = g_new0 (KmsLoopWorker, pool->n_workers);
+
+  return pool;
+}
+
+static KmsLoopPool *
+kms_loop_get_pool (void)
+{
+  static GOnce once = G_ONCE_INIT;
+
+  return g_once (&once, kms_loop_pool_init, NULL);
+}
+
+/* Must be called with the pool mutex held */
+static KmsLoopWorker *
+kms_loop_pool_start_worker (KmsLoopPool * pool)
+{
+  KmsLoopWorker *worker = &pool->workers[pool->n_started++];
+
+  GST_DEBUG ("Starting loop thread %u of %u", pool->n_started,
+      pool->n_workers);
+
+  /* Workers live as long as the process */
+  worker->context = g_main_context_new ();
+  worker->loop = g_main_loop_new (worker->context, FALSE);
+  worker->thread = g_thread_new ("KmsLoopPool", pool_worker_thread, worker);
+
+  return worker;
+}
+
+static KmsLoopWorker *
+kms_loop_pool_acquire_worker (void)
+{
+  KmsLoopPool *pool = kms_loop_get_pool ();
+  KmsLoopWorker *worker = NULL;
+  guint i;
+
+  g_mutex_lock (&pool->mutex);
+
+  for (i = 0; i < pool->n_started; i++) {
+    if (worker == NULL || pool->workers[i].n_loops < worker->n_loops) {
+      worker = &pool->workers[i];
+    }
+  }
+
+  /* A new thread is only started when every running one is busy */
+  if ((worker == NULL || worker->n_loops > 0)
+      && pool->n_started < pool->n_workers) {
+    worker = kms_loop_pool_start_worker (pool);
+  }
+
+  worker->n_loops++;
+
+  g_mutex_unlock (&pool->mutex);
+
+  return worker;
+}
+
+static void
+kms_loop_pool_release_worker (KmsLoopWorker * worker)
+{
+  KmsLoopPool *pool = kms_loop_get_pool ();
+
+  g_mutex_lock (&pool->mutex);
+  worker->n_loops--;
+  g_mutex_unlock (&pool->mutex);
+}
+
+static gboolean
+signal_barrier (KmsLoop * self)
+{
+  g_mutex_lock (&self->priv->mutex);
+  self->priv->waiting_worker = FALSE;
+  g_cond_signal (&self->priv->cond);
+  g_mutex_unlock (&self->priv->mutex);
+
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * Waits until the worker finishes what it is dispatching, so no callback
+ * of this loop is running once its sources have been destroyed.
+ */
+static void
+kms_loop_pooled_wait_worker (KmsLoop * self)
+{
+  GSource *source;
+
+  g_mutex_lock (&self->priv->mutex);
+  self->priv->waiting_worker = TRUE;
+  g_mutex_unlock (&self->priv->mutex);
+
+  source = g_idle_source_new ();
+  g_source_set_priority (source, G_PRIORITY_HIGH);
+  g_source_set_callback (source, (GSourceFunc) signal_barrier, self, NULL);
+  g_source_attach (source, self->priv->worker->context);
+  g_source_unref (source);
+
+  g_mutex_lock (&self->priv->mutex);
+  while (self->priv->waiting_worker) {
+    g_cond_wait (&self->priv->cond, &self->priv->mutex);
+  }
+  g_mutex_unlock (&self->priv->mutex);
+}
+
+static void
+kms_loop_pooled_dispose (KmsLoop * self)
+{
+  GHashTableIter iter;
+  GHashTable *sources;
+  GSource *source;
+
+  KMS_LOOP_LOCK (self);
+
+  if (self->priv->thread == NULL) {
+    KMS_LOOP_UNLOCK (self);
+    return;
+  }
+
+  /* No more sources can be attached from now on */
+  self->priv->thread = NULL;
+  sources = self->priv->sources;
+  self->priv->sources = NULL;
+
+  KMS_LOOP_UNLOCK (self);
+
+  g_hash_table_iter_init (&iter, sources);
+  while (g_hash_table_iter_next (&iter, (gpointer *) & source, NULL)) {
+    g_source_destroy (source);
+  }
+  g_hash_table_unref (sources);
+
+  if (g_thread_self () != self->priv->worker->thread) {
+    kms_loop_pooled_wait_worker (self);
+  }
+
+  kms_loop_pool_release_worker (self->priv->worker);
+}
+
+static gboolean
+prune_destroyed_source (gpointer key, gpointer value, gpointer user_data)
+{
+  return g_source_is_destroyed (key);
+}
+
+static void
+kms_loop_pooled_track_source (KmsLoop * self, GSource * source)
+{
+  if (g_hash_table_size (self->priv->sources) >= self->priv->prune_threshold) {
+    g_hash_table_foreach_remove (self->priv->sources, prune_destroyed_source,
+        NULL);
+    self->priv->prune_threshold = MAX (PRUNE_SOURCES_THRESHOLD,
+        2 * g_hash_table_size (self->priv->sources));
+  }
+
+  g_hash_table_add (self->priv->sources, g_source_ref (source));
+}
+
 static gboolean
 quit_main_loop (KmsLoop * self)
 {
@@ -124,6 +362,9 @@ kms_loop_get_property (GObject * object, guint property_id, GValue * value,
     case PROP_CONTEXT:
       g_value_set_boxed (value, self->priv->context);
       break;
+    case PROP_POOLED:
+      g_value_set_boolean (value, self->priv->pooled);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -132,6 +373,55 @@ kms_loop_get_property (GObject * object, guint property_id, GValue * value,
   KMS_LOOP_UNLOCK (self);
 }
 
+static void
+kms_loop_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  KmsLoop *self = KMS_LOOP (object);
+
+  KMS_LOOP_LOCK (self);
+
+  switch (property_id) {
+    case PROP_POOLED:
+      self->priv->pooled = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+
+  KMS_LOOP_UNLOCK (self);
+}
+
+static void
+kms_loop_constructed (GObject * obj)
+{
+  KmsLoop *self = KMS_LOOP (obj);
+
+  G_OBJECT_CLASS (kms_loop_parent_class)->constructed (obj);
+
+  if (self->priv->pooled) {
+    self->priv->worker = kms_loop_pool_acquire_worker ();
+    self->priv->context = g_main_context_ref (self->priv->worker->context);
+    self->priv->sources = g_hash_table_new_full (NULL, NULL,
+        (GDestroyNotify) g_source_unref, NULL);
+    self->priv->prune_threshold = PRUNE_SOURCES_THRESHOLD;
+    self->priv->thread = self->priv->worker->thread;
+
+    return;
+  }
+
+  self->priv->thread = g_thread_new ("KmsLoop", loop_thread_init, self);
+
+  g_mutex_lock (&self->priv->mutex);
+
+  while (!self->priv->initialized) {
+    g_cond_wait (&self->priv->cond, &self->priv->mutex);
+  }
+
+  g_mutex_unlock (&self->priv->mutex);
+}
+
 static void
 kms_loop_dispose (GObject * obj)
 {
@@ -139,6 +429,12 @@ kms_loop_dispose (GObject * obj)
 
   GST_DEBUG_OBJECT (obj, "Dispose");
 
+  if (self->priv->pooled) {
+    kms_loop_pooled_dispose (self);
+    G_OBJECT_CLASS (kms_loop_parent_class)->dispose (obj);
+    return;
+  }
+
   KMS_LOOP_LOCK (self);
 
   if (self->priv->thread != NULL) {
@@ -193,6 +489,8 @@ kms_loop_class_init (KmsLoopClass * klass)
   objclass->dispose = kms_loop_dispose;
   objclass->finalize = kms_loop_finalize;
   objclass->get_property = kms_loop_get_property;
+  objclass->set_property = kms_loop_set_property;
+  objclass->constructed = kms_loop_constructed;
 
   /* Install properties */
   obj_properties[PROP_CONTEXT] = g_param_spec_boxed ("context",
@@ -200,6 +498,12 @@ kms_loop_class_init (KmsLoopClass * klass)
       "Main loop context",
       G_TYPE_MAIN_CONTEXT, (GParamFlags) (G_PARAM_READABLE));
 
+  obj_properties[PROP_POOLED] = g_param_spec_boolean ("pooled",
+      "Pooled",
+      "Share one of a fixed set of threads with other loops instead of "
+      "running a dedicated one",
+      FALSE, (GParamFlags) (G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
+
   g_object_class_install_properties (objclass, N_PROPERTIES, obj_properties);
 
   /* Registers a private structure for the instantiatable type */
@@ -215,24 +519,25 @@ kms_loop_init (KmsLoop * self)
   g_rec_mutex_init (&self->priv->rmutex);
   g_cond_init (&self->priv->cond);
   g_mutex_init (&self->priv->mutex);
+}
 
-  self->priv->thread = g_thread_new ("KmsLoop", loop_thread_init, self);
-
-  g_mutex_lock (&self->priv->mutex);
+KmsLoop *
+kms_loop_new (void)
+{
+  GObject *loop;
 
-  while (!self->priv->initialized) {
-    g_cond_wait (&self->priv->cond, &self->priv->mutex);
-  }
+  loop = g_object_new (KMS_TYPE_LOOP, "pooled",
+      kms_loop_get_env_pool_size () > 0, NULL);
 
-  g_mutex_unlock (&self->priv->mutex);
+  return KMS_LOOP (loop);
 }
 
 KmsLoop *
-kms_loop_new (void)
+kms_loop_new_pooled (void)
 {
   GObject *loop;
 
-  loop = g_object_new (KMS_TYPE_LOOP, NULL);
+  loop = g_object_new (KMS_TYPE_LOOP, "pooled", TRUE, NULL);
 
   return KMS_LOOP (loop);
 }
@@ -254,6 +559,10 @@ kms_loop_attach (KmsLoop * self, GSource * source, gint priority,
   g_source_set_callback (source, function, data, notify);
   id = g_source_attach (source, self->priv->context);
 
+  if (self->priv->pooled) {
+    kms_loop_pooled_track_source (self, source);
+  }
+
   KMS_LOOP_UNLOCK (self);
 
   return id;
@@ -69,6 +69,16 @@ GType kms_loop_get_type (void);
 
 KmsLoop * kms_loop_new (void);
 
+/*
+ * Pooled loops do not own a thread, they share one of a fixed set of
+ * threads (one per CPU, or KURENTO_LOOP_POOL_SIZE) with other pooled
+ * loops. Those threads are started as pooled loops are created. Sources
+ * added to the same loop keep running in order on the same thread.
+ * kms_loop_new also returns pooled loops when KURENTO_LOOP_POOL_SIZE
+ * is set.
+ */
+KmsLoop * kms_loop_new_pooled (void);
+
 guint kms_loop_idle_add (KmsLoop *self, GSourceFunc function,
   gpointer data);
 
@@ -86,6 +96,7 @@ gboolean kms_loop_remove (KmsLoop *self, guint source_id);
 #define KMS_LOOP_IS_CURRENT_THREAD(loop) \
   kms_loop_is_current_thread(loop)
 
+/* For pooled loops this is also TRUE for loops sharing the same thread */
 gboolean kms_loop_is_current_thread (KmsLoop *self);
 
 G_END_DECLS
@@ -21,6 +21,7 @@
 
 #include "kmsparsetreebin.h"
 #include "kmsutils.h"
+#include "kmsbitratecalc.h"
 
 #define GST_DEFAULT_NAME "parsetreebin"
 #define GST_CAT_DEFAULT kms_parse_tree_bin_debug
@@ -38,15 +39,14 @@ G_DEFINE_TYPE (KmsParseTreeBin, kms_parse_tree_bin, KMS_TYPE_TREE_BIN);
 )
 
 #define BITRATE_THRESHOLD 0.07
+#define BITRATE_CALC_INTERVAL GST_SECOND
 
 struct _KmsParseTreeBinPrivate
 {
   GstElement *parser;
 
   /* Bitrate calculation */
-  GstClockTime last_buffer_pts;
-  GstClockTime last_buffer_dts;
-  guint bitrate_mean;
+  KmsBitrateCalc bitrate_calc;
   guint last_pushed_bitrate;
 };
 
@@ -87,68 +87,62 @@ difference_over_threshold (guint a, guint b, float th)
   return (a > b ? (a - b) > (a * th) : (b - a) > (b * th));
 }
 
+static void
+kms_parse_tree_bin_push_bitrate (KmsParseTreeBin * self, GstPad * pad,
+    guint bitrate)
+{
+  GstTagList *taglist = NULL;
+  GstEvent *previous_tag_event;
+
+  GST_TRACE_OBJECT (self, "Bitrate: %u", bitrate);
+
+  previous_tag_event = gst_pad_get_sticky_event (pad, GST_EVENT_TAG, 0);
+
+  if (previous_tag_event) {
+    GST_TRACE_OBJECT (self, "Previous tag event: %" GST_PTR_FORMAT,
+        previous_tag_event);
+    gst_event_parse_tag (previous_tag_event, &taglist);
+
+    taglist = gst_tag_list_copy (taglist);
+    gst_tag_list_add (taglist, GST_TAG_MERGE_REPLACE, "bitrate", bitrate,
+        NULL);
+
+    gst_event_unref (previous_tag_event);
+  }
+
+  if (!taglist) {
+    taglist = gst_tag_list_new ("bitrate", bitrate, NULL);
+  }
+
+  gst_pad_send_event (pad, gst_event_new_tag (taglist));
+  self->priv->last_pushed_bitrate = bitrate;
+}
+
 static GstPadProbeReturn
 bitrate_calculation_probe (GstPad * pad, GstPadProbeInfo * info, gpointer data)
 {
   KmsParseTreeBin *self = data;
+  guint bitrate;
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    kms_bitrate_calc_update_buffer (&self->priv->bitrate_calc,
+        gst_pad_probe_info_get_buffer (info));
+  } else if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    kms_bitrate_calc_update_buffer_list (&self->priv->bitrate_calc,
+        gst_pad_probe_info_get_buffer_list (info));
+  }
+
+  bitrate = kms_bitrate_calc_get_bitrate (&self->priv->bitrate_calc);
+
+  if (bitrate == 0) {
+    return GST_PAD_PROBE_OK;
+  }
 
-  if (GST_PAD_PROBE_INFO_TYPE (info) | GST_PAD_PROBE_TYPE_BUFFER) {
-    GstBuffer *buffer = gst_pad_probe_info_get_buffer (info);
-    GstClockTime timediff = GST_CLOCK_TIME_NONE;
-    guint bitrate;
-
-    if (GST_CLOCK_TIME_IS_VALID (buffer->dts)
-        && GST_CLOCK_TIME_IS_VALID (self->priv->last_buffer_dts)) {
-      timediff = buffer->dts - self->priv->last_buffer_dts;
-    } else if (GST_CLOCK_TIME_IS_VALID (buffer->pts)
-        && GST_CLOCK_TIME_IS_VALID (self->priv->last_buffer_pts)) {
-      timediff = buffer->pts - self->priv->last_buffer_pts;
-    }
-
-    if (timediff > 0) {
-      bitrate = (gst_buffer_get_size (buffer) * GST_SECOND * 8) / timediff;
-
-      self->priv->bitrate_mean = (self->priv->bitrate_mean * 7 + bitrate) / 8;
-
-      if (self->priv->last_pushed_bitrate == 0
-          || difference_over_threshold (self->priv->bitrate_mean,
-              self->priv->last_pushed_bitrate, BITRATE_THRESHOLD)) {
-        GstTagList *taglist = NULL;
-        GstEvent *previous_tag_event;
-
-        GST_TRACE_OBJECT (self, "Bitrate: %u", bitrate);
-        GST_TRACE_OBJECT (self, "Bitrate_mean:\t\t%u",
-            self->priv->bitrate_mean);
-
-        previous_tag_event = gst_pad_get_sticky_event (pad, GST_EVENT_TAG, 0);
-
-        if (previous_tag_event) {
-          GST_TRACE_OBJECT (self, "Previous tag event: %" GST_PTR_FORMAT,
-              previous_tag_event);
-          gst_event_parse_tag (previous_tag_event, &taglist);
-
-          taglist = gst_tag_list_copy (taglist);
-          gst_tag_list_add (taglist, GST_TAG_MERGE_REPLACE, "bitrate",
-              self->priv->bitrate_mean, NULL);
-
-          gst_event_unref (previous_tag_event);
-        }
-
-        if (!taglist) {
-          taglist =
-              gst_tag_list_new ("bitrate", self->priv->bitrate_mean, NULL);
-        }
-
-        gst_pad_send_event (pad, gst_event_new_tag (taglist));
-        self->priv->last_pushed_bitrate = self->priv->bitrate_mean;
-      }
-    }
-
-    self->priv->last_buffer_pts = buffer->pts;
-    self->priv->last_buffer_dts = buffer->dts;
-  } else if (GST_PAD_PROBE_INFO_TYPE (info) | GST_PAD_PROBE_TYPE_BUFFER_LIST) {
-    GST_WARNING_OBJECT (self,
-        "Bufferlist is not supported yet for bitrate calculation");
+  /* Only send a new tag when the bitrate changes significantly */
+  if (self->priv->last_pushed_bitrate == 0
+      || difference_over_threshold (bitrate, self->priv->last_pushed_bitrate,
+          BITRATE_THRESHOLD)) {
+    kms_parse_tree_bin_push_bitrate (self, pad, bitrate);
   }
 
   return GST_PAD_PROBE_OK;
@@ -201,8 +195,7 @@ kms_parse_tree_bin_init (KmsParseTreeBin * self)
 {
   self->priv = KMS_PARSE_TREE_BIN_GET_PRIVATE (self);
 
-  self->priv->last_buffer_dts = GST_CLOCK_TIME_NONE;
-  self->priv->last_buffer_pts = GST_CLOCK_TIME_NONE;
+  kms_bitrate_calc_init (&self->priv->bitrate_calc, BITRATE_CALC_INTERVAL);
 }
 
 static void
@@ -39,6 +39,13 @@ G_DEFINE_QUARK (KMS_REMB_REMOTE, kms_remb_remote);
 
 #define REMB_MAX_FACTOR_INPUT_BR 2
 
+#define DEFAULT_REMB_DELAY_BASED FALSE
+
+/* abs-send-time is a 24 bits, 6.18 fixed point seconds value */
+#define ABS_SEND_TIME_BITS 24
+#define ABS_SEND_TIME_FRACTION_BITS 18
+#define ABS_SEND_TIME_MASK ((1 << ABS_SEND_TIME_BITS) - 1)
+
 static void
 kms_remb_base_destroy (KmsRembBase * self)
 {
@@ -311,6 +318,10 @@ kms_remb_local_update (KmsRembLocal * self)
     self->probed = TRUE;
   }
 
+  KMS_REMB_BASE_LOCK (self);
+  self->fraction_lost = fraction_lost;
+  KMS_REMB_BASE_UNLOCK (self);
+
   packets_rcv_interval_top =
       MAX (self->packets_recv_interval_top, packets_rcv_interval);
   self->fraction_lost_record =
@@ -445,6 +456,21 @@ kms_remb_local_on_sending_rtcp (GObject *rtpsession,
   const guint32 old_bitrate = self->remb_sent;
   guint32 new_bitrate = self->remb;
 
+  if (self->delay_based) {
+    guint delay_bitrate;
+
+    KMS_REMB_BASE_LOCK (self);
+    delay_bitrate = kms_delay_bwe_get_estimate (self->delay_bwe);
+    KMS_REMB_BASE_UNLOCK (self);
+
+    /* 0 means that no congestion has been detected yet */
+    if (delay_bitrate > 0) {
+      GST_TRACE_OBJECT (rtpsession, "REMB: Delay-based: %" G_GUINT32_FORMAT,
+          delay_bitrate);
+      new_bitrate = MIN (new_bitrate, delay_bitrate);
+    }
+  }
+
   if (self->event_manager != NULL) {
     guint remb_local_max;
 
@@ -502,6 +528,7 @@ kms_remb_local_destroy (KmsRembLocal * self)
   g_slist_free_full (self->remote_sessions,
       (GDestroyNotify) kms_rl_remote_session_destroy);
   kms_remb_base_destroy (KMS_REMB_BASE (self));
+  kms_delay_bwe_free (self->delay_bwe);
 
   g_slice_free (KmsRembLocal, self);
 }
@@ -533,9 +560,48 @@ kms_remb_local_create (GObject * rtpsession, guint min_bw, guint max_bw)
   self->threshold_factor = DEFAULT_REMB_THRESHOLD_FACTOR;
   self->up_losses = DEFAULT_REMB_UP_LOSSES;
 
+  self->delay_based = DEFAULT_REMB_DELAY_BASED;
+  self->delay_bwe = kms_delay_bwe_new (MAX (min_bw * 1000, REMB_MIN),
+      max_bw * 1000);
+
   return self;
 }
 
+void
+kms_remb_local_incoming_packet (KmsRembLocal * rl, guint32 abs_send_time,
+    GstClockTime arrival_time, gsize size)
+{
+  GstClockTime send_time;
+  gint32 diff;
+
+  if (!rl->delay_based) {
+    /* Packets are only timed for the delay-based estimation */
+    return;
+  }
+
+  abs_send_time &= ABS_SEND_TIME_MASK;
+
+  KMS_REMB_BASE_LOCK (rl);
+
+  if (!rl->abs_send_time_valid) {
+    /* Start one wrap ahead so reordered packets never go negative */
+    rl->abs_send_time = abs_send_time + ABS_SEND_TIME_MASK + 1;
+    rl->abs_send_time_valid = TRUE;
+  } else {
+    /* Signed distance in the 24 bits space, it wraps every 64 seconds */
+    diff = (gint32) ((abs_send_time - rl->abs_send_time_last) <<
+        (32 - ABS_SEND_TIME_BITS)) >> (32 - ABS_SEND_TIME_BITS);
+    rl->abs_send_time += diff;
+  }
+  rl->abs_send_time_last = abs_send_time;
+
+  send_time = gst_util_uint64_scale (rl->abs_send_time, GST_SECOND,
+      1 << ABS_SEND_TIME_FRACTION_BITS);
+  kms_delay_bwe_incoming_packet (rl->delay_bwe, send_time, arrival_time, size);
+
+  KMS_REMB_BASE_UNLOCK (rl);
+}
+
 void
 kms_remb_local_add_remote_session (KmsRembLocal * rl, GObject * rtpsess,
     guint ssrc)
@@ -550,6 +616,7 @@ kms_remb_local_set_params (KmsRembLocal * rl, GstStructure * params)
 {
   gfloat auxf;
   gint auxi;
+  gboolean auxb;
   gboolean is_set;
 
   is_set =
@@ -601,6 +668,12 @@ kms_remb_local_set_params (KmsRembLocal * rl, GstStructure * params)
   if (is_set) {
     rl->up_losses = auxi;
   }
+
+  is_set =
+      gst_structure_get (params, "delay-based", G_TYPE_BOOLEAN, &auxb, NULL);
+  if (is_set) {
+    rl->delay_based = auxb;
+  }
 }
 
 void
@@ -613,7 +686,20 @@ kms_remb_local_get_params (KmsRembLocal * rl, GstStructure ** params)
       "lineal-factor-grade", G_TYPE_FLOAT, rl->lineal_factor_grade,
       "decrement-factor", G_TYPE_FLOAT, rl->decrement_factor,
       "threshold-factor", G_TYPE_FLOAT, rl->threshold_factor,
-      "up-losses", G_TYPE_INT, rl->up_losses, NULL);
+      "up-losses", G_TYPE_INT, rl->up_losses,
+      "delay-based", G_TYPE_BOOLEAN, rl->delay_based, NULL);
+}
+
+guint
+kms_remb_local_get_fraction_lost (KmsRembLocal * rl)
+{
+  guint fraction_lost;
+
+  KMS_REMB_BASE_LOCK (rl);
+  fraction_lost = MIN (rl->fraction_lost, 255);
+  KMS_REMB_BASE_UNLOCK (rl);
+
+  return fraction_lost;
 }
 
 /* KmsRembLocal end */
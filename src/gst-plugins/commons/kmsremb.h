@@ -19,6 +19,7 @@
 #define __KMS_REMB_H__
 
 #include "kmsutils.h" /* TODO: must be not needed */
+#include "kmsdelaybwe.h"
 
 G_BEGIN_DECLS
 
@@ -70,7 +71,15 @@ struct _KmsRembLocal
   guint64 last_octets_received;
   guint64 last_packets_received;
   guint64 fraction_lost_record;
+  guint fraction_lost; /* Last interval, 0 to 255 */
   RembEventManager *event_manager;
+
+  /* Delay-based estimation, combined with the loss-based one */
+  gboolean delay_based;
+  KmsDelayBwe *delay_bwe;
+  gint64 abs_send_time; // Unwrapped, 6.18 fixed point seconds
+  guint32 abs_send_time_last;
+  gboolean abs_send_time_valid;
 };
 
 KmsRembLocal * kms_remb_local_create (GObject *rtpsess,
@@ -79,6 +88,10 @@ void kms_remb_local_destroy (KmsRembLocal *rl);
 void kms_remb_local_add_remote_session (KmsRembLocal *rl, GObject *rtpsess, guint ssrc);
 void kms_remb_local_set_params (KmsRembLocal *rl, GstStructure *params);
 void kms_remb_local_get_params (KmsRembLocal *rl, GstStructure **params);
+void kms_remb_local_incoming_packet (KmsRembLocal *rl, guint32 abs_send_time,
+  GstClockTime arrival_time, gsize size);
+/* Losses of the received video, as an RTCP fraction lost */
+guint kms_remb_local_get_fraction_lost (KmsRembLocal *rl);
 /* KmsRembLocal end */
 
 /* KmsRembRemote begin */
@@ -0,0 +1,373 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+#include <gst/rtp/gstrtpbuffer.h>
+
+#include "kmsrtpallocator.h"
+
+#define GST_DEFAULT_NAME "rtpallocator"
+#define GST_CAT_DEFAULT kms_rtp_allocator_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+#define kms_rtp_allocator_parent_class parent_class
+G_DEFINE_TYPE (KmsRtpAllocator, kms_rtp_allocator, GST_TYPE_ALLOCATOR);
+
+#define KMS_RTP_ALLOCATOR_GET_PRIVATE(obj) (  \
+  G_TYPE_INSTANCE_GET_PRIVATE (               \
+    (obj),                                    \
+    KMS_TYPE_RTP_ALLOCATOR,                   \
+    KmsRtpAllocatorPrivate                    \
+  )                                           \
+)
+
+enum
+{
+  PROP_0,
+  PROP_FREE_CHUNKS,
+  N_PROPERTIES
+};
+
+struct _KmsRtpAllocatorPrivate
+{
+  GstAtomicQueue *chunks;
+  gint n_chunks;
+};
+
+typedef struct _KmsRtpMemory
+{
+  GstMemory mem;
+  guint8 *data;
+} KmsRtpMemory;
+
+static KmsRtpMemory *
+kms_rtp_memory_new_chunk (void)
+{
+  KmsRtpMemory *mem;
+  guint8 *data;
+
+  /* The chunk is allocated in the same block as its GstMemory */
+  mem = g_malloc (sizeof (KmsRtpMemory) + KMS_RTP_ALLOCATOR_ALIGN +
+      KMS_RTP_ALLOCATOR_CHUNK_SIZE);
+  data = (guint8 *) mem + sizeof (KmsRtpMemory);
+  data = (guint8 *) (((guintptr) data + KMS_RTP_ALLOCATOR_ALIGN) &
+      ~((guintptr) KMS_RTP_ALLOCATOR_ALIGN));
+  mem->data = data;
+
+  return mem;
+}
+
+static GstMemory *
+kms_rtp_allocator_alloc (GstAllocator * allocator, gsize size,
+    GstAllocationParams * params)
+{
+  KmsRtpAllocator *self = KMS_RTP_ALLOCATOR (allocator);
+  gsize maxsize = size + params->prefix + params->padding;
+  KmsRtpMemory *mem;
+
+  if (maxsize > KMS_RTP_ALLOCATOR_CHUNK_SIZE
+      || params->align > KMS_RTP_ALLOCATOR_ALIGN) {
+    GST_LOG_OBJECT (self, "Cannot serve %" G_GSIZE_FORMAT " bytes with align"
+        " %" G_GSIZE_FORMAT ", using system memory", maxsize, params->align);
+    return gst_allocator_alloc (NULL, size, params);
+  }
+
+  mem = gst_atomic_queue_pop (self->priv->chunks);
+  if (mem != NULL) {
+    g_atomic_int_add (&self->priv->n_chunks, -1);
+  } else {
+    mem = kms_rtp_memory_new_chunk ();
+  }
+
+  gst_memory_init (GST_MEMORY_CAST (mem), params->flags, allocator, NULL,
+      KMS_RTP_ALLOCATOR_CHUNK_SIZE, KMS_RTP_ALLOCATOR_ALIGN, params->prefix,
+      size);
+
+  if (params->prefix && (params->flags & GST_MEMORY_FLAG_ZERO_PREFIXED)) {
+    memset (mem->data, 0, params->prefix);
+  }
+
+  if (params->padding && (params->flags & GST_MEMORY_FLAG_ZERO_PADDED)) {
+    memset (mem->data + params->prefix + size, 0, params->padding);
+  }
+
+  return GST_MEMORY_CAST (mem);
+}
+
+static void
+kms_rtp_allocator_free (GstAllocator * allocator, GstMemory * memory)
+{
+  KmsRtpAllocator *self = KMS_RTP_ALLOCATOR (allocator);
+  KmsRtpMemory *mem = (KmsRtpMemory *) memory;
+
+  if (memory->parent != NULL) {
+    /* Shared memory, the chunk belongs to the parent */
+    g_slice_free (KmsRtpMemory, mem);
+    return;
+  }
+
+  if (g_atomic_int_add (&self->priv->n_chunks,
+          1) < KMS_RTP_ALLOCATOR_MAX_FREE_CHUNKS) {
+    gst_atomic_queue_push (self->priv->chunks, mem);
+  } else {
+    g_atomic_int_add (&self->priv->n_chunks, -1);
+    g_free (mem);
+  }
+}
+
+static gpointer
+kms_rtp_memory_map (GstMemory * memory, gsize maxsize, GstMapFlags flags)
+{
+  return ((KmsRtpMemory *) memory)->data;
+}
+
+static void
+kms_rtp_memory_unmap (GstMemory * memory)
+{
+  /* Nothing to do */
+}
+
+static GstMemory *
+kms_rtp_memory_copy (GstMemory * memory, gssize offset, gssize size)
+{
+  KmsRtpMemory *mem = (KmsRtpMemory *) memory;
+  GstAllocationParams params;
+  GstMemory *copy;
+  GstMapInfo info;
+
+  if (size == -1) {
+    size = memory->size > offset ? memory->size - offset : 0;
+  }
+
+  gst_allocation_params_init (&params);
+  params.align = memory->align;
+
+  copy = gst_allocator_alloc (memory->allocator, size, &params);
+  if (!gst_memory_map (copy, &info, GST_MAP_WRITE)) {
+    gst_memory_unref (copy);
+    return NULL;
+  }
+
+  memcpy (info.data, mem->data + memory->offset + offset, size);
+  gst_memory_unmap (copy, &info);
+
+  return copy;
+}
+
+static GstMemory *
+kms_rtp_memory_share (GstMemory * memory, gssize offset, gssize size)
+{
+  KmsRtpMemory *mem = (KmsRtpMemory *) memory, *sub;
+  GstMemory *parent;
+
+  if (size == -1) {
+    size = memory->size - offset;
+  }
+
+  if ((parent = memory->parent) == NULL) {
+    parent = memory;
+  }
+
+  sub = g_slice_new (KmsRtpMemory);
+  gst_memory_init (GST_MEMORY_CAST (sub),
+      GST_MINI_OBJECT_FLAGS (parent) | GST_MINI_OBJECT_FLAG_LOCK_READONLY,
+      memory->allocator, parent, memory->maxsize, memory->align,
+      memory->offset + offset, size);
+  sub->data = mem->data;
+
+  return GST_MEMORY_CAST (sub);
+}
+
+static gboolean
+kms_rtp_memory_is_span (GstMemory * mem1, GstMemory * mem2, gsize * offset)
+{
+  KmsRtpMemory *m1 = (KmsRtpMemory *) mem1, *m2 = (KmsRtpMemory *) mem2;
+
+  if (offset) {
+    *offset = mem1->offset - mem1->parent->offset;
+  }
+
+  return m1->data + mem1->offset + mem1->size == m2->data + mem2->offset;
+}
+
+static void
+kms_rtp_allocator_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  KmsRtpAllocator *self = KMS_RTP_ALLOCATOR (object);
+
+  switch (property_id) {
+    case PROP_FREE_CHUNKS:
+      g_value_set_int (value, g_atomic_int_get (&self->priv->n_chunks));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+kms_rtp_allocator_finalize (GObject * object)
+{
+  KmsRtpAllocator *self = KMS_RTP_ALLOCATOR (object);
+  KmsRtpMemory *mem;
+
+  while ((mem = gst_atomic_queue_pop (self->priv->chunks)) != NULL) {
+    g_free (mem);
+  }
+
+  gst_atomic_queue_unref (self->priv->chunks);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+kms_rtp_allocator_class_init (KmsRtpAllocatorClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstAllocatorClass *allocator_class = GST_ALLOCATOR_CLASS (klass);
+
+  gobject_class->finalize = kms_rtp_allocator_finalize;
+  gobject_class->get_property = kms_rtp_allocator_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_FREE_CHUNKS,
+      g_param_spec_int ("free-chunks", "Free chunks",
+          "Number of freed chunks kept for reuse", 0,
+          KMS_RTP_ALLOCATOR_MAX_FREE_CHUNKS, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  allocator_class->alloc = kms_rtp_allocator_alloc;
+  allocator_class->free = kms_rtp_allocator_free;
+
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+
+  g_type_class_add_private (klass, sizeof (KmsRtpAllocatorPrivate));
+}
+
+static void
+kms_rtp_allocator_init (KmsRtpAllocator * self)
+{
+  GstAllocator *allocator = GST_ALLOCATOR (self);
+
+  self->priv = KMS_RTP_ALLOCATOR_GET_PRIVATE (self);
+  self->priv->chunks =
+      gst_atomic_queue_new (KMS_RTP_ALLOCATOR_MAX_FREE_CHUNKS);
+
+  allocator->mem_type = KMS_RTP_ALLOCATOR_NAME;
+  allocator->mem_map = kms_rtp_memory_map;
+  allocator->mem_unmap = kms_rtp_memory_unmap;
+  allocator->mem_copy = kms_rtp_memory_copy;
+  allocator->mem_share = kms_rtp_memory_share;
+  allocator->mem_is_span = kms_rtp_memory_is_span;
+}
+
+static gpointer
+register_allocator (gpointer data)
+{
+  GstAllocator *allocator;
+
+  allocator = g_object_new (KMS_TYPE_RTP_ALLOCATOR, NULL);
+  gst_object_ref_sink (allocator);
+  gst_allocator_register (KMS_RTP_ALLOCATOR_NAME, allocator);
+
+  return NULL;
+}
+
+/**
+ * kms_rtp_allocator_get_default:
+ *
+ * Returns: (transfer full): the process-wide RTP allocator
+ */
+GstAllocator *
+kms_rtp_allocator_get_default (void)
+{
+  static GOnce once = G_ONCE_INIT;
+
+  g_once (&once, register_allocator, NULL);
+
+  return gst_allocator_find (KMS_RTP_ALLOCATOR_NAME);
+}
+
+static void
+kms_rtp_allocator_init_params (GstAllocationParams * params)
+{
+  gst_allocation_params_init (params);
+  params->align = KMS_RTP_ALLOCATOR_ALIGN;
+}
+
+/**
+ * kms_rtp_buffer_make_header_writable:
+ * @buffer: (transfer full): a RTP buffer
+ *
+ * Returns a buffer whose RTP header can be modified and grown (for adding
+ * header extensions) in place. Writable buffers are returned as they are.
+ * Otherwise the header is copied into a recycled RTP chunk with room to
+ * grow, while the payload memory is shared, not copied.
+ *
+ * Returns: (transfer full): a writable buffer
+ */
+GstBuffer *
+kms_rtp_buffer_make_header_writable (GstBuffer * buffer)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstAllocationParams params;
+  GstAllocator *allocator;
+  GstMemory *header;
+  GstBuffer *out;
+  GstMapInfo info;
+  guint header_len;
+
+  if (gst_buffer_is_writable (buffer)) {
+    /* Nobody else sees it, mapping it for writing is enough */
+    return buffer;
+  }
+
+  if (!gst_rtp_buffer_map (buffer, GST_MAP_READ, &rtp)) {
+    return gst_buffer_make_writable (buffer);
+  }
+
+  header_len = gst_rtp_buffer_get_header_len (&rtp);
+  gst_rtp_buffer_unmap (&rtp);
+
+  allocator = kms_rtp_allocator_get_default ();
+  kms_rtp_allocator_init_params (&params);
+  header = gst_allocator_alloc (allocator, header_len, &params);
+  gst_object_unref (allocator);
+
+  if (!gst_memory_map (header, &info, GST_MAP_WRITE)) {
+    gst_memory_unref (header);
+    return gst_buffer_make_writable (buffer);
+  }
+
+  gst_buffer_extract (buffer, 0, info.data, header_len);
+  gst_memory_unmap (header, &info);
+
+  out = gst_buffer_new ();
+  gst_buffer_append_memory (out, header);
+  gst_buffer_copy_into (out, buffer, GST_BUFFER_COPY_FLAGS |
+      GST_BUFFER_COPY_TIMESTAMPS | GST_BUFFER_COPY_META, 0, -1);
+  gst_buffer_copy_into (out, buffer, GST_BUFFER_COPY_MEMORY, header_len, -1);
+
+  gst_buffer_unref (buffer);
+
+  return out;
+}
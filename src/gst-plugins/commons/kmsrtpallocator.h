@@ -0,0 +1,76 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_RTP_ALLOCATOR_H__
+#define __KMS_RTP_ALLOCATOR_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define KMS_TYPE_RTP_ALLOCATOR \
+  (kms_rtp_allocator_get_type())
+#define KMS_RTP_ALLOCATOR(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),KMS_TYPE_RTP_ALLOCATOR,KmsRtpAllocator))
+#define KMS_RTP_ALLOCATOR_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),KMS_TYPE_RTP_ALLOCATOR,KmsRtpAllocatorClass))
+#define KMS_IS_RTP_ALLOCATOR(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),KMS_TYPE_RTP_ALLOCATOR))
+#define KMS_IS_RTP_ALLOCATOR_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),KMS_TYPE_RTP_ALLOCATOR))
+
+#define KMS_RTP_ALLOCATOR_NAME "KmsRtpMemory"
+
+/* Chunks are big enough for a MTU sized packet plus header extensions */
+#define KMS_RTP_ALLOCATOR_CHUNK_SIZE 2048
+/* Cache line alignment */
+#define KMS_RTP_ALLOCATOR_ALIGN 63
+/* Maximum number of free chunks kept for reuse (8 MiB) */
+#define KMS_RTP_ALLOCATOR_MAX_FREE_CHUNKS 4096
+
+typedef struct _KmsRtpAllocator KmsRtpAllocator;
+typedef struct _KmsRtpAllocatorClass KmsRtpAllocatorClass;
+typedef struct _KmsRtpAllocatorPrivate KmsRtpAllocatorPrivate;
+
+/**
+ * KmsRtpAllocator:
+ *
+ * Allocator of fixed-size, cache line aligned memory chunks. Freed chunks
+ * are kept in a lock-free free list and recycled, so allocating RTP
+ * packets does not reach malloc in steady state.
+ */
+struct _KmsRtpAllocator
+{
+  GstAllocator parent;
+
+  KmsRtpAllocatorPrivate *priv;
+};
+
+struct _KmsRtpAllocatorClass
+{
+  GstAllocatorClass parent_class;
+};
+
+GType kms_rtp_allocator_get_type (void);
+
+GstAllocator * kms_rtp_allocator_get_default (void);
+
+GstBuffer * kms_rtp_buffer_make_header_writable (GstBuffer * buffer);
+
+G_END_DECLS
+
+#endif /* __KMS_RTP_ALLOCATOR_H__ */
@@ -0,0 +1,305 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <gst/rtp/gstrtpbuffer.h>
+
+#include "kmsrtpbatcher.h"
+
+#define GST_DEFAULT_NAME "rtpbatcher"
+#define GST_CAT_DEFAULT kms_rtp_batcher_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+#define kms_rtp_batcher_parent_class parent_class
+G_DEFINE_TYPE (KmsRtpBatcher, kms_rtp_batcher, GST_TYPE_ELEMENT);
+
+#define KMS_RTP_BATCHER_GET_PRIVATE(obj) (  \
+  G_TYPE_INSTANCE_GET_PRIVATE (             \
+    (obj),                                  \
+    KMS_TYPE_RTP_BATCHER,                   \
+    KmsRtpBatcherPrivate                    \
+  )                                         \
+)
+
+/* A 1080p keyframe fits, bigger frames are pushed in several lists */
+#define DEFAULT_MAX_PACKETS 128
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-rtp"));
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-rtp"));
+
+enum
+{
+  PROP_0,
+  PROP_MAX_PACKETS,
+  N_PROPERTIES
+};
+
+struct _KmsRtpBatcherPrivate
+{
+  GstPad *sinkpad;
+  GstPad *srcpad;
+
+  /* Only used from the streaming thread */
+  GstBufferList *pending;
+  guint32 pending_ts;
+
+  guint max_packets;
+};
+
+static GstFlowReturn
+kms_rtp_batcher_push_pending (KmsRtpBatcher * self)
+{
+  GstBufferList *list = self->priv->pending;
+
+  if (list == NULL) {
+    return GST_FLOW_OK;
+  }
+
+  self->priv->pending = NULL;
+
+  GST_LOG_OBJECT (self, "Pushing %u packets", gst_buffer_list_length (list));
+
+  return gst_pad_push_list (self->priv->srcpad, list);
+}
+
+static void
+kms_rtp_batcher_drop_pending (KmsRtpBatcher * self)
+{
+  if (self->priv->pending != NULL) {
+    gst_buffer_list_unref (self->priv->pending);
+    self->priv->pending = NULL;
+  }
+}
+
+static GstFlowReturn
+kms_rtp_batcher_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  KmsRtpBatcher *self = KMS_RTP_BATCHER (parent);
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstFlowReturn ret;
+  gboolean marker;
+  guint32 ts;
+
+  if (!gst_rtp_buffer_map (buffer, GST_MAP_READ, &rtp)) {
+    GST_WARNING_OBJECT (self, "Not an RTP buffer, pushing as is");
+    ret = kms_rtp_batcher_push_pending (self);
+    if (ret != GST_FLOW_OK) {
+      gst_buffer_unref (buffer);
+      return ret;
+    }
+
+    return gst_pad_push (self->priv->srcpad, buffer);
+  }
+
+  ts = gst_rtp_buffer_get_timestamp (&rtp);
+  marker = gst_rtp_buffer_get_marker (&rtp);
+  gst_rtp_buffer_unmap (&rtp);
+
+  if (self->priv->pending != NULL && ts != self->priv->pending_ts) {
+    /* Previous frame had no marker */
+    ret = kms_rtp_batcher_push_pending (self);
+    if (ret != GST_FLOW_OK) {
+      gst_buffer_unref (buffer);
+      return ret;
+    }
+  }
+
+  if (self->priv->pending == NULL) {
+    self->priv->pending = gst_buffer_list_new_sized (self->priv->max_packets);
+    self->priv->pending_ts = ts;
+  }
+
+  gst_buffer_list_add (self->priv->pending, buffer);
+
+  if (marker
+      || gst_buffer_list_length (self->priv->pending) >=
+      self->priv->max_packets) {
+    return kms_rtp_batcher_push_pending (self);
+  }
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+kms_rtp_batcher_chain_list (GstPad * pad, GstObject * parent,
+    GstBufferList * list)
+{
+  KmsRtpBatcher *self = KMS_RTP_BATCHER (parent);
+  GstFlowReturn ret;
+
+  /* Already batched by the payloader */
+  ret = kms_rtp_batcher_push_pending (self);
+  if (ret != GST_FLOW_OK) {
+    gst_buffer_list_unref (list);
+    return ret;
+  }
+
+  return gst_pad_push_list (self->priv->srcpad, list);
+}
+
+static gboolean
+kms_rtp_batcher_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  KmsRtpBatcher *self = KMS_RTP_BATCHER (parent);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_STOP:
+      kms_rtp_batcher_drop_pending (self);
+      break;
+    case GST_EVENT_FLUSH_START:
+      break;
+    default:
+      if (GST_EVENT_IS_SERIALIZED (event)) {
+        /* Keep packets before the event */
+        kms_rtp_batcher_push_pending (self);
+      }
+      break;
+  }
+
+  return gst_pad_event_default (pad, parent, event);
+}
+
+static GstStateChangeReturn
+kms_rtp_batcher_change_state (GstElement * element, GstStateChange transition)
+{
+  KmsRtpBatcher *self = KMS_RTP_BATCHER (element);
+  GstStateChangeReturn ret;
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+
+  if (transition == GST_STATE_CHANGE_PAUSED_TO_READY) {
+    /* Streaming thread is stopped */
+    kms_rtp_batcher_drop_pending (self);
+  }
+
+  return ret;
+}
+
+static void
+kms_rtp_batcher_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  KmsRtpBatcher *self = KMS_RTP_BATCHER (object);
+
+  switch (property_id) {
+    case PROP_MAX_PACKETS:
+      GST_OBJECT_LOCK (self);
+      self->priv->max_packets = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+kms_rtp_batcher_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  KmsRtpBatcher *self = KMS_RTP_BATCHER (object);
+
+  switch (property_id) {
+    case PROP_MAX_PACKETS:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint (value, self->priv->max_packets);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+kms_rtp_batcher_finalize (GObject * object)
+{
+  KmsRtpBatcher *self = KMS_RTP_BATCHER (object);
+
+  kms_rtp_batcher_drop_pending (self);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+kms_rtp_batcher_class_init (KmsRtpBatcherClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+
+  gobject_class->finalize = kms_rtp_batcher_finalize;
+  gobject_class->set_property = kms_rtp_batcher_set_property;
+  gobject_class->get_property = kms_rtp_batcher_get_property;
+
+  gstelement_class->change_state = kms_rtp_batcher_change_state;
+
+  gst_element_class_set_details_simple (gstelement_class,
+      "RTP batcher",
+      "Codec/Payloader/Network/RTP",
+      "Groups the RTP packets of each frame in a buffer list",
+      "Kurento <kurento@googlegroups.com>");
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&src_template));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&sink_template));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_PACKETS,
+      g_param_spec_uint ("max-packets", "Maximum packets",
+          "Maximum number of packets in a buffer list", 1, G_MAXUINT,
+          DEFAULT_MAX_PACKETS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+
+  g_type_class_add_private (klass, sizeof (KmsRtpBatcherPrivate));
+}
+
+static void
+kms_rtp_batcher_init (KmsRtpBatcher * self)
+{
+  self->priv = KMS_RTP_BATCHER_GET_PRIVATE (self);
+
+  self->priv->sinkpad = gst_pad_new_from_static_template (&sink_template,
+      "sink");
+  gst_pad_set_chain_function (self->priv->sinkpad,
+      GST_DEBUG_FUNCPTR (kms_rtp_batcher_chain));
+  gst_pad_set_chain_list_function (self->priv->sinkpad,
+      GST_DEBUG_FUNCPTR (kms_rtp_batcher_chain_list));
+  gst_pad_set_event_function (self->priv->sinkpad,
+      GST_DEBUG_FUNCPTR (kms_rtp_batcher_sink_event));
+  GST_PAD_SET_PROXY_CAPS (self->priv->sinkpad);
+  GST_PAD_SET_PROXY_ALLOCATION (self->priv->sinkpad);
+  gst_element_add_pad (GST_ELEMENT (self), self->priv->sinkpad);
+
+  self->priv->srcpad = gst_pad_new_from_static_template (&src_template,
+      "src");
+  GST_PAD_SET_PROXY_CAPS (self->priv->srcpad);
+  gst_element_add_pad (GST_ELEMENT (self), self->priv->srcpad);
+
+  self->priv->max_packets = DEFAULT_MAX_PACKETS;
+}
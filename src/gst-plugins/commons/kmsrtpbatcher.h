@@ -0,0 +1,65 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_RTP_BATCHER_H__
+#define __KMS_RTP_BATCHER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define KMS_TYPE_RTP_BATCHER \
+  (kms_rtp_batcher_get_type())
+#define KMS_RTP_BATCHER(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),KMS_TYPE_RTP_BATCHER,KmsRtpBatcher))
+#define KMS_RTP_BATCHER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),KMS_TYPE_RTP_BATCHER,KmsRtpBatcherClass))
+#define KMS_IS_RTP_BATCHER(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),KMS_TYPE_RTP_BATCHER))
+#define KMS_IS_RTP_BATCHER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),KMS_TYPE_RTP_BATCHER))
+
+typedef struct _KmsRtpBatcher KmsRtpBatcher;
+typedef struct _KmsRtpBatcherClass KmsRtpBatcherClass;
+typedef struct _KmsRtpBatcherPrivate KmsRtpBatcherPrivate;
+
+/**
+ * KmsRtpBatcher:
+ *
+ * Groups the RTP packets of a frame, pushed one by one by payloaders, into
+ * a single GstBufferList. A frame ends with the marker bit, a timestamp
+ * change or after "max-packets" packets, so no latency is added when the
+ * payloader sets the marker. Buffer lists coming from upstream are pushed
+ * as they are.
+ */
+struct _KmsRtpBatcher
+{
+  GstElement parent;
+
+  KmsRtpBatcherPrivate *priv;
+};
+
+struct _KmsRtpBatcherClass
+{
+  GstElementClass parent_class;
+};
+
+GType kms_rtp_batcher_get_type (void);
+
+G_END_DECLS
+
+#endif /* __KMS_RTP_BATCHER_H__ */
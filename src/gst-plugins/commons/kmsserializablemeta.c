@@ -16,6 +16,80 @@
  */
 
 #include "kmsserializablemeta.h"
+#include "kmsrefstruct.h"
+
+/* Metadata structures duplicated since startup */
+static gint structure_copies = 0;
+
+struct _KmsSerializableData
+{
+  KmsRefStruct ref;
+  GstStructure *structure;
+};
+
+static void
+kms_serializable_data_destroy (KmsSerializableData * sdata)
+{
+  gst_structure_set_parent_refcount (sdata->structure, NULL);
+  gst_structure_free (sdata->structure);
+  g_slice_free (KmsSerializableData, sdata);
+}
+
+static KmsSerializableData *
+kms_serializable_data_new (GstStructure * structure)
+{
+  KmsSerializableData *sdata;
+
+  sdata = g_slice_new (KmsSerializableData);
+  kms_ref_struct_init (KMS_REF_STRUCT_CAST (sdata),
+      (GDestroyNotify) kms_serializable_data_destroy);
+  sdata->structure = structure;
+
+  /* The structure is only writable while it is not shared */
+  gst_structure_set_parent_refcount (structure, &sdata->ref._count);
+
+  return sdata;
+}
+
+static GstStructure *
+kms_serializable_meta_copy_structure (const GstStructure * structure)
+{
+  g_atomic_int_inc (&structure_copies);
+
+  return gst_structure_copy (structure);
+}
+
+static void
+kms_serializable_meta_set_shared (KmsSerializableMeta * smeta,
+    KmsSerializableData * sdata)
+{
+  if (smeta->shared != NULL) {
+    kms_ref_struct_unref (KMS_REF_STRUCT_CAST (smeta->shared));
+  }
+
+  smeta->shared = sdata;
+  smeta->data = (sdata != NULL) ? sdata->structure : NULL;
+}
+
+static gboolean
+kms_serializable_meta_is_shared (KmsSerializableMeta * smeta)
+{
+  return smeta->shared != NULL &&
+      g_atomic_int_get (&smeta->shared->ref._count) > 1;
+}
+
+static void
+kms_serializable_meta_make_writable (KmsSerializableMeta * smeta)
+{
+  if (!kms_serializable_meta_is_shared (smeta)) {
+    return;
+  }
+
+  GST_DEBUG ("copy serializable metadata on write");
+  kms_serializable_meta_set_shared (smeta,
+      kms_serializable_data_new (kms_serializable_meta_copy_structure
+          (smeta->data)));
+}
 
 GType
 kms_serializable_meta_api_get_type (void)
@@ -38,6 +112,7 @@ kms_serializable_meta_init (GstMeta * meta, gpointer params, GstBuffer * buffer)
   KmsSerializableMeta *smeta = (KmsSerializableMeta *) meta;
 
   smeta->data = NULL;
+  smeta->shared = NULL;
 
   return TRUE;
 }
@@ -46,19 +121,29 @@ static gboolean
 kms_serializable_meta_transform (GstBuffer * transbuf, GstMeta * meta,
     GstBuffer * buffer, GQuark type, gpointer data)
 {
-  KmsSerializableMeta *smeta;
+  KmsSerializableMeta *smeta, *new_meta;
 
-  if (GST_META_TRANSFORM_IS_COPY (type)) {
-    GstStructure *copy = NULL;
+  if (!GST_META_TRANSFORM_IS_COPY (type)) {
+    return TRUE;
+  }
 
-    smeta = (KmsSerializableMeta *) meta;
+  smeta = (KmsSerializableMeta *) meta;
+  new_meta = (KmsSerializableMeta *) gst_buffer_get_meta (transbuf,
+      KMS_SERIALIZABLE_META_API_TYPE);
 
-    if (smeta->data != NULL) {
-      copy = gst_structure_copy (smeta->data);
-    }
+  if (new_meta == NULL) {
+    GST_TRACE ("share serializable metadata");
+    new_meta = (KmsSerializableMeta *) gst_buffer_add_meta (transbuf,
+        KMS_SERIALIZABLE_META_INFO, NULL);
 
+    if (smeta->shared != NULL) {
+      kms_serializable_meta_set_shared (new_meta, (KmsSerializableData *)
+          kms_ref_struct_ref (KMS_REF_STRUCT_CAST (smeta->shared)));
+    }
+  } else if (smeta->data != NULL) {
     GST_DEBUG ("copy serializable metadata");
-    kms_buffer_add_serializable_meta (transbuf, copy);
+    kms_buffer_add_serializable_meta (transbuf,
+        kms_serializable_meta_copy_structure (smeta->data));
   }
 
   return TRUE;
@@ -69,9 +154,7 @@ kms_serializable_meta_free (GstMeta * meta, GstBuffer * buffer)
 {
   KmsSerializableMeta *smeta = (KmsSerializableMeta *) meta;
 
-  if (smeta->data != NULL) {
-    gst_structure_free (smeta->data);
-  }
+  kms_serializable_meta_set_shared (smeta, NULL);
 }
 
 const GstMetaInfo *
@@ -110,6 +193,19 @@ add_fields_to_structure (GQuark field_id, const GValue * value, gpointer st)
   return TRUE;
 }
 
+static gboolean
+add_missing_fields_to_structure (GQuark field_id, const GValue * value,
+    gpointer st)
+{
+  GstStructure *data = GST_STRUCTURE (st);
+
+  if (!gst_structure_id_has_field (data, field_id)) {
+    gst_structure_id_set_value (data, field_id, value);
+  }
+
+  return TRUE;
+}
+
 KmsSerializableMeta *
 kms_buffer_add_serializable_meta (GstBuffer * buffer, GstStructure * data)
 {
@@ -120,22 +216,49 @@ kms_buffer_add_serializable_meta (GstBuffer * buffer, GstStructure * data)
   meta = (KmsSerializableMeta *) gst_buffer_get_meta (buffer,
       KMS_SERIALIZABLE_META_API_TYPE);
 
-  if (meta != NULL) {
-    gst_structure_foreach (data, add_fields_to_structure, meta->data);
-    gst_structure_free (data);
-
-  } else {
+  if (meta == NULL) {
     meta = (KmsSerializableMeta *) gst_buffer_add_meta (buffer,
         KMS_SERIALIZABLE_META_INFO, NULL);
+  }
+
+  if (data == NULL) {
+    return meta;
+  }
 
-    meta->data = data;
+  if (meta->data == NULL) {
+    kms_serializable_meta_set_shared (meta, kms_serializable_data_new (data));
+  } else if (kms_serializable_meta_is_shared (meta)) {
+    /* New fields win, the shared structure is left untouched */
+    gst_structure_set_name (data, gst_structure_get_name (meta->data));
+    gst_structure_foreach (meta->data, add_missing_fields_to_structure, data);
+    kms_serializable_meta_set_shared (meta, kms_serializable_data_new (data));
+  } else {
+    gst_structure_foreach (data, add_fields_to_structure, meta->data);
+    gst_structure_free (data);
   }
 
   return meta;
 }
 
+const GstStructure *
+kms_serializable_meta_peek_metadata (GstBuffer * buffer)
+{
+  KmsSerializableMeta *meta;
+
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), NULL);
+
+  meta = (KmsSerializableMeta *) gst_buffer_get_meta (buffer,
+      KMS_SERIALIZABLE_META_API_TYPE);
+
+  if (meta == NULL) {
+    return NULL;
+  }
+
+  return meta->data;
+}
+
 GstStructure *
-kms_serializable_meta_get_metadata (GstBuffer * buffer)
+kms_serializable_meta_get_writable_metadata (GstBuffer * buffer)
 {
   KmsSerializableMeta *meta;
 
@@ -148,5 +271,20 @@ kms_serializable_meta_get_metadata (GstBuffer * buffer)
     return NULL;
   }
 
+  kms_serializable_meta_make_writable (meta);
+
   return meta->data;
 }
+
+GstStructure *
+kms_serializable_meta_get_metadata (GstBuffer * buffer)
+{
+  /* Old callers may modify it, so it must not be shared */
+  return kms_serializable_meta_get_writable_metadata (buffer);
+}
+
+guint
+kms_serializable_meta_get_structure_copies (void)
+{
+  return g_atomic_int_get (&structure_copies);
+}
@@ -25,19 +25,24 @@
 G_BEGIN_DECLS
 
 typedef struct _KmsSerializableMeta KmsSerializableMeta;
+typedef struct _KmsSerializableData KmsSerializableData;
 
 /**
  * KmsSerializableMeta:
  * @meta: the parent type
- * @ts: The time stamp
+ * @data: the metadata, shared with the copies of the buffer
  *
  * Metadata for sending aditional information that can be passed over network
- * with the buffer
+ * with the buffer. Copies of the buffer share @data until one of them
+ * modifies it, so it is not writable while it is shared.
  */
 struct _KmsSerializableMeta {
   GstMeta       meta;
 
   GstStructure *data;
+
+  /*< private >*/
+  KmsSerializableData *shared;
 };
 
 GType kms_serializable_meta_api_get_type (void);
@@ -48,8 +53,8 @@ GType kms_serializable_meta_api_get_type (void);
  * kms_buffer_get_serializable_meta
  *
  * This function is deprecated. Use this function could cause
- * concurrency problems. Use kms_serializable_meta_get_metadata() instead of
- * this one.
+ * concurrency problems. Use kms_serializable_meta_peek_metadata() or
+ * kms_serializable_meta_get_writable_metadata() instead of this one.
  *
  * This function returns the metadata into a buffer.
  *
@@ -81,13 +86,43 @@ KmsSerializableMeta * kms_buffer_add_serializable_meta (GstBuffer *buffer,
 /**
  * kms_serializable_meta_get_metadata
  *
+ * This function is deprecated. The metadata can be shared with copies of the
+ * buffer, so it is copied first to keep callers that modify it working. Use
+ * kms_serializable_meta_peek_metadata() or
+ * kms_serializable_meta_get_writable_metadata() instead of this one.
+ *
+ * @param b: the buffer which contains the metadata
+ * @return The metadata [transfer none]
+ */
+GstStructure * kms_serializable_meta_get_metadata (GstBuffer *buffer) __attribute__ ((deprecated));
+
+/**
+ * kms_serializable_meta_peek_metadata
+ *
  * This function returns the metadata into a buffer. The metadata has the same
  * life cycle than the type which contains it in the buffer.
  *
+ * The metadata is read-only, other buffers can be sharing it. Use
+ * kms_serializable_meta_get_writable_metadata() to modify it.
+ *
  * @param b: the buffer which contains the metadata
  * @return The metadata [transfer none]
  */
-GstStructure * kms_serializable_meta_get_metadata (GstBuffer *buffer);
+const GstStructure * kms_serializable_meta_peek_metadata (GstBuffer *buffer);
+
+/**
+ * kms_serializable_meta_get_writable_metadata
+ *
+ * Same as kms_serializable_meta_peek_metadata() but the metadata returned can
+ * be modified. It is copied first if other buffers share it.
+ *
+ * @param b: the buffer which contains the metadata
+ * @return The metadata [transfer none]
+ */
+GstStructure * kms_serializable_meta_get_writable_metadata (GstBuffer *buffer);
+
+/* Number of metadata structures copied, sharing them does not count */
+guint kms_serializable_meta_get_structure_copies (void);
 
 G_END_DECLS
 
@@ -26,10 +26,15 @@ struct _KmsStatsProbe
   gulong probe_id;
 };
 
+/* Process-wide 1-in-N sampling of buffer latency metas */
+static guint latency_sampling = 1;
+
 typedef struct _BufferLatencyValues
 {
   gboolean valid;
   KmsMediaType type;
+  guint sampling;               /* 0 follows latency_sampling */
+  guint count;
 } BufferLatencyValues;
 
 typedef struct _ProbeData ProbeData;
@@ -49,7 +54,8 @@ typedef struct _ProbeData
 } ProbeData;
 
 static BufferLatencyValues *
-buffer_latency_values_new (gboolean is_valid, KmsMediaType type)
+buffer_latency_values_new (gboolean is_valid, KmsMediaType type,
+    guint sampling)
 {
   BufferLatencyValues *blv;
 
@@ -57,6 +63,8 @@ buffer_latency_values_new (gboolean is_valid, KmsMediaType type)
 
   blv->valid = is_valid;
   blv->type = type;
+  blv->sampling = sampling;
+  blv->count = 0;
 
   return blv;
 }
@@ -169,21 +177,53 @@ buffer_latency_probe_cb (GstBuffer * buffer, ProbeData * pdata)
 {
   BufferLatencyValues *blv = (BufferLatencyValues *) pdata->invoke_data;
   GstClockTime time;
+  guint sampling;
+
+  sampling = blv->sampling;
+  if (sampling == 0) {
+    sampling = g_atomic_int_get (&latency_sampling);
+  }
+
+  /* Probes run in the streaming thread, no need to be atomic */
+  if (sampling > 1 && (blv->count++ % sampling) != 0) {
+    return;
+  }
 
   time = kms_utils_get_time_nsecs ();
 
   kms_buffer_add_buffer_latency_meta (buffer, time, blv->valid, blv->type);
 }
 
+void
+kms_stats_set_latency_sampling (guint sampling)
+{
+  g_return_if_fail (sampling > 0);
+
+  g_atomic_int_set (&latency_sampling, sampling);
+}
+
+guint
+kms_stats_get_latency_sampling (void)
+{
+  return g_atomic_int_get (&latency_sampling);
+}
+
 gulong
 kms_stats_add_buffer_latency_meta_probe (GstPad * pad, gboolean is_valid,
     KmsMediaType type)
+{
+  return kms_stats_add_buffer_latency_meta_probe_full (pad, is_valid, type, 0);
+}
+
+gulong
+kms_stats_add_buffer_latency_meta_probe_full (GstPad * pad, gboolean is_valid,
+    KmsMediaType type, guint sampling)
 {
   ProbeData *pdata;
 
   BufferLatencyValues *blv;
 
-  blv = buffer_latency_values_new (is_valid, type);
+  blv = buffer_latency_values_new (is_valid, type, sampling);
 
   pdata = probe_data_new (buffer_latency_probe_cb, blv,
       (GDestroyNotify) buffer_latency_values_destroy, NULL, FALSE, NULL, NULL);
@@ -228,7 +268,7 @@ kms_stats_add_buffer_update_latency_meta_probe (GstPad * pad, gboolean is_valid,
 
   BufferLatencyValues *blv;
 
-  blv = buffer_latency_values_new (is_valid, type);
+  blv = buffer_latency_values_new (is_valid, type, 1);
 
   pdata = probe_data_new (buffer_update_latency_probe_cb, blv,
       (GDestroyNotify) buffer_latency_values_destroy, NULL, FALSE, NULL, NULL);
@@ -268,12 +308,10 @@ buffer_for_each_meta_cb (GstBuffer * buffer, GstMeta ** meta, ProbeData * pdata)
 
   if (pdata->locked) {
     KMS_BUFFER_LATENCY_DATA_LOCK (blmeta);
-  }
-
-  func (pad, blmeta->type, diff, blmeta->data, pdata->user_data);
-
-  if (pdata->locked) {
+    func (pad, blmeta->type, diff, blmeta, pdata->user_data);
     KMS_BUFFER_LATENCY_DATA_UNLOCK (blmeta);
+  } else {
+    func (pad, blmeta->type, diff, blmeta, pdata->user_data);
   }
 
   return TRUE;
@@ -301,6 +339,90 @@ kms_stats_add_buffer_latency_notification_probe (GstPad * pad,
       process_buffer_probe_cb, pdata, (GDestroyNotify) probe_data_destroy);
 }
 
+typedef struct _BufferLatencyMark
+{
+  GQuark id;
+  KmsRefStruct *data;
+} BufferLatencyMark;
+
+static BufferLatencyMark *
+buffer_latency_mark_new (const gchar * id, KmsRefStruct * data)
+{
+  BufferLatencyMark *blm;
+
+  blm = g_slice_new (BufferLatencyMark);
+
+  blm->id = g_quark_from_string (id);
+  blm->data = data != NULL ? kms_ref_struct_ref (data) : NULL;
+
+  return blm;
+}
+
+static void
+buffer_latency_mark_destroy (BufferLatencyMark * blm)
+{
+  if (blm->data != NULL) {
+    kms_ref_struct_unref (blm->data);
+  }
+
+  g_slice_free (BufferLatencyMark, blm);
+}
+
+static gboolean
+buffer_for_each_meta_mark_cb (GstBuffer * buffer, GstMeta ** meta,
+    ProbeData * pdata)
+{
+  BufferLatencyMark *blm = (BufferLatencyMark *) pdata->invoke_data;
+  KmsBufferLatencyMeta *blmeta;
+
+  if ((*meta)->info->api != KMS_BUFFER_LATENCY_META_API_TYPE) {
+    /* continue iterating */
+    return TRUE;
+  }
+
+  blmeta = (KmsBufferLatencyMeta *) * meta;
+
+  if (!blmeta->valid) {
+    /* Ignore this meta */
+    return TRUE;
+  }
+
+  if (GST_CLOCK_TIME_IS_VALID (kms_buffer_latency_meta_get_mark (blmeta,
+              blm->id))) {
+    GST_WARNING ("Can not mark buffer %" GST_PTR_FORMAT
+        " for latency. Already used ID: %s", buffer,
+        g_quark_to_string (blm->id));
+    return TRUE;
+  }
+
+  kms_buffer_latency_meta_add_mark_full (blmeta, blm->id,
+      kms_utils_get_time_nsecs (), blm->data);
+
+  return TRUE;
+}
+
+static void
+buffer_latency_mark_cb (GstBuffer * buffer, ProbeData * pdata)
+{
+  gst_buffer_foreach_meta (buffer,
+      (GstBufferForeachMetaFunc) buffer_for_each_meta_mark_cb, pdata);
+}
+
+gulong
+kms_stats_add_buffer_latency_mark_probe (GstPad * pad, const gchar * id,
+    KmsRefStruct * data)
+{
+  ProbeData *pdata;
+
+  pdata = probe_data_new (buffer_latency_mark_cb,
+      buffer_latency_mark_new (id, data),
+      (GDestroyNotify) buffer_latency_mark_destroy, NULL, FALSE, NULL, NULL);
+
+  return gst_pad_add_probe (pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      process_buffer_probe_cb, pdata, (GDestroyNotify) probe_data_destroy);
+}
+
 KmsStatsProbe *
 kms_stats_probe_new (GstPad * pad, KmsMediaType type)
 {
@@ -21,6 +21,7 @@
 #include "kmsmediatype.h"
 #include "kmslist.h"
 #include "kmsrefstruct.h"
+#include "kmsbufferlacentymeta.h"
 
 G_BEGIN_DECLS
 
@@ -41,8 +42,19 @@ G_BEGIN_DECLS
 GstStructure * kms_stats_get_element_stats (GstStructure *stats);
 
 /* buffer latency */
-typedef void (*BufferLatencyCallback) (GstPad * pad, KmsMediaType type, GstClockTimeDiff t, KmsList *data, gpointer user_data);
+
+/* meta data can only be used when the callback is locked */
+typedef void (*BufferLatencyCallback) (GstPad * pad, KmsMediaType type, GstClockTimeDiff t, KmsBufferLatencyMeta *meta, gpointer user_data);
+
+/* Only 1 in sampling buffers get a latency meta, 1 by default */
+void kms_stats_set_latency_sampling (guint sampling);
+guint kms_stats_get_latency_sampling (void);
+
 gulong kms_stats_add_buffer_latency_meta_probe (GstPad * pad, gboolean is_valid, KmsMediaType type);
+/* sampling 0 follows kms_stats_set_latency_sampling () */
+gulong kms_stats_add_buffer_latency_meta_probe_full (GstPad * pad, gboolean is_valid, KmsMediaType type, guint sampling);
+/* Marks valid metas with id, the marks hold a reference to data */
+gulong kms_stats_add_buffer_latency_mark_probe (GstPad * pad, const gchar * id, KmsRefStruct * data);
 gulong kms_stats_add_buffer_update_latency_meta_probe (GstPad * pad, gboolean is_valid, KmsMediaType type);
 gulong kms_stats_add_buffer_latency_notification_probe (GstPad * pad, BufferLatencyCallback cb, gboolean locked, gpointer user_data, GDestroyNotify destroy_data);
 
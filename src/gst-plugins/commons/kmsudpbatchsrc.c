@@ -0,0 +1,804 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+/* recvmmsg */
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "kmsudpbatchsrc.h"
+#include "kmsrtpallocator.h"
+#include "kmsioreactor.h"
+
+/* Not exported by old libc headers */
+#ifndef UDP_GRO
+#  define UDP_GRO 104
+#endif
+
+#define GST_DEFAULT_NAME "udpbatchsrc"
+#define GST_CAT_DEFAULT kms_udp_batch_src_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+#define kms_udp_batch_src_parent_class parent_class
+G_DEFINE_TYPE (KmsUdpBatchSrc, kms_udp_batch_src, GST_TYPE_ELEMENT);
+
+#define KMS_UDP_BATCH_SRC_GET_PRIVATE(obj) (  \
+  G_TYPE_INSTANCE_GET_PRIVATE (               \
+    (obj),                                    \
+    KMS_TYPE_UDP_BATCH_SRC,                   \
+    KmsUdpBatchSrcPrivate                     \
+  )                                           \
+)
+
+#define DEFAULT_FD -1
+#define DEFAULT_MAX_PACKETS 32
+#define MAX_MAX_PACKETS 1024
+#define DEFAULT_GRO FALSE
+#define DEFAULT_USE_REACTOR FALSE
+
+/* Biggest datagram the kernel can build when coalescing with GRO */
+#define GRO_BUFFER_SIZE 65535
+#define CONTROL_SIZE CMSG_SPACE (sizeof (gint))
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+enum
+{
+  PROP_0,
+  PROP_FD,
+  PROP_CAPS,
+  PROP_MAX_PACKETS,
+  PROP_GRO,
+  PROP_USE_REACTOR,
+  N_PROPERTIES
+};
+
+struct _KmsUdpBatchSrcPrivate
+{
+  GstPad *srcpad;
+  GstPoll *poll;
+  GstPollFD pollfd;
+
+  gint fd;
+  GstCaps *caps;
+  guint max_packets;
+  gboolean gro;
+  gboolean use_reactor;
+
+  /* Protected by the object lock */
+  guint reactor_id;
+  gboolean running;
+
+  /* Only used from the thread that pushes */
+  gboolean need_events;
+
+  /* Set up while going to PAUSED and only used from the reading thread */
+  gboolean gro_enabled;
+  GstAllocator *allocator;
+  gsize slot_size;
+  guint n_slots;
+  struct mmsghdr *msgs;
+  struct iovec *iovs;
+  GstMemory **mems;
+  GstMapInfo *maps;
+  guint8 *controls;
+};
+
+static void
+kms_udp_batch_src_enable_gro (KmsUdpBatchSrc * self)
+{
+  gint on = 1;
+
+  self->priv->gro_enabled = FALSE;
+
+  if (!self->priv->gro) {
+    return;
+  }
+
+  if (setsockopt (self->priv->fd, IPPROTO_UDP, UDP_GRO, &on, sizeof (on)) < 0) {
+    GST_WARNING_OBJECT (self, "UDP GRO not supported: %s", g_strerror (errno));
+    return;
+  }
+
+  self->priv->gro_enabled = TRUE;
+}
+
+static gboolean
+kms_udp_batch_src_fill_slot (KmsUdpBatchSrc * self, guint i)
+{
+  GstAllocationParams params;
+  GstMemory *mem;
+
+  gst_allocation_params_init (&params);
+  mem = gst_allocator_alloc (self->priv->allocator, self->priv->slot_size,
+      &params);
+  if (mem == NULL) {
+    return FALSE;
+  }
+
+  if (!gst_memory_map (mem, &self->priv->maps[i], GST_MAP_WRITE)) {
+    gst_memory_unref (mem);
+    return FALSE;
+  }
+
+  self->priv->mems[i] = mem;
+  self->priv->iovs[i].iov_base = self->priv->maps[i].data;
+  self->priv->iovs[i].iov_len = self->priv->maps[i].size;
+
+  return TRUE;
+}
+
+static void
+kms_udp_batch_src_release_slots (KmsUdpBatchSrc * self)
+{
+  guint i;
+
+  for (i = 0; i < self->priv->n_slots; i++) {
+    if (self->priv->mems[i] != NULL) {
+      gst_memory_unmap (self->priv->mems[i], &self->priv->maps[i]);
+      gst_memory_unref (self->priv->mems[i]);
+    }
+  }
+
+  g_clear_pointer (&self->priv->msgs, g_free);
+  g_clear_pointer (&self->priv->iovs, g_free);
+  g_clear_pointer (&self->priv->mems, g_free);
+  g_clear_pointer (&self->priv->maps, g_free);
+  g_clear_pointer (&self->priv->controls, g_free);
+  g_clear_object (&self->priv->allocator);
+  self->priv->n_slots = 0;
+}
+
+static void
+kms_udp_batch_src_prepare_slots (KmsUdpBatchSrc * self)
+{
+  guint i;
+
+  GST_OBJECT_LOCK (self);
+  self->priv->n_slots = self->priv->max_packets;
+  GST_OBJECT_UNLOCK (self);
+
+  if (self->priv->gro_enabled) {
+    /* Coalesced datagrams do not fit in RTP chunks */
+    self->priv->allocator = NULL;
+    self->priv->slot_size = GRO_BUFFER_SIZE;
+  } else {
+    self->priv->allocator = kms_rtp_allocator_get_default ();
+    self->priv->slot_size = KMS_RTP_ALLOCATOR_CHUNK_SIZE;
+  }
+
+  self->priv->msgs = g_new0 (struct mmsghdr, self->priv->n_slots);
+  self->priv->iovs = g_new0 (struct iovec, self->priv->n_slots);
+  self->priv->mems = g_new0 (GstMemory *, self->priv->n_slots);
+  self->priv->maps = g_new0 (GstMapInfo, self->priv->n_slots);
+  self->priv->controls = g_malloc0 (CONTROL_SIZE * self->priv->n_slots);
+
+  for (i = 0; i < self->priv->n_slots; i++) {
+    self->priv->msgs[i].msg_hdr.msg_iov = &self->priv->iovs[i];
+    self->priv->msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+}
+
+static GstClockTime
+kms_udp_batch_src_get_running_time (KmsUdpBatchSrc * self)
+{
+  GstClock *clock;
+  GstClockTime now;
+
+  clock = gst_element_get_clock (GST_ELEMENT (self));
+  if (clock == NULL) {
+    return GST_CLOCK_TIME_NONE;
+  }
+
+  now = gst_clock_get_time (clock) -
+      gst_element_get_base_time (GST_ELEMENT (self));
+  gst_object_unref (clock);
+
+  return now;
+}
+
+static void
+kms_udp_batch_src_push_events (KmsUdpBatchSrc * self)
+{
+  GstSegment segment;
+  GstCaps *caps;
+  gchar *stream_id;
+
+  stream_id = gst_pad_create_stream_id (self->priv->srcpad,
+      GST_ELEMENT (self), NULL);
+  gst_pad_push_event (self->priv->srcpad,
+      gst_event_new_stream_start (stream_id));
+  g_free (stream_id);
+
+  GST_OBJECT_LOCK (self);
+  caps = self->priv->caps != NULL ? gst_caps_ref (self->priv->caps) : NULL;
+  GST_OBJECT_UNLOCK (self);
+
+  if (caps != NULL) {
+    gst_pad_push_event (self->priv->srcpad, gst_event_new_caps (caps));
+    gst_caps_unref (caps);
+  }
+
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (self->priv->srcpad, gst_event_new_segment (&segment));
+}
+
+static void
+kms_udp_batch_src_add_datagram (KmsUdpBatchSrc * self, guint i,
+    GstBufferList * list, GstClockTime timestamp)
+{
+  struct msghdr *hdr = &self->priv->msgs[i].msg_hdr;
+  gsize len = self->priv->msgs[i].msg_len;
+  GstMemory *mem = self->priv->mems[i];
+  struct cmsghdr *cmsg;
+  GstBuffer *buffer;
+  gint segment_size = 0;
+  gsize offset;
+
+  gst_memory_unmap (mem, &self->priv->maps[i]);
+  self->priv->mems[i] = NULL;
+
+  if (hdr->msg_flags & MSG_TRUNC) {
+    GST_WARNING_OBJECT (self, "Dropping truncated datagram");
+    gst_memory_unref (mem);
+    return;
+  }
+
+  if (len == 0) {
+    gst_memory_unref (mem);
+    return;
+  }
+
+  for (cmsg = CMSG_FIRSTHDR (hdr); cmsg != NULL;
+      cmsg = CMSG_NXTHDR (hdr, cmsg)) {
+    if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO) {
+      memcpy (&segment_size, CMSG_DATA (cmsg), sizeof (segment_size));
+    }
+  }
+
+  gst_memory_resize (mem, 0, len);
+  buffer = gst_buffer_new ();
+  gst_buffer_append_memory (buffer, mem);
+  GST_BUFFER_DTS (buffer) = timestamp;
+  GST_BUFFER_PTS (buffer) = timestamp;
+
+  if (segment_size <= 0 || len <= (gsize) segment_size) {
+    gst_buffer_list_add (list, buffer);
+    return;
+  }
+
+  /* Split coalesced datagrams, sharing the received memory */
+  for (offset = 0; offset < len; offset += segment_size) {
+    GstBuffer *segment;
+
+    segment = gst_buffer_copy_region (buffer, GST_BUFFER_COPY_MEMORY, offset,
+        MIN (segment_size, len - offset));
+    GST_BUFFER_DTS (segment) = timestamp;
+    GST_BUFFER_PTS (segment) = timestamp;
+    gst_buffer_list_add (list, segment);
+  }
+
+  gst_buffer_unref (buffer);
+}
+
+/* Reads one batch into list. Returns FALSE when reading must stop */
+static gboolean
+kms_udp_batch_src_read (KmsUdpBatchSrc * self, GstBufferList ** list)
+{
+  GstClockTime timestamp;
+  gint i, n;
+
+  *list = NULL;
+
+  for (i = 0; i < self->priv->n_slots; i++) {
+    struct msghdr *hdr = &self->priv->msgs[i].msg_hdr;
+
+    if (self->priv->mems[i] == NULL && !kms_udp_batch_src_fill_slot (self, i)) {
+      GST_ELEMENT_ERROR (self, RESOURCE, NO_SPACE_LEFT, (NULL),
+          ("Cannot allocate receive buffers"));
+      return FALSE;
+    }
+
+    hdr->msg_control = self->priv->controls + i * CONTROL_SIZE;
+    hdr->msg_controllen = CONTROL_SIZE;
+    hdr->msg_flags = 0;
+  }
+
+  n = recvmmsg (self->priv->fd, self->priv->msgs, self->priv->n_slots,
+      MSG_DONTWAIT, NULL);
+  if (n < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR
+        || errno == ECONNREFUSED) {
+      /* ICMP errors of connected sockets are not fatal */
+      return TRUE;
+    }
+
+    GST_ELEMENT_ERROR (self, RESOURCE, READ, (NULL),
+        ("recvmmsg failed: %s", g_strerror (errno)));
+    return FALSE;
+  }
+
+  timestamp = kms_udp_batch_src_get_running_time (self);
+  *list = gst_buffer_list_new_sized (n);
+
+  for (i = 0; i < n; i++) {
+    kms_udp_batch_src_add_datagram (self, i, *list, timestamp);
+  }
+
+  if (gst_buffer_list_length (*list) == 0) {
+    gst_buffer_list_unref (*list);
+    *list = NULL;
+  }
+
+  return TRUE;
+}
+
+/* Pushes list from the streaming or the reactor thread. Returns FALSE when
+ * pushing must stop */
+static gboolean
+kms_udp_batch_src_push (KmsUdpBatchSrc * self, GstBufferList * list)
+{
+  GstFlowReturn ret;
+
+  if (self->priv->need_events) {
+    kms_udp_batch_src_push_events (self);
+    self->priv->need_events = FALSE;
+  }
+
+  GST_LOG_OBJECT (self, "Pushing %u packets read in one call",
+      gst_buffer_list_length (list));
+
+  ret = gst_pad_push_list (self->priv->srcpad, list);
+  if (ret == GST_FLOW_OK) {
+    return TRUE;
+  }
+
+  if (ret == GST_FLOW_NOT_LINKED || ret < GST_FLOW_EOS) {
+    GST_ELEMENT_ERROR (self, STREAM, FAILED, ("Internal data flow error."),
+        ("streaming task paused, reason %s (%d)", gst_flow_get_name (ret),
+            ret));
+  } else {
+    GST_DEBUG_OBJECT (self, "Pausing task, reason %s", gst_flow_get_name (ret));
+  }
+
+  return FALSE;
+}
+
+static void
+kms_udp_batch_src_loop (KmsUdpBatchSrc * self)
+{
+  GstBufferList *list;
+
+  if (gst_poll_wait (self->priv->poll, GST_CLOCK_TIME_NONE) < 0) {
+    if (errno == EBUSY) {
+      GST_DEBUG_OBJECT (self, "Flushing");
+      goto pause;
+    } else if (errno == EAGAIN || errno == EINTR) {
+      return;
+    }
+
+    GST_ELEMENT_ERROR (self, RESOURCE, READ, (NULL),
+        ("Poll failed: %s", g_strerror (errno)));
+    goto pause;
+  }
+
+  if (!kms_udp_batch_src_read (self, &list)) {
+    goto pause;
+  }
+
+  if (list == NULL || kms_udp_batch_src_push (self, list)) {
+    return;
+  }
+
+pause:
+  gst_pad_pause_task (self->priv->srcpad);
+}
+
+/* Must be called from the reactor callback with the object lock held */
+static void
+kms_udp_batch_src_leave_reactor (KmsUdpBatchSrc * self)
+{
+  if (self->priv->reactor_id == 0) {
+    /* Already being removed when deactivating */
+    return;
+  }
+
+  /* Does not wait as it is called from the callback itself */
+  kms_io_reactor_remove (kms_io_reactor_get_default (),
+      self->priv->reactor_id);
+  self->priv->reactor_id = 0;
+}
+
+static gboolean
+kms_udp_batch_src_reactor_cb (gint fd, gpointer user_data)
+{
+  KmsUdpBatchSrc *self = KMS_UDP_BATCH_SRC (user_data);
+  GstBufferList *list;
+
+  GST_OBJECT_LOCK (self);
+  if (!self->priv->running) {
+    /* Paused: leave the datagrams in the socket until the next start */
+    kms_udp_batch_src_leave_reactor (self);
+    GST_OBJECT_UNLOCK (self);
+    return FALSE;
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  /* One batch per call, so sockets served by the same thread take turns */
+  if (kms_udp_batch_src_read (self, &list)
+      && (list == NULL || kms_udp_batch_src_push (self, list))) {
+    return TRUE;
+  }
+
+  GST_OBJECT_LOCK (self);
+  kms_udp_batch_src_leave_reactor (self);
+  GST_OBJECT_UNLOCK (self);
+
+  return FALSE;
+}
+
+static void
+kms_udp_batch_src_start (KmsUdpBatchSrc * self)
+{
+  GST_OBJECT_LOCK (self);
+  if (self->priv->running) {
+    GST_OBJECT_UNLOCK (self);
+    return;
+  }
+  self->priv->running = TRUE;
+
+  if (self->priv->use_reactor) {
+    /* Received lists are pushed from the reactor callback, no task needed.
+     * It may still be watching the socket since the last pause */
+    if (self->priv->reactor_id == 0) {
+      self->priv->reactor_id = kms_io_reactor_add_fd
+          (kms_io_reactor_get_default (), self->priv->fd,
+          kms_udp_batch_src_reactor_cb, self, NULL);
+    }
+    GST_OBJECT_UNLOCK (self);
+    return;
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  gst_poll_set_flushing (self->priv->poll, FALSE);
+  gst_pad_start_task (self->priv->srcpad,
+      (GstTaskFunction) kms_udp_batch_src_loop, self, NULL);
+}
+
+/* Stops reading. A reactor callback that is pushing is not waited for, as
+ * downstream may block until the pipeline is playing again */
+static void
+kms_udp_batch_src_stop (KmsUdpBatchSrc * self)
+{
+  GST_OBJECT_LOCK (self);
+  self->priv->running = FALSE;
+  GST_OBJECT_UNLOCK (self);
+
+  gst_poll_set_flushing (self->priv->poll, TRUE);
+  gst_pad_pause_task (self->priv->srcpad);
+}
+
+static gboolean
+kms_udp_batch_src_activate_mode (GstPad * pad, GstObject * parent,
+    GstPadMode mode, gboolean active)
+{
+  KmsUdpBatchSrc *self = KMS_UDP_BATCH_SRC (parent);
+  guint reactor_id;
+
+  if (mode != GST_PAD_MODE_PUSH) {
+    return FALSE;
+  }
+
+  if (active) {
+    self->priv->need_events = TRUE;
+    return TRUE;
+  }
+
+  kms_udp_batch_src_stop (self);
+
+  GST_OBJECT_LOCK (self);
+  reactor_id = self->priv->reactor_id;
+  self->priv->reactor_id = 0;
+  GST_OBJECT_UNLOCK (self);
+
+  if (reactor_id != 0) {
+    /* The pad is flushing, so a running callback returns soon */
+    kms_io_reactor_remove (kms_io_reactor_get_default (), reactor_id);
+  }
+
+  return gst_pad_stop_task (pad);
+}
+static gboolean
+kms_udp_batch_src_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  KmsUdpBatchSrc *self = KMS_UDP_BATCH_SRC (parent);
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_LATENCY:
+      gst_query_set_latency (query, TRUE, 0, GST_CLOCK_TIME_NONE);
+      return TRUE;
+    case GST_QUERY_CAPS:{
+      GstCaps *filter, *caps;
+
+      GST_OBJECT_LOCK (self);
+      caps = self->priv->caps != NULL ? gst_caps_ref (self->priv->caps) :
+          gst_caps_new_any ();
+      GST_OBJECT_UNLOCK (self);
+
+      gst_query_parse_caps (query, &filter);
+      if (filter != NULL) {
+        GstCaps *intersection;
+
+        intersection = gst_caps_intersect_full (filter, caps,
+            GST_CAPS_INTERSECT_FIRST);
+        gst_caps_unref (caps);
+        caps = intersection;
+      }
+
+      gst_query_set_caps_result (query, caps);
+      gst_caps_unref (caps);
+      return TRUE;
+    }
+    default:
+      return gst_pad_query_default (pad, parent, query);
+  }
+}
+
+static GstStateChangeReturn
+kms_udp_batch_src_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  KmsUdpBatchSrc *self = KMS_UDP_BATCH_SRC (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_NULL_TO_READY:
+      GST_OBJECT_LOCK (self);
+      if (self->priv->fd < 0) {
+        GST_OBJECT_UNLOCK (self);
+        GST_ELEMENT_ERROR (self, RESOURCE, OPEN_READ, (NULL),
+            ("No socket configured"));
+        return GST_STATE_CHANGE_FAILURE;
+      }
+      GST_OBJECT_UNLOCK (self);
+
+      gst_poll_fd_init (&self->priv->pollfd);
+      self->priv->pollfd.fd = self->priv->fd;
+      gst_poll_add_fd (self->priv->poll, &self->priv->pollfd);
+      gst_poll_fd_ctl_read (self->priv->poll, &self->priv->pollfd, TRUE);
+      kms_udp_batch_src_enable_gro (self);
+      break;
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      kms_udp_batch_src_prepare_slots (self);
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
+      kms_udp_batch_src_start (self);
+      break;
+    case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+      kms_udp_batch_src_stop (self);
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE) {
+    return ret;
+  }
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+    case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+      /* Live source */
+      ret = GST_STATE_CHANGE_NO_PREROLL;
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      /* Task was stopped when deactivating the pad */
+      kms_udp_batch_src_release_slots (self);
+      break;
+    case GST_STATE_CHANGE_READY_TO_NULL:
+      gst_poll_remove_fd (self->priv->poll, &self->priv->pollfd);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+static void
+kms_udp_batch_src_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  KmsUdpBatchSrc *self = KMS_UDP_BATCH_SRC (object);
+
+  GST_OBJECT_LOCK (self);
+
+  switch (property_id) {
+    case PROP_FD:
+      self->priv->fd = g_value_get_int (value);
+      break;
+    case PROP_CAPS:
+      gst_caps_replace (&self->priv->caps, g_value_get_boxed (value));
+      break;
+    case PROP_MAX_PACKETS:
+      self->priv->max_packets = g_value_get_uint (value);
+      break;
+    case PROP_GRO:
+      self->priv->gro = g_value_get_boolean (value);
+      break;
+    case PROP_USE_REACTOR:
+      self->priv->use_reactor = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+
+  GST_OBJECT_UNLOCK (self);
+}
+
+static void
+kms_udp_batch_src_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  KmsUdpBatchSrc *self = KMS_UDP_BATCH_SRC (object);
+
+  GST_OBJECT_LOCK (self);
+
+  switch (property_id) {
+    case PROP_FD:
+      g_value_set_int (value, self->priv->fd);
+      break;
+    case PROP_CAPS:
+      g_value_set_boxed (value, self->priv->caps);
+      break;
+    case PROP_MAX_PACKETS:
+      g_value_set_uint (value, self->priv->max_packets);
+      break;
+    case PROP_GRO:
+      g_value_set_boolean (value, self->priv->gro);
+      break;
+    case PROP_USE_REACTOR:
+      g_value_set_boolean (value, self->priv->use_reactor);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+
+  GST_OBJECT_UNLOCK (self);
+}
+
+static void
+kms_udp_batch_src_finalize (GObject * object)
+{
+  KmsUdpBatchSrc *self = KMS_UDP_BATCH_SRC (object);
+
+  kms_udp_batch_src_release_slots (self);
+  gst_caps_replace (&self->priv->caps, NULL);
+  gst_poll_free (self->priv->poll);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+kms_udp_batch_src_class_init (KmsUdpBatchSrcClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+
+  gobject_class->finalize = kms_udp_batch_src_finalize;
+  gobject_class->set_property = kms_udp_batch_src_set_property;
+  gobject_class->get_property = kms_udp_batch_src_get_property;
+
+  gstelement_class->change_state = kms_udp_batch_src_change_state;
+
+  gst_element_class_set_details_simple (gstelement_class,
+      "UDP batch source",
+      "Source/Network",
+      "Reads UDP datagrams in batches and pushes them as buffer lists",
+      "Kurento <kurento@googlegroups.com>");
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&src_template));
+
+  g_object_class_install_property (gobject_class, PROP_FD,
+      g_param_spec_int ("fd", "File descriptor",
+          "Bound UDP socket to read from. It is not closed by the element",
+          -1, G_MAXINT, DEFAULT_FD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_CAPS,
+      g_param_spec_boxed ("caps", "Caps", "Caps of the received packets",
+          GST_TYPE_CAPS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_PACKETS,
+      g_param_spec_uint ("max-packets", "Maximum packets",
+          "Maximum number of datagrams read per system call (used from the "
+          "next start)", 1, MAX_MAX_PACKETS, DEFAULT_MAX_PACKETS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_GRO,
+      g_param_spec_boolean ("gro", "Generic receive offload",
+          "Let the kernel coalesce datagrams of the same flow (UDP_GRO)",
+          DEFAULT_GRO, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_USE_REACTOR,
+      g_param_spec_boolean ("use-reactor", "Use reactor",
+          "Read from the threads of the process-wide I/O reactor instead "
+          "of polling in a streaming thread of its own, pushing from them",
+          DEFAULT_USE_REACTOR, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+
+  g_type_class_add_private (klass, sizeof (KmsUdpBatchSrcPrivate));
+}
+
+static void
+kms_udp_batch_src_init (KmsUdpBatchSrc * self)
+{
+  self->priv = KMS_UDP_BATCH_SRC_GET_PRIVATE (self);
+
+  self->priv->srcpad = gst_pad_new_from_static_template (&src_template,
+      "src");
+  gst_pad_set_activatemode_function (self->priv->srcpad,
+      GST_DEBUG_FUNCPTR (kms_udp_batch_src_activate_mode));
+  gst_pad_set_query_function (self->priv->srcpad,
+      GST_DEBUG_FUNCPTR (kms_udp_batch_src_query));
+  gst_element_add_pad (GST_ELEMENT (self), self->priv->srcpad);
+
+  GST_OBJECT_FLAG_SET (self, GST_ELEMENT_FLAG_SOURCE);
+
+  self->priv->poll = gst_poll_new (TRUE);
+  self->priv->fd = DEFAULT_FD;
+  self->priv->max_packets = DEFAULT_MAX_PACKETS;
+  self->priv->gro = DEFAULT_GRO;
+  self->priv->use_reactor = DEFAULT_USE_REACTOR;
+}
+
+/**
+ * kms_udp_batch_src_new:
+ * @fd: bound UDP socket
+ * @caps: (allow-none): caps of the received packets
+ *
+ * Returns: (transfer floating): a new #KmsUdpBatchSrc
+ */
+GstElement *
+kms_udp_batch_src_new (gint fd, GstCaps * caps)
+{
+  return g_object_new (KMS_TYPE_UDP_BATCH_SRC, "fd", fd, "caps", caps, NULL);
+}
+
+gboolean
+kms_udp_batch_src_plugin_init (GstPlugin * plugin)
+{
+  return gst_element_register (plugin, GST_DEFAULT_NAME, GST_RANK_NONE,
+      KMS_TYPE_UDP_BATCH_SRC);
+}
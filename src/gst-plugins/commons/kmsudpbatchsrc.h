@@ -0,0 +1,73 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_UDP_BATCH_SRC_H__
+#define __KMS_UDP_BATCH_SRC_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define KMS_TYPE_UDP_BATCH_SRC \
+  (kms_udp_batch_src_get_type())
+#define KMS_UDP_BATCH_SRC(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),KMS_TYPE_UDP_BATCH_SRC,KmsUdpBatchSrc))
+#define KMS_UDP_BATCH_SRC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),KMS_TYPE_UDP_BATCH_SRC,KmsUdpBatchSrcClass))
+#define KMS_IS_UDP_BATCH_SRC(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),KMS_TYPE_UDP_BATCH_SRC))
+#define KMS_IS_UDP_BATCH_SRC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),KMS_TYPE_UDP_BATCH_SRC))
+
+typedef struct _KmsUdpBatchSrc KmsUdpBatchSrc;
+typedef struct _KmsUdpBatchSrcClass KmsUdpBatchSrcClass;
+typedef struct _KmsUdpBatchSrcPrivate KmsUdpBatchSrcPrivate;
+
+/**
+ * KmsUdpBatchSrc:
+ *
+ * Live source reading RTP or RTCP datagrams from an already bound UDP
+ * socket. Up to "max-packets" datagrams are read with a single recvmmsg
+ * call into memory of the RTP allocator and pushed downstream as one
+ * GstBufferList. With "gro" the kernel may also coalesce datagrams of the
+ * same flow, which are split again before pushing. With "use-reactor" the
+ * socket is read from the shared I/O reactor, whose threads also push the
+ * lists, so the element needs no streaming thread. Registered by kmscore as
+ * "udpbatchsrc", so KmsIRtpConnection implementations and pipelines can
+ * create it by name instead of udpsrc.
+ */
+struct _KmsUdpBatchSrc
+{
+  GstElement parent;
+
+  KmsUdpBatchSrcPrivate *priv;
+};
+
+struct _KmsUdpBatchSrcClass
+{
+  GstElementClass parent_class;
+};
+
+GType kms_udp_batch_src_get_type (void);
+
+GstElement * kms_udp_batch_src_new (gint fd, GstCaps * caps);
+
+gboolean kms_udp_batch_src_plugin_init (GstPlugin * plugin);
+
+G_END_DECLS
+
+#endif /* __KMS_UDP_BATCH_SRC_H__ */
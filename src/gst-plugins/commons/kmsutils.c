@@ -18,6 +18,7 @@
 #include "kmsutils.h"
 #include "constants.h"
 #include "kmsagnosticcaps.h"
+#include "kmskeyframecoordinator.h"
 #include <gst/video/video-event.h>
 #include <uuid/uuid.h>
 #include <string.h>
@@ -26,13 +27,10 @@
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 #define GST_DEFAULT_NAME "kmsutils"
 
-#define LAST_KEY_FRAME_REQUEST_TIME "last-key-frame-request-time"
-G_DEFINE_QUARK (LAST_KEY_FRAME_REQUEST_TIME, last_key_frame_request_time);
-
 #define KMS_KEY_ID "kms-key-id"
 G_DEFINE_QUARK (KMS_KEY_ID, kms_key_id);
 
-#define DEFAULT_KEYFRAME_DISPERSION GST_SECOND  /* 1s */
+#define DEFAULT_KEYFRAME_DISPERSION KMS_KEYFRAME_COORDINATOR_DEFAULT_WINDOW
 
 #define UUID_STR_SIZE 37        /* 36-byte string (plus tailing '\0') */
 #define BEGIN_CERTIFICATE "-----BEGIN CERTIFICATE-----"
@@ -113,65 +111,200 @@ static GstStaticCaps static_audio_caps =
 GST_STATIC_CAPS (KMS_AGNOSTIC_AUDIO_CAPS);
 static GstStaticCaps static_video_caps =
 GST_STATIC_CAPS (KMS_AGNOSTIC_VIDEO_CAPS);
-static GstStaticCaps static_rtp_caps = GST_STATIC_CAPS (KMS_AGNOSTIC_RTP_CAPS);
-static GstStaticCaps static_raw_caps =
-    GST_STATIC_CAPS
-    ("video/x-raw; video/x-raw(ANY); audio/x-raw; audio/x-raw(ANY);");
+
+/* Media caps are only checked by structure name, except for the few entries
+ * of agnostic caps that constrain some field */
+#define CAPS_NAME_ANY_FIELDS 1
+#define CAPS_NAME_SOME_FIELDS 2
+
+typedef struct _KmsCapsNames
+{
+  GstCaps *caps;
+  /* Structure name quark -> CAPS_NAME_* */
+  GHashTable *names;
+} KmsCapsNames;
+
+typedef struct _KmsCapsClassifier
+{
+  KmsCapsNames audio;
+  KmsCapsNames video;
+  GQuark audio_raw;
+  GQuark video_raw;
+  GQuark rtp;
+} KmsCapsClassifier;
+
+static void
+kms_caps_names_init (KmsCapsNames * names, GstStaticCaps * static_caps)
+{
+  guint i;
+
+  names->caps = gst_static_caps_get (static_caps);
+  names->names = g_hash_table_new (NULL, NULL);
+
+  for (i = 0; i < gst_caps_get_size (names->caps); i++) {
+    GstStructure *st = gst_caps_get_structure (names->caps, i);
+    gpointer key = GUINT_TO_POINTER (gst_structure_get_name_id (st));
+
+    if (GPOINTER_TO_INT (g_hash_table_lookup (names->names, key)) ==
+        CAPS_NAME_ANY_FIELDS) {
+      continue;
+    }
+
+    g_hash_table_insert (names->names, key,
+        GINT_TO_POINTER (gst_structure_n_fields (st) == 0 ?
+            CAPS_NAME_ANY_FIELDS : CAPS_NAME_SOME_FIELDS));
+  }
+}
+
+static gpointer
+kms_caps_classifier_new (gpointer data)
+{
+  KmsCapsClassifier *classifier = g_slice_new0 (KmsCapsClassifier);
+
+  kms_caps_names_init (&classifier->audio, &static_audio_caps);
+  kms_caps_names_init (&classifier->video, &static_video_caps);
+  classifier->audio_raw = g_quark_from_static_string ("audio/x-raw");
+  classifier->video_raw = g_quark_from_static_string ("video/x-raw");
+  classifier->rtp = g_quark_from_static_string ("application/x-rtp");
+
+  return classifier;
+}
+
+static KmsCapsClassifier *
+kms_caps_classifier_get (void)
+{
+  static GOnce once = G_ONCE_INIT;
+
+  g_once (&once, kms_caps_classifier_new, NULL);
+
+  return once.retval;
+}
 
 static gboolean
-caps_can_intersect_with_static (const GstCaps * caps,
-    GstStaticCaps * static_caps)
+features_are_system_memory (GstCapsFeatures * features)
 {
-  GstCaps *aux;
-  gboolean ret;
+  return features == NULL
+      || gst_caps_features_is_equal (features,
+      GST_CAPS_FEATURES_MEMORY_SYSTEM_MEMORY);
+}
 
-  if (caps == NULL) {
+static gboolean
+kms_caps_names_match (KmsCapsNames * names, GstStructure * st,
+    GstCapsFeatures * features)
+{
+  GQuark name = gst_structure_get_name_id (st);
+  guint i;
+
+  /* Agnostic caps only use system memory */
+  if (!features_are_system_memory (features)
+      && !gst_caps_features_is_any (features)) {
     return FALSE;
   }
 
-  aux = gst_static_caps_get (static_caps);
-  ret = gst_caps_can_intersect (caps, aux);
-  gst_caps_unref (aux);
+  switch (GPOINTER_TO_INT (g_hash_table_lookup (names->names,
+              GUINT_TO_POINTER (name)))) {
+    case CAPS_NAME_ANY_FIELDS:
+      return TRUE;
+    case CAPS_NAME_SOME_FIELDS:
+      break;
+    default:
+      return FALSE;
+  }
+
+  for (i = 0; i < gst_caps_get_size (names->caps); i++) {
+    GstStructure *aux = gst_caps_get_structure (names->caps, i);
 
-  return ret;
+    if (gst_structure_get_name_id (aux) == name
+        && gst_structure_can_intersect (st, aux)) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/**
+ * kms_utils_caps_classify:
+ * @caps: (allow-none): caps to check
+ *
+ * Classifies @caps against agnostic caps without intersecting them. Audio
+ * and video are set when some structure can intersect with them, raw and
+ * RTP when every structure is a subset of them, like the kms_utils_caps_are_*
+ * functions.
+ */
+KmsCapsClass
+kms_utils_caps_classify (const GstCaps * caps)
+{
+  KmsCapsClassifier *classifier;
+  KmsCapsClass any = 0, all = KMS_CAPS_CLASS_RAW | KMS_CAPS_CLASS_RTP;
+  guint i, n;
+
+  if (caps == NULL) {
+    return 0;
+  }
+
+  if (gst_caps_is_any (caps)) {
+    return KMS_CAPS_CLASS_AUDIO | KMS_CAPS_CLASS_VIDEO;
+  }
+
+  n = gst_caps_get_size (caps);
+  if (n == 0) {
+    return 0;
+  }
+
+  classifier = kms_caps_classifier_get ();
+
+  for (i = 0; i < n; i++) {
+    GstStructure *st = gst_caps_get_structure (caps, i);
+    GstCapsFeatures *features = gst_caps_get_features (caps, i);
+    GQuark name = gst_structure_get_name_id (st);
+    KmsCapsClass flags = 0;
+
+    if (kms_caps_names_match (&classifier->audio, st, features)) {
+      flags |= KMS_CAPS_CLASS_AUDIO;
+    }
+
+    if (kms_caps_names_match (&classifier->video, st, features)) {
+      flags |= KMS_CAPS_CLASS_VIDEO;
+    }
+
+    if (name == classifier->audio_raw || name == classifier->video_raw) {
+      flags |= KMS_CAPS_CLASS_RAW;
+    }
+
+    if (name == classifier->rtp && features_are_system_memory (features)) {
+      flags |= KMS_CAPS_CLASS_RTP;
+    }
+
+    any |= flags;
+    all &= flags;
+  }
+
+  return (any & (KMS_CAPS_CLASS_AUDIO | KMS_CAPS_CLASS_VIDEO)) | all;
 }
 
 gboolean
 kms_utils_caps_are_audio (const GstCaps * caps)
 {
-  return caps_can_intersect_with_static (caps, &static_audio_caps);
+  return (kms_utils_caps_classify (caps) & KMS_CAPS_CLASS_AUDIO) != 0;
 }
 
 gboolean
 kms_utils_caps_are_video (const GstCaps * caps)
 {
-  return caps_can_intersect_with_static (caps, &static_video_caps);
+  return (kms_utils_caps_classify (caps) & KMS_CAPS_CLASS_VIDEO) != 0;
 }
 
 gboolean
 kms_utils_caps_are_raw (const GstCaps * caps)
 {
-  gboolean ret;
-  GstCaps *raw_caps = gst_static_caps_get (&static_raw_caps);
-
-  ret = gst_caps_is_always_compatible (caps, raw_caps);
-
-  gst_caps_unref (raw_caps);
-
-  return ret;
+  return (kms_utils_caps_classify (caps) & KMS_CAPS_CLASS_RAW) != 0;
 }
 
 gboolean
 kms_utils_caps_are_rtp (const GstCaps * caps)
 {
-  gboolean ret;
-  GstCaps *raw_caps = gst_static_caps_get (&static_rtp_caps);
-
-  ret = gst_caps_is_always_compatible (caps, raw_caps);
-
-  gst_caps_unref (raw_caps);
-
-  return ret;
+  return (kms_utils_caps_classify (caps) & KMS_CAPS_CLASS_RTP) != 0;
 }
 
 /* Caps end */
@@ -460,70 +593,10 @@ kms_utils_manage_gaps (GstPad * pad)
       gap_detection_probe, NULL, NULL);
 }
 
-static gboolean
-check_last_request_time (GstPad * pad)
-{
-  GstClockTime *last, now;
-  GstClock *clock;
-  GstElement *element = gst_pad_get_parent_element (pad);
-  gboolean ret = FALSE;
-
-  if (element == NULL) {
-    GST_ERROR_OBJECT (pad, "Cannot get parent object to get clock");
-    return TRUE;
-  }
-
-  clock = gst_element_get_clock (element);
-  now = gst_clock_get_time (clock);
-  g_object_unref (clock);
-  g_object_unref (element);
-
-  GST_OBJECT_LOCK (pad);
-
-  last =
-      g_object_get_qdata (G_OBJECT (pad), last_key_frame_request_time_quark ());
-
-  if (last == NULL) {
-    last = g_slice_new (GstClockTime);
-    g_object_set_qdata_full (G_OBJECT (pad),
-        last_key_frame_request_time_quark (), last,
-        (GDestroyNotify) kms_utils_destroy_GstClockTime);
-
-    *last = now;
-    ret = TRUE;
-  } else if (((*last) + DEFAULT_KEYFRAME_DISPERSION) < now) {
-    ret = TRUE;
-    *last = now;
-  }
-
-  GST_OBJECT_UNLOCK (pad);
-
-  return ret;
-}
-
-static GstPadProbeReturn
-control_duplicates (GstPad * pad, GstPadProbeInfo * info, gpointer data)
-{
-  GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
-
-  if (gst_video_event_is_force_key_unit (event)) {
-    if (check_last_request_time (pad)) {
-      GST_TRACE_OBJECT (pad, "Sending keyframe request");
-      return GST_PAD_PROBE_OK;
-    } else {
-      GST_TRACE_OBJECT (pad, "Dropping keyframe request");
-      return GST_PAD_PROBE_DROP;
-    }
-  }
-
-  return GST_PAD_PROBE_OK;
-}
-
 void
 kms_utils_control_key_frames_request_duplicates (GstPad * pad)
 {
-  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM, control_duplicates,
-      NULL, NULL);
+  kms_keyframe_coordinator_attach (pad, DEFAULT_KEYFRAME_DISPERSION);
 }
 
 static gboolean
@@ -765,10 +838,11 @@ struct _RembEventManager
 {
   GMutex mutex;
   guint remb_min;
-  GHashTable *remb_hash;
+  GHashTable *remb_hash;        /* <ssrc, RembEntry> */
+  GPtrArray *remb_heap;         /* min-heap of RembEntry by bitrate */
+  GQueue remb_queue;            /* RembEntry sorted by last update time */
   GstPad *pad;
   gulong probe_id;
-  GstClockTime oldest_remb_time;
   GstClockTime clear_interval;
 
   /* Callback */
@@ -777,34 +851,115 @@ struct _RembEventManager
   GDestroyNotify user_data_destroy;
 };
 
-typedef struct _RembHashValue
+typedef struct _RembEntry
 {
+  guint ssrc;
   guint bitrate;
   GstClockTime ts;
-} RembHashValue;
+  guint heap_index;
+  GList link;
+} RembEntry;
 
-static RembHashValue *
-remb_hash_value_create (guint bitrate)
+static RembEntry *
+remb_entry_create (guint ssrc)
 {
-  RembHashValue *value = g_slice_new0 (RembHashValue);
+  RembEntry *entry = g_slice_new0 (RembEntry);
 
-  value->bitrate = bitrate;
-  value->ts = kms_utils_get_time_nsecs ();
+  entry->ssrc = ssrc;
+  entry->link.data = entry;
 
-  return value;
+  return entry;
 }
 
 static void
-remb_hash_value_destroy (gpointer value)
+remb_entry_destroy (gpointer entry)
 {
-  g_slice_free (RembHashValue, value);
+  g_slice_free (RembEntry, entry);
+}
+
+#define REMB_HEAP_ENTRY(manager, i) \
+  ((RembEntry *) g_ptr_array_index ((manager)->remb_heap, (i)))
+
+static void
+remb_heap_set (RembEventManager * manager, guint i, RembEntry * entry)
+{
+  g_ptr_array_index (manager->remb_heap, i) = entry;
+  entry->heap_index = i;
+}
+
+static void
+remb_heap_sift_up (RembEventManager * manager, guint i)
+{
+  RembEntry *entry = REMB_HEAP_ENTRY (manager, i);
+
+  while (i > 0) {
+    guint parent = (i - 1) / 2;
+    RembEntry *p = REMB_HEAP_ENTRY (manager, parent);
+
+    if (p->bitrate <= entry->bitrate) {
+      break;
+    }
+
+    remb_heap_set (manager, i, p);
+    i = parent;
+  }
+
+  remb_heap_set (manager, i, entry);
+}
+
+static void
+remb_heap_sift_down (RembEventManager * manager, guint i)
+{
+  RembEntry *entry = REMB_HEAP_ENTRY (manager, i);
+  guint len = manager->remb_heap->len;
+
+  for (;;) {
+    guint child = 2 * i + 1;
+    RembEntry *c;
+
+    if (child >= len) {
+      break;
+    }
+
+    if (child + 1 < len && REMB_HEAP_ENTRY (manager, child + 1)->bitrate <
+        REMB_HEAP_ENTRY (manager, child)->bitrate) {
+      child++;
+    }
+
+    c = REMB_HEAP_ENTRY (manager, child);
+    if (entry->bitrate <= c->bitrate) {
+      break;
+    }
+
+    remb_heap_set (manager, i, c);
+    i = child;
+  }
+
+  remb_heap_set (manager, i, entry);
+}
+
+static void
+remb_heap_remove (RembEventManager * manager, RembEntry * entry)
+{
+  guint i = entry->heap_index, last = manager->remb_heap->len - 1;
+
+  if (i != last) {
+    remb_heap_set (manager, i, REMB_HEAP_ENTRY (manager, last));
+  }
+
+  g_ptr_array_set_size (manager->remb_heap, last);
+
+  if (i < last) {
+    remb_heap_sift_down (manager, i);
+    remb_heap_sift_up (manager, i);
+  }
 }
 
 static void
 remb_event_manager_set_min (RembEventManager * manager, guint min)
 {
   if (manager->remb_min != min) {
-    manager->remb_min = min;
+    g_atomic_int_set (&manager->remb_min, min);
 
     if (manager->callback) {
       // TODO: Think about having a threshold to not notify in excess
@@ -813,42 +968,37 @@ remb_event_manager_set_min (RembEventManager * manager, guint min)
   }
 }
 
+/* Entries are sorted by update time, so only the expired ones are visited */
 static void
-remb_event_manager_calc_min (RembEventManager * manager, guint default_min)
+remb_event_manager_clear_old (RembEventManager * manager, GstClockTime time)
 {
-  guint remb_min = 0;
-  GstClockTime time = kms_utils_get_time_nsecs ();
-  GstClockTime oldest_time = GST_CLOCK_TIME_NONE;
-  GHashTableIter iter;
-  gpointer key, v;
-
-  g_hash_table_iter_init (&iter, manager->remb_hash);
-  while (g_hash_table_iter_next (&iter, &key, &v)) {
-    guint br = ((RembHashValue *) v)->bitrate;
-    GstClockTime ts = ((RembHashValue *) v)->ts;
-
-    if (time - ts > manager->clear_interval) {
-      GST_TRACE ("Remove entry %" G_GUINT32_FORMAT, GPOINTER_TO_UINT (key));
-      g_hash_table_iter_remove (&iter);
-      continue;
-    }
+  GList *l;
 
-    if (remb_min == 0) {
-      remb_min = br;
-    } else {
-      remb_min = MIN (remb_min, br);
+  while ((l = g_queue_peek_head_link (&manager->remb_queue)) != NULL) {
+    RembEntry *entry = l->data;
+
+    if (time - entry->ts <= manager->clear_interval) {
+      break;
     }
 
-    oldest_time = MIN (oldest_time, ts);
+    GST_TRACE ("Remove entry %" G_GUINT32_FORMAT, entry->ssrc);
+    g_queue_unlink (&manager->remb_queue, l);
+    remb_heap_remove (manager, entry);
+    g_hash_table_remove (manager->remb_hash, GUINT_TO_POINTER (entry->ssrc));
   }
+}
 
-  if (remb_min == 0 && default_min > 0) {
-    GST_DEBUG_OBJECT (manager->pad, "Setting default value: %" G_GUINT32_FORMAT,
-        default_min);
-    remb_min = default_min;
+static void
+remb_event_manager_calc_min (RembEventManager * manager, GstClockTime time)
+{
+  guint remb_min = 0;
+
+  remb_event_manager_clear_old (manager, time);
+
+  if (manager->remb_heap->len > 0) {
+    remb_min = REMB_HEAP_ENTRY (manager, 0)->bitrate;
   }
 
-  manager->oldest_remb_time = oldest_time;
   remb_event_manager_set_min (manager, remb_min);
 }
 
@@ -856,38 +1006,37 @@ static void
 remb_event_manager_update_min (RembEventManager * manager, guint bitrate,
     guint ssrc)
 {
-  RembHashValue *last_value;
-  GstClockTime time = kms_utils_get_time_nsecs ();
-  gboolean new_br = TRUE;
+  GstClockTime time;
+  RembEntry *entry;
 
   g_mutex_lock (&manager->mutex);
-  last_value = g_hash_table_lookup (manager->remb_hash,
-      GUINT_TO_POINTER (ssrc));
+  time = kms_utils_get_time_nsecs ();
+  entry = g_hash_table_lookup (manager->remb_hash, GUINT_TO_POINTER (ssrc));
 
-  if (last_value != NULL) {
-    new_br = (bitrate != last_value->bitrate);
-    last_value->bitrate = bitrate;
-    last_value->ts = kms_utils_get_time_nsecs ();
-  } else {
-    RembHashValue *value;
+  if (entry != NULL) {
+    guint last_bitrate = entry->bitrate;
 
-    value = remb_hash_value_create (bitrate);
-    g_hash_table_insert (manager->remb_hash, GUINT_TO_POINTER (ssrc), value);
-  }
+    entry->bitrate = bitrate;
+    if (bitrate < last_bitrate) {
+      remb_heap_sift_up (manager, entry->heap_index);
+    } else if (bitrate > last_bitrate) {
+      remb_heap_sift_down (manager, entry->heap_index);
+    }
 
-  if (bitrate < manager->remb_min) {
-    remb_event_manager_set_min (manager, bitrate);
+    g_queue_unlink (&manager->remb_queue, &entry->link);
   } else {
-    gboolean calc_min;
-
-    calc_min = new_br && (bitrate > manager->remb_min);
-    calc_min = calc_min
-        || (time - manager->oldest_remb_time > manager->clear_interval);
-    if (calc_min) {
-      remb_event_manager_calc_min (manager, bitrate);
-    }
+    entry = remb_entry_create (ssrc);
+    entry->bitrate = bitrate;
+    g_hash_table_insert (manager->remb_hash, GUINT_TO_POINTER (ssrc), entry);
+    g_ptr_array_add (manager->remb_heap, entry);
+    remb_heap_sift_up (manager, manager->remb_heap->len - 1);
   }
 
+  entry->ts = time;
+  g_queue_push_tail_link (&manager->remb_queue, &entry->link);
+
+  remb_event_manager_calc_min (manager, time);
+
   GST_TRACE_OBJECT (manager->pad, "remb_min: %" G_GUINT32_FORMAT,
       manager->remb_min);
 
@@ -921,11 +1070,12 @@ kms_utils_remb_event_manager_create (GstPad * pad)
 
   g_mutex_init (&manager->mutex);
   manager->remb_hash =
-      g_hash_table_new_full (NULL, NULL, NULL, remb_hash_value_destroy);
+      g_hash_table_new_full (NULL, NULL, NULL, remb_entry_destroy);
+  manager->remb_heap = g_ptr_array_new ();
+  g_queue_init (&manager->remb_queue);
   manager->pad = g_object_ref (pad);
   manager->probe_id = gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM,
       remb_probe, manager, NULL);
-  manager->oldest_remb_time = kms_utils_get_time_nsecs ();
   manager->clear_interval = DEFAULT_CLEAR_INTERVAL;
 
   return manager;
@@ -948,6 +1098,7 @@ kms_utils_remb_event_manager_destroy (RembEventManager * manager)
 
   gst_pad_remove_probe (manager->pad, manager->probe_id);
   g_object_unref (manager->pad);
+  g_ptr_array_free (manager->remb_heap, TRUE);
   g_hash_table_destroy (manager->remb_hash);
   g_mutex_clear (&manager->mutex);
   g_slice_free (RembEventManager, manager);
@@ -962,18 +1113,14 @@ kms_utils_remb_event_manager_pointer_destroy (gpointer manager)
 guint
 kms_utils_remb_event_manager_get_min (RembEventManager * manager)
 {
-  GstClockTime time = kms_utils_get_time_nsecs ();
-  guint ret;
-
-  g_mutex_lock (&manager->mutex);
-  if (time - manager->oldest_remb_time > manager->clear_interval) {
-    remb_event_manager_calc_min (manager, 0);
+  /* Avoid contention with the streaming threads, the last published value
+   * is good enough if they are currently updating it */
+  if (g_mutex_trylock (&manager->mutex)) {
+    remb_event_manager_calc_min (manager, kms_utils_get_time_nsecs ());
+    g_mutex_unlock (&manager->mutex);
   }
 
-  ret = manager->remb_min;
-  g_mutex_unlock (&manager->mutex);
-
-  return ret;
+  return g_atomic_int_get (&manager->remb_min);
 }
 
 void
@@ -37,6 +37,16 @@ gboolean kms_is_valid_uri (const gchar * url);
 gboolean gst_element_sync_state_with_parent_target_state (GstElement * element);
 
 /* Caps */
+typedef enum
+{
+  KMS_CAPS_CLASS_AUDIO = 1 << 0,
+  KMS_CAPS_CLASS_VIDEO = 1 << 1,
+  KMS_CAPS_CLASS_RAW = 1 << 2,
+  KMS_CAPS_CLASS_RTP = 1 << 3
+} KmsCapsClass;
+
+KmsCapsClass kms_utils_caps_classify (const GstCaps * caps);
+
 gboolean kms_utils_caps_are_audio (const GstCaps * caps);
 gboolean kms_utils_caps_are_video (const GstCaps * caps);
 gboolean kms_utils_caps_are_rtp (const GstCaps * caps);
@@ -0,0 +1,1075 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+
+#include "kmsvideokernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KMS_VIDEO_KERNELS_X86 1
+#include <immintrin.h>
+#define KMS_TARGET(isa) __attribute__ ((target (isa)))
+#endif
+
+#define GST_DEFAULT_NAME "videokernels"
+#define GST_CAT_DEFAULT kms_video_kernels_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+/*
+ * Fixed point coefficients. They are chosen so every intermediate value
+ * fits in 16 bits, which lets the SIMD versions produce exactly the same
+ * output as the scalar one.
+ *
+ * YUV to RGB, 6 fractional bits
+ */
+#define YUV_Y 74
+#define YUV_RV 102
+#define YUV_GU 25
+#define YUV_GV 52
+#define YUV_BU 129
+
+/* RGB to YUV, 7 fractional bits */
+#define RGB_YR 33
+#define RGB_YG 64
+#define RGB_YB 13
+#define RGB_UR -19
+#define RGB_UG -37
+#define RGB_UB 56
+#define RGB_VR 56
+#define RGB_VG -47
+#define RGB_VB -9
+
+typedef struct _KmsVideoKernelsTable
+{
+  void (*yuv_to_rgbx_row) (const guint8 * y, const guint8 * u,
+      const guint8 * v, guint8 * rgbx, gint width);
+  /* y1 may be NULL when there is no second row */
+  void (*rgbx_to_yuv_rows) (const guint8 * s0, const guint8 * s1,
+      guint8 * y0, guint8 * y1, guint8 * u, guint8 * v, gint width);
+  void (*interleave_uv_row) (const guint8 * u, const guint8 * v, guint8 * uv,
+      gint width);
+  void (*deinterleave_uv_row) (const guint8 * uv, guint8 * u, guint8 * v,
+      gint width);
+  void (*downscale2_row) (const guint8 * s0, const guint8 * s1, guint8 * d,
+      gint dst_width, guint bpp);
+} KmsVideoKernelsTable;
+
+static inline guint8
+avg2 (guint a, guint b)
+{
+  return (a + b + 1) >> 1;
+}
+
+static inline guint8
+clamp_u8 (gint v)
+{
+  return CLAMP (v, 0, 255);
+}
+
+/* Scalar kernels */
+
+static void
+yuv_to_rgbx_row_c (const guint8 * y, const guint8 * u, const guint8 * v,
+    guint8 * rgbx, gint width)
+{
+  gint x;
+
+  for (x = 0; x < width; x++) {
+    gint cu = u[x >> 1] - 128;
+    gint cv = v[x >> 1] - 128;
+    gint yc = (y[x] - 16) * YUV_Y + 32;
+    guint8 *p = rgbx + 4 * x;
+
+    p[0] = clamp_u8 ((yc + YUV_RV * cv) >> 6);
+    p[1] = clamp_u8 ((yc - YUV_GU * cu - YUV_GV * cv) >> 6);
+    p[2] = clamp_u8 ((yc + YUV_BU * cu) >> 6);
+    p[3] = 0xff;
+  }
+}
+
+static inline guint8
+rgbx_to_y (const guint8 * p)
+{
+  return ((RGB_YR * p[0] + RGB_YG * p[1] + RGB_YB * p[2] + 64) >> 7) + 16;
+}
+
+static void
+rgbx_to_yuv_rows_c (const guint8 * s0, const guint8 * s1, guint8 * y0,
+    guint8 * y1, guint8 * u, guint8 * v, gint width)
+{
+  gint x, c;
+
+  for (x = 0; x < width; x++) {
+    y0[x] = rgbx_to_y (s0 + 4 * x);
+    if (y1 != NULL) {
+      y1[x] = rgbx_to_y (s1 + 4 * x);
+    }
+  }
+
+  for (x = 0; x < width; x += 2) {
+    /* Odd widths reuse the last column */
+    gint next = x + 1 < width ? x + 1 : x;
+    guint8 p[3];
+
+    for (c = 0; c < 3; c++) {
+      p[c] = avg2 (avg2 (s0[4 * x + c], s1[4 * x + c]),
+          avg2 (s0[4 * next + c], s1[4 * next + c]));
+    }
+
+    u[x >> 1] = clamp_u8 (((RGB_UR * p[0] + RGB_UG * p[1] + RGB_UB * p[2] +
+                64) >> 7) + 128);
+    v[x >> 1] = clamp_u8 (((RGB_VR * p[0] + RGB_VG * p[1] + RGB_VB * p[2] +
+                64) >> 7) + 128);
+  }
+}
+
+static void
+interleave_uv_row_c (const guint8 * u, const guint8 * v, guint8 * uv,
+    gint width)
+{
+  gint x;
+
+  for (x = 0; x < width; x++) {
+    uv[2 * x] = u[x];
+    uv[2 * x + 1] = v[x];
+  }
+}
+
+static void
+deinterleave_uv_row_c (const guint8 * uv, guint8 * u, guint8 * v, gint width)
+{
+  gint x;
+
+  for (x = 0; x < width; x++) {
+    u[x] = uv[2 * x];
+    v[x] = uv[2 * x + 1];
+  }
+}
+
+static void
+downscale2_row_c (const guint8 * s0, const guint8 * s1, guint8 * d,
+    gint dst_width, guint bpp)
+{
+  gint x;
+  guint c;
+
+  for (x = 0; x < dst_width; x++) {
+    guint a = 2 * x * bpp, b = a + bpp;
+
+    for (c = 0; c < bpp; c++) {
+      d[x * bpp + c] = avg2 (avg2 (s0[a + c], s1[a + c]),
+          avg2 (s0[b + c], s1[b + c]));
+    }
+  }
+}
+
+static const KmsVideoKernelsTable scalar_table = {
+  yuv_to_rgbx_row_c,
+  rgbx_to_yuv_rows_c,
+  interleave_uv_row_c,
+  deinterleave_uv_row_c,
+  downscale2_row_c
+};
+
+#ifdef KMS_VIDEO_KERNELS_X86
+
+static void yuv_to_rgbx_row_sse41 (const guint8 * y, const guint8 * u,
+    const guint8 * v, guint8 * rgbx, gint width)
+    KMS_TARGET ("sse4.1");
+static inline __m128i rgbx_to_y_sse41 (const guint8 * s)
+    KMS_TARGET ("sse4.1");
+static void rgbx_to_yuv_rows_sse41 (const guint8 * s0, const guint8 * s1,
+    guint8 * y0, guint8 * y1, guint8 * u, guint8 * v, gint width)
+    KMS_TARGET ("sse4.1");
+static void interleave_uv_row_sse41 (const guint8 * u, const guint8 * v,
+    guint8 * uv, gint width)
+    KMS_TARGET ("sse4.1");
+static void deinterleave_uv_row_sse41 (const guint8 * uv, guint8 * u,
+    guint8 * v, gint width)
+    KMS_TARGET ("sse4.1");
+static void downscale2_row_sse41 (const guint8 * s0, const guint8 * s1,
+    guint8 * d, gint dst_width, guint bpp)
+    KMS_TARGET ("sse4.1");
+static void yuv_to_rgbx_row_avx2 (const guint8 * y, const guint8 * u,
+    const guint8 * v, guint8 * rgbx, gint width)
+    KMS_TARGET ("avx2");
+static void interleave_uv_row_avx2 (const guint8 * u, const guint8 * v,
+    guint8 * uv, gint width)
+    KMS_TARGET ("avx2");
+static void deinterleave_uv_row_avx2 (const guint8 * uv, guint8 * u,
+    guint8 * v, gint width)
+    KMS_TARGET ("avx2");
+static void downscale2_row_avx2 (const guint8 * s0, const guint8 * s1,
+    guint8 * d, gint dst_width, guint bpp)
+    KMS_TARGET ("avx2");
+
+/* SSE4.1 kernels */
+
+static void
+yuv_to_rgbx_row_sse41 (const guint8 * y, const guint8 * u, const guint8 * v,
+    guint8 * rgbx, gint width)
+{
+  const __m128i k_y = _mm_set1_epi16 (YUV_Y);
+  const __m128i k_rv = _mm_set1_epi16 (YUV_RV);
+  const __m128i k_gu = _mm_set1_epi16 (YUV_GU);
+  const __m128i k_gv = _mm_set1_epi16 (YUV_GV);
+  const __m128i k_bu = _mm_set1_epi16 (YUV_BU);
+  const __m128i y_off = _mm_set1_epi16 (16);
+  const __m128i uv_off = _mm_set1_epi16 (128);
+  const __m128i round = _mm_set1_epi16 (32);
+  const __m128i alpha = _mm_set1_epi8 ((gchar) 0xff);
+  gint x;
+
+  for (x = 0; x + 16 <= width; x += 16) {
+    __m128i yy = _mm_loadu_si128 ((const __m128i *) (y + x));
+    __m128i uu = _mm_loadl_epi64 ((const __m128i *) (u + x / 2));
+    __m128i vv = _mm_loadl_epi64 ((const __m128i *) (v + x / 2));
+    __m128i r[2], g[2], b[2], rr, gg, bb, rg, ba;
+    guint8 *out = rgbx + 4 * x;
+    gint i;
+
+    /* One chroma sample for every two pixels */
+    uu = _mm_unpacklo_epi8 (uu, uu);
+    vv = _mm_unpacklo_epi8 (vv, vv);
+
+    for (i = 0; i < 2; i++) {
+      __m128i y16, u16, v16;
+
+      if (i == 0) {
+        y16 = _mm_cvtepu8_epi16 (yy);
+        u16 = _mm_cvtepu8_epi16 (uu);
+        v16 = _mm_cvtepu8_epi16 (vv);
+      } else {
+        y16 = _mm_cvtepu8_epi16 (_mm_srli_si128 (yy, 8));
+        u16 = _mm_cvtepu8_epi16 (_mm_srli_si128 (uu, 8));
+        v16 = _mm_cvtepu8_epi16 (_mm_srli_si128 (vv, 8));
+      }
+
+      y16 = _mm_adds_epi16 (_mm_mullo_epi16 (_mm_sub_epi16 (y16, y_off), k_y),
+          round);
+      u16 = _mm_sub_epi16 (u16, uv_off);
+      v16 = _mm_sub_epi16 (v16, uv_off);
+
+      r[i] = _mm_srai_epi16 (_mm_adds_epi16 (y16,
+              _mm_mullo_epi16 (v16, k_rv)), 6);
+      g[i] = _mm_srai_epi16 (_mm_subs_epi16 (y16,
+              _mm_add_epi16 (_mm_mullo_epi16 (u16, k_gu),
+                  _mm_mullo_epi16 (v16, k_gv))), 6);
+      b[i] = _mm_srai_epi16 (_mm_adds_epi16 (y16,
+              _mm_mullo_epi16 (u16, k_bu)), 6);
+    }
+
+    rr = _mm_packus_epi16 (r[0], r[1]);
+    gg = _mm_packus_epi16 (g[0], g[1]);
+    bb = _mm_packus_epi16 (b[0], b[1]);
+
+    rg = _mm_unpacklo_epi8 (rr, gg);
+    ba = _mm_unpacklo_epi8 (bb, alpha);
+    _mm_storeu_si128 ((__m128i *) out, _mm_unpacklo_epi16 (rg, ba));
+    _mm_storeu_si128 ((__m128i *) (out + 16), _mm_unpackhi_epi16 (rg, ba));
+
+    rg = _mm_unpackhi_epi8 (rr, gg);
+    ba = _mm_unpackhi_epi8 (bb, alpha);
+    _mm_storeu_si128 ((__m128i *) (out + 32), _mm_unpacklo_epi16 (rg, ba));
+    _mm_storeu_si128 ((__m128i *) (out + 48), _mm_unpackhi_epi16 (rg, ba));
+  }
+
+  yuv_to_rgbx_row_c (y + x, u + x / 2, v + x / 2, rgbx + 4 * x, width - x);
+}
+
+static inline __m128i
+rgbx_to_y_sse41 (const guint8 * s)
+{
+  const __m128i k_y = _mm_setr_epi8 (RGB_YR, RGB_YG, RGB_YB, 0, RGB_YR,
+      RGB_YG, RGB_YB, 0, RGB_YR, RGB_YG, RGB_YB, 0, RGB_YR, RGB_YG, RGB_YB, 0);
+  const __m128i round = _mm_set1_epi16 (64);
+  const __m128i y_off = _mm_set1_epi16 (16);
+  __m128i p[4], lo, hi;
+  gint i;
+
+  for (i = 0; i < 4; i++) {
+    p[i] = _mm_maddubs_epi16 (_mm_loadu_si128 ((const __m128i *) (s + 16 * i)),
+        k_y);
+  }
+
+  lo = _mm_hadd_epi16 (p[0], p[1]);
+  hi = _mm_hadd_epi16 (p[2], p[3]);
+  lo = _mm_add_epi16 (_mm_srli_epi16 (_mm_add_epi16 (lo, round), 7), y_off);
+  hi = _mm_add_epi16 (_mm_srli_epi16 (_mm_add_epi16 (hi, round), 7), y_off);
+
+  return _mm_packus_epi16 (lo, hi);
+}
+
+static void
+rgbx_to_yuv_rows_sse41 (const guint8 * s0, const guint8 * s1, guint8 * y0,
+    guint8 * y1, guint8 * u, guint8 * v, gint width)
+{
+  const __m128i k_u = _mm_setr_epi8 (RGB_UR, RGB_UG, RGB_UB, 0, RGB_UR,
+      RGB_UG, RGB_UB, 0, RGB_UR, RGB_UG, RGB_UB, 0, RGB_UR, RGB_UG, RGB_UB, 0);
+  const __m128i k_v = _mm_setr_epi8 (RGB_VR, RGB_VG, RGB_VB, 0, RGB_VR,
+      RGB_VG, RGB_VB, 0, RGB_VR, RGB_VG, RGB_VB, 0, RGB_VR, RGB_VG, RGB_VB, 0);
+  const __m128i round = _mm_set1_epi16 (64);
+  const __m128i uv_off = _mm_set1_epi16 (128);
+  gint x;
+
+  for (x = 0; x + 16 <= width; x += 16) {
+    const guint8 *a = s0 + 4 * x, *b = s1 + 4 * x;
+    __m128i avg[4], c[2], uu, vv, uv;
+    gint i;
+
+    _mm_storeu_si128 ((__m128i *) (y0 + x), rgbx_to_y_sse41 (a));
+    if (y1 != NULL) {
+      _mm_storeu_si128 ((__m128i *) (y1 + x), rgbx_to_y_sse41 (b));
+    }
+
+    for (i = 0; i < 4; i++) {
+      avg[i] = _mm_avg_epu8 (_mm_loadu_si128 ((const __m128i *) (a + 16 * i)),
+          _mm_loadu_si128 ((const __m128i *) (b + 16 * i)));
+    }
+
+    /* Average even and odd pixels */
+    for (i = 0; i < 2; i++) {
+      __m128 p0 = _mm_castsi128_ps (avg[2 * i]);
+      __m128 p1 = _mm_castsi128_ps (avg[2 * i + 1]);
+
+      c[i] = _mm_avg_epu8 (
+          _mm_castps_si128 (_mm_shuffle_ps (p0, p1, _MM_SHUFFLE (2, 0, 2, 0))),
+          _mm_castps_si128 (_mm_shuffle_ps (p0, p1, _MM_SHUFFLE (3, 1, 3, 1))));
+    }
+
+    uu = _mm_hadd_epi16 (_mm_maddubs_epi16 (c[0], k_u),
+        _mm_maddubs_epi16 (c[1], k_u));
+    vv = _mm_hadd_epi16 (_mm_maddubs_epi16 (c[0], k_v),
+        _mm_maddubs_epi16 (c[1], k_v));
+    uu = _mm_add_epi16 (_mm_srai_epi16 (_mm_add_epi16 (uu, round), 7), uv_off);
+    vv = _mm_add_epi16 (_mm_srai_epi16 (_mm_add_epi16 (vv, round), 7), uv_off);
+
+    uv = _mm_packus_epi16 (uu, vv);
+    _mm_storel_epi64 ((__m128i *) (u + x / 2), uv);
+    _mm_storel_epi64 ((__m128i *) (v + x / 2), _mm_srli_si128 (uv, 8));
+  }
+
+  rgbx_to_yuv_rows_c (s0 + 4 * x, s1 + 4 * x, y0 + x,
+      y1 != NULL ? y1 + x : NULL, u + x / 2, v + x / 2, width - x);
+}
+
+static void
+interleave_uv_row_sse41 (const guint8 * u, const guint8 * v, guint8 * uv,
+    gint width)
+{
+  gint x;
+
+  for (x = 0; x + 16 <= width; x += 16) {
+    __m128i uu = _mm_loadu_si128 ((const __m128i *) (u + x));
+    __m128i vv = _mm_loadu_si128 ((const __m128i *) (v + x));
+
+    _mm_storeu_si128 ((__m128i *) (uv + 2 * x), _mm_unpacklo_epi8 (uu, vv));
+    _mm_storeu_si128 ((__m128i *) (uv + 2 * x + 16),
+        _mm_unpackhi_epi8 (uu, vv));
+  }
+
+  interleave_uv_row_c (u + x, v + x, uv + 2 * x, width - x);
+}
+
+static void
+deinterleave_uv_row_sse41 (const guint8 * uv, guint8 * u, guint8 * v,
+    gint width)
+{
+  const __m128i mask = _mm_set1_epi16 (0x00ff);
+  gint x;
+
+  for (x = 0; x + 16 <= width; x += 16) {
+    __m128i a = _mm_loadu_si128 ((const __m128i *) (uv + 2 * x));
+    __m128i b = _mm_loadu_si128 ((const __m128i *) (uv + 2 * x + 16));
+
+    _mm_storeu_si128 ((__m128i *) (u + x),
+        _mm_packus_epi16 (_mm_and_si128 (a, mask), _mm_and_si128 (b, mask)));
+    _mm_storeu_si128 ((__m128i *) (v + x),
+        _mm_packus_epi16 (_mm_srli_epi16 (a, 8), _mm_srli_epi16 (b, 8)));
+  }
+
+  deinterleave_uv_row_c (uv + 2 * x, u + x, v + x, width - x);
+}
+
+static void
+downscale2_row_sse41 (const guint8 * s0, const guint8 * s1, guint8 * d,
+    gint dst_width, guint bpp)
+{
+  const __m128i mask8 = _mm_set1_epi16 (0x00ff);
+  const __m128i mask16 = _mm_set1_epi32 (0x0000ffff);
+  gint x, step = 16 / bpp;
+
+  for (x = 0; x + step <= dst_width; x += step) {
+    const guint8 *a = s0 + 2 * x * bpp, *b = s1 + 2 * x * bpp;
+    __m128i v0, v1, out;
+
+    v0 = _mm_avg_epu8 (_mm_loadu_si128 ((const __m128i *) a),
+        _mm_loadu_si128 ((const __m128i *) b));
+    v1 = _mm_avg_epu8 (_mm_loadu_si128 ((const __m128i *) (a + 16)),
+        _mm_loadu_si128 ((const __m128i *) (b + 16)));
+
+    switch (bpp) {
+      case 1:
+        out = _mm_packus_epi16 (
+            _mm_avg_epu16 (_mm_and_si128 (v0, mask8), _mm_srli_epi16 (v0, 8)),
+            _mm_avg_epu16 (_mm_and_si128 (v1, mask8), _mm_srli_epi16 (v1,
+                    8)));
+        break;
+      case 2:
+        out = _mm_packus_epi32 (
+            _mm_avg_epu8 (_mm_and_si128 (v0, mask16), _mm_srli_epi32 (v0, 16)),
+            _mm_avg_epu8 (_mm_and_si128 (v1, mask16), _mm_srli_epi32 (v1,
+                    16)));
+        break;
+      default:{
+        __m128 p0 = _mm_castsi128_ps (v0), p1 = _mm_castsi128_ps (v1);
+
+        out = _mm_avg_epu8 (
+            _mm_castps_si128 (_mm_shuffle_ps (p0, p1,
+                    _MM_SHUFFLE (2, 0, 2, 0))),
+            _mm_castps_si128 (_mm_shuffle_ps (p0, p1,
+                    _MM_SHUFFLE (3, 1, 3, 1))));
+        break;
+      }
+    }
+
+    _mm_storeu_si128 ((__m128i *) (d + x * bpp), out);
+  }
+
+  downscale2_row_c (s0 + 2 * x * bpp, s1 + 2 * x * bpp, d + x * bpp,
+      dst_width - x, bpp);
+}
+
+static const KmsVideoKernelsTable sse41_table = {
+  yuv_to_rgbx_row_sse41,
+  rgbx_to_yuv_rows_sse41,
+  interleave_uv_row_sse41,
+  deinterleave_uv_row_sse41,
+  downscale2_row_sse41
+};
+
+/* AVX2 kernels, falling back to SSE4.1 where 256 bits do not pay off */
+
+static void
+yuv_to_rgbx_row_avx2 (const guint8 * y, const guint8 * u, const guint8 * v,
+    guint8 * rgbx, gint width)
+{
+  const __m256i k_y = _mm256_set1_epi16 (YUV_Y);
+  const __m256i k_rv = _mm256_set1_epi16 (YUV_RV);
+  const __m256i k_gu = _mm256_set1_epi16 (YUV_GU);
+  const __m256i k_gv = _mm256_set1_epi16 (YUV_GV);
+  const __m256i k_bu = _mm256_set1_epi16 (YUV_BU);
+  const __m256i y_off = _mm256_set1_epi16 (16);
+  const __m256i uv_off = _mm256_set1_epi16 (128);
+  const __m256i round = _mm256_set1_epi16 (32);
+  const __m256i alpha = _mm256_set1_epi8 ((gchar) 0xff);
+  gint x;
+
+  for (x = 0; x + 32 <= width; x += 32) {
+    __m256i yy = _mm256_loadu_si256 ((const __m256i *) (y + x));
+    __m128i uu = _mm_loadu_si128 ((const __m128i *) (u + x / 2));
+    __m128i vv = _mm_loadu_si128 ((const __m128i *) (v + x / 2));
+    __m256i r[2], g[2], b[2], rr, gg, bb, rg, ba, t0, t1;
+    guint8 *out = rgbx + 4 * x;
+    gint i;
+
+    for (i = 0; i < 2; i++) {
+      __m256i y16, u16, v16;
+
+      if (i == 0) {
+        y16 = _mm256_cvtepu8_epi16 (_mm256_castsi256_si128 (yy));
+        u16 = _mm256_cvtepu8_epi16 (_mm_unpacklo_epi8 (uu, uu));
+        v16 = _mm256_cvtepu8_epi16 (_mm_unpacklo_epi8 (vv, vv));
+      } else {
+        y16 = _mm256_cvtepu8_epi16 (_mm256_extracti128_si256 (yy, 1));
+        u16 = _mm256_cvtepu8_epi16 (_mm_unpackhi_epi8 (uu, uu));
+        v16 = _mm256_cvtepu8_epi16 (_mm_unpackhi_epi8 (vv, vv));
+      }
+
+      y16 = _mm256_adds_epi16 (_mm256_mullo_epi16 (_mm256_sub_epi16 (y16,
+                  y_off), k_y), round);
+      u16 = _mm256_sub_epi16 (u16, uv_off);
+      v16 = _mm256_sub_epi16 (v16, uv_off);
+
+      r[i] = _mm256_srai_epi16 (_mm256_adds_epi16 (y16,
+              _mm256_mullo_epi16 (v16, k_rv)), 6);
+      g[i] = _mm256_srai_epi16 (_mm256_subs_epi16 (y16,
+              _mm256_add_epi16 (_mm256_mullo_epi16 (u16, k_gu),
+                  _mm256_mullo_epi16 (v16, k_gv))), 6);
+      b[i] = _mm256_srai_epi16 (_mm256_adds_epi16 (y16,
+              _mm256_mullo_epi16 (u16, k_bu)), 6);
+    }
+
+    /* Lanes hold pixels 0-7, 16-23 | 8-15, 24-31 */
+    rr = _mm256_packus_epi16 (r[0], r[1]);
+    gg = _mm256_packus_epi16 (g[0], g[1]);
+    bb = _mm256_packus_epi16 (b[0], b[1]);
+
+    /* Pixels 0-7 | 8-15 */
+    rg = _mm256_unpacklo_epi8 (rr, gg);
+    ba = _mm256_unpacklo_epi8 (bb, alpha);
+    t0 = _mm256_unpacklo_epi16 (rg, ba);
+    t1 = _mm256_unpackhi_epi16 (rg, ba);
+    _mm256_storeu_si256 ((__m256i *) out, _mm256_permute2x128_si256 (t0, t1,
+            0x20));
+    _mm256_storeu_si256 ((__m256i *) (out + 32),
+        _mm256_permute2x128_si256 (t0, t1, 0x31));
+
+    /* Pixels 16-23 | 24-31 */
+    rg = _mm256_unpackhi_epi8 (rr, gg);
+    ba = _mm256_unpackhi_epi8 (bb, alpha);
+    t0 = _mm256_unpacklo_epi16 (rg, ba);
+    t1 = _mm256_unpackhi_epi16 (rg, ba);
+    _mm256_storeu_si256 ((__m256i *) (out + 64),
+        _mm256_permute2x128_si256 (t0, t1, 0x20));
+    _mm256_storeu_si256 ((__m256i *) (out + 96),
+        _mm256_permute2x128_si256 (t0, t1, 0x31));
+  }
+
+  yuv_to_rgbx_row_sse41 (y + x, u + x / 2, v + x / 2, rgbx + 4 * x,
+      width - x);
+}
+
+static void
+interleave_uv_row_avx2 (const guint8 * u, const guint8 * v, guint8 * uv,
+    gint width)
+{
+  gint x;
+
+  for (x = 0; x + 32 <= width; x += 32) {
+    __m256i uu = _mm256_loadu_si256 ((const __m256i *) (u + x));
+    __m256i vv = _mm256_loadu_si256 ((const __m256i *) (v + x));
+    __m256i lo = _mm256_unpacklo_epi8 (uu, vv);
+    __m256i hi = _mm256_unpackhi_epi8 (uu, vv);
+
+    _mm256_storeu_si256 ((__m256i *) (uv + 2 * x),
+        _mm256_permute2x128_si256 (lo, hi, 0x20));
+    _mm256_storeu_si256 ((__m256i *) (uv + 2 * x + 32),
+        _mm256_permute2x128_si256 (lo, hi, 0x31));
+  }
+
+  interleave_uv_row_sse41 (u + x, v + x, uv + 2 * x, width - x);
+}
+
+static void
+deinterleave_uv_row_avx2 (const guint8 * uv, guint8 * u, guint8 * v, gint width)
+{
+  const __m256i mask = _mm256_set1_epi16 (0x00ff);
+  gint x;
+
+  for (x = 0; x + 32 <= width; x += 32) {
+    __m256i a = _mm256_loadu_si256 ((const __m256i *) (uv + 2 * x));
+    __m256i b = _mm256_loadu_si256 ((const __m256i *) (uv + 2 * x + 32));
+    __m256i uu, vv;
+
+    uu = _mm256_packus_epi16 (_mm256_and_si256 (a, mask),
+        _mm256_and_si256 (b, mask));
+    vv = _mm256_packus_epi16 (_mm256_srli_epi16 (a, 8),
+        _mm256_srli_epi16 (b, 8));
+
+    _mm256_storeu_si256 ((__m256i *) (u + x),
+        _mm256_permute4x64_epi64 (uu, 0xd8));
+    _mm256_storeu_si256 ((__m256i *) (v + x),
+        _mm256_permute4x64_epi64 (vv, 0xd8));
+  }
+
+  deinterleave_uv_row_sse41 (uv + 2 * x, u + x, v + x, width - x);
+}
+
+static void
+downscale2_row_avx2 (const guint8 * s0, const guint8 * s1, guint8 * d,
+    gint dst_width, guint bpp)
+{
+  const __m256i mask = _mm256_set1_epi16 (0x00ff);
+  gint x = 0;
+
+  if (bpp != 1) {
+    downscale2_row_sse41 (s0, s1, d, dst_width, bpp);
+    return;
+  }
+
+  for (x = 0; x + 32 <= dst_width; x += 32) {
+    const guint8 *a = s0 + 2 * x, *b = s1 + 2 * x;
+    __m256i v0, v1, out;
+
+    v0 = _mm256_avg_epu8 (_mm256_loadu_si256 ((const __m256i *) a),
+        _mm256_loadu_si256 ((const __m256i *) b));
+    v1 = _mm256_avg_epu8 (_mm256_loadu_si256 ((const __m256i *) (a + 32)),
+        _mm256_loadu_si256 ((const __m256i *) (b + 32)));
+
+    out = _mm256_packus_epi16 (
+        _mm256_avg_epu16 (_mm256_and_si256 (v0, mask),
+            _mm256_srli_epi16 (v0, 8)),
+        _mm256_avg_epu16 (_mm256_and_si256 (v1, mask),
+            _mm256_srli_epi16 (v1, 8)));
+
+    _mm256_storeu_si256 ((__m256i *) (d + x),
+        _mm256_permute4x64_epi64 (out, 0xd8));
+  }
+
+  downscale2_row_sse41 (s0 + 2 * x, s1 + 2 * x, d + x, dst_width - x, bpp);
+}
+
+static const KmsVideoKernelsTable avx2_table = {
+  yuv_to_rgbx_row_avx2,
+  rgbx_to_yuv_rows_sse41,
+  interleave_uv_row_avx2,
+  deinterleave_uv_row_avx2,
+  downscale2_row_avx2
+};
+
+#endif /* KMS_VIDEO_KERNELS_X86 */
+
+/* Dispatch */
+
+static KmsVideoKernelsImpl best_impl = KMS_VIDEO_KERNELS_SCALAR;
+static KmsVideoKernelsImpl current_impl = KMS_VIDEO_KERNELS_SCALAR;
+static const KmsVideoKernelsTable *kernels = &scalar_table;
+
+static const KmsVideoKernelsTable *
+kms_video_kernels_get_table (KmsVideoKernelsImpl impl)
+{
+  switch (impl) {
+#ifdef KMS_VIDEO_KERNELS_X86
+    case KMS_VIDEO_KERNELS_AVX2:
+      return &avx2_table;
+    case KMS_VIDEO_KERNELS_SSE41:
+      return &sse41_table;
+#endif
+    default:
+      return &scalar_table;
+  }
+}
+
+static gpointer
+kms_video_kernels_detect (gpointer data)
+{
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+
+#ifdef KMS_VIDEO_KERNELS_X86
+  __builtin_cpu_init ();
+
+  if (__builtin_cpu_supports ("avx2")) {
+    best_impl = KMS_VIDEO_KERNELS_AVX2;
+  } else if (__builtin_cpu_supports ("sse4.1")) {
+    best_impl = KMS_VIDEO_KERNELS_SSE41;
+  }
+#endif
+
+  current_impl = best_impl;
+  kernels = kms_video_kernels_get_table (best_impl);
+
+  GST_INFO ("Using %s video kernels", kms_video_kernels_impl_get_name
+      (best_impl));
+
+  return NULL;
+}
+
+static inline const KmsVideoKernelsTable *
+kms_video_kernels (void)
+{
+  static GOnce once = G_ONCE_INIT;
+
+  g_once (&once, kms_video_kernels_detect, NULL);
+
+  return kernels;
+}
+
+KmsVideoKernelsImpl
+kms_video_kernels_get_impl (void)
+{
+  kms_video_kernels ();
+
+  return current_impl;
+}
+
+KmsVideoKernelsImpl
+kms_video_kernels_set_impl (KmsVideoKernelsImpl impl)
+{
+  kms_video_kernels ();
+
+  current_impl = MIN (impl, best_impl);
+  kernels = kms_video_kernels_get_table (current_impl);
+
+  return current_impl;
+}
+
+const gchar *
+kms_video_kernels_impl_get_name (KmsVideoKernelsImpl impl)
+{
+  switch (impl) {
+    case KMS_VIDEO_KERNELS_AVX2:
+      return "avx2";
+    case KMS_VIDEO_KERNELS_SSE41:
+      return "sse4.1";
+    default:
+      return "scalar";
+  }
+}
+
+/* Plane kernels */
+
+void
+kms_video_kernels_copy_plane (const guint8 * src, gint src_stride,
+    guint8 * dst, gint dst_stride, gint width, gint height)
+{
+  gint y;
+
+  if (src_stride == width && dst_stride == width) {
+    memcpy (dst, src, (gsize) width * height);
+    return;
+  }
+
+  /* libc memcpy is already vectorized, rows are copied as they are */
+  for (y = 0; y < height; y++) {
+    memcpy (dst + y * dst_stride, src + y * src_stride, width);
+  }
+}
+
+void
+kms_video_kernels_i420_to_nv12 (guint8 * const src[], const gint src_stride[],
+    guint8 * const dst[], const gint dst_stride[], gint width, gint height)
+{
+  const KmsVideoKernelsTable *k = kms_video_kernels ();
+  gint y, cw = (width + 1) / 2, ch = (height + 1) / 2;
+
+  kms_video_kernels_copy_plane (src[0], src_stride[0], dst[0], dst_stride[0],
+      width, height);
+
+  for (y = 0; y < ch; y++) {
+    k->interleave_uv_row (src[1] + y * src_stride[1],
+        src[2] + y * src_stride[2], dst[1] + y * dst_stride[1], cw);
+  }
+}
+
+void
+kms_video_kernels_nv12_to_i420 (guint8 * const src[], const gint src_stride[],
+    guint8 * const dst[], const gint dst_stride[], gint width, gint height)
+{
+  const KmsVideoKernelsTable *k = kms_video_kernels ();
+  gint y, cw = (width + 1) / 2, ch = (height + 1) / 2;
+
+  kms_video_kernels_copy_plane (src[0], src_stride[0], dst[0], dst_stride[0],
+      width, height);
+
+  for (y = 0; y < ch; y++) {
+    k->deinterleave_uv_row (src[1] + y * src_stride[1],
+        dst[1] + y * dst_stride[1], dst[2] + y * dst_stride[2], cw);
+  }
+}
+
+void
+kms_video_kernels_i420_to_rgbx (guint8 * const src[], const gint src_stride[],
+    guint8 * dst, gint dst_stride, gint width, gint height)
+{
+  const KmsVideoKernelsTable *k = kms_video_kernels ();
+  gint y;
+
+  for (y = 0; y < height; y++) {
+    k->yuv_to_rgbx_row (src[0] + y * src_stride[0],
+        src[1] + (y / 2) * src_stride[1], src[2] + (y / 2) * src_stride[2],
+        dst + y * dst_stride, width);
+  }
+}
+
+void
+kms_video_kernels_nv12_to_rgbx (guint8 * const src[], const gint src_stride[],
+    guint8 * dst, gint dst_stride, gint width, gint height)
+{
+  const KmsVideoKernelsTable *k = kms_video_kernels ();
+  gint y, cw = (width + 1) / 2;
+  guint8 *u, *v;
+
+  u = g_malloc (2 * cw);
+  v = u + cw;
+
+  for (y = 0; y < height; y++) {
+    if (y % 2 == 0) {
+      k->deinterleave_uv_row (src[1] + (y / 2) * src_stride[1], u, v, cw);
+    }
+
+    k->yuv_to_rgbx_row (src[0] + y * src_stride[0], u, v,
+        dst + y * dst_stride, width);
+  }
+
+  g_free (u);
+}
+
+static void
+kms_video_kernels_rgbx_to_yuv (const guint8 * src, gint src_stride,
+    guint8 * y_plane, gint y_stride, guint8 * u_plane, gint u_stride,
+    guint8 * v_plane, gint v_stride, gint width, gint height)
+{
+  const KmsVideoKernelsTable *k = kms_video_kernels ();
+  gint y;
+
+  for (y = 0; y < height; y += 2) {
+    const guint8 *s0 = src + y * src_stride;
+    gboolean last = y + 1 >= height;
+
+    /* Odd heights reuse the last row for chroma */
+    k->rgbx_to_yuv_rows (s0, last ? s0 : s0 + src_stride,
+        y_plane + y * y_stride, last ? NULL : y_plane + (y + 1) * y_stride,
+        u_plane + (y / 2) * u_stride, v_plane + (y / 2) * v_stride, width);
+  }
+}
+
+void
+kms_video_kernels_rgbx_to_i420 (const guint8 * src, gint src_stride,
+    guint8 * const dst[], const gint dst_stride[], gint width, gint height)
+{
+  kms_video_kernels_rgbx_to_yuv (src, src_stride, dst[0], dst_stride[0],
+      dst[1], dst_stride[1], dst[2], dst_stride[2], width, height);
+}
+
+void
+kms_video_kernels_rgbx_to_nv12 (const guint8 * src, gint src_stride,
+    guint8 * const dst[], const gint dst_stride[], gint width, gint height)
+{
+  const KmsVideoKernelsTable *k = kms_video_kernels ();
+  gint y, cw = (width + 1) / 2, ch = (height + 1) / 2;
+  guint8 *u, *v;
+
+  u = g_malloc ((gsize) 2 * cw * ch);
+  v = u + cw * ch;
+
+  kms_video_kernels_rgbx_to_yuv (src, src_stride, dst[0], dst_stride[0],
+      u, cw, v, cw, width, height);
+
+  for (y = 0; y < ch; y++) {
+    k->interleave_uv_row (u + y * cw, v + y * cw, dst[1] + y * dst_stride[1],
+        cw);
+  }
+
+  g_free (u);
+}
+
+static void
+kms_video_kernels_downscale (const guint8 * src, gint src_stride,
+    guint8 * dst, gint dst_stride, gint width, gint height, guint factor,
+    guint bpp)
+{
+  const KmsVideoKernelsTable *k = kms_video_kernels ();
+  gint y, dst_height = height / factor, dst_width = width / factor;
+  guint8 *tmp0, *tmp1;
+
+  if (factor == 2) {
+    for (y = 0; y < dst_height; y++) {
+      const guint8 *s = src + 2 * y * src_stride;
+
+      k->downscale2_row (s, s + src_stride, dst + y * dst_stride, dst_width,
+          bpp);
+    }
+    return;
+  }
+
+  g_return_if_fail (factor == 4);
+
+  /* Two passes by 2, keeping only two rows of the intermediate image */
+  tmp0 = g_malloc ((gsize) 2 * (width / 2) * bpp);
+  tmp1 = tmp0 + (width / 2) * bpp;
+
+  for (y = 0; y < dst_height; y++) {
+    const guint8 *s = src + 4 * y * src_stride;
+
+    k->downscale2_row (s, s + src_stride, tmp0, width / 2, bpp);
+    k->downscale2_row (s + 2 * src_stride, s + 3 * src_stride, tmp1,
+        width / 2, bpp);
+    k->downscale2_row (tmp0, tmp1, dst + y * dst_stride, dst_width, bpp);
+  }
+
+  g_free (tmp0);
+}
+
+void
+kms_video_kernels_downscale_plane (const guint8 * src, gint src_stride,
+    guint8 * dst, gint dst_stride, gint width, gint height, guint factor)
+{
+  kms_video_kernels_downscale (src, src_stride, dst, dst_stride, width, height,
+      factor, 1);
+}
+
+void
+kms_video_kernels_luma_histogram (const guint8 * src, gint stride,
+    gint width, gint height, guint32 histogram[256])
+{
+  /* Several partial histograms avoid stalls on consecutive equal values,
+   * which are the common case in video. Scatter updates do not vectorize */
+  guint32 partial[4][256];
+  gint x, y, i;
+
+  memset (partial, 0, sizeof (partial));
+
+  for (y = 0; y < height; y++) {
+    const guint8 *row = src + y * stride;
+
+    for (x = 0; x + 4 <= width; x += 4) {
+      partial[0][row[x]]++;
+      partial[1][row[x + 1]]++;
+      partial[2][row[x + 2]]++;
+      partial[3][row[x + 3]]++;
+    }
+
+    for (; x < width; x++) {
+      partial[0][row[x]]++;
+    }
+  }
+
+  for (i = 0; i < 256; i++) {
+    histogram[i] = partial[0][i] + partial[1][i] + partial[2][i] +
+        partial[3][i];
+  }
+}
+
+/* Frame helpers */
+
+static gboolean
+kms_video_kernels_format_supported (GstVideoFormat format)
+{
+  return format == GST_VIDEO_FORMAT_I420 || format == GST_VIDEO_FORMAT_NV12
+      || format == GST_VIDEO_FORMAT_RGBx;
+}
+
+static void
+kms_video_kernels_plane_layout (const GstVideoFrame * frame, guint plane,
+    gint * width, gint * height, guint * bpp)
+{
+  guint comp;
+
+  for (comp = 0; comp < GST_VIDEO_FRAME_N_COMPONENTS (frame); comp++) {
+    if (GST_VIDEO_FRAME_COMP_PLANE (frame, comp) == plane) {
+      break;
+    }
+  }
+
+  *width = GST_VIDEO_FRAME_COMP_WIDTH (frame, comp);
+  *height = GST_VIDEO_FRAME_COMP_HEIGHT (frame, comp);
+  *bpp = GST_VIDEO_FRAME_COMP_PSTRIDE (frame, comp);
+}
+
+gboolean
+kms_video_kernels_convert_frame (const GstVideoFrame * src,
+    GstVideoFrame * dst)
+{
+  GstVideoFormat in = GST_VIDEO_FRAME_FORMAT (src);
+  GstVideoFormat out = GST_VIDEO_FRAME_FORMAT (dst);
+  gint width = GST_VIDEO_FRAME_WIDTH (src);
+  gint height = GST_VIDEO_FRAME_HEIGHT (src);
+  guint8 *const *s = (guint8 * const *) src->data;
+  guint8 *const *d = (guint8 * const *) dst->data;
+  const gint *ss = src->info.stride, *ds = dst->info.stride;
+
+  if (!kms_video_kernels_format_supported (in) ||
+      !kms_video_kernels_format_supported (out)) {
+    GST_DEBUG ("Unsupported conversion %s to %s",
+        gst_video_format_to_string (in), gst_video_format_to_string (out));
+    return FALSE;
+  }
+
+  if (width != GST_VIDEO_FRAME_WIDTH (dst) ||
+      height != GST_VIDEO_FRAME_HEIGHT (dst)) {
+    GST_DEBUG ("Frames sizes do not match");
+    return FALSE;
+  }
+
+  if (in == out) {
+    guint plane;
+
+    for (plane = 0; plane < GST_VIDEO_FRAME_N_PLANES (src); plane++) {
+      gint w, h;
+      guint bpp;
+
+      kms_video_kernels_plane_layout (src, plane, &w, &h, &bpp);
+      kms_video_kernels_copy_plane (s[plane], ss[plane], d[plane], ds[plane],
+          w * bpp, h);
+    }
+
+    return TRUE;
+  }
+
+  switch (in) {
+    case GST_VIDEO_FORMAT_I420:
+      if (out == GST_VIDEO_FORMAT_NV12) {
+        kms_video_kernels_i420_to_nv12 (s, ss, d, ds, width, height);
+      } else {
+        kms_video_kernels_i420_to_rgbx (s, ss, d[0], ds[0], width, height);
+      }
+      break;
+    case GST_VIDEO_FORMAT_NV12:
+      if (out == GST_VIDEO_FORMAT_I420) {
+        kms_video_kernels_nv12_to_i420 (s, ss, d, ds, width, height);
+      } else {
+        kms_video_kernels_nv12_to_rgbx (s, ss, d[0], ds[0], width, height);
+      }
+      break;
+    default:
+      if (out == GST_VIDEO_FORMAT_I420) {
+        kms_video_kernels_rgbx_to_i420 (s[0], ss[0], d, ds, width, height);
+      } else {
+        kms_video_kernels_rgbx_to_nv12 (s[0], ss[0], d, ds, width, height);
+      }
+      break;
+  }
+
+  return TRUE;
+}
+
+gboolean
+kms_video_kernels_downscale_frame (const GstVideoFrame * src,
+    GstVideoFrame * dst, guint factor)
+{
+  GstVideoFormat format = GST_VIDEO_FRAME_FORMAT (src);
+  gint width = GST_VIDEO_FRAME_WIDTH (src);
+  gint height = GST_VIDEO_FRAME_HEIGHT (src);
+  guint plane;
+
+  if (factor != 2 && factor != 4) {
+    GST_DEBUG ("Unsupported downscale factor %u", factor);
+    return FALSE;
+  }
+
+  if (!kms_video_kernels_format_supported (format) ||
+      format != GST_VIDEO_FRAME_FORMAT (dst)) {
+    GST_DEBUG ("Unsupported format %s", gst_video_format_to_string (format));
+    return FALSE;
+  }
+
+  /* Chroma planes must be downscaled by the same factor */
+  if (width % (2 * factor) != 0 || height % (2 * factor) != 0 ||
+      GST_VIDEO_FRAME_WIDTH (dst) != width / factor ||
+      GST_VIDEO_FRAME_HEIGHT (dst) != height / factor) {
+    GST_DEBUG ("Unsupported sizes for downscale by %u", factor);
+    return FALSE;
+  }
+
+  for (plane = 0; plane < GST_VIDEO_FRAME_N_PLANES (src); plane++) {
+    gint w, h;
+    guint bpp;
+
+    kms_video_kernels_plane_layout (src, plane, &w, &h, &bpp);
+    kms_video_kernels_downscale (GST_VIDEO_FRAME_PLANE_DATA (src, plane),
+        GST_VIDEO_FRAME_PLANE_STRIDE (src, plane),
+        GST_VIDEO_FRAME_PLANE_DATA (dst, plane),
+        GST_VIDEO_FRAME_PLANE_STRIDE (dst, plane), w, h, factor, bpp);
+  }
+
+  return TRUE;
+}
@@ -0,0 +1,95 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_VIDEO_KERNELS_H__
+#define __KMS_VIDEO_KERNELS_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+G_BEGIN_DECLS
+
+/**
+ * KmsVideoKernelsImpl:
+ *
+ * Instruction set used by the raw video kernels. The best one supported by
+ * the CPU is selected the first time a kernel is used. All of them produce
+ * exactly the same output.
+ */
+typedef enum
+{
+  KMS_VIDEO_KERNELS_SCALAR,
+  KMS_VIDEO_KERNELS_SSE41,
+  KMS_VIDEO_KERNELS_AVX2
+} KmsVideoKernelsImpl;
+
+KmsVideoKernelsImpl kms_video_kernels_get_impl (void);
+
+/* Selects a lower implementation, mainly for tests and benchmarks. It is not
+ * thread safe and returns the implementation actually in use */
+KmsVideoKernelsImpl kms_video_kernels_set_impl (KmsVideoKernelsImpl impl);
+
+const gchar * kms_video_kernels_impl_get_name (KmsVideoKernelsImpl impl);
+
+/*
+ * Plane based kernels. Planes follow the GstVideoFrame layout, so
+ * GST_VIDEO_FRAME_PLANE_DATA and GST_VIDEO_FRAME_PLANE_STRIDE can be passed
+ * directly. Colour conversions use BT.601 limited range and 4:2:0 chroma
+ * is computed as the average of each 2x2 block.
+ */
+
+void kms_video_kernels_copy_plane (const guint8 * src, gint src_stride,
+    guint8 * dst, gint dst_stride, gint width, gint height);
+
+void kms_video_kernels_i420_to_nv12 (guint8 * const src[],
+    const gint src_stride[], guint8 * const dst[], const gint dst_stride[],
+    gint width, gint height);
+void kms_video_kernels_nv12_to_i420 (guint8 * const src[],
+    const gint src_stride[], guint8 * const dst[], const gint dst_stride[],
+    gint width, gint height);
+
+void kms_video_kernels_i420_to_rgbx (guint8 * const src[],
+    const gint src_stride[], guint8 * dst, gint dst_stride, gint width,
+    gint height);
+void kms_video_kernels_nv12_to_rgbx (guint8 * const src[],
+    const gint src_stride[], guint8 * dst, gint dst_stride, gint width,
+    gint height);
+void kms_video_kernels_rgbx_to_i420 (const guint8 * src, gint src_stride,
+    guint8 * const dst[], const gint dst_stride[], gint width, gint height);
+void kms_video_kernels_rgbx_to_nv12 (const guint8 * src, gint src_stride,
+    guint8 * const dst[], const gint dst_stride[], gint width, gint height);
+
+/* Bilinear downscale of one 8 bit plane. Destination size is width / factor
+ * by height / factor; factor must be 2 or 4 */
+void kms_video_kernels_downscale_plane (const guint8 * src, gint src_stride,
+    guint8 * dst, gint dst_stride, gint width, gint height, guint factor);
+
+void kms_video_kernels_luma_histogram (const guint8 * src, gint stride,
+    gint width, gint height, guint32 histogram[256]);
+
+/*
+ * Frame helpers for raw video filters. They support I420, NV12 and RGBx and
+ * return FALSE when formats or sizes are not supported.
+ */
+gboolean kms_video_kernels_convert_frame (const GstVideoFrame * src,
+    GstVideoFrame * dst);
+gboolean kms_video_kernels_downscale_frame (const GstVideoFrame * src,
+    GstVideoFrame * dst, guint factor);
+
+G_END_DECLS
+
+#endif /* __KMS_VIDEO_KERNELS_H__ */
@@ -19,6 +19,7 @@
 #include <gst/gst.h>
 #include <glib.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "constants.h"
 
@@ -664,33 +665,280 @@ sdp_utils_media_has_rtcp_nack (const GstSDPMedia * media)
   return FALSE;
 }
 
+/* Media index */
+
+typedef struct _SdpIndexKey
+{
+  const gchar *name;
+  const gchar *token;
+  gsize len;
+} SdpIndexKey;
+
+struct _SdpMediaIndex
+{
+  const GstSDPMedia *media;
+
+  GHashTable *maps;             /* (name, format) -> first attribute value */
+  GHashTable *attrs;            /* set of (name, value) */
+  GHashTable *formats;          /* set of formats */
+  GHashTable *codecs;           /* codec name -> first payload type */
+};
+
+static void
+sdp_index_key_init (SdpIndexKey * key, const gchar * name,
+    const gchar * token, gsize len)
+{
+  key->name = name;
+  key->token = token;
+  key->len = len;
+}
+
+static SdpIndexKey *
+sdp_index_key_new (const gchar * name, const gchar * token, gsize len)
+{
+  SdpIndexKey *key = g_slice_new (SdpIndexKey);
+
+  sdp_index_key_init (key, name, token, len);
+
+  return key;
+}
+
+static void
+sdp_index_key_free (SdpIndexKey * key)
+{
+  g_slice_free (SdpIndexKey, key);
+}
+
+static SdpIndexKey *
+sdp_index_key_new_for_attribute (const GstSDPAttribute * attr)
+{
+  return sdp_index_key_new (attr->key, attr->value,
+      (attr->value != NULL) ? strlen (attr->value) : 0);
+}
+
+static guint
+sdp_index_key_hash (const SdpIndexKey * key)
+{
+  guint hash = g_str_hash (key->name);
+  gsize i;
+
+  for (i = 0; i < key->len; i++) {
+    hash = (hash << 5) + hash + key->token[i];
+  }
+
+  return hash;
+}
+
 static gboolean
-sdp_media_contains_attr (const GstSDPMedia * m, const GstSDPAttribute * attr)
+sdp_index_key_equal (const SdpIndexKey * k1, const SdpIndexKey * k2)
+{
+  if (k1->len != k2->len || (k1->token == NULL) != (k2->token == NULL)) {
+    return FALSE;
+  }
+
+  return g_strcmp0 (k1->name, k2->name) == 0 &&
+      (k1->len == 0 || memcmp (k1->token, k2->token, k1->len) == 0);
+}
+
+/* Length of the first space separated token of @value */
+static gsize
+sdp_index_token_len (const gchar * value)
+{
+  const gchar *space = strchr (value, ' ');
+
+  return (space != NULL) ? (gsize) (space - value) : strlen (value);
+}
+
+static void
+sdp_media_index_add_attribute (SdpMediaIndex * index,
+    const GstSDPAttribute * attr)
+{
+  SdpIndexKey *key;
+
+  if (attr->key == NULL) {
+    return;
+  }
+
+  g_hash_table_add (index->attrs, sdp_index_key_new_for_attribute (attr));
+
+  if (attr->value == NULL) {
+    return;
+  }
+
+  key = sdp_index_key_new (attr->key, attr->value,
+      sdp_index_token_len (attr->value));
+
+  if (g_hash_table_contains (index->maps, key)) {
+    /* Lookups return the first attribute, as a linear scan does */
+    sdp_index_key_free (key);
+  } else {
+    g_hash_table_insert (index->maps, key, (gpointer) attr->value);
+  }
+}
+
+static void
+sdp_media_index_add_codec (SdpMediaIndex * index, const gchar * format)
 {
+  const gchar *rtpmap, *slash;
+  gchar *name;
+
+  rtpmap = sdp_utils_media_index_get_rtpmap (index, format);
+
+  if (rtpmap == NULL || (slash = strchr (rtpmap, '/')) == NULL) {
+    return;
+  }
+
+  name = g_strndup (rtpmap, slash - rtpmap);
+
+  if (g_hash_table_contains (index->codecs, name)) {
+    g_free (name);
+  } else {
+    g_hash_table_insert (index->codecs, name,
+        GINT_TO_POINTER (atoi (format)));
+  }
+}
+
+SdpMediaIndex *
+sdp_utils_media_index_new (const GstSDPMedia * media)
+{
+  SdpMediaIndex *index;
+  guint i, len;
+
+  index = g_slice_new0 (SdpMediaIndex);
+  index->media = media;
+  index->maps = g_hash_table_new_full ((GHashFunc) sdp_index_key_hash,
+      (GEqualFunc) sdp_index_key_equal, (GDestroyNotify) sdp_index_key_free,
+      NULL);
+  index->attrs = g_hash_table_new_full ((GHashFunc) sdp_index_key_hash,
+      (GEqualFunc) sdp_index_key_equal, (GDestroyNotify) sdp_index_key_free,
+      NULL);
+  index->formats = g_hash_table_new (g_str_hash, g_str_equal);
+  index->codecs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      NULL);
+
+  len = gst_sdp_media_attributes_len (media);
+  for (i = 0; i < len; i++) {
+    sdp_media_index_add_attribute (index,
+        gst_sdp_media_get_attribute (media, i));
+  }
+
+  len = gst_sdp_media_formats_len (media);
+  for (i = 0; i < len; i++) {
+    const gchar *format = gst_sdp_media_get_format (media, i);
+
+    g_hash_table_add (index->formats, (gpointer) format);
+    sdp_media_index_add_codec (index, format);
+  }
+
+  return index;
+}
+
+void
+sdp_utils_media_index_free (SdpMediaIndex * index)
+{
+  g_hash_table_unref (index->maps);
+  g_hash_table_unref (index->attrs);
+  g_hash_table_unref (index->formats);
+  g_hash_table_unref (index->codecs);
+
+  g_slice_free (SdpMediaIndex, index);
+}
+
+const GstSDPMedia *
+sdp_utils_media_index_get_media (const SdpMediaIndex * index)
+{
+  return index->media;
+}
+
+const gchar *
+sdp_utils_media_index_get_attr_map_value (const SdpMediaIndex * index,
+    const gchar * name, const gchar * fmt)
+{
+  SdpIndexKey key;
+
+  if (fmt == NULL) {
+    return NULL;
+  }
+
+  sdp_index_key_init (&key, name, fmt, strlen (fmt));
+
+  return g_hash_table_lookup (index->maps, &key);
+}
+
+const gchar *
+sdp_utils_media_index_get_rtpmap (const SdpMediaIndex * index,
+    const gchar * format)
+{
+  const gchar *val;
   guint i;
+  gint pt;
 
-  for (i = 0;; i++) {
-    const gchar *val;
+  val = sdp_utils_media_index_get_attr_map_value (index, RTPMAP, format);
 
-    val = gst_sdp_media_get_attribute_val_n (m, attr->key, i);
+  if (val != NULL && (val = strchr (val, ' ')) != NULL) {
+    return val + 1;
+  }
 
-    if (val == NULL) {
-      /* Attribute is not present */
-      return FALSE;
-    }
+  for (i = 0; format[i] != '\0'; i++) {
+    if (!g_ascii_isdigit (format[i]))
+      return NULL;
+  }
 
-    if (g_strcmp0 (attr->value, val) == 0) {
-      /* Attribute found */
-      return TRUE;
-    }
+  pt = atoi (format);
+  if (pt > 34)
+    return NULL;
+
+  return rtpmaps[pt];
+}
+
+const gchar *
+sdp_utils_media_index_get_fmtp (const SdpMediaIndex * index,
+    const gchar * format)
+{
+  return sdp_utils_media_index_get_attr_map_value (index, FMTP, format);
+}
+
+gint
+sdp_utils_media_index_get_pt_for_codec_name (const SdpMediaIndex * index,
+    const gchar * codec_name)
+{
+  gpointer pt;
+
+  if (!g_hash_table_lookup_extended (index->codecs, codec_name, NULL, &pt)) {
+    return -1;
   }
 
-  return FALSE;
+  return GPOINTER_TO_INT (pt);
+}
+
+gboolean
+sdp_utils_media_index_has_format (const SdpMediaIndex * index,
+    const gchar * format)
+{
+  return format != NULL && g_hash_table_contains (index->formats, format);
+}
+
+gboolean
+sdp_utils_media_index_has_attribute (const SdpMediaIndex * index,
+    const GstSDPAttribute * attr)
+{
+  SdpIndexKey key;
+
+  if (attr->key == NULL) {
+    return FALSE;
+  }
+
+  sdp_index_key_init (&key, attr->key, attr->value,
+      (attr->value != NULL) ? strlen (attr->value) : 0);
+
+  return g_hash_table_contains (index->attrs, &key);
 }
 
 static gboolean
 sdp_media_equal_attributes (const GstSDPMedia * m1, const GstSDPMedia * m2)
 {
+  SdpMediaIndex *index;
+  gboolean ret = TRUE;
   guint i, len;
 
   len = gst_sdp_media_attributes_len (m1);
@@ -699,16 +947,18 @@ sdp_media_equal_attributes (const GstSDPMedia * m1, const GstSDPMedia * m2)
     return FALSE;
   }
 
-  for (i = 0; i < len; i++) {
+  index = sdp_utils_media_index_new (m2);
+
+  for (i = 0; i < len && ret; i++) {
     const GstSDPAttribute *attr;
 
     attr = gst_sdp_media_get_attribute (m1, i);
-    if (!sdp_media_contains_attr (m2, attr)) {
-      return FALSE;
-    }
+    ret = sdp_utils_media_index_has_attribute (index, attr);
   }
 
-  return TRUE;
+  sdp_utils_media_index_free (index);
+
+  return ret;
 }
 
 static gboolean
@@ -790,35 +1040,12 @@ sdp_utils_equal_medias (const GstSDPMedia * m1, const GstSDPMedia * m2)
   return sdp_media_equal_attributes (m1, m2);
 }
 
-static gboolean
-sdp_message_contains_attr (const GstSDPMessage * m,
-    const GstSDPAttribute * attr)
-{
-  guint i;
-
-  for (i = 0;; i++) {
-    const gchar *val;
-
-    val = gst_sdp_message_get_attribute_val_n (m, attr->key, i);
-
-    if (val == NULL) {
-      /* Attribute is not present */
-      return FALSE;
-    }
-
-    if (g_strcmp0 (attr->value, val) == 0) {
-      /* Attribute found */
-      return TRUE;
-    }
-  }
-
-  return FALSE;
-}
-
 static gboolean
 sdp_message_equal_attributes (const GstSDPMessage * msg1,
     const GstSDPMessage * msg2)
 {
+  GHashTable *attrs;
+  gboolean ret = TRUE;
   guint i, len;
 
   /* TODO: Check more fields of GstSDPMessage */
@@ -829,16 +1056,30 @@ sdp_message_equal_attributes (const GstSDPMessage * msg1,
     return FALSE;
   }
 
+  attrs = g_hash_table_new_full ((GHashFunc) sdp_index_key_hash,
+      (GEqualFunc) sdp_index_key_equal, (GDestroyNotify) sdp_index_key_free,
+      NULL);
+
   for (i = 0; i < len; i++) {
-    const GstSDPAttribute *attr;
+    const GstSDPAttribute *attr = gst_sdp_message_get_attribute (msg2, i);
 
-    attr = gst_sdp_message_get_attribute (msg1, i);
-    if (!sdp_message_contains_attr (msg2, attr)) {
-      return FALSE;
+    if (attr->key != NULL) {
+      g_hash_table_add (attrs, sdp_index_key_new_for_attribute (attr));
     }
   }
 
-  return TRUE;
+  for (i = 0; i < len && ret; i++) {
+    const GstSDPAttribute *attr = gst_sdp_message_get_attribute (msg1, i);
+    SdpIndexKey key;
+
+    sdp_index_key_init (&key, attr->key, attr->value,
+        (attr->value != NULL) ? strlen (attr->value) : 0);
+    ret = g_hash_table_contains (attrs, &key);
+  }
+
+  g_hash_table_unref (attrs);
+
+  return ret;
 }
 
 gboolean
@@ -985,32 +1226,12 @@ gint
 sdp_utils_get_pt_for_codec_name (const GstSDPMedia * media,
     const gchar * codec_name)
 {
-  const gchar *rtpmap;
-  guint j, f_len;
-  gint pt = -1;
-
-  f_len = gst_sdp_media_formats_len (media);
-  for (j = 0; j < f_len; j++) {
-    gchar *found_codec_name;
-    const gchar *payload = gst_sdp_media_get_format (media, j);
-
-    rtpmap = sdp_utils_sdp_media_get_rtpmap (media, payload);
-
-    if (!sdp_utils_get_data_from_rtpmap (rtpmap, &found_codec_name, NULL)) {
-      continue;
-    }
+  SdpMediaIndex *index;
+  gint pt;
 
-    if (g_strcmp0 (found_codec_name, codec_name) == 0) {
-      GST_ERROR ("Found codec name pt is: %u", atoi (payload));
-      pt = atoi (payload);
-    }
-
-    g_free (found_codec_name);
-
-    if (pt != -1) {
-      return pt;
-    }
-  }
+  index = sdp_utils_media_index_new (media);
+  pt = sdp_utils_media_index_get_pt_for_codec_name (index, codec_name);
+  sdp_utils_media_index_free (index);
 
   return pt;
 }
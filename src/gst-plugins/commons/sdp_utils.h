@@ -69,6 +69,24 @@ gboolean sdp_utils_is_pt_in_fmts (const GstSDPMedia * media, gint pt);
 
 gint sdp_utils_get_pt_for_codec_name (const GstSDPMedia *media, const gchar *codec_name);
 
+/*
+ * Read only view of a GstSDPMedia indexed by attribute, payload type and
+ * codec name. It is built once in linear time and reflects the media at that
+ * moment, so it must not be used after the media is modified or freed.
+ */
+typedef struct _SdpMediaIndex SdpMediaIndex;
+
+SdpMediaIndex * sdp_utils_media_index_new (const GstSDPMedia * media);
+void sdp_utils_media_index_free (SdpMediaIndex * index);
+const GstSDPMedia * sdp_utils_media_index_get_media (const SdpMediaIndex * index);
+
+const gchar * sdp_utils_media_index_get_attr_map_value (const SdpMediaIndex * index, const gchar * name, const gchar * fmt);
+const gchar * sdp_utils_media_index_get_rtpmap (const SdpMediaIndex * index, const gchar * format);
+const gchar * sdp_utils_media_index_get_fmtp (const SdpMediaIndex * index, const gchar * format);
+gint sdp_utils_media_index_get_pt_for_codec_name (const SdpMediaIndex * index, const gchar * codec_name);
+gboolean sdp_utils_media_index_has_format (const SdpMediaIndex * index, const gchar * format);
+gboolean sdp_utils_media_index_has_attribute (const SdpMediaIndex * index, const GstSDPAttribute * attr);
+
 gint sdp_utils_get_abs_send_time_id (const GstSDPMedia * media);
 gboolean sdp_utils_media_is_inactive (const GstSDPMedia * media);
 
@@ -106,6 +106,7 @@ enum
   PROP_LOCAL_DESC,
   PROP_REMOTE_DESC,
   PROP_STATE,
+  PROP_OFFER_TEMPLATE,
   N_PROPERTIES
 };
 
@@ -136,6 +137,20 @@ typedef struct _SdpSessionDescription
   gchar *version;
 } SdpSessionDescription;
 
+/*
+ * Shared offers generated by the handlers of the first agent that created
+ * an initial offer for a template key. They are cloned by next agents using
+ * the same key, whose handlers only complete them with their extensions.
+ */
+typedef struct _KmsSdpOfferTemplate
+{
+  KmsRefStruct ref;
+  GPtrArray *medias;
+
+  /* Handlers may write the address in their medias */
+  gchar *addr;
+} KmsSdpOfferTemplate;
+
 typedef struct _KmsSdpAgentCallbacksData
 {
   KmsSdpAgentCallbacks callbacks;
@@ -169,8 +184,13 @@ struct _KmsSdpAgentPrivate
   SdpSessionDescription remote;
 
   GSList *extensions;
+
+  gchar *offer_template;
 };
 
+static GMutex templates_mutex;
+static GHashTable *templates;   /* key -> KmsSdpOfferTemplate */
+
 #define SDP_AGENT_STATE(agent) kms_sdp_agent_states[(agent)->priv->state]
 #define SDP_AGENT_NEW_STATE(agent, new_state) do {               \
   GST_DEBUG_OBJECT ((agent), "State changed from '%s' to '%s'",  \
@@ -312,6 +332,70 @@ kms_sdp_agent_commit_state_operations (KmsSdpAgent * agent,
   }
 }
 
+static void
+kms_sdp_offer_template_destroy (KmsSdpOfferTemplate * tmpl)
+{
+  g_ptr_array_unref (tmpl->medias);
+  g_free (tmpl->addr);
+
+  g_slice_free (KmsSdpOfferTemplate, tmpl);
+}
+
+static KmsSdpOfferTemplate *
+kms_sdp_offer_template_new (const gchar * addr)
+{
+  KmsSdpOfferTemplate *tmpl;
+
+  tmpl = g_slice_new0 (KmsSdpOfferTemplate);
+  kms_ref_struct_init (KMS_REF_STRUCT_CAST (tmpl),
+      (GDestroyNotify) kms_sdp_offer_template_destroy);
+  tmpl->medias = g_ptr_array_new_with_free_func ((GDestroyNotify)
+      gst_sdp_media_free);
+  tmpl->addr = g_strdup (addr);
+
+  return tmpl;
+}
+
+static KmsSdpOfferTemplate *
+kms_sdp_offer_template_lookup (const gchar * key)
+{
+  KmsSdpOfferTemplate *tmpl = NULL;
+
+  g_mutex_lock (&templates_mutex);
+
+  if (templates != NULL) {
+    tmpl = g_hash_table_lookup (templates, key);
+  }
+
+  if (tmpl != NULL) {
+    kms_ref_struct_ref (KMS_REF_STRUCT_CAST (tmpl));
+  }
+
+  g_mutex_unlock (&templates_mutex);
+
+  return tmpl;
+}
+
+static void
+kms_sdp_offer_template_store (const gchar * key, KmsSdpOfferTemplate * tmpl)
+{
+  g_mutex_lock (&templates_mutex);
+
+  if (templates == NULL) {
+    templates = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        (GDestroyNotify) kms_ref_struct_unref);
+  }
+
+  if (!g_hash_table_contains (templates, key)) {
+    GST_DEBUG ("Compiled offer template '%s' with %u medias", key,
+        tmpl->medias->len);
+    g_hash_table_insert (templates, g_strdup (key),
+        kms_ref_struct_ref (KMS_REF_STRUCT_CAST (tmpl)));
+  }
+
+  g_mutex_unlock (&templates_mutex);
+}
+
 static void
 sdp_handler_destroy (SdpHandler * handler)
 {
@@ -408,6 +492,7 @@ kms_sdp_agent_finalize (GObject * object)
   g_rec_mutex_clear (&self->priv->mutex);
 
   g_free (self->priv->addr);
+  g_free (self->priv->offer_template);
 
   clear_sdp_session_description (&self->priv->local);
   clear_sdp_session_description (&self->priv->remote);
@@ -445,6 +530,9 @@ kms_sdp_agent_get_property (GObject * object, guint prop_id,
     case PROP_STATE:
       g_value_set_enum (value, self->priv->state);
       break;
+    case PROP_OFFER_TEMPLATE:
+      g_value_set_string (value, self->priv->offer_template);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -477,6 +565,10 @@ kms_sdp_agent_set_property (GObject * object, guint prop_id,
       g_free (self->priv->addr);
       self->priv->addr = g_value_dup_string (value);
       break;
+    case PROP_OFFER_TEMPLATE:
+      g_free (self->priv->offer_template);
+      self->priv->offer_template = g_value_dup_string (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -866,18 +958,11 @@ kms_sdp_agent_fire_on_answer_callback (KmsSdpAgent * agent,
 }
 
 static gboolean
-kms_sdp_agent_make_media_offer (KmsSdpAgent * agent, SdpHandler * sdp_handler,
-    GstSDPMessage * offer, guint index, GError ** err)
+kms_sdp_agent_add_media_offer (KmsSdpAgent * agent, SdpHandler * sdp_handler,
+    GstSDPMessage * offer, GstSDPMedia * media, guint index, GError ** err)
 {
-  GstSDPMedia *media;
   gboolean ret = TRUE;
 
-  media = kms_sdp_agent_create_proper_media_offer (agent, sdp_handler, err);
-
-  if (media == NULL) {
-    return FALSE;
-  }
-
   /* update index */
   sdp_handler->sdph->index = index;
 
@@ -895,6 +980,56 @@ kms_sdp_agent_make_media_offer (KmsSdpAgent * agent, SdpHandler * sdp_handler,
   return ret;
 }
 
+static GstSDPMedia *
+kms_sdp_agent_create_shared_media_offer (KmsSdpAgent * agent,
+    SdpHandler * sdp_handler, KmsSdpOfferTemplate * recording, GError ** err)
+{
+  GstSDPMedia *media, *copy;
+
+  media = kms_sdp_media_handler_create_shared_offer (sdp_handler->sdph->handler,
+      sdp_handler->sdph->media, err);
+
+  if (media == NULL) {
+    return NULL;
+  }
+
+  gst_sdp_media_copy (media, &copy);
+  g_ptr_array_add (recording->medias, copy);
+
+  if (!kms_sdp_media_handler_complete_shared_offer (sdp_handler->sdph->handler,
+          media, err)) {
+    gst_sdp_media_free (media);
+    return NULL;
+  }
+
+  sdp_handler->offer = TRUE;
+
+  return media;
+}
+
+static gboolean
+kms_sdp_agent_make_media_offer (KmsSdpAgent * agent, SdpHandler * sdp_handler,
+    GstSDPMessage * offer, guint index, KmsSdpOfferTemplate * recording,
+    GError ** err)
+{
+  GstSDPMedia *media;
+
+  if (recording != NULL && !sdp_handler->disabled && !sdp_handler->rejected
+      && !sdp_handler->unsupported && !sdp_handler->sdph->negotiated) {
+    media = kms_sdp_agent_create_shared_media_offer (agent, sdp_handler,
+        recording, err);
+  } else {
+    media = kms_sdp_agent_create_proper_media_offer (agent, sdp_handler, err);
+  }
+
+  if (media == NULL) {
+    return FALSE;
+  }
+
+  return kms_sdp_agent_add_media_offer (agent, sdp_handler, offer, media,
+      index, err);
+}
+
 static gboolean
 kms_sdp_agent_set_origin (GstSDPMessage * msg,
     const GstSDPOrigin * origin, GError ** error)
@@ -1076,13 +1211,44 @@ kms_sdp_agent_merge_offer_handlers (KmsSdpAgent * agent)
 
 static gboolean
 kms_sdp_agent_create_media_offer (KmsSdpAgent * agent, GstSDPMessage * offer,
-    GError ** error)
+    KmsSdpOfferTemplate * recording, GError ** error)
+{
+  guint index = 0;
+  GSList *l;
+
+  for (l = agent->priv->offer_handlers; l != NULL; l = g_slist_next (l)) {
+    if (!kms_sdp_agent_make_media_offer (agent, l->data, offer, index++,
+            recording, error)) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+static gboolean
+kms_sdp_agent_offer_template_matches (KmsSdpAgent * agent,
+    KmsSdpOfferTemplate * tmpl)
 {
   guint index = 0;
   GSList *l;
 
+  if (g_slist_length (agent->priv->offer_handlers) != tmpl->medias->len ||
+      g_strcmp0 (agent->priv->addr, tmpl->addr) != 0) {
+    return FALSE;
+  }
+
   for (l = agent->priv->offer_handlers; l != NULL; l = g_slist_next (l)) {
-    if (!kms_sdp_agent_make_media_offer (agent, l->data, offer, index++, error)) {
+    SdpHandler *sdp_handler = l->data;
+    GstSDPMedia *media = g_ptr_array_index (tmpl->medias, index++);
+
+    if (sdp_handler->disabled || sdp_handler->unsupported ||
+        sdp_handler->rejected || sdp_handler->sdph->negotiated) {
+      return FALSE;
+    }
+
+    if (g_strcmp0 (sdp_handler->sdph->media,
+            gst_sdp_media_get_media (media)) != 0) {
       return FALSE;
     }
   }
@@ -1090,6 +1256,120 @@ kms_sdp_agent_create_media_offer (KmsSdpAgent * agent, GstSDPMessage * offer,
   return TRUE;
 }
 
+/* Returns the completed medias, or NULL if a handler refused its copy */
+static GPtrArray *
+kms_sdp_agent_complete_offer_template (KmsSdpAgent * agent,
+    KmsSdpOfferTemplate * tmpl)
+{
+  GPtrArray *medias;
+  guint index = 0;
+  GSList *l;
+
+  medias = g_ptr_array_new_with_free_func ((GDestroyNotify)
+      gst_sdp_media_free);
+
+  for (l = agent->priv->offer_handlers; l != NULL; l = g_slist_next (l)) {
+    SdpHandler *sdp_handler = l->data;
+    GError *err = NULL;
+    GstSDPMedia *media;
+
+    gst_sdp_media_copy (g_ptr_array_index (tmpl->medias, index++), &media);
+    g_ptr_array_add (medias, media);
+
+    /* Extensions keep per agent state, so they run on every copy */
+    if (!kms_sdp_media_handler_complete_shared_offer (sdp_handler->sdph->
+            handler, media, &err)) {
+      GST_DEBUG_OBJECT (agent, "Handler %u can not use offer template: %s",
+          sdp_handler->sdph->id, err->message);
+      g_error_free (err);
+      g_ptr_array_unref (medias);
+
+      return NULL;
+    }
+  }
+
+  return medias;
+}
+
+static gboolean
+kms_sdp_agent_apply_offer_template (KmsSdpAgent * agent, GstSDPMessage * offer,
+    GPtrArray * medias, GError ** error)
+{
+  guint index = 0;
+  GSList *l;
+
+  /* Medias are handed over to the offer */
+  g_ptr_array_set_free_func (medias, NULL);
+
+  for (l = agent->priv->offer_handlers; l != NULL;
+      l = g_slist_next (l), index++) {
+    SdpHandler *sdp_handler = l->data;
+
+    sdp_handler->offer = TRUE;
+
+    /* Per endpoint fields are patched by the on_media_offer callback */
+    if (!kms_sdp_agent_add_media_offer (agent, sdp_handler, offer,
+            g_ptr_array_index (medias, index), index, error)) {
+      break;
+    }
+  }
+
+  if (l == NULL) {
+    return TRUE;
+  }
+
+  /* The medias after the failed one were not added */
+  for (index++; index < medias->len; index++) {
+    gst_sdp_media_free (g_ptr_array_index (medias, index));
+  }
+
+  return FALSE;
+}
+
+static gboolean
+kms_sdp_agent_create_initial_media_offer (KmsSdpAgent * agent,
+    GstSDPMessage * offer, GError ** error)
+{
+  KmsSdpOfferTemplate *tmpl;
+  GPtrArray *medias = NULL;
+  gboolean ret;
+
+  tmpl = kms_sdp_offer_template_lookup (agent->priv->offer_template);
+
+  if (tmpl != NULL && kms_sdp_agent_offer_template_matches (agent, tmpl)) {
+    medias = kms_sdp_agent_complete_offer_template (agent, tmpl);
+  }
+
+  if (medias != NULL) {
+    GST_LOG_OBJECT (agent, "Using offer template '%s'",
+        agent->priv->offer_template);
+    ret = kms_sdp_agent_apply_offer_template (agent, offer, medias, error);
+    g_ptr_array_unref (medias);
+    kms_ref_struct_unref (KMS_REF_STRUCT_CAST (tmpl));
+
+    return ret;
+  }
+
+  if (tmpl != NULL) {
+    GST_WARNING_OBJECT (agent, "Handlers do not match offer template '%s'",
+        agent->priv->offer_template);
+    kms_ref_struct_unref (KMS_REF_STRUCT_CAST (tmpl));
+
+    return kms_sdp_agent_create_media_offer (agent, offer, NULL, error);
+  }
+
+  tmpl = kms_sdp_offer_template_new (agent->priv->addr);
+  ret = kms_sdp_agent_create_media_offer (agent, offer, tmpl, error);
+
+  if (ret && kms_sdp_agent_offer_template_matches (agent, tmpl)) {
+    kms_sdp_offer_template_store (agent->priv->offer_template, tmpl);
+  }
+
+  kms_ref_struct_unref (KMS_REF_STRUCT_CAST (tmpl));
+
+  return ret;
+}
+
 static gboolean
 kms_sdp_agent_offer_processing_extensions (KmsSdpAgent * agent,
     GstSDPMessage * offer, gboolean pre_process, GError ** error)
@@ -1223,7 +1503,12 @@ kms_sdp_agent_create_offer_impl (KmsSdpAgent * agent, GError ** error)
   kms_sdp_agent_merge_offer_handlers (agent);
 
   /* Process medias */
-  if (!kms_sdp_agent_create_media_offer (agent, offer, error)) {
+  if (agent->priv->offer_template != NULL &&
+      agent->priv->state == KMS_SDP_AGENT_STATE_UNNEGOTIATED) {
+    if (!kms_sdp_agent_create_initial_media_offer (agent, offer, error)) {
+      goto end;
+    }
+  } else if (!kms_sdp_agent_create_media_offer (agent, offer, NULL, error)) {
     goto end;
   }
 
@@ -2066,6 +2351,13 @@ kms_sdp_agent_class_init (KmsSdpAgentClass * klass)
       KMS_SDP_AGENT_STATE_UNNEGOTIATED,
       G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
 
+  obj_properties[PROP_OFFER_TEMPLATE] = g_param_spec_string ("offer-template",
+      "Offer template",
+      "Agents with the same key share the medias of their initial offers. "
+      "It must identify every setting of the media handlers. Media "
+      "extensions still run for every agent", NULL,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (gobject_class,
       N_PROPERTIES, obj_properties);
 
@@ -2113,6 +2405,18 @@ kms_sdp_agent_new ()
   return agent;
 }
 
+void
+kms_sdp_agent_clear_offer_templates ()
+{
+  g_mutex_lock (&templates_mutex);
+
+  if (templates != NULL) {
+    g_hash_table_remove_all (templates);
+  }
+
+  g_mutex_unlock (&templates_mutex);
+}
+
 /* TODO: rename to _add_media_handler */
 gint
 kms_sdp_agent_add_proto_handler (KmsSdpAgent * agent, const gchar * media,
@@ -133,6 +133,15 @@ typedef struct {
 void kms_sdp_agent_set_callbacks (KmsSdpAgent * agent,
   KmsSdpAgentCallbacks * callbacks, gpointer user_data, GDestroyNotify destroy);
 
+/*
+ * Initial offers of agents with the "offer-template" property set reuse the
+ * medias generated by the first agent with the same key. Only the origin
+ * and what the on_media_offer callback adds (ssrc, cname, ice...) differ
+ * between them, so media extensions are not run again. Agents whose media
+ * extensions generate per agent attributes (e.g. SDES keys) must not set it.
+ */
+void kms_sdp_agent_clear_offer_templates ();
+
 gboolean kms_sdp_media_handler_set_parent (KmsSdpMediaHandler *handler, KmsSdpAgent * parent, GError **error);
 
 G_END_DECLS
@@ -125,6 +125,9 @@ struct _KmsSdpMediaHandlerPrivate
   GSList *extensions;
   gint id;
   KmsSdpAgent *parent;
+
+  /* Extensions are left out of offers while this is set */
+  gboolean shared_offer;
 };
 
 static void
@@ -270,6 +273,33 @@ kms_sdp_media_handler_add_media_extension_impl (KmsSdpMediaHandler * handler,
   return TRUE;
 }
 
+static void
+kms_sdp_media_handler_add_offer_extensions (KmsSdpMediaHandler * handler,
+    GstSDPMedia * offer)
+{
+  GError *err = NULL;
+  GSList *l;
+
+  for (l = handler->priv->extensions; l != NULL; l = g_slist_next (l)) {
+    KmsISdpMediaExtension *ext = KMS_I_SDP_MEDIA_EXTENSION (l->data);
+
+    if (!kms_i_sdp_media_extension_add_offer_attributes (ext, offer, &err)) {
+      GST_ERROR_OBJECT (ext, "%s", err->message);
+      g_clear_error (&err);
+    }
+  }
+}
+
+static gboolean
+kms_sdp_media_handler_complete_shared_offer_impl (KmsSdpMediaHandler *
+    handler, GstSDPMedia * offer, GError ** error)
+{
+  /* Extensions keep per agent state (keys, stream ids...) */
+  kms_sdp_media_handler_add_offer_extensions (handler, offer);
+
+  return TRUE;
+}
+
 static gboolean
 is_direction_attr_present (const GstSDPMedia * media)
 {
@@ -351,8 +381,6 @@ static gboolean
 kms_sdp_media_handler_add_offer_attributes_impl (KmsSdpMediaHandler * handler,
     GstSDPMedia * offer, const GstSDPMedia * prev_offer, GError ** error)
 {
-  GError *err = NULL;
-  GSList *l;
   gint i;
 
   /* Add bandwidth attributes */
@@ -363,13 +391,8 @@ kms_sdp_media_handler_add_offer_attributes_impl (KmsSdpMediaHandler * handler,
     gst_sdp_media_add_bandwidth (offer, bw->bwtype, bw->bandwidth);
   }
 
-  for (l = handler->priv->extensions; l != NULL; l = g_slist_next (l)) {
-    KmsISdpMediaExtension *ext = KMS_I_SDP_MEDIA_EXTENSION (l->data);
-
-    if (!kms_i_sdp_media_extension_add_offer_attributes (ext, offer, &err)) {
-      GST_ERROR_OBJECT (ext, "%s", err->message);
-      g_clear_error (&err);
-    }
+  if (!handler->priv->shared_offer) {
+    kms_sdp_media_handler_add_offer_extensions (handler, offer);
   }
 
   return TRUE;
@@ -470,6 +493,8 @@ kms_sdp_media_handler_class_init (KmsSdpMediaHandlerClass * klass)
   klass->add_bandwidth = kms_sdp_media_handler_add_bandwidth_impl;
   klass->manage_protocol = kms_sdp_media_handler_manage_protocol_impl;
   klass->add_media_extension = kms_sdp_media_handler_add_media_extension_impl;
+  klass->complete_shared_offer =
+      kms_sdp_media_handler_complete_shared_offer_impl;
 
   klass->can_insert_attribute = kms_sdp_media_handler_can_insert_attribute_impl;
   klass->intersect_sdp_medias = kms_sdp_media_handler_intersect_sdp_medias_impl;
@@ -557,6 +582,33 @@ kms_sdp_media_handler_add_media_extension (KmsSdpMediaHandler * handler,
       ext);
 }
 
+GstSDPMedia *
+kms_sdp_media_handler_create_shared_offer (KmsSdpMediaHandler * handler,
+    const gchar * media, GError ** error)
+{
+  GstSDPMedia *offer;
+
+  g_return_val_if_fail (KMS_IS_SDP_MEDIA_HANDLER (handler), NULL);
+
+  handler->priv->shared_offer = TRUE;
+  offer = KMS_SDP_MEDIA_HANDLER_GET_CLASS (handler)->create_offer (handler,
+      media, NULL, error);
+  handler->priv->shared_offer = FALSE;
+
+  return offer;
+}
+
+gboolean
+kms_sdp_media_handler_complete_shared_offer (KmsSdpMediaHandler * handler,
+    GstSDPMedia * offer, GError ** error)
+{
+  g_return_val_if_fail (KMS_IS_SDP_MEDIA_HANDLER (handler), FALSE);
+
+  return
+      KMS_SDP_MEDIA_HANDLER_GET_CLASS (handler)->complete_shared_offer
+      (handler, offer, error);
+}
+
 gboolean
 kms_sdp_media_handler_set_id (KmsSdpMediaHandler * handler, guint id,
     GError ** error)
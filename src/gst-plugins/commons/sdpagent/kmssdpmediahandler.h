@@ -82,6 +82,7 @@ struct _KmsSdpMediaHandlerClass
   void (*add_bandwidth) (KmsSdpMediaHandler *handler, const gchar *bwtype, guint bandwidth);
   gboolean (*manage_protocol) (KmsSdpMediaHandler *handler, const gchar *protocol);
   gboolean (*add_media_extension) (KmsSdpMediaHandler *handler, KmsISdpMediaExtension *ext);
+  gboolean (*complete_shared_offer) (KmsSdpMediaHandler *handler, GstSDPMedia * offer, GError **error);
 
   /* private methods */
   gboolean (*can_insert_attribute) (KmsSdpMediaHandler *handler, const GstSDPMedia * offer, const GstSDPAttribute * attr, GstSDPMedia * answer, const GstSDPMessage *msg);
@@ -103,6 +104,16 @@ void kms_sdp_media_handler_add_bandwidth (KmsSdpMediaHandler *handler, const gch
 gboolean kms_sdp_media_handler_manage_protocol (KmsSdpMediaHandler *handler, const gchar *protocol);
 gboolean kms_sdp_media_handler_add_media_extension (KmsSdpMediaHandler *handler, KmsISdpMediaExtension *ext);
 
+/*
+ * Shared offers are initial offers without the attributes of the media
+ * extensions, so they can be copied to other handlers configured the same
+ * way. Each copy must be completed by the handler that offers it, which
+ * adds the attributes of its own extensions and fails if the copy does not
+ * match its configuration.
+ */
+GstSDPMedia * kms_sdp_media_handler_create_shared_offer (KmsSdpMediaHandler *handler, const gchar *media, GError **error);
+gboolean kms_sdp_media_handler_complete_shared_offer (KmsSdpMediaHandler *handler, GstSDPMedia * offer, GError **error);
+
 void kms_sdp_media_handler_remove_parent (KmsSdpMediaHandler *handler);
 gboolean kms_sdp_media_handler_set_id (KmsSdpMediaHandler *handler, guint id, GError **error);
 
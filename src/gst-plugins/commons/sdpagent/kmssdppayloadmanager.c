@@ -43,6 +43,15 @@ G_DEFINE_TYPE_WITH_CODE (KmsSdpPayloadManager,
 #define MIN_DYNAMIC_PAYLOAD 96
 #define MAX_DYNAMIC_PAYLOAD 127
 
+#define N_PAYLOADS (MAX_DYNAMIC_PAYLOAD + 1)
+
+/* One bit per dynamic payload type, bit 0 is MIN_DYNAMIC_PAYLOAD */
+#define DYNAMIC_BIT(pt) (1u << ((pt) - MIN_DYNAMIC_PAYLOAD))
+#define is_dynamic_pt(pt) \
+    ((pt) >= MIN_DYNAMIC_PAYLOAD && (pt) <= MAX_DYNAMIC_PAYLOAD)
+
+G_STATIC_ASSERT (MAX_DYNAMIC_PAYLOAD - MIN_DYNAMIC_PAYLOAD < 32);
+
 #define KMS_SDP_PAYLOAD_MANAGER_GET_PRIVATE(obj) (  \
   G_TYPE_INSTANCE_GET_PRIVATE (                     \
     (obj),                                          \
@@ -54,9 +63,11 @@ G_DEFINE_TYPE_WITH_CODE (KmsSdpPayloadManager,
 struct _KmsSdpPayloadManagerPrivate
 {
   GMutex mutex;
-  guint counter;                /* atomic */
+  guint counter;
   gboolean share_pts;
-  gchar *codecs[MAX_DYNAMIC_PAYLOAD + 1];
+  guint32 used;                 /* dynamic payload types given or registered */
+  gchar *codecs[N_PAYLOADS];
+  GHashTable *pts;              /* codec name -> payload type */
 };
 
 static void
@@ -65,7 +76,9 @@ kms_sdp_payload_manager_finalize (GObject * object)
   KmsSdpPayloadManager *self = KMS_SDP_PAYLOAD_MANAGER (object);
   gint i;
 
-  for (i = 0; i <= MAX_DYNAMIC_PAYLOAD; i++) {
+  g_hash_table_unref (self->priv->pts);
+
+  for (i = 0; i < N_PAYLOADS; i++) {
     g_free (self->priv->codecs[i]);
   }
 
@@ -90,6 +103,8 @@ kms_sdp_payload_manager_init (KmsSdpPayloadManager * self)
   self->priv = KMS_SDP_PAYLOAD_MANAGER_GET_PRIVATE (self);
   self->priv->counter = MIN_DYNAMIC_PAYLOAD;
   self->priv->share_pts = FALSE;
+  /* Keys are the strings in codecs, they are released with them */
+  self->priv->pts = g_hash_table_new (g_str_hash, g_str_equal);
   g_mutex_init (&self->priv->mutex);
 }
 
@@ -118,77 +133,102 @@ kms_sdp_payload_manager_new_same_codec_shares_pt ()
   return obj;
 }
 
+/* Must be called with the mutex held */
 static gint
-kms_sdp_payload_manager_get_next_int (KmsSdpPayloadManager * self,
+kms_sdp_payload_manager_get_next_free_pt (KmsSdpPayloadManager * self,
     GError ** error)
 {
-  gint val;
+  guint32 available;
+  gint pt;
 
-  val = g_atomic_int_add (&self->priv->counter, 1);
+  /* Payload types are never handed out twice, even if they are released */
+  if (is_dynamic_pt (self->priv->counter)) {
+    available = ~self->priv->used &
+        ~(DYNAMIC_BIT (self->priv->counter) - 1);
+  } else {
+    available = 0;
+  }
 
-  if (val <= MAX_DYNAMIC_PAYLOAD) {
-    return val;
+  if (available == 0) {
+    self->priv->counter = MAX_DYNAMIC_PAYLOAD + 1;
+    g_set_error_literal (error, KMS_SDP_AGENT_ERROR,
+        SDP_AGENT_INVALID_PARAMETER,
+        "Not more dynamic payload types available");
+    return -1;
   }
 
-  g_set_error_literal (error, KMS_SDP_AGENT_ERROR, SDP_AGENT_INVALID_PARAMETER,
-      "Not more dynamic payload types available");
+  pt = MIN_DYNAMIC_PAYLOAD + g_bit_nth_lsf (available, -1);
+  self->priv->counter = pt + 1;
+  self->priv->used |= DYNAMIC_BIT (pt);
 
-  return -1;
+  return pt;
 }
 
-static gint
-kms_sdp_payload_manager_get_dynamic_pt_from_list (KmsSdpPayloadManager * self,
-    GError ** error)
+/* Must be called with the mutex held */
+static void
+kms_sdp_payload_manager_release_pt (KmsSdpPayloadManager * self, gint pt)
 {
-  gint i;
+  gchar *codec = self->priv->codecs[pt];
 
-  do {
-    i = kms_sdp_payload_manager_get_next_int (self, error);
+  if (codec == NULL) {
+    return;
+  }
 
-    if (i < 0) {
-      return i;
-    }
+  if (GPOINTER_TO_INT (g_hash_table_lookup (self->priv->pts, codec)) == pt) {
+    g_hash_table_remove (self->priv->pts, codec);
+  }
 
-  } while (self->priv->codecs[i] != NULL);
+  if (is_dynamic_pt (pt)) {
+    self->priv->used &= ~DYNAMIC_BIT (pt);
+  }
 
-  return i;
+  g_free (codec);
+  self->priv->codecs[pt] = NULL;
 }
 
 static gint
 kms_sdp_payload_get_pt_for_codec (KmsSdpPayloadManager * self,
     const gchar * codec_name)
 {
-  gint i;
+  gpointer value;
+  gint pt;
+
+  if (!g_hash_table_lookup_extended (self->priv->pts, codec_name, NULL,
+          &value)) {
+    return -1;
+  }
 
-  for (i = MIN_DYNAMIC_PAYLOAD; i <= MAX_DYNAMIC_PAYLOAD; i++) {
-    if (g_strcmp0 (self->priv->codecs[i], codec_name) == 0) {
-      GST_DEBUG_OBJECT (self, "Got codec for pt %s %d", codec_name, i);
-      return i;
-    }
+  pt = GPOINTER_TO_INT (value);
+
+  if (!is_dynamic_pt (pt)) {
+    return -1;
   }
 
-  return -1;
+  GST_DEBUG_OBJECT (self, "Got codec for pt %s %d", codec_name, pt);
+
+  return pt;
 }
 
 static void
 kms_sdp_payload_manager_register_dynamic_payload_internal (KmsSdpPayloadManager
     * self, gint pt, const gchar * codec_name)
 {
-  gint i;
+  gpointer prev;
+  gchar *codec;
 
-  if (self->priv->codecs[pt] != NULL) {
-    g_free (self->priv->codecs[pt]);
-    self->priv->codecs[pt] = NULL;
-  }
+  kms_sdp_payload_manager_release_pt (self, pt);
 
-  for (i = MIN_DYNAMIC_PAYLOAD; i <= MAX_DYNAMIC_PAYLOAD; i++) {
-    if (g_strcmp0 (self->priv->codecs[i], codec_name) == 0) {
-      g_free (self->priv->codecs[i]);
-      self->priv->codecs[i] = NULL;
-    }
+  if (g_hash_table_lookup_extended (self->priv->pts, codec_name, NULL, &prev)) {
+    kms_sdp_payload_manager_release_pt (self, GPOINTER_TO_INT (prev));
   }
 
-  self->priv->codecs[pt] = g_strdup (codec_name);
+  codec = g_strdup (codec_name);
+  self->priv->codecs[pt] = codec;
+  g_hash_table_insert (self->priv->pts, codec, GINT_TO_POINTER (pt));
+
+  if (is_dynamic_pt (pt)) {
+    self->priv->used |= DYNAMIC_BIT (pt);
+  }
 
   GST_DEBUG_OBJECT (self, "Registering pt: %s -> %d", codec_name, pt);
 }
@@ -201,7 +241,11 @@ kms_sdp_payload_manager_get_dynamic_pt (KmsISdpPayloadManager * obj,
   gint pt;
 
   if (!self->priv->share_pts) {
-    return kms_sdp_payload_manager_get_next_int (self, error);
+    g_mutex_lock (&self->priv->mutex);
+    pt = kms_sdp_payload_manager_get_next_free_pt (self, error);
+    g_mutex_unlock (&self->priv->mutex);
+
+    return pt;
   }
 
   if (codec_name == NULL) {
@@ -217,7 +261,7 @@ kms_sdp_payload_manager_get_dynamic_pt (KmsISdpPayloadManager * obj,
     goto end;
   }
 
-  pt = kms_sdp_payload_manager_get_dynamic_pt_from_list (self, error);
+  pt = kms_sdp_payload_manager_get_next_free_pt (self, error);
 
   if (pt == -1) {
     goto end;
@@ -251,6 +295,12 @@ kms_sdp_payload_manager_register_dynamic_payload (KmsISdpPayloadManager * obj,
     return FALSE;
   }
 
+  if (pt < 0 || pt >= N_PAYLOADS) {
+    g_set_error (error, KMS_SDP_AGENT_ERROR, SDP_AGENT_INVALID_PARAMETER,
+        "Invalid payload type (%d)", pt);
+    return FALSE;
+  }
+
   g_mutex_lock (&self->priv->mutex);
   kms_sdp_payload_manager_register_dynamic_payload_internal (self, pt,
       codec_name);
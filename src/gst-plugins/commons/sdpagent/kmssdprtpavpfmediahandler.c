@@ -262,26 +262,6 @@ error:
   return NULL;
 }
 
-static gboolean
-format_supported (const GstSDPMedia * media, const gchar * fmt)
-{
-  guint i, len;
-
-  len = gst_sdp_media_formats_len (media);
-
-  for (i = 0; i < len; i++) {
-    const gchar *format;
-
-    format = gst_sdp_media_get_format (media, i);
-
-    if (g_strcmp0 (format, fmt) == 0) {
-      return TRUE;
-    }
-  }
-
-  return FALSE;
-}
-
 static gboolean
 supported_rtcp_fb_val (const gchar * val)
 {
@@ -296,8 +276,13 @@ kms_sdp_rtp_avpf_media_handler_filter_rtcp_fb_attrs (KmsSdpMediaHandler *
     handler, const GstSDPMedia * offer, GstSDPMedia * answer, GError ** error)
 {
   KmsSdpRtpAvpfMediaHandler *self = KMS_SDP_RTP_AVPF_MEDIA_HANDLER (handler);
+  SdpMediaIndex *index;
+  gboolean ret = TRUE;
   guint i;
 
+  /* Formats of the answer are already set, only attributes are added below */
+  index = sdp_utils_media_index_new (answer);
+
   for (i = 0;; i++) {
     const gchar *val;
     gchar **opts;
@@ -305,12 +290,12 @@ kms_sdp_rtp_avpf_media_handler_filter_rtcp_fb_attrs (KmsSdpMediaHandler *
     val = gst_sdp_media_get_attribute_val_n (offer, SDP_MEDIA_RTCP_FB, i);
 
     if (val == NULL) {
-      return TRUE;
+      break;
     }
 
     opts = g_strsplit (val, " ", 0);
 
-    if (!format_supported (answer, opts[0] /* format */ )) {
+    if (!sdp_utils_media_index_has_format (index, opts[0] /* format */ )) {
       /* Ignore rtcp-fb attribute */
       g_strfreev (opts);
       continue;
@@ -341,13 +326,16 @@ kms_sdp_rtp_avpf_media_handler_filter_rtcp_fb_attrs (KmsSdpMediaHandler *
       g_set_error (error, KMS_SDP_AGENT_ERROR, SDP_AGENT_UNEXPECTED_ERROR,
           "Cannot add media attribute 'a=%s:%s'", SDP_MEDIA_RTCP_FB, val);
       g_strfreev (opts);
-      return FALSE;
+      ret = FALSE;
+      break;
     }
 
     g_strfreev (opts);
   }
 
-  return TRUE;
+  sdp_utils_media_index_free (index);
+
+  return ret;
 }
 
 GstSDPMedia *
@@ -45,12 +45,20 @@ G_DEFINE_TYPE_WITH_CODE (KmsSdpRtpAvpMediaHandler,
   )                                                       \
 )
 
+typedef struct _KmsSdpRtpMapTable KmsSdpRtpMapTable;
+struct _KmsSdpRtpMapTable
+{
+  GQueue rtpmaps;               /* KmsSdpRtpMaps in the order they are offered */
+  GHashTable *names;            /* lowercase codec name -> KmsSdpRtpMap */
+  GHashTable *payloads;         /* payload type -> KmsSdpRtpMap */
+};
+
 struct _KmsSdpRtpAvpMediaHandlerPrivate
 {
   GHashTable *extmaps;
   KmsISdpPayloadManager *ptmanager;
-  GSList *audio_fmts;
-  GSList *video_fmts;
+  KmsSdpRtpMapTable audio_fmts;
+  KmsSdpRtpMapTable video_fmts;
 };
 
 #define SDP_AUDIO_MEDIA "audio"
@@ -144,6 +152,56 @@ kms_sdp_rtp_map_destroy_pointer (gpointer rtpmap)
   kms_sdp_rtp_map_destroy ((KmsSdpRtpMap *) rtpmap);
 }
 
+static void
+kms_sdp_rtp_map_table_init (KmsSdpRtpMapTable * table)
+{
+  g_queue_init (&table->rtpmaps);
+  table->names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  table->payloads = g_hash_table_new (g_direct_hash, g_direct_equal);
+}
+
+static void
+kms_sdp_rtp_map_table_clear (KmsSdpRtpMapTable * table)
+{
+  g_hash_table_unref (table->names);
+  g_hash_table_unref (table->payloads);
+
+  g_queue_foreach (&table->rtpmaps, (GFunc) kms_sdp_rtp_map_destroy_pointer,
+      NULL);
+  g_queue_clear (&table->rtpmaps);
+}
+
+static void
+kms_sdp_rtp_map_table_add (KmsSdpRtpMapTable * table, KmsSdpRtpMap * rtpmap)
+{
+  g_queue_push_tail (&table->rtpmaps, rtpmap);
+  g_hash_table_insert (table->names, g_ascii_strdown (rtpmap->name, -1),
+      rtpmap);
+  g_hash_table_insert (table->payloads, GUINT_TO_POINTER (rtpmap->payload),
+      rtpmap);
+}
+
+/* Encoding names are case-insensitive [rfc4566] section 6 */
+static KmsSdpRtpMap *
+kms_sdp_rtp_map_table_lookup_name (KmsSdpRtpMapTable * table,
+    const gchar * name)
+{
+  KmsSdpRtpMap *rtpmap;
+  gchar *key;
+
+  key = g_ascii_strdown (name, -1);
+  rtpmap = g_hash_table_lookup (table->names, key);
+  g_free (key);
+
+  return rtpmap;
+}
+
+static KmsSdpRtpMap *
+kms_sdp_rtp_map_table_lookup_payload (KmsSdpRtpMapTable * table, guint payload)
+{
+  return g_hash_table_lookup (table->payloads, GUINT_TO_POINTER (payload));
+}
+
 static gboolean
 cmp_static_payload (const gchar * enc, const gchar * static_pt)
 {
@@ -247,14 +305,14 @@ static gboolean
 kms_sdp_rtp_avp_media_handler_add_supported_fmts (KmsSdpRtpAvpMediaHandler *
     self, GstSDPMedia * media, GError ** error)
 {
-  GSList *item = NULL;
+  GList *item = NULL;
   gboolean is_audio;
 
   if (g_strcmp0 (gst_sdp_media_get_media (media), SDP_AUDIO_MEDIA) == 0) {
-    item = self->priv->audio_fmts;
+    item = self->priv->audio_fmts.rtpmaps.head;
     is_audio = TRUE;
   } else if (g_strcmp0 (gst_sdp_media_get_media (media), SDP_VIDEO_MEDIA) == 0) {
-    item = self->priv->video_fmts;
+    item = self->priv->video_fmts.rtpmaps.head;
     is_audio = FALSE;
   } else {
     g_set_error (error, KMS_SDP_AGENT_ERROR, SDP_AGENT_UNEXPECTED_ERROR,
@@ -310,7 +368,7 @@ kms_sdp_rtp_avp_media_handler_add_supported_fmts (KmsSdpRtpAvpMediaHandler *
     }
 
     g_free (fmt);
-    item = g_slist_next (item);
+    item = g_list_next (item);
   }
 
   return TRUE;
@@ -366,14 +424,14 @@ static gboolean
 kms_sdp_rtp_avp_media_handler_add_rtpmap_attrs (KmsSdpRtpAvpMediaHandler * self,
     GstSDPMedia * media, GError ** error)
 {
-  GSList *fmts = NULL;
+  KmsSdpRtpMapTable *fmts = NULL;
   gboolean omit;
   guint i;
 
   if (g_strcmp0 (gst_sdp_media_get_media (media), SDP_AUDIO_MEDIA) == 0) {
-    fmts = self->priv->audio_fmts;
+    fmts = &self->priv->audio_fmts;
   } else if (g_strcmp0 (gst_sdp_media_get_media (media), SDP_VIDEO_MEDIA) == 0) {
-    fmts = self->priv->video_fmts;
+    fmts = &self->priv->video_fmts;
   } else {
     g_set_error (error, KMS_SDP_AGENT_ERROR, SDP_AGENT_UNEXPECTED_ERROR,
         "Unsuported media '%s'", gst_sdp_media_get_media (media));
@@ -381,8 +439,8 @@ kms_sdp_rtp_avp_media_handler_add_rtpmap_attrs (KmsSdpRtpAvpMediaHandler * self,
   }
 
   for (i = 0; i < media->fmts->len; i++) {
+    KmsSdpRtpMap *rtpmap;
     gchar *payload;
-    GSList *item = NULL;
     guint pt;
 
     payload = g_array_index (media->fmts, gchar *, i);
@@ -392,34 +450,32 @@ kms_sdp_rtp_avp_media_handler_add_rtpmap_attrs (KmsSdpRtpAvpMediaHandler * self,
     /* numbers so it is completely defined in the RTP Audio/Video profile */
     omit = pt >= DEFAULT_RTP_AUDIO_BASE_PAYLOAD && pt <= G_N_ELEMENTS (rtpmaps);
 
-    for (item = fmts; item != NULL; item = g_slist_next (item)) {
-      KmsSdpRtpMap *rtpmap = item->data;
+    rtpmap = kms_sdp_rtp_map_table_lookup_payload (fmts, pt);
 
-      if (pt != rtpmap->payload) {
-        continue;
-      }
-
-      if (!omit) {
-        gchar *attr;
+    if (rtpmap == NULL) {
+      continue;
+    }
 
-        attr = g_strdup_printf ("%u %s", rtpmap->payload, rtpmap->name);
+    if (!omit) {
+      gchar *attr;
 
-        if (gst_sdp_media_add_attribute (media, "rtpmap", attr) != GST_SDP_OK) {
-          /* Add rtpmap attribute */
-          g_set_error (error, KMS_SDP_AGENT_ERROR, SDP_AGENT_UNEXPECTED_ERROR,
-              "Can not to set attribute 'rtpmap:%s'", attr);
-          g_free (attr);
-          return FALSE;
-        }
+      attr = g_strdup_printf ("%u %s", rtpmap->payload, rtpmap->name);
 
+      if (gst_sdp_media_add_attribute (media, "rtpmap", attr) != GST_SDP_OK) {
+        /* Add rtpmap attribute */
+        g_set_error (error, KMS_SDP_AGENT_ERROR, SDP_AGENT_UNEXPECTED_ERROR,
+            "Can not to set attribute 'rtpmap:%s'", attr);
         g_free (attr);
-      }
-
-      /* Add fmtp attributes */
-      if (!kms_sdp_rtp_avp_media_handler_add_fmtp_attrs (self, rtpmap, media,
-              error)) {
         return FALSE;
       }
+
+      g_free (attr);
+    }
+
+    /* Add fmtp attributes */
+    if (!kms_sdp_rtp_avp_media_handler_add_fmtp_attrs (self, rtpmap, media,
+            error)) {
+      return FALSE;
     }
   }
 
@@ -464,53 +520,53 @@ static gboolean
 kms_sdp_rtp_avp_media_handler_encoding_supported (KmsSdpRtpAvpMediaHandler *
     self, const GstSDPMedia * media, const gchar * enc, gint pt)
 {
-  GSList *item = NULL;
+  KmsSdpRtpMapTable *fmts = NULL;
+  KmsSdpRtpMap *rtpmap;
+  gint static_pt;
 
   if (g_strcmp0 (gst_sdp_media_get_media (media), SDP_AUDIO_MEDIA) == 0) {
-    item = self->priv->audio_fmts;
+    fmts = &self->priv->audio_fmts;
   } else if (g_strcmp0 (gst_sdp_media_get_media (media), SDP_VIDEO_MEDIA) == 0) {
-    item = self->priv->video_fmts;
+    fmts = &self->priv->video_fmts;
   } else {
     return FALSE;
   }
 
-  while (item != NULL) {
-    KmsSdpRtpMap *rtpmap = item->data;
-    gboolean supported = FALSE;
+  if (enc == NULL) {
+    return FALSE;
+  }
 
-    if (rtpmap->payload >= DEFAULT_RTP_AUDIO_BASE_PAYLOAD &&
-        rtpmap->payload <= G_N_ELEMENTS (rtpmaps)) {
-      /* Check static payload type */
-      supported = cmp_static_payload (enc, rtpmaps[rtpmap->payload]);
-    } else {
-      /* Check dynamic pt */
-      supported = g_ascii_strcasecmp (rtpmap->name, enc) == 0;
-      if (supported) {
-        kms_i_sdp_payload_manager_register_dynamic_payload (self->priv->
-            ptmanager, pt, rtpmap->name, NULL);
-      }
-    }
+  /* Check static payload type */
+  static_pt = get_static_payload_for_codec_name (enc);
+  if (static_pt >= 0 && kms_sdp_rtp_map_table_lookup_payload (fmts,
+          static_pt) != NULL) {
+    return TRUE;
+  }
 
-    if (supported) {
-      return TRUE;
-    } else {
-      item = g_slist_next (item);
-    }
+  /* Check dynamic pt */
+  rtpmap = kms_sdp_rtp_map_table_lookup_name (fmts, enc);
+  if (rtpmap == NULL || (rtpmap->payload >= DEFAULT_RTP_AUDIO_BASE_PAYLOAD &&
+          rtpmap->payload <= G_N_ELEMENTS (rtpmaps))) {
+    return FALSE;
   }
 
-  return FALSE;
+  kms_i_sdp_payload_manager_register_dynamic_payload (self->priv->ptmanager,
+      pt, rtpmap->name, NULL);
+
+  return TRUE;
 }
 
 static gboolean
 kms_sdp_rtp_avp_media_handler_format_supported (KmsSdpRtpAvpMediaHandler * self,
-    const GstSDPMedia * media, const gchar * fmt)
+    const SdpMediaIndex * index, const gchar * fmt)
 {
+  const GstSDPMedia *media = sdp_utils_media_index_get_media (index);
   const gchar *val;
   gchar **attrs;
   gboolean ret;
   gint pt;
 
-  val = sdp_utils_get_attr_map_value (media, "rtpmap", fmt);
+  val = sdp_utils_media_index_get_attr_map_value (index, "rtpmap", fmt);
   pt = atoi (fmt);
 
   if (val == NULL) {
@@ -584,9 +640,10 @@ static gboolean
 
 static gboolean
     kms_sdp_rtp_avp_media_handler_add_supported_rtpmap_attrs
-    (KmsSdpRtpAvpMediaHandler * self, const GstSDPMedia * offer,
+    (KmsSdpRtpAvpMediaHandler * self, const SdpMediaIndex * index,
     GstSDPMedia * answer, GError ** error)
 {
+  const GstSDPMedia *offer = sdp_utils_media_index_get_media (index);
   guint i, len;
 
   len = gst_sdp_media_formats_len (answer);
@@ -595,7 +652,7 @@ static gboolean
     const gchar *fmt, *val;
 
     fmt = gst_sdp_media_get_format (answer, i);
-    val = sdp_utils_get_attr_map_value (offer, "rtpmap", fmt);
+    val = sdp_utils_media_index_get_attr_map_value (index, "rtpmap", fmt);
 
     if (val == NULL) {
       gint pt;
@@ -874,8 +931,9 @@ kms_sdp_rtp_avp_media_handler_add_new_offer_attributes (KmsSdpRtpAvpMediaHandler
 
 static gboolean
 kms_sdp_rtp_avp_media_handler_set_supported_fmts (KmsSdpRtpAvpMediaHandler *
-    self, const GstSDPMedia * origin, GstSDPMedia * target, GError ** error)
+    self, const SdpMediaIndex * index, GstSDPMedia * target, GError ** error)
 {
+  const GstSDPMedia *origin = sdp_utils_media_index_get_media (index);
   guint i, len;
 
   len = gst_sdp_media_formats_len (origin);
@@ -886,7 +944,7 @@ kms_sdp_rtp_avp_media_handler_set_supported_fmts (KmsSdpRtpAvpMediaHandler *
 
     fmt = gst_sdp_media_get_format (origin, i);
 
-    if (!kms_sdp_rtp_avp_media_handler_format_supported (self, origin, fmt)) {
+    if (!kms_sdp_rtp_avp_media_handler_format_supported (self, index, fmt)) {
       continue;
     }
 
@@ -902,8 +960,9 @@ kms_sdp_rtp_avp_media_handler_set_supported_fmts (KmsSdpRtpAvpMediaHandler *
 
 static gboolean
 kms_sdp_rtp_avp_media_handler_add_supported_fmtp (KmsSdpRtpAvpMediaHandler *
-    self, const GstSDPMedia * prev_offer, GstSDPMedia * offer, GError ** error)
+    self, const SdpMediaIndex * index, GstSDPMedia * offer, GError ** error)
 {
+  const GstSDPMedia *prev_offer = sdp_utils_media_index_get_media (index);
   guint i, len;
 
   len = gst_sdp_media_formats_len (offer);
@@ -920,7 +979,7 @@ kms_sdp_rtp_avp_media_handler_add_supported_fmtp (KmsSdpRtpAvpMediaHandler *
       return FALSE;
     }
 
-    fmtp = sdp_utils_sdp_media_get_fmtp (prev_offer, payload);
+    fmtp = sdp_utils_media_index_get_fmtp (index, payload);
 
     if (fmtp == NULL) {
       continue;
@@ -941,11 +1000,16 @@ static gboolean
     (KmsSdpRtpAvpMediaHandler * self, GstSDPMedia * offer,
     const GstSDPMedia * prev_offer, GError ** error)
 {
+  SdpMediaIndex *index;
   guint port, num_ports;
+  gboolean ret = FALSE;
+
+  /* Every format of the previous offer is looked up several times */
+  index = sdp_utils_media_index_new (prev_offer);
 
-  if (!kms_sdp_rtp_avp_media_handler_set_supported_fmts (self, prev_offer,
+  if (!kms_sdp_rtp_avp_media_handler_set_supported_fmts (self, index,
           offer, error)) {
-    return FALSE;
+    goto end;
   }
 
   if (gst_sdp_media_formats_len (offer) > 0) {
@@ -960,21 +1024,26 @@ static gboolean
   if (gst_sdp_media_set_port_info (offer, port, num_ports) != GST_SDP_OK) {
     g_set_error_literal (error, KMS_SDP_AGENT_ERROR,
         SDP_AGENT_INVALID_PARAMETER, "Can not set port attribute");
-    return FALSE;
+    goto end;
   }
 
   if (!kms_sdp_rtp_avp_media_handler_add_supported_extmaps (self, prev_offer,
           offer, error)) {
-    return FALSE;
+    goto end;
   }
 
   if (!kms_sdp_rtp_avp_media_handler_add_supported_rtpmap_attrs (self,
-          prev_offer, offer, error)) {
-    return FALSE;
+          index, offer, error)) {
+    goto end;
   }
 
-  return kms_sdp_rtp_avp_media_handler_add_supported_fmtp (self, prev_offer,
+  ret = kms_sdp_rtp_avp_media_handler_add_supported_fmtp (self, index,
       offer, error);
+
+end:
+  sdp_utils_media_index_free (index);
+
+  return ret;
 }
 
 static gboolean
@@ -1044,8 +1113,11 @@ kms_sdp_rtp_avp_media_handler_add_answer_attributes_impl (KmsSdpMediaHandler *
     handler, const GstSDPMedia * offer, GstSDPMedia * answer, GError ** error)
 {
   KmsSdpRtpAvpMediaHandler *self = KMS_SDP_RTP_AVP_MEDIA_HANDLER (handler);
+  SdpMediaIndex *index;
   guint i, len, port;
+  gboolean ret = FALSE;
 
+  index = sdp_utils_media_index_new (offer);
   len = gst_sdp_media_formats_len (offer);
 
   /* Set only supported media formats in answer */
@@ -1054,14 +1126,14 @@ kms_sdp_rtp_avp_media_handler_add_answer_attributes_impl (KmsSdpMediaHandler *
 
     fmt = gst_sdp_media_get_format (offer, i);
 
-    if (!kms_sdp_rtp_avp_media_handler_format_supported (self, offer, fmt)) {
+    if (!kms_sdp_rtp_avp_media_handler_format_supported (self, index, fmt)) {
       continue;
     }
 
     if (gst_sdp_media_add_format (answer, fmt) != GST_SDP_OK) {
       g_set_error (error, KMS_SDP_AGENT_ERROR, SDP_AGENT_UNEXPECTED_ERROR,
           "Can add format '%s'", fmt);
-      return FALSE;
+      goto end;
     }
   }
 
@@ -1075,21 +1147,26 @@ kms_sdp_rtp_avp_media_handler_add_answer_attributes_impl (KmsSdpMediaHandler *
   if (gst_sdp_media_set_port_info (answer, port, 1) != GST_SDP_OK) {
     g_set_error_literal (error, KMS_SDP_AGENT_ERROR,
         SDP_AGENT_INVALID_PARAMETER, "Can not set port attribute");
-    return FALSE;
+    goto end;
   }
 
   if (!kms_sdp_rtp_avp_media_handler_add_supported_extmaps (self, offer,
           answer, error)) {
-    return FALSE;
+    goto end;
   }
 
   if (!KMS_SDP_MEDIA_HANDLER_CLASS (parent_class)->add_answer_attributes
       (handler, offer, answer, error)) {
-    return FALSE;
+    goto end;
   }
 
-  return kms_sdp_rtp_avp_media_handler_add_supported_rtpmap_attrs (self, offer,
+  ret = kms_sdp_rtp_avp_media_handler_add_supported_rtpmap_attrs (self, index,
       answer, error);
+
+end:
+  sdp_utils_media_index_free (index);
+
+  return ret;
 }
 
 static void
@@ -1103,12 +1180,70 @@ kms_sdp_rtp_avp_media_handler_finalize (GObject * object)
 
   g_clear_object (&self->priv->ptmanager);
 
-  g_slist_free_full (self->priv->audio_fmts, kms_sdp_rtp_map_destroy_pointer);
-  g_slist_free_full (self->priv->video_fmts, kms_sdp_rtp_map_destroy_pointer);
+  kms_sdp_rtp_map_table_clear (&self->priv->audio_fmts);
+  kms_sdp_rtp_map_table_clear (&self->priv->video_fmts);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+static gboolean
+kms_sdp_rtp_avp_media_handler_complete_shared_offer (KmsSdpMediaHandler *
+    handler, GstSDPMedia * offer, GError ** error)
+{
+  KmsSdpRtpAvpMediaHandler *self = KMS_SDP_RTP_AVP_MEDIA_HANDLER (handler);
+  KmsSdpRtpMapTable *fmts;
+  GList *item;
+  guint i, len;
+
+  if (g_strcmp0 (gst_sdp_media_get_media (offer), SDP_AUDIO_MEDIA) == 0) {
+    fmts = &self->priv->audio_fmts;
+  } else if (g_strcmp0 (gst_sdp_media_get_media (offer), SDP_VIDEO_MEDIA) == 0) {
+    fmts = &self->priv->video_fmts;
+  } else {
+    g_set_error (error, KMS_SDP_AGENT_ERROR, SDP_AGENT_UNEXPECTED_ERROR,
+        "Unsuported media '%s'", gst_sdp_media_get_media (offer));
+    return FALSE;
+  }
+
+  /* Dynamic payload types were assigned by the payload manager of each    */
+  /* handler, so the shared ones must be the same this handler would offer */
+  len = gst_sdp_media_formats_len (offer);
+
+  if (len != g_queue_get_length (&fmts->rtpmaps)) {
+    g_set_error_literal (error, KMS_SDP_AGENT_ERROR,
+        SDP_AGENT_INVALID_PARAMETER, "Shared offer has other payloads");
+    return FALSE;
+  }
+
+  for (i = 0, item = fmts->rtpmaps.head; i < len; i++, item = item->next) {
+    KmsSdpRtpMap *rtpmap = item->data;
+    const gchar *fmt, *val;
+    gboolean match;
+
+    fmt = gst_sdp_media_get_format (offer, i);
+    val = sdp_utils_get_attr_map_value (offer, "rtpmap", fmt);
+    match = rtpmap->payload == atoi (fmt);
+
+    if (match && val != NULL) {
+      gchar *attr = g_strdup_printf ("%u %s", rtpmap->payload, rtpmap->name);
+
+      match = g_ascii_strcasecmp (val, attr) == 0;
+      g_free (attr);
+    }
+
+    if (!match) {
+      g_set_error (error, KMS_SDP_AGENT_ERROR, SDP_AGENT_INVALID_PARAMETER,
+          "Shared offer uses payload %s for other codec than '%s'", fmt,
+          rtpmap->name);
+      return FALSE;
+    }
+  }
+
+  return
+      KMS_SDP_MEDIA_HANDLER_CLASS (parent_class)->complete_shared_offer
+      (handler, offer, error);
+}
+
 static void
 kms_sdp_rtp_avp_media_handler_class_init (KmsSdpRtpAvpMediaHandlerClass * klass)
 {
@@ -1122,6 +1257,8 @@ kms_sdp_rtp_avp_media_handler_class_init (KmsSdpRtpAvpMediaHandlerClass * klass)
   handler_class = KMS_SDP_MEDIA_HANDLER_CLASS (klass);
   handler_class->create_offer = kms_sdp_rtp_avp_media_handler_create_offer;
   handler_class->create_answer = kms_sdp_rtp_avp_media_handler_create_answer;
+  handler_class->complete_shared_offer =
+      kms_sdp_rtp_avp_media_handler_complete_shared_offer;
 
   handler_class->can_insert_attribute =
       kms_sdp_rtp_avp_media_handler_can_insert_attribute;
@@ -1146,6 +1283,9 @@ kms_sdp_rtp_avp_media_handler_init (KmsSdpRtpAvpMediaHandler * self)
 
   self->priv->extmaps =
       g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+
+  kms_sdp_rtp_map_table_init (&self->priv->audio_fmts);
+  kms_sdp_rtp_map_table_init (&self->priv->video_fmts);
 }
 
 KmsSdpRtpAvpMediaHandler *
@@ -1195,28 +1335,12 @@ kms_sdp_rtp_avp_media_handler_use_payload_manager (KmsSdpRtpAvpMediaHandler *
   return TRUE;
 }
 
-static gboolean
-is_codec_used (GSList * rtpmaps, const gchar * name)
-{
-  GSList *l;
-
-  for (l = rtpmaps; l != NULL; l = l->next) {
-    KmsSdpRtpMap *rtpmap = l->data;
-
-    if (g_strcmp0 (rtpmap->name, name) == 0) {
-      return TRUE;
-    }
-  }
-
-  return FALSE;
-}
-
 static gint
 kms_sdp_rtp_avp_media_handler_add_codec (KmsSdpRtpAvpMediaHandler * self,
     const gchar * media, const gchar * name, GError ** error)
 {
+  KmsSdpRtpMapTable *fmts;
   KmsSdpRtpMap *rtpmap;
-  GSList **fmts;
 
   if (g_strcmp0 (media, SDP_AUDIO_MEDIA) == 0) {
     fmts = &self->priv->audio_fmts;
@@ -1228,7 +1352,7 @@ kms_sdp_rtp_avp_media_handler_add_codec (KmsSdpRtpAvpMediaHandler * self,
     return -1;
   }
 
-  if (is_codec_used (*fmts, name)) {
+  if (kms_sdp_rtp_map_table_lookup_name (fmts, name) != NULL) {
     g_set_error (error, KMS_SDP_AGENT_ERROR, SDP_AGENT_UNEXPECTED_ERROR,
         "Codec %s is already used", name);
     return -1;
@@ -1240,7 +1364,7 @@ kms_sdp_rtp_avp_media_handler_add_codec (KmsSdpRtpAvpMediaHandler * self,
     return -1;
   }
 
-  *fmts = g_slist_append (*fmts, rtpmap);
+  kms_sdp_rtp_map_table_add (fmts, rtpmap);
 
   return rtpmap->payload;
 }
@@ -1275,12 +1399,6 @@ gint kms_sdp_rtp_avp_media_handler_add_generic_video_payload
       error);
 }
 
-static gint
-find_rtpmap_payload (KmsSdpRtpMap * rtpmap, guint * payload)
-{
-  return rtpmap->payload - *payload;
-}
-
 gboolean
 kms_sdp_rtp_avp_media_handler_add_fmtp (KmsSdpRtpAvpMediaHandler * self,
     guint payload, const gchar * value, GError ** error)
@@ -1288,17 +1406,16 @@ kms_sdp_rtp_avp_media_handler_add_fmtp (KmsSdpRtpAvpMediaHandler * self,
   GstSDPAttribute *fmtp;
   KmsSdpRtpMap *rtpmap;
   gchar *attr;
-  GSList *l;
 
-  l = g_slist_find_custom (self->priv->audio_fmts, &payload,
-      (GCompareFunc) find_rtpmap_payload);
+  rtpmap = kms_sdp_rtp_map_table_lookup_payload (&self->priv->audio_fmts,
+      payload);
 
-  if (l == NULL) {
-    l = g_slist_find_custom (self->priv->video_fmts, &payload,
-        (GCompareFunc) find_rtpmap_payload);
+  if (rtpmap == NULL) {
+    rtpmap = kms_sdp_rtp_map_table_lookup_payload (&self->priv->video_fmts,
+        payload);
   }
 
-  if (l == NULL) {
+  if (rtpmap == NULL) {
     g_set_error (error, KMS_SDP_AGENT_ERROR, SDP_AGENT_INVALID_PARAMETER,
         "Invalid payload (%d)", payload);
     return FALSE;
@@ -1317,7 +1434,6 @@ kms_sdp_rtp_avp_media_handler_add_fmtp (KmsSdpRtpAvpMediaHandler * self,
 
   g_free (attr);
 
-  rtpmap = l->data;
   rtpmap->fmtps = g_slist_prepend (rtpmap->fmtps, fmtp);
 
   return TRUE;
@@ -405,6 +405,7 @@ kms_agnostic_bin2_link_to_tee (KmsAgnosticBin2 * self, GstPad * pad,
     GstElement * tee, GstCaps * caps)
 {
   GstElement *queue = gst_element_factory_make ("queue", NULL);
+  KmsCapsClass caps_class = kms_utils_caps_classify (caps);
   GstPad *target;
   GstProxyPad *proxy;
 
@@ -412,12 +413,12 @@ kms_agnostic_bin2_link_to_tee (KmsAgnosticBin2 * self, GstPad * pad,
   gst_element_sync_state_with_parent (queue);
 
   if (!(gst_caps_is_any (caps) || gst_caps_is_empty (caps))
-      && kms_utils_caps_are_raw (caps)) {
+      && (caps_class & KMS_CAPS_CLASS_RAW)) {
     GstElement *convert = kms_utils_create_convert_for_caps (caps);
     GstElement *rate = kms_utils_create_rate_for_caps (caps);
     GstElement *mediator = kms_utils_create_mediator_element (caps);
 
-    if (kms_utils_caps_are_video (caps)) {
+    if (caps_class & KMS_CAPS_CLASS_VIDEO) {
       g_object_set (queue, "leaky", 2, "max-size-time", LEAKY_TIME, NULL);
     }
 
@@ -527,11 +528,12 @@ kms_agnostic_bin2_find_bin_for_caps (KmsAgnosticBin2 * self, GstCaps * caps)
 static GstCaps *
 kms_agnostic_bin2_get_raw_caps (const GstCaps * caps)
 {
+  KmsCapsClass caps_class = kms_utils_caps_classify (caps);
   GstCaps *raw_caps = NULL;
 
-  if (kms_utils_caps_are_audio (caps)) {
+  if (caps_class & KMS_CAPS_CLASS_AUDIO) {
     raw_caps = gst_static_caps_get (&static_raw_audio_caps);
-  } else if (kms_utils_caps_are_video (caps)) {
+  } else if (caps_class & KMS_CAPS_CLASS_VIDEO) {
     raw_caps = gst_static_caps_get (&static_raw_video_caps);
   }
 
@@ -1330,6 +1332,8 @@ kms_agnostic_bin2_init (KmsAgnosticBin2 * self)
   gst_pad_set_chain_list_function (self->priv->sink,
       kms_agnostic_bin2_sink_chain_list);
   kms_utils_manage_gaps (self->priv->sink);
+  /* Requests from every output of this source leave through the sink */
+  kms_utils_control_key_frames_request_duplicates (self->priv->sink);
   g_object_unref (templ);
   g_object_unref (target);
 
@@ -19,6 +19,8 @@
 #  include <config.h>
 #endif
 
+#include <string.h>
+
 #include "kmsagnosticbin3.h"
 #include "kmsagnosticcaps.h"
 #include "kms-core-marshal.h"
@@ -29,6 +31,23 @@
 #define KMS_AGNOSTICBIN3_SRC_PAD_DATA "kms-agnosticbin3-src-pad-data"
 G_DEFINE_QUARK (KMS_AGNOSTICBIN3_SRC_PAD_DATA, kms_agnosticbin3_src_pad_data);
 
+#define KMS_AGNOSTICBIN3_TRANSCODER_LOAD "kms-agnosticbin3-transcoder-load"
+G_DEFINE_QUARK (KMS_AGNOSTICBIN3_TRANSCODER_LOAD,
+    kms_agnosticbin3_transcoder_load);
+
+#define KMS_AGNOSTICBIN3_TRANSCODER_INPUT "kms-agnosticbin3-transcoder-input"
+G_DEFINE_QUARK (KMS_AGNOSTICBIN3_TRANSCODER_INPUT,
+    kms_agnosticbin3_transcoder_input);
+
+/* Input timestamps remembered to measure the processing latency */
+#define TRANSCODER_LOAD_WINDOW 32
+/* Processing latency equivalent to serving one more output */
+#define TRANSCODER_LATENCY_PER_OUTPUT (10 * GST_MSECOND)
+/* Above this latency a transcoder is not given new encodings */
+#define TRANSCODER_SATURATION_LATENCY (100 * GST_MSECOND)
+/* Maximum transcoders sharing the same input */
+#define TRANSCODERS_PER_INPUT 4
+
 #define GST_CAT_DEFAULT kms_agnostic_bin3_debug
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 
@@ -47,6 +66,7 @@ struct _KmsAgnosticBin3Private
 {
   GRecMutex mutex;
   GSList *agnosticbins;
+  guint n_spawned;
   GHashTable *sinkcaps;
 
   guint src_pad_count;
@@ -72,6 +92,15 @@ typedef enum
   KMS_SRC_PAD_STATE_LINKED
 } KmsSrcPadState;
 
+typedef struct _KmsTranscoderLoad
+{
+  GMutex mutex;
+  GstClockTime pts[TRANSCODER_LOAD_WINDOW];
+  GstClockTime time[TRANSCODER_LOAD_WINDOW];
+  guint next;
+  GstClockTime latency;         /* Moving average */
+} KmsTranscoderLoad;
+
 typedef struct _KmsSrcPadData
 {
   GMutex mutex;
@@ -109,9 +138,125 @@ GST_STATIC_PAD_TEMPLATE (AGNOSTICBIN3_SRC_PAD,
     GST_STATIC_CAPS (KMS_AGNOSTIC_CAPS_CAPS)
     );
 
-static gboolean set_transcoder_src_target_pad (GstGhostPad *, GstElement *);
+static gboolean set_transcoder_src_target_pad (GstGhostPad *, GstElement *,
+    gboolean);
 static GstElement *kms_agnosticbin3_get_element_for_transcoding (KmsAgnosticBin3
-    *);
+    *, const GstCaps *);
+
+static KmsTranscoderLoad *
+create_transcoder_load ()
+{
+  KmsTranscoderLoad *load;
+  guint i;
+
+  load = g_slice_new0 (KmsTranscoderLoad);
+  g_mutex_init (&load->mutex);
+
+  for (i = 0; i < TRANSCODER_LOAD_WINDOW; i++) {
+    load->pts[i] = GST_CLOCK_TIME_NONE;
+  }
+
+  return load;
+}
+
+static void
+destroy_transcoder_load (KmsTranscoderLoad * load)
+{
+  g_mutex_clear (&load->mutex);
+  g_slice_free (KmsTranscoderLoad, load);
+}
+
+/* Call this function with load mutex held */
+static void
+transcoder_load_add_input (KmsTranscoderLoad * load, GstBuffer * buffer,
+    GstClockTime now)
+{
+  guint prev;
+
+  if (!GST_BUFFER_PTS_IS_VALID (buffer)) {
+    return;
+  }
+
+  /* Buffers of the same frame share their timestamp */
+  prev = (load->next + TRANSCODER_LOAD_WINDOW - 1) % TRANSCODER_LOAD_WINDOW;
+  if (load->pts[prev] == GST_BUFFER_PTS (buffer)) {
+    return;
+  }
+
+  load->pts[load->next] = GST_BUFFER_PTS (buffer);
+  load->time[load->next] = now;
+  load->next = (load->next + 1) % TRANSCODER_LOAD_WINDOW;
+}
+
+static GstPadProbeReturn
+transcoder_load_input_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  KmsTranscoderLoad *load = user_data;
+  GstClockTime now = kms_utils_get_time_nsecs ();
+
+  g_mutex_lock (&load->mutex);
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    transcoder_load_add_input (load, GST_PAD_PROBE_INFO_BUFFER (info), now);
+  } else {
+    GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
+    guint i, len = gst_buffer_list_length (list);
+
+    for (i = 0; i < len; i++) {
+      transcoder_load_add_input (load, gst_buffer_list_get (list, i), now);
+    }
+  }
+
+  g_mutex_unlock (&load->mutex);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+transcoder_load_output_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  KmsTranscoderLoad *load = user_data;
+  GstClockTime now, elapsed;
+  GstBuffer *buffer;
+  guint i;
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+  } else {
+    GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
+    guint len = gst_buffer_list_length (list);
+
+    /* The frames of a list are done when its last buffer is */
+    if (len == 0) {
+      return GST_PAD_PROBE_OK;
+    }
+
+    buffer = gst_buffer_list_get (list, len - 1);
+  }
+
+  if (!GST_BUFFER_PTS_IS_VALID (buffer)) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  now = kms_utils_get_time_nsecs ();
+
+  g_mutex_lock (&load->mutex);
+
+  /* Encoders keep timestamps, so output buffers match their input ones */
+  for (i = 0; i < TRANSCODER_LOAD_WINDOW; i++) {
+    if (load->pts[i] == GST_BUFFER_PTS (buffer)) {
+      elapsed = now > load->time[i] ? now - load->time[i] : 0;
+      load->latency = (load->latency * 7 + elapsed) / 8;
+      break;
+    }
+  }
+
+  g_mutex_unlock (&load->mutex);
+
+  return GST_PAD_PROBE_OK;
+}
 
 static KmsSrcPadData *
 create_src_pad_data ()
@@ -184,6 +329,43 @@ get_transcoder_connected_to_sinkpad (GstPad * pad)
   return transcoder;
 }
 
+/* Gets the agnosticbin3 sink pad feeding @transcoder. [Transfer none] */
+static GstPad *
+get_transcoder_input (GstElement * transcoder)
+{
+  return g_object_get_qdata (G_OBJECT (transcoder),
+      kms_agnosticbin3_transcoder_input_quark ());
+}
+
+/* Only transcoded outputs are measured, passthrough ones do not load it */
+static GstPad *
+request_transcoder_src_pad (GstElement * transcoder, gboolean transcoding)
+{
+  KmsTranscoderLoad *load;
+  GstPad *target;
+
+  target = gst_element_get_request_pad (transcoder, "src_%u");
+
+  load = g_object_get_qdata (G_OBJECT (transcoder),
+      kms_agnosticbin3_transcoder_load_quark ());
+  if (target != NULL && load != NULL && transcoding) {
+    gst_pad_add_probe (target,
+        GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+        transcoder_load_output_probe, load, NULL);
+  }
+
+  return target;
+}
+
+/* Call this function with mutex held */
+static gboolean
+kms_agnostic_bin3_inputs_configured (KmsAgnosticBin3 * self)
+{
+  /* Spawned transcoders share the input of an already configured one */
+  return g_hash_table_size (self->priv->sinkcaps) ==
+      g_slist_length (self->priv->agnosticbins) - self->priv->n_spawned;
+}
+
 static void
 connect_srcpad_to_encoder (GstPad * srcpad, GstPad * sinkpad)
 {
@@ -237,8 +419,7 @@ connect_srcpad_to_encoder (GstPad * srcpad, GstPad * sinkpad)
   if (transcode) {
     gboolean supported;
 
-    if (g_hash_table_size (self->priv->sinkcaps) !=
-        g_slist_length (self->priv->agnosticbins)) {
+    if (!kms_agnostic_bin3_inputs_configured (self)) {
       /* Other transcoder which is not yet configured could */
       /* manage these capabilities */
       goto end;
@@ -255,7 +436,7 @@ connect_srcpad_to_encoder (GstPad * srcpad, GstPad * sinkpad)
     }
 
     /* no one upstream supports these capabilities we need to transcode */
-    transcoder = kms_agnosticbin3_get_element_for_transcoding (self);
+    transcoder = kms_agnosticbin3_get_element_for_transcoding (self, caps);
     GST_DEBUG_OBJECT (srcpad, "Connection requires transcoding");
   } else {
     transcoder = get_transcoder_connected_to_sinkpad (sinkpad);
@@ -267,7 +448,7 @@ connect_srcpad_to_encoder (GstPad * srcpad, GstPad * sinkpad)
     goto end;
   }
 
-  target = gst_element_get_request_pad (transcoder, "src_%u");
+  target = request_transcoder_src_pad (transcoder, transcode);
   g_object_unref (transcoder);
 
   GST_DEBUG_OBJECT (srcpad, "Setting target %" GST_PTR_FORMAT, target);
@@ -311,72 +492,222 @@ link_pending_src_pads (GstPad * srcpad, GstPad * sinkpad)
   g_object_unref (self);
 }
 
-static void
-append_transcoder_to_list (GstPad * sink, GSList ** elements)
+static gboolean
+caps_have_same_media (const GstCaps * caps1, const GstCaps * caps2)
 {
-  GstElement *e;
+  const gchar *name1, *name2;
+  const gchar *sep;
 
-  e = get_transcoder_connected_to_sinkpad (sink);
-  *elements = g_slist_prepend (*elements, e);
+  if (caps1 == NULL || caps2 == NULL || gst_caps_is_empty (caps1)
+      || gst_caps_is_empty (caps2) || gst_caps_is_any (caps1)
+      || gst_caps_is_any (caps2)) {
+    return TRUE;
+  }
+
+  name1 = gst_structure_get_name (gst_caps_get_structure (caps1, 0));
+  name2 = gst_structure_get_name (gst_caps_get_structure (caps2, 0));
+  sep = strchr (name1, '/');
+
+  if (sep == NULL) {
+    return TRUE;
+  }
+
+  /* Compare "audio/", "video/"... prefixes */
+  return strncmp (name1, name2, sep - name1 + 1) == 0;
 }
 
-static GSList *
-kms_agnosticbin3_get_configured_transcoders (KmsAgnosticBin3 * self)
+/* Lower is better. Call this function with mutex held */
+static gdouble
+kms_agnosticbin3_transcoder_score (GstElement * transcoder,
+    gboolean * saturated)
 {
-  GSList *transcoders = NULL;
-  GList *pads;
+  KmsTranscoderLoad *load;
+  GstClockTime latency = 0;
+  guint outputs;
+
+  GST_OBJECT_LOCK (transcoder);
+  outputs = transcoder->numsrcpads;
+  GST_OBJECT_UNLOCK (transcoder);
+
+  load = g_object_get_qdata (G_OBJECT (transcoder),
+      kms_agnosticbin3_transcoder_load_quark ());
+  if (load != NULL) {
+    g_mutex_lock (&load->mutex);
+    latency = load->latency;
+    g_mutex_unlock (&load->mutex);
+  }
 
-  pads = g_hash_table_get_keys (self->priv->sinkcaps);
+  *saturated = latency > TRANSCODER_SATURATION_LATENCY;
 
-  if (g_list_length (pads) <= 0) {
-    goto end;
+  return outputs + (gdouble) latency / TRANSCODER_LATENCY_PER_OUTPUT;
+}
+
+/* Adds a new transcoder whose load is measured. [Transfer none] */
+static GstElement *
+kms_agnostic_bin3_add_transcoder (KmsAgnosticBin3 * self)
+{
+  KmsTranscoderLoad *load;
+  GstElement *agnosticbin;
+  GstPad *sinkpad;
+
+  agnosticbin = gst_element_factory_make ("agnosticbin", NULL);
+
+  load = create_transcoder_load ();
+  g_object_set_qdata_full (G_OBJECT (agnosticbin),
+      kms_agnosticbin3_transcoder_load_quark (), load,
+      (GDestroyNotify) destroy_transcoder_load);
+
+  gst_bin_add (GST_BIN (self), agnosticbin);
+  gst_element_sync_state_with_parent (agnosticbin);
+
+  sinkpad = gst_element_get_static_pad (agnosticbin, "sink");
+  gst_pad_add_probe (sinkpad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      transcoder_load_input_probe, load, NULL);
+  g_object_unref (sinkpad);
+
+  return agnosticbin;
+}
+
+/* Feeds a new transcoder with the input of @saturated or returns NULL */
+/* if that input has no more transcoders available. [Transfer full]    */
+/* Call this function with mutex held */
+static GstElement *
+kms_agnostic_bin3_spawn_transcoder (KmsAgnosticBin3 * self,
+    GstElement * saturated)
+{
+  GstElement *source, *transcoder;
+  GstPad *input, *srcpad, *sinkpad;
+  guint count = 0;
+  GSList *l;
+
+  input = get_transcoder_input (saturated);
+  if (input == NULL) {
+    return NULL;
   }
 
-  g_list_foreach (pads, (GFunc) append_transcoder_to_list, &transcoders);
+  for (l = self->priv->agnosticbins; l != NULL; l = l->next) {
+    if (get_transcoder_input (GST_ELEMENT (l->data)) == input) {
+      count++;
+    }
+  }
 
-end:
+  if (count >= TRANSCODERS_PER_INPUT) {
+    GST_DEBUG_OBJECT (input, "All %u transcoders are saturated", count);
+    return NULL;
+  }
 
-  if (pads != NULL) {
-    g_list_free (pads);
+  /* Passthrough outputs of the first transcoder are a copy of the input */
+  source = get_transcoder_connected_to_sinkpad (input);
+  srcpad = request_transcoder_src_pad (source, FALSE);
+  if (srcpad == NULL) {
+    GST_ERROR_OBJECT (source, "Can not request src pad");
+    g_object_unref (source);
+    return NULL;
+  }
+
+  transcoder = kms_agnostic_bin3_add_transcoder (self);
+  sinkpad = gst_element_get_static_pad (transcoder, "sink");
+
+  if (gst_pad_link (srcpad, sinkpad) != GST_PAD_LINK_OK) {
+    GST_ERROR_OBJECT (self, "Can not link %" GST_PTR_FORMAT " to %"
+        GST_PTR_FORMAT, source, transcoder);
+    gst_element_release_request_pad (source, srcpad);
+    gst_element_set_state (transcoder, GST_STATE_NULL);
+    gst_bin_remove (GST_BIN (self), transcoder);
+    transcoder = NULL;
+  } else {
+    GST_DEBUG_OBJECT (self, "Spawned %" GST_PTR_FORMAT " for %"
+        GST_PTR_FORMAT, transcoder, input);
+    g_object_set_qdata (G_OBJECT (transcoder),
+        kms_agnosticbin3_transcoder_input_quark (), input);
+    self->priv->agnosticbins = g_slist_prepend (self->priv->agnosticbins,
+        transcoder);
+    self->priv->n_spawned++;
+    g_object_ref (transcoder);
   }
 
-  return transcoders;
+  g_object_unref (sinkpad);
+  g_object_unref (srcpad);
+  g_object_unref (source);
+
+  return transcoder;
 }
 
 /* Gets the transcoder that can manage these caps or NULL. [Transfer full] */
 static GstElement *
-kms_agnosticbin3_get_element_for_transcoding (KmsAgnosticBin3 * self)
+kms_agnosticbin3_get_element_for_transcoding (KmsAgnosticBin3 * self,
+    const GstCaps * caps)
 {
-  GstElement *transcoder = NULL;
-  guint index, len;
-  GSList *l, *transcoders;
+  GstElement *transcoder = NULL, *spawned;
+  gboolean best_saturated = TRUE;
+  gdouble best_score = 0;
+  GPtrArray *candidates;
+  guint index, i;
+  GSList *l;
 
+  /* Used to break ties, so equally loaded transcoders share the work */
   index = (guint) g_atomic_int_add (&self->priv->last, 1);
 
   KMS_AGNOSTIC_BIN3_LOCK (self);
 
-  transcoders = kms_agnosticbin3_get_configured_transcoders (self);
-  len = g_slist_length (transcoders);
+  candidates = g_ptr_array_new ();
+  for (l = self->priv->agnosticbins; l != NULL; l = l->next) {
+    GstPad *input = get_transcoder_input (GST_ELEMENT (l->data));
+    GstCaps *inputcaps;
 
-  if (len <= 0) {
-    goto end;
+    if (input == NULL) {
+      continue;
+    }
+
+    inputcaps = g_hash_table_lookup (self->priv->sinkcaps, input);
+    if (inputcaps != NULL && caps_have_same_media (inputcaps, caps)) {
+      g_ptr_array_add (candidates, l->data);
+    }
   }
 
-  index %= len;
-  l = g_slist_nth (transcoders, index);
-  transcoder = l->data;
+  for (i = 0; i < candidates->len; i++) {
+    GstElement *candidate;
+    gboolean saturated;
+    gdouble score;
 
-end:
+    candidate = g_ptr_array_index (candidates, (index + i) % candidates->len);
+    score = kms_agnosticbin3_transcoder_score (candidate, &saturated);
 
-  KMS_AGNOSTIC_BIN3_UNLOCK (self);
+    GST_TRACE_OBJECT (candidate, "Score: %f, saturated: %d", score,
+        saturated);
 
-  if (transcoder != NULL)
-    g_object_ref (transcoder);
+    /* Saturated transcoders are only used when all of them are */
+    if (transcoder == NULL || (best_saturated && !saturated)
+        || (saturated == best_saturated && score < best_score)) {
+      transcoder = candidate;
+      best_score = score;
+      best_saturated = saturated;
+    }
+  }
+
+  g_ptr_array_unref (candidates);
+
+  if (transcoder == NULL) {
+    goto end;
+  }
 
-  if (transcoders != NULL) {
-    g_slist_free_full (transcoders, (GDestroyNotify) g_object_unref);
+  if (best_saturated) {
+    spawned = kms_agnostic_bin3_spawn_transcoder (self, transcoder);
+    if (spawned != NULL) {
+      transcoder = spawned;
+      goto end;
+    }
   }
 
+  GST_DEBUG_OBJECT (self, "Selected %" GST_PTR_FORMAT " (score: %f%s)",
+      transcoder, best_score, best_saturated ? ", saturated" : "");
+  g_object_ref (transcoder);
+
+end:
+
+  KMS_AGNOSTIC_BIN3_UNLOCK (self);
+
   return transcoder;
 }
 
@@ -435,11 +766,7 @@ kms_agnostic_bin3_request_sink_pad (KmsAgnosticBin3 * self,
   GstPad *target, *pad = NULL;
   gchar *padname;
 
-  agnosticbin = gst_element_factory_make ("agnosticbin", NULL);
-
-  gst_bin_add (GST_BIN (self), agnosticbin);
-  gst_element_sync_state_with_parent (agnosticbin);
-
+  agnosticbin = kms_agnostic_bin3_add_transcoder (self);
   target = gst_element_get_static_pad (agnosticbin, "sink");
 
   padname = g_strdup_printf (AGNOSTICBIN3_SINK_PAD,
@@ -458,6 +785,9 @@ kms_agnostic_bin3_request_sink_pad (KmsAgnosticBin3 * self,
   g_free (padname);
   g_object_unref (target);
 
+  g_object_set_qdata (G_OBJECT (agnosticbin),
+      kms_agnosticbin3_transcoder_input_quark (), pad);
+
   KMS_AGNOSTIC_BIN3_LOCK (self);
 
   self->priv->agnosticbins = g_slist_prepend (self->priv->agnosticbins,
@@ -600,17 +930,17 @@ kms_agnostic_bin3_create_src_pad_with_transcodification (KmsAgnosticBin3 * self,
   transcoder = kms_agnostic_bin3_get_compatible_transcoder_tree (self, caps);
   if (transcoder != NULL) {
     GST_DEBUG_OBJECT (pad, "Connect without transcoding");
-    set_transcoder_src_target_pad (GST_GHOST_PAD (pad), transcoder);
+    set_transcoder_src_target_pad (GST_GHOST_PAD (pad), transcoder, FALSE);
     goto end;
   }
 
   GST_DEBUG_OBJECT (pad, "Connect forcing transcode");
 
   /* No compatible transcoder found. Force transcodification in one of them */
-  /* Get any available transcoder. Round robin will be used */
-  transcoder = kms_agnosticbin3_get_element_for_transcoding (self);
+  /* Get the least loaded transcoder */
+  transcoder = kms_agnosticbin3_get_element_for_transcoding (self, caps);
   if (transcoder != NULL) {
-    set_transcoder_src_target_pad (GST_GHOST_PAD (pad), transcoder);
+    set_transcoder_src_target_pad (GST_GHOST_PAD (pad), transcoder, TRUE);
   } else {
     /* There is not any configured transcoder yet */
     GST_DEBUG_OBJECT (pad, "Can not connect to any transcoder");
@@ -628,12 +958,13 @@ end:
 }
 
 static gboolean
-set_transcoder_src_target_pad (GstGhostPad * pad, GstElement * transcoder)
+set_transcoder_src_target_pad (GstGhostPad * pad, GstElement * transcoder,
+    gboolean transcoding)
 {
   GstPad *target;
   gboolean ret;
 
-  target = gst_element_get_request_pad (transcoder, "src_%u");
+  target = request_transcoder_src_pad (transcoder, transcoding);
 
   if (!(ret = gst_ghost_pad_set_target (GST_GHOST_PAD (pad), target))) {
     GST_ERROR_OBJECT (pad, "Can not set target pad");
@@ -668,7 +999,7 @@ kms_agnostic_bin3_create_src_pad_with_caps (KmsAgnosticBin3 * self,
 
     /* Create ghost pad connected to the transcoder element */
     pad = kms_agnostic_bin3_create_new_src_pad (self, templ);
-    if (set_transcoder_src_target_pad (GST_GHOST_PAD (pad), element)) {
+    if (set_transcoder_src_target_pad (GST_GHOST_PAD (pad), element, FALSE)) {
       paddata->state = KMS_SRC_PAD_STATE_LINKED;
     } else {
       /* We got caps but we could not link with this agnostic */
@@ -740,6 +1071,7 @@ kms_agnostic_bin3_src_pad_linked (GstPad * pad, GstPad * peer,
   KmsAgnosticBin3 *self = KMS_AGNOSTIC_BIN3 (user_data);
   KmsSrcPadState new_state = KMS_SRC_PAD_STATE_UNCONFIGURED;
   GstElement *element;
+  gboolean transcoding = FALSE;
   KmsSrcPadData *data;
   GstCaps *caps = NULL;
   gboolean ret;
@@ -782,8 +1114,7 @@ kms_agnostic_bin3_src_pad_linked (GstPad * pad, GstPad * peer,
     goto connect_transcoder;
   }
 
-  if (g_hash_table_size (self->priv->sinkcaps) !=
-      g_slist_length (self->priv->agnosticbins)) {
+  if (!kms_agnostic_bin3_inputs_configured (self)) {
     /* There is still pending agnosticbins that are not yet configured  */
     /* Any of them may support this pad without transcoding. Wait until */
     /* agnosticbins negotiate caps. They will connect pending pads as   */
@@ -800,18 +1131,20 @@ kms_agnostic_bin3_src_pad_linked (GstPad * pad, GstPad * peer,
     goto change_state;
   }
 
-  /* Get any available transcoder. Round robin will be ussed */
-  element = kms_agnosticbin3_get_element_for_transcoding (self);
+  /* Get the least loaded transcoder */
+  element = kms_agnosticbin3_get_element_for_transcoding (self, caps);
   if (element == NULL) {
     GST_DEBUG_OBJECT (pad, "Can not connect to any encoder yet");
     goto change_state;
   }
 
   GST_DEBUG_OBJECT (pad, "Connected transcoding");
+  transcoding = TRUE;
 
 connect_transcoder:
   {
-    if (set_transcoder_src_target_pad (GST_GHOST_PAD (pad), element)) {
+    if (set_transcoder_src_target_pad (GST_GHOST_PAD (pad), element,
+            transcoding)) {
       new_state = KMS_SRC_PAD_STATE_LINKED;
     } else {
       new_state = KMS_SRC_PAD_STATE_UNCONFIGURED;
@@ -21,6 +21,7 @@
 
 #include "kmsbitratefilter.h"
 #include "commons/kmsutils.h"
+#include "commons/kmsbitratecalc.h"
 
 #define PLUGIN_NAME "bitratefilter"
 
@@ -41,17 +42,10 @@ G_DEFINE_TYPE (KmsBitrateFilter, kms_bitrate_filter, GST_TYPE_BASE_TRANSFORM);
 #define BITRATE_CALC_INTERVAL GST_SECOND
 #define BITRATE_CALC_THRESHOLD 100000   /* bps */
 
-typedef struct _KmsBitrateCalcData
-{
-  GQueue /*GstClockTime */  * pts_queue;
-  GQueue /*gsize */  * sizes_queue;
-  guint64 total_size;
-  gint bitrate, last_bitrate;   /* bps */
-} KmsBitrateCalcData;
-
 struct _KmsBitrateFilterPrivate
 {
-  KmsBitrateCalcData bitrate_calc_data;
+  KmsBitrateCalc bitrate_calc;
+  gint bitrate, last_bitrate;   /* bps */
 };
 
 static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
@@ -64,62 +58,6 @@ static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS_ANY);
 
-static void
-kms_bitrate_calc_data_clear (KmsBitrateCalcData * data)
-{
-  if (data == NULL) {
-    return;
-  }
-
-  g_queue_free_full (data->pts_queue,
-      (GDestroyNotify) kms_utils_destroy_guint64);
-  g_queue_free (data->sizes_queue);
-}
-
-static void
-kms_bitrate_calc_data_init (KmsBitrateCalcData * data)
-{
-  data->pts_queue = g_queue_new ();
-  data->sizes_queue = g_queue_new ();
-}
-
-static void
-kms_bitrate_calc_data_update (KmsBitrateCalcData * data, GstBuffer * buffer)
-{
-  gsize size;
-  guint64 *current_pts, *last_pts, diff;
-
-  current_pts = g_slice_new0 (guint64);
-  *current_pts = buffer->pts;
-  g_queue_push_head (data->pts_queue, current_pts);
-
-  size = gst_buffer_get_size (buffer);
-  g_queue_push_head (data->sizes_queue, GSIZE_TO_POINTER (size));
-  data->total_size += size;
-
-  /* Remove old buffers */
-  last_pts = (guint64 *) g_queue_peek_tail (data->pts_queue);
-  diff = *current_pts - *last_pts;
-  while (diff > BITRATE_CALC_INTERVAL) {
-    gpointer p;
-
-    p = g_queue_pop_tail (data->pts_queue);
-    kms_utils_destroy_guint64 (p);
-
-    p = g_queue_pop_tail (data->sizes_queue);
-    data->total_size -= GPOINTER_TO_SIZE (p);
-
-    last_pts = (guint64 *) g_queue_peek_tail (data->pts_queue);
-    diff = *current_pts - *last_pts;
-  }
-
-  if (diff == 0) {
-    data->bitrate = 0;
-  } else {
-    data->bitrate = (8 * GST_SECOND * data->total_size) / diff;
-  }
-}
-
 static GstFlowReturn
 kms_bitrate_filter_transform_ip (GstBaseTransform * base, GstBuffer * buf)
 {
@@ -131,10 +69,10 @@ static void
 kms_bitrate_filter_update_src_caps (KmsBitrateFilter * self)
 {
   GstBaseTransform *trans = GST_BASE_TRANSFORM (self);
-  KmsBitrateCalcData *data = &self->priv->bitrate_calc_data;
+  KmsBitrateFilterPrivate *priv = self->priv;
   GstCaps *caps;
 
-  if (ABS (data->bitrate - data->last_bitrate) < BITRATE_CALC_THRESHOLD) {
+  if (ABS (priv->bitrate - priv->last_bitrate) < BITRATE_CALC_THRESHOLD) {
     return;
   }
 
@@ -143,12 +81,12 @@ kms_bitrate_filter_update_src_caps (KmsBitrateFilter * self)
     return;
   }
 
-  data->last_bitrate = data->bitrate;
+  priv->last_bitrate = priv->bitrate;
 
   GST_DEBUG_OBJECT (trans, "Old caps: %" GST_PTR_FORMAT, caps);
 
   caps = gst_caps_make_writable (caps);
-  gst_caps_set_simple (caps, "bitrate", G_TYPE_INT, data->bitrate, NULL);
+  gst_caps_set_simple (caps, "bitrate", G_TYPE_INT, priv->bitrate, NULL);
   gst_pad_set_caps (trans->srcpad, caps);
 
   GST_DEBUG_OBJECT (trans, "New caps: %" GST_PTR_FORMAT, caps);
@@ -161,29 +99,20 @@ kms_bitrate_filter_prepare_buf (GstBaseTransform * trans, GstBuffer * input,
     GstBuffer ** buf)
 {
   KmsBitrateFilter *self = KMS_BITRATE_FILTER (trans);
-  KmsBitrateCalcData *data = &self->priv->bitrate_calc_data;
 
   /* always return the input as output buffer */
   *buf = input;
-  kms_bitrate_calc_data_update (data, input);
+  kms_bitrate_calc_update_buffer (&self->priv->bitrate_calc, input);
+  self->priv->bitrate = MIN (kms_bitrate_calc_get_bitrate
+      (&self->priv->bitrate_calc), G_MAXINT32);
   kms_bitrate_filter_update_src_caps (self);
 
-  GST_TRACE_OBJECT (self, "bitrate: %" G_GINT32_FORMAT " bps", data->bitrate);
+  GST_TRACE_OBJECT (self, "bitrate: %" G_GINT32_FORMAT " bps",
+      self->priv->bitrate);
 
   return GST_FLOW_OK;
 }
 
-static void
-kms_bitrate_filter_dispose (GObject * object)
-{
-  KmsBitrateFilter *self = KMS_BITRATE_FILTER (object);
-
-  kms_bitrate_calc_data_clear (&self->priv->bitrate_calc_data);
-
-  /* chain up */
-  G_OBJECT_CLASS (kms_bitrate_filter_parent_class)->dispose (object);
-}
-
 static GstCaps *
 kms_bitrate_filter_transform_caps (GstBaseTransform * base,
     GstPadDirection direction, GstCaps * caps, GstCaps * filter)
@@ -217,18 +146,15 @@ static void
 kms_bitrate_filter_init (KmsBitrateFilter * self)
 {
   self->priv = KMS_BITRATE_FILTER_GET_PRIVATE (self);
-  kms_bitrate_calc_data_init (&self->priv->bitrate_calc_data);
+  kms_bitrate_calc_init (&self->priv->bitrate_calc, BITRATE_CALC_INTERVAL);
 }
 
 static void
 kms_bitrate_filter_class_init (KmsBitrateFilterClass * klass)
 {
-  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
   GstBaseTransformClass *trans_class = GST_BASE_TRANSFORM_CLASS (klass);
 
-  gobject_class->dispose = kms_bitrate_filter_dispose;
-
   gst_element_class_set_details_simple (gstelement_class,
       "BitrateFilter",
       "Generic",
@@ -20,7 +20,9 @@
 #include "kmsagnosticbin.h"
 #include "kmsagnosticbin3.h"
 #include "kmshubport.h"
+#include "kmsudpbatchsrc.h"
 #include "kmsfilterelement.h"
+#include "kmsfilterworker.h"
 #include "kmsaudiomixer.h"
 #include "kmsaudiomixerbin.h"
 #include "kmsbitratefilter.h"
@@ -45,9 +47,15 @@ kurento_init (GstPlugin * kurento)
   if (!kms_filter_element_plugin_init (kurento))
     return FALSE;
 
+  if (!kms_filter_worker_plugin_init (kurento))
+    return FALSE;
+
   if (!kms_hub_port_plugin_init (kurento))
     return FALSE;
 
+  if (!kms_udp_batch_src_plugin_init (kurento))
+    return FALSE;
+
   if (!kms_audio_mixer_plugin_init (kurento))
     return FALSE;
 
@@ -25,10 +25,15 @@
 #include "kmsutils.h"
 #include "kms-core-enumtypes.h"
 #include "kmsfiltertype.h"
+#include "kmsfilterworker.h"
 
 #define PLUGIN_NAME "filterelement"
 
 #define DEFAULT_FILTER_TYPE KMS_FILTER_TYPE_AUTODETECT
+#define DEFAULT_FILTER_WORKER FALSE
+#define DEFAULT_FRAME_BUDGET 1
+
+#define KMS_FILTER_STATISTICS_FIELD "filter-statistics"
 
 GST_DEBUG_CATEGORY_STATIC (kms_filter_element_debug_category);
 #define GST_CAT_DEFAULT kms_filter_element_debug_category
@@ -55,6 +60,10 @@ struct _KmsFilterElementPrivate
   gchar *filter_factory;
   GstElement *filter;
   KmsFilterType filter_type;
+
+  gboolean filter_worker;
+  guint frame_budget;
+  GstElement *worker;
 };
 
 /* properties */
@@ -63,7 +72,9 @@ enum
   PROP_0,
   PROP_FILTER_FACTORY,
   PROP_FILTER,
-  PROP_FILTER_TYPE
+  PROP_FILTER_TYPE,
+  PROP_FILTER_WORKER,
+  PROP_FRAME_BUDGET
 };
 
 /* pad templates */
@@ -75,20 +86,43 @@ G_DEFINE_TYPE_WITH_CODE (KmsFilterElement, kms_filter_element,
     GST_DEBUG_CATEGORY_INIT (kms_filter_element_debug_category, PLUGIN_NAME,
         0, "debug category for filterelement element"));
 
+static GstElement *
+kms_filter_element_create_handoff (KmsFilterElement * self)
+{
+  GstElement *handoff;
+
+  if (self->priv->filter_worker) {
+    handoff = g_object_new (KMS_TYPE_FILTER_WORKER, "max-buffers",
+        self->priv->frame_budget, NULL);
+    self->priv->worker = handoff;
+  } else {
+    handoff = gst_element_factory_make ("queue", NULL);
+    g_object_set (handoff, "leaky", 2, "max-size-buffers",
+        self->priv->frame_budget, NULL);
+  }
+
+  return handoff;
+}
+
 static void
 kms_filter_element_connect_filter (KmsFilterElement * self,
     KmsElementPadType type, GstElement * filter, GstElement * agnosticbin)
 {
-  GstElement *queue = gst_element_factory_make ("queue", NULL);
+  GstElement *queue = kms_filter_element_create_handoff (self);
   GstPad *target = gst_element_get_static_pad (queue, "sink");
 
-  g_object_set (queue, "leaky", 2, "max-size-buffers", 1, NULL);
-
   gst_bin_add_many (GST_BIN (self), queue, filter, NULL);
 
   self->priv->filter = filter;
 
-  gst_element_link_many (queue, filter, agnosticbin, NULL);
+  if (self->priv->worker != NULL) {
+    gst_element_link_pads (queue, KMS_FILTER_WORKER_FILTER_SRC, filter, NULL);
+    gst_element_link_pads (filter, NULL, queue, KMS_FILTER_WORKER_FILTER_SINK);
+    gst_element_link_pads (queue, "src", agnosticbin, NULL);
+  } else {
+    gst_element_link_many (queue, filter, agnosticbin, NULL);
+  }
+
   gst_element_sync_state_with_parent (filter);
   gst_element_sync_state_with_parent (queue);
 
@@ -240,6 +274,12 @@ kms_filter_element_get_property (GObject * object, guint prop_id,
     case PROP_FILTER_TYPE:
       g_value_set_enum (value, self->priv->filter_type);
       break;
+    case PROP_FILTER_WORKER:
+      g_value_set_boolean (value, self->priv->filter_worker);
+      break;
+    case PROP_FRAME_BUDGET:
+      g_value_set_uint (value, self->priv->frame_budget);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -285,6 +325,21 @@ kms_filter_element_set_property (GObject * object, guint prop_id,
     case PROP_FILTER_TYPE:
       self->priv->filter_type = g_value_get_enum (value);
       break;
+    case PROP_FILTER_WORKER:
+      if (self->priv->filter != NULL) {
+        GST_WARNING_OBJECT (object,
+            "Filter worker must be configured before the filter");
+      } else {
+        self->priv->filter_worker = g_value_get_boolean (value);
+      }
+      break;
+    case PROP_FRAME_BUDGET:
+      self->priv->frame_budget = g_value_get_uint (value);
+      if (self->priv->worker != NULL) {
+        g_object_set (self->priv->worker, "max-buffers",
+            self->priv->frame_budget, NULL);
+      }
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -303,6 +358,7 @@ kms_filter_element_dispose (GObject * object)
 
   /* No need to release as bin is owning the reference */
   filter_element->priv->filter = NULL;
+  filter_element->priv->worker = NULL;
 
   G_OBJECT_CLASS (kms_filter_element_parent_class)->dispose (object);
 }
@@ -325,10 +381,36 @@ kms_filter_element_finalize (GObject * object)
   G_OBJECT_CLASS (kms_filter_element_parent_class)->finalize (object);
 }
 
+static GstStructure *
+kms_filter_element_stats (KmsElement * obj, gchar * selector)
+{
+  KmsFilterElement *self = KMS_FILTER_ELEMENT (obj);
+  GstStructure *stats, *f_stats;
+
+  /* chain up */
+  stats =
+      KMS_ELEMENT_CLASS (kms_filter_element_parent_class)->stats (obj,
+      selector);
+
+  KMS_FILTER_ELEMENT_LOCK (self);
+
+  if (self->priv->worker != NULL) {
+    g_object_get (self->priv->worker, "stats", &f_stats, NULL);
+    gst_structure_set (stats, KMS_FILTER_STATISTICS_FIELD, GST_TYPE_STRUCTURE,
+        f_stats, NULL);
+    gst_structure_free (f_stats);
+  }
+
+  KMS_FILTER_ELEMENT_UNLOCK (self);
+
+  return stats;
+}
+
 static void
 kms_filter_element_class_init (KmsFilterElementClass * klass)
 {
   GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  KmsElementClass *kmselement_class = KMS_ELEMENT_CLASS (klass);
 
   gst_element_class_set_static_metadata (GST_ELEMENT_CLASS (klass),
       "FilterElement", "Generic/Filter", "Kurento filter_element",
@@ -355,6 +437,19 @@ kms_filter_element_class_init (KmsFilterElementClass * klass)
           "type of the filter",
           KMS_TYPE_FILTER_TYPE, DEFAULT_FILTER_TYPE, G_PARAM_READWRITE));
 
+  g_object_class_install_property (gobject_class, PROP_FILTER_WORKER,
+      g_param_spec_boolean ("filter-worker", "Filter worker",
+          "Run the filter in the shared filter thread pool instead of "
+          "behind its own queue", DEFAULT_FILTER_WORKER,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_FRAME_BUDGET,
+      g_param_spec_uint ("frame-budget", "Frame budget",
+          "Frames that may wait for the filter before dropping the oldest",
+          1, G_MAXUINT, DEFAULT_FRAME_BUDGET, G_PARAM_READWRITE));
+
+  kmselement_class->stats = GST_DEBUG_FUNCPTR (kms_filter_element_stats);
+
   /* Registers a private structure for the instantiatable type */
   g_type_class_add_private (klass, sizeof (KmsFilterElementPrivate));
 }
@@ -368,6 +463,8 @@ kms_filter_element_init (KmsFilterElement * self)
 
   self->priv->filter = NULL;
   self->priv->filter_factory = NULL;
+  self->priv->filter_worker = DEFAULT_FILTER_WORKER;
+  self->priv->frame_budget = DEFAULT_FRAME_BUDGET;
 }
 
 gboolean
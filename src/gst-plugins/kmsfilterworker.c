@@ -0,0 +1,686 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "kmsfilterworker.h"
+
+#define PLUGIN_NAME "filterworker"
+
+#define DEFAULT_MAX_BUFFERS 1
+
+/* Items handed to the filter each time the worker gets a pool thread, so
+ * busy filters take turns with the rest */
+#define MAX_BATCH 4
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static GstStaticPadTemplate filtersrctemplate =
+GST_STATIC_PAD_TEMPLATE (KMS_FILTER_WORKER_FILTER_SRC,
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static GstStaticPadTemplate filtersinktemplate =
+GST_STATIC_PAD_TEMPLATE (KMS_FILTER_WORKER_FILTER_SINK,
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+GST_DEBUG_CATEGORY_STATIC (kms_filter_worker_debug);
+#define GST_CAT_DEFAULT kms_filter_worker_debug
+#define kms_filter_worker_parent_class parent_class
+
+G_DEFINE_TYPE_WITH_CODE (KmsFilterWorker, kms_filter_worker,
+    GST_TYPE_ELEMENT,
+    GST_DEBUG_CATEGORY_INIT (kms_filter_worker_debug,
+        PLUGIN_NAME, 0, "debug category for " PLUGIN_NAME " element"));
+
+#define KMS_FILTER_WORKER_GET_PRIVATE(obj) ( \
+  G_TYPE_INSTANCE_GET_PRIVATE (              \
+    (obj),                                   \
+    KMS_TYPE_FILTER_WORKER,                  \
+    KmsFilterWorkerPrivate                   \
+  )                                          \
+)
+
+#define KMS_FILTER_WORKER_LOCK(obj) (                         \
+  g_mutex_lock (&KMS_FILTER_WORKER (obj)->priv->mutex)        \
+)
+
+#define KMS_FILTER_WORKER_UNLOCK(obj) (                       \
+  g_mutex_unlock (&KMS_FILTER_WORKER (obj)->priv->mutex)      \
+)
+
+/* Upper bounds of the processing time histogram, in milliseconds */
+static const guint histogram_bounds[] = { 1, 2, 5, 10, 20, 50, 100 };
+
+#define HISTOGRAM_SIZE (G_N_ELEMENTS (histogram_bounds) + 1)
+
+struct _KmsFilterWorkerPrivate
+{
+  GMutex mutex;
+  GCond cond;
+
+  GstPad *sinkpad;
+  GstPad *filter_srcpad;
+  GstPad *filter_sinkpad;
+  GstPad *srcpad;
+
+  /* Buffers and serialized events waiting for the filter */
+  GQueue items;
+  guint queued_buffers;
+  guint max_buffers;
+
+  gboolean scheduled;
+  gboolean flushing;
+  GstFlowReturn last_ret;
+
+  /* Start of the push into the filter, until its first output */
+  gint64 filter_start;
+
+  /* Metrics */
+  guint64 processed;
+  guint64 dropped;
+  GstClockTime total_time;
+  GstClockTime max_time;
+  guint64 histogram[HISTOGRAM_SIZE];
+};
+
+enum
+{
+  PROP_0,
+  PROP_MAX_BUFFERS,
+  PROP_STATS,
+  N_PROPERTIES
+};
+
+static void
+kms_filter_worker_clear_queue (GQueue * queue, guint * n_buffers)
+{
+  gpointer item;
+
+  while ((item = g_queue_pop_head (queue)) != NULL) {
+    gst_mini_object_unref (item);
+  }
+
+  *n_buffers = 0;
+}
+
+static void
+kms_filter_worker_drop_oldest (KmsFilterWorker * self, GQueue * queue,
+    guint * n_buffers)
+{
+  GList *l;
+
+  for (l = queue->head; l != NULL; l = l->next) {
+    if (GST_IS_BUFFER (l->data)) {
+      GST_LOG_OBJECT (self, "Dropping %" GST_PTR_FORMAT, l->data);
+      gst_buffer_unref (l->data);
+      g_queue_delete_link (queue, l);
+      (*n_buffers)--;
+      self->priv->dropped++;
+      return;
+    }
+  }
+}
+
+/* Must be called with the lock held */
+static void
+kms_filter_worker_enforce_budget (KmsFilterWorker * self)
+{
+  while (self->priv->queued_buffers > self->priv->max_buffers) {
+    kms_filter_worker_drop_oldest (self, &self->priv->items,
+        &self->priv->queued_buffers);
+  }
+}
+
+static void
+kms_filter_worker_account (KmsFilterWorker * self, GstClockTime elapsed)
+{
+  guint i, ms = GST_TIME_AS_MSECONDS (elapsed);
+
+  for (i = 0; i < G_N_ELEMENTS (histogram_bounds); i++) {
+    if (ms < histogram_bounds[i]) {
+      break;
+    }
+  }
+
+  self->priv->histogram[i]++;
+  self->priv->processed++;
+  self->priv->total_time += elapsed;
+  self->priv->max_time = MAX (self->priv->max_time, elapsed);
+}
+
+static void kms_filter_worker_process (KmsFilterWorker * self,
+    gpointer user_data);
+
+static gpointer
+kms_filter_worker_create_pool (gpointer data)
+{
+  GError *err = NULL;
+  GThreadPool *pool;
+
+  pool = g_thread_pool_new ((GFunc) kms_filter_worker_process, NULL,
+      g_get_num_processors (), FALSE, &err);
+
+  if (pool == NULL) {
+    GST_ERROR ("Cannot create filter thread pool: %s", err->message);
+    g_error_free (err);
+  }
+
+  return pool;
+}
+
+static GThreadPool *
+kms_filter_worker_get_pool (void)
+{
+  static GOnce once = G_ONCE_INIT;
+
+  return g_once (&once, (GThreadFunc) kms_filter_worker_create_pool, NULL);
+}
+
+/* Must be called with the lock held. The reference of self is handed over
+ * to the pool */
+static gboolean
+kms_filter_worker_push_to_pool (KmsFilterWorker * self)
+{
+  GError *err = NULL;
+
+  if (!g_thread_pool_push (kms_filter_worker_get_pool (), self, &err)) {
+    GST_ERROR_OBJECT (self, "Cannot schedule filter: %s", err->message);
+    g_error_free (err);
+    self->priv->scheduled = FALSE;
+    g_cond_broadcast (&self->priv->cond);
+
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Runs in the shared pool. The filter output is pushed downstream from
+ * filter_sinkpad in the same thread, with no further hand-off */
+static void
+kms_filter_worker_process (KmsFilterWorker * self, gpointer user_data)
+{
+  GstMiniObject *item;
+  guint processed = 0;
+
+  KMS_FILTER_WORKER_LOCK (self);
+
+  while (!self->priv->flushing && processed < MAX_BATCH &&
+      (item = g_queue_pop_head (&self->priv->items)) != NULL) {
+    processed++;
+
+    if (GST_IS_BUFFER (item)) {
+      GstFlowReturn ret;
+
+      self->priv->queued_buffers--;
+      self->priv->filter_start = g_get_monotonic_time ();
+      KMS_FILTER_WORKER_UNLOCK (self);
+
+      ret = gst_pad_push (self->priv->filter_srcpad, GST_BUFFER_CAST (item));
+
+      KMS_FILTER_WORKER_LOCK (self);
+      if (self->priv->filter_start != 0) {
+        /* The filter did not produce any output */
+        kms_filter_worker_account (self,
+            (g_get_monotonic_time () - self->priv->filter_start) *
+            GST_USECOND);
+        self->priv->filter_start = 0;
+      }
+
+      if (ret != GST_FLOW_OK && ret != GST_FLOW_NOT_LINKED) {
+        GST_DEBUG_OBJECT (self, "Push returned %s", gst_flow_get_name (ret));
+        self->priv->last_ret = ret;
+      }
+    } else {
+      KMS_FILTER_WORKER_UNLOCK (self);
+      gst_pad_push_event (self->priv->filter_srcpad, GST_EVENT_CAST (item));
+      KMS_FILTER_WORKER_LOCK (self);
+    }
+  }
+
+  if (!self->priv->flushing && !g_queue_is_empty (&self->priv->items)) {
+    /* Go to the back of the pool queue, still scheduled */
+    if (kms_filter_worker_push_to_pool (self)) {
+      KMS_FILTER_WORKER_UNLOCK (self);
+      return;
+    }
+  } else {
+    self->priv->scheduled = FALSE;
+    g_cond_broadcast (&self->priv->cond);
+  }
+
+  KMS_FILTER_WORKER_UNLOCK (self);
+
+  gst_object_unref (self);
+}
+
+/* Must be called with the lock held */
+static void
+kms_filter_worker_schedule (KmsFilterWorker * self)
+{
+  if (self->priv->scheduled) {
+    return;
+  }
+
+  self->priv->scheduled = TRUE;
+
+  if (!kms_filter_worker_push_to_pool (gst_object_ref (self))) {
+    gst_object_unref (self);
+  }
+}
+
+/* Must be called with the lock held */
+static void
+kms_filter_worker_wait_idle (KmsFilterWorker * self)
+{
+  while (self->priv->scheduled) {
+    g_cond_wait (&self->priv->cond, &self->priv->mutex);
+  }
+}
+
+static GstFlowReturn
+kms_filter_worker_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  KmsFilterWorker *self = KMS_FILTER_WORKER (parent);
+  GstFlowReturn ret;
+
+  KMS_FILTER_WORKER_LOCK (self);
+
+  if (self->priv->flushing) {
+    ret = GST_FLOW_FLUSHING;
+    goto drop;
+  }
+
+  if (self->priv->last_ret != GST_FLOW_OK) {
+    ret = self->priv->last_ret;
+    goto drop;
+  }
+
+  g_queue_push_tail (&self->priv->items, buffer);
+  self->priv->queued_buffers++;
+  kms_filter_worker_enforce_budget (self);
+
+  kms_filter_worker_schedule (self);
+
+  KMS_FILTER_WORKER_UNLOCK (self);
+
+  return GST_FLOW_OK;
+
+drop:
+  KMS_FILTER_WORKER_UNLOCK (self);
+  gst_buffer_unref (buffer);
+
+  return ret;
+}
+
+static gboolean
+kms_filter_worker_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  KmsFilterWorker *self = KMS_FILTER_WORKER (parent);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_START:
+      KMS_FILTER_WORKER_LOCK (self);
+      self->priv->flushing = TRUE;
+      kms_filter_worker_clear_queue (&self->priv->items,
+          &self->priv->queued_buffers);
+      KMS_FILTER_WORKER_UNLOCK (self);
+      return gst_pad_push_event (self->priv->filter_srcpad, event);
+    case GST_EVENT_FLUSH_STOP:
+      KMS_FILTER_WORKER_LOCK (self);
+      kms_filter_worker_wait_idle (self);
+      self->priv->flushing = FALSE;
+      self->priv->last_ret = GST_FLOW_OK;
+      KMS_FILTER_WORKER_UNLOCK (self);
+      return gst_pad_push_event (self->priv->filter_srcpad, event);
+    default:
+      break;
+  }
+
+  if (!GST_EVENT_IS_SERIALIZED (event)) {
+    return gst_pad_event_default (pad, parent, event);
+  }
+
+  KMS_FILTER_WORKER_LOCK (self);
+
+  if (self->priv->flushing) {
+    KMS_FILTER_WORKER_UNLOCK (self);
+    gst_event_unref (event);
+    return FALSE;
+  }
+
+  g_queue_push_tail (&self->priv->items, event);
+  kms_filter_worker_schedule (self);
+
+  KMS_FILTER_WORKER_UNLOCK (self);
+
+  return TRUE;
+}
+
+static gboolean
+kms_filter_worker_sink_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  KmsFilterWorker *self = KMS_FILTER_WORKER (parent);
+
+  if (GST_QUERY_IS_SERIALIZED (query)) {
+    /* Let pending data reach the filter before answering */
+    KMS_FILTER_WORKER_LOCK (self);
+    kms_filter_worker_wait_idle (self);
+    KMS_FILTER_WORKER_UNLOCK (self);
+  }
+
+  return gst_pad_query_default (pad, parent, query);
+}
+
+static GstIterator *
+kms_filter_worker_iterate_internal_links (GstPad * pad, GstObject * parent)
+{
+  KmsFilterWorker *self = KMS_FILTER_WORKER (parent);
+  GValue val = G_VALUE_INIT;
+  GstIterator *it;
+  GstPad *otherpad;
+
+  if (pad == self->priv->sinkpad) {
+    otherpad = self->priv->filter_srcpad;
+  } else if (pad == self->priv->filter_srcpad) {
+    otherpad = self->priv->sinkpad;
+  } else if (pad == self->priv->filter_sinkpad) {
+    otherpad = self->priv->srcpad;
+  } else {
+    otherpad = self->priv->filter_sinkpad;
+  }
+
+  g_value_init (&val, GST_TYPE_PAD);
+  g_value_set_object (&val, otherpad);
+  it = gst_iterator_new_single (GST_TYPE_PAD, &val);
+  g_value_unset (&val);
+
+  return it;
+}
+
+static GstFlowReturn
+kms_filter_worker_filter_chain (GstPad * pad, GstObject * parent,
+    GstBuffer * buffer)
+{
+  KmsFilterWorker *self = KMS_FILTER_WORKER (parent);
+
+  KMS_FILTER_WORKER_LOCK (self);
+  if (self->priv->filter_start != 0) {
+    /* Only the time spent in the filter is accounted, not downstream */
+    kms_filter_worker_account (self,
+        (g_get_monotonic_time () - self->priv->filter_start) * GST_USECOND);
+    self->priv->filter_start = 0;
+  }
+  KMS_FILTER_WORKER_UNLOCK (self);
+
+  return gst_pad_push (self->priv->srcpad, buffer);
+}
+
+static GstStructure *
+kms_filter_worker_get_stats (KmsFilterWorker * self)
+{
+  GstStructure *stats, *histogram;
+  GstClockTime avg;
+  guint i;
+
+  histogram = gst_structure_new_empty ("processing-time-histogram");
+
+  KMS_FILTER_WORKER_LOCK (self);
+
+  for (i = 0; i < HISTOGRAM_SIZE; i++) {
+    gchar *name;
+
+    if (i < G_N_ELEMENTS (histogram_bounds)) {
+      name = g_strdup_printf ("under-%ums", histogram_bounds[i]);
+    } else {
+      name = g_strdup_printf ("over-%ums", histogram_bounds[i - 1]);
+    }
+
+    gst_structure_set (histogram, name, G_TYPE_UINT64,
+        self->priv->histogram[i], NULL);
+    g_free (name);
+  }
+
+  avg = self->priv->processed > 0 ?
+      self->priv->total_time / self->priv->processed : 0;
+
+  stats = gst_structure_new (KMS_FILTER_WORKER_STATS_STRUCT_NAME,
+      "processed-frames", G_TYPE_UINT64, self->priv->processed,
+      "dropped-frames", G_TYPE_UINT64, self->priv->dropped,
+      "queued-frames", G_TYPE_UINT, self->priv->queued_buffers,
+      "frame-budget", G_TYPE_UINT, self->priv->max_buffers,
+      "avg-processing-time", G_TYPE_UINT64, avg,
+      "max-processing-time", G_TYPE_UINT64, self->priv->max_time,
+      "processing-time", GST_TYPE_STRUCTURE, histogram, NULL);
+
+  KMS_FILTER_WORKER_UNLOCK (self);
+
+  gst_structure_free (histogram);
+
+  return stats;
+}
+
+static GstStateChangeReturn
+kms_filter_worker_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  KmsFilterWorker *self = KMS_FILTER_WORKER (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      KMS_FILTER_WORKER_LOCK (self);
+      self->priv->flushing = FALSE;
+      self->priv->last_ret = GST_FLOW_OK;
+      KMS_FILTER_WORKER_UNLOCK (self);
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      KMS_FILTER_WORKER_LOCK (self);
+      self->priv->flushing = TRUE;
+      kms_filter_worker_clear_queue (&self->priv->items,
+          &self->priv->queued_buffers);
+      KMS_FILTER_WORKER_UNLOCK (self);
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+
+  if (transition == GST_STATE_CHANGE_PAUSED_TO_READY) {
+    KMS_FILTER_WORKER_LOCK (self);
+    kms_filter_worker_wait_idle (self);
+    KMS_FILTER_WORKER_UNLOCK (self);
+  }
+
+  return ret;
+}
+
+static void
+kms_filter_worker_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  KmsFilterWorker *self = KMS_FILTER_WORKER (object);
+
+  switch (property_id) {
+    case PROP_MAX_BUFFERS:
+      KMS_FILTER_WORKER_LOCK (self);
+      self->priv->max_buffers = g_value_get_uint (value);
+      kms_filter_worker_enforce_budget (self);
+      KMS_FILTER_WORKER_UNLOCK (self);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+kms_filter_worker_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  KmsFilterWorker *self = KMS_FILTER_WORKER (object);
+
+  switch (property_id) {
+    case PROP_MAX_BUFFERS:
+      KMS_FILTER_WORKER_LOCK (self);
+      g_value_set_uint (value, self->priv->max_buffers);
+      KMS_FILTER_WORKER_UNLOCK (self);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, kms_filter_worker_get_stats (self));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+kms_filter_worker_finalize (GObject * object)
+{
+  KmsFilterWorker *self = KMS_FILTER_WORKER (object);
+
+  GST_DEBUG_OBJECT (self, "finalize");
+
+  kms_filter_worker_clear_queue (&self->priv->items,
+      &self->priv->queued_buffers);
+  g_mutex_clear (&self->priv->mutex);
+  g_cond_clear (&self->priv->cond);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+kms_filter_worker_add_pad (KmsFilterWorker * self, GstPad * pad)
+{
+  gst_pad_set_iterate_internal_links_function (pad,
+      kms_filter_worker_iterate_internal_links);
+  GST_PAD_SET_PROXY_CAPS (pad);
+  GST_PAD_SET_PROXY_ALLOCATION (pad);
+  gst_element_add_pad (GST_ELEMENT (self), pad);
+}
+
+static void
+kms_filter_worker_init (KmsFilterWorker * self)
+{
+  self->priv = KMS_FILTER_WORKER_GET_PRIVATE (self);
+
+  self->priv->sinkpad =
+      gst_pad_new_from_static_template (&sinktemplate, "sink");
+  gst_pad_set_chain_function (self->priv->sinkpad, kms_filter_worker_chain);
+  gst_pad_set_event_function (self->priv->sinkpad,
+      kms_filter_worker_sink_event);
+  gst_pad_set_query_function (self->priv->sinkpad,
+      kms_filter_worker_sink_query);
+  kms_filter_worker_add_pad (self, self->priv->sinkpad);
+
+  self->priv->filter_srcpad =
+      gst_pad_new_from_static_template (&filtersrctemplate,
+      KMS_FILTER_WORKER_FILTER_SRC);
+  kms_filter_worker_add_pad (self, self->priv->filter_srcpad);
+
+  self->priv->filter_sinkpad =
+      gst_pad_new_from_static_template (&filtersinktemplate,
+      KMS_FILTER_WORKER_FILTER_SINK);
+  gst_pad_set_chain_function (self->priv->filter_sinkpad,
+      kms_filter_worker_filter_chain);
+  kms_filter_worker_add_pad (self, self->priv->filter_sinkpad);
+
+  self->priv->srcpad = gst_pad_new_from_static_template (&srctemplate, "src");
+  kms_filter_worker_add_pad (self, self->priv->srcpad);
+
+  g_mutex_init (&self->priv->mutex);
+  g_cond_init (&self->priv->cond);
+  g_queue_init (&self->priv->items);
+
+  self->priv->max_buffers = DEFAULT_MAX_BUFFERS;
+  self->priv->flushing = TRUE;
+  self->priv->last_ret = GST_FLOW_OK;
+}
+
+static void
+kms_filter_worker_class_init (KmsFilterWorkerClass * klass)
+{
+  GstElementClass *gstelement_class;
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->finalize = kms_filter_worker_finalize;
+  gobject_class->set_property = kms_filter_worker_set_property;
+  gobject_class->get_property = kms_filter_worker_get_property;
+
+  gstelement_class = GST_ELEMENT_CLASS (klass);
+  gstelement_class->change_state = kms_filter_worker_change_state;
+
+  gst_element_class_set_details_simple (gstelement_class,
+      "Filter worker",
+      "Generic",
+      "Runs the filter linked to its filter pads in a shared thread pool, "
+      "dropping the oldest frames when it cannot keep up",
+      "Kurento <kurento@googlegroups.com>");
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&srctemplate));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&sinktemplate));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&filtersrctemplate));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&filtersinktemplate));
+
+  GST_DEBUG_REGISTER_FUNCPTR (kms_filter_worker_chain);
+  GST_DEBUG_REGISTER_FUNCPTR (kms_filter_worker_sink_event);
+  GST_DEBUG_REGISTER_FUNCPTR (kms_filter_worker_sink_query);
+  GST_DEBUG_REGISTER_FUNCPTR (kms_filter_worker_filter_chain);
+  GST_DEBUG_REGISTER_FUNCPTR (kms_filter_worker_iterate_internal_links);
+
+  g_object_class_install_property (gobject_class, PROP_MAX_BUFFERS,
+      g_param_spec_uint ("max-buffers", "Maximum buffers",
+          "Frames that may wait for the filter before dropping the oldest",
+          1, G_MAXUINT, DEFAULT_MAX_BUFFERS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Processed and dropped frames and processing time histogram",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_type_class_add_private (klass, sizeof (KmsFilterWorkerPrivate));
+}
+
+gboolean
+kms_filter_worker_plugin_init (GstPlugin * plugin)
+{
+  return gst_element_register (plugin, PLUGIN_NAME, GST_RANK_NONE,
+      KMS_TYPE_FILTER_WORKER);
+}
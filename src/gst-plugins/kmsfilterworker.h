@@ -0,0 +1,72 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_FILTER_WORKER_H__
+#define __KMS_FILTER_WORKER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+#define KMS_TYPE_FILTER_WORKER \
+  (kms_filter_worker_get_type())
+#define KMS_FILTER_WORKER(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),KMS_TYPE_FILTER_WORKER,KmsFilterWorker))
+#define KMS_FILTER_WORKER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),KMS_TYPE_FILTER_WORKER,KmsFilterWorkerClass))
+#define KMS_IS_FILTER_WORKER(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),KMS_TYPE_FILTER_WORKER))
+#define KMS_IS_FILTER_WORKER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),KMS_TYPE_FILTER_WORKER))
+#define KMS_FILTER_WORKER_CAST(obj) ((KmsFilterWorker*)(obj))
+
+#define KMS_FILTER_WORKER_STATS_STRUCT_NAME "filter-stats"
+
+#define KMS_FILTER_WORKER_FILTER_SRC "filter_src"
+#define KMS_FILTER_WORKER_FILTER_SINK "filter_sink"
+
+typedef struct _KmsFilterWorker KmsFilterWorker;
+typedef struct _KmsFilterWorkerClass KmsFilterWorkerClass;
+typedef struct _KmsFilterWorkerPrivate KmsFilterWorkerPrivate;
+
+/**
+ * KmsFilterWorker:
+ *
+ * Runs the filter linked between its "filter_src" and "filter_sink" pads
+ * in a thread pool shared by all the filters in the process, a few frames
+ * at a time. The filter output is pushed downstream from the same pool
+ * thread. Up to "max-buffers" frames wait for the filter; when a new one
+ * arrives and the budget is exhausted the oldest waiting frame is dropped.
+ * Serialized events are never dropped and keep their order.
+ */
+struct _KmsFilterWorker
+{
+  GstElement element;
+
+  KmsFilterWorkerPrivate *priv;
+};
+
+struct _KmsFilterWorkerClass
+{
+  GstElementClass parent_class;
+};
+
+GType kms_filter_worker_get_type (void);
+
+gboolean kms_filter_worker_plugin_init (GstPlugin * plugin);
+
+G_END_DECLS
+#endif /* __KMS_FILTER_WORKER_H__ */
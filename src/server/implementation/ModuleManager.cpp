@@ -20,8 +20,13 @@
 
 #include <gst/gst.h>
 #include <KurentoException.hpp>
+#include <cstdlib>
+#include <future>
 #include <sstream>
+#include <vector>
 #include <boost/filesystem.hpp>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
 
 #define GST_CAT_DEFAULT kurento_media_set
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
@@ -35,8 +40,38 @@ typedef const char * (*GetNameFunc) ();
 typedef const char * (*GetDescFunc) ();
 typedef const char * (*GetGenerationTimeFunc) ();
 
+#define MANIFEST_ENV "KURENTO_MODULES_MANIFEST"
+#define MANIFEST_MTIME "mtime"
+#define MANIFEST_SIZE "size"
+#define MANIFEST_NAME "name"
+#define MANIFEST_VERSION "version"
+#define MANIFEST_GENERATION_TIME "generation-time"
+#define MANIFEST_DESCRIPTOR "descriptor"
+#define MANIFEST_FACTORIES "factories"
+
+// Factories are also registered using the module name as a prefix
+// Modules core, elements and filters use kurento as prefix
+static std::string
+getFactoryPrefix (const std::string &moduleName)
+{
+  if (moduleName == "core" || moduleName == "elements"
+      || moduleName == "filters")  {
+    return "kurento";
+  } else {
+    return moduleName;
+  }
+}
+
 int
 ModuleManager::loadModule (std::string modulePath)
+{
+  std::unique_lock <std::recursive_mutex> lock (mutex);
+
+  return loadModuleUnlocked (modulePath);
+}
+
+int
+ModuleManager::loadModuleUnlocked (std::string modulePath)
 {
   const kurento::FactoryRegistrar *registrar;
   void *registrarFactory, *getVersion = NULL, *getName = NULL,
@@ -51,7 +86,8 @@ ModuleManager::loadModule (std::string modulePath)
 
   moduleFileName = path.filename().string();
 
-  if (loadedModules.find (moduleFileName) != loadedModules.end() ) {
+  if (loadedModules.find (moduleFileName) != loadedModules.end()
+      || pendingModules.find (moduleFileName) != pendingModules.end() ) {
     GST_WARNING ("Module named %s already loaded", moduleFileName.c_str() );
     return -1;
   }
@@ -74,8 +110,10 @@ ModuleManager::loadModule (std::string modulePath)
   const std::map <std::string, std::shared_ptr <kurento::Factory > > &factories =
     registrar->getFactories();
 
+  // Deferred modules keep their factories, as if they were loaded
   for (auto it : factories) {
-    if (loadedFactories.find (it.first) != loadedFactories.end() ) {
+    if (loadedFactories.find (it.first) != loadedFactories.end()
+        || pendingFactories.find (it.first) != pendingFactories.end() ) {
       GST_WARNING ("Factory %s is already registered, skiping module %s",
                    it.first.c_str(), module.get_name().c_str() );
       return -1;
@@ -100,15 +138,7 @@ ModuleManager::loadModule (std::string modulePath)
     std::string finalModuleName;
 
     moduleName = ( (GetVersionFunc) getName) ();
-
-    // Factories are also registered using the module name as a prefix
-    // Modules core, elements and filters use kurento as prefix
-    if (moduleName == "core" || moduleName == "elements"
-        || moduleName == "filters")  {
-      finalModuleName = "kurento";
-    } else {
-      finalModuleName = moduleName;
-    }
+    finalModuleName = getFactoryPrefix (moduleName);
 
     for (auto it : factories) {
       loadedFactories [finalModuleName + "." + it.first] = it.second;
@@ -129,7 +159,8 @@ ModuleManager::loadModule (std::string modulePath)
 
   loadedModules[moduleFileName] = std::shared_ptr<ModuleData> (new ModuleData (
                                     moduleName, moduleVersion, generationTime,
-                                    moduleDescriptor, factories) );
+                                    moduleDescriptor != NULL ? moduleDescriptor : "",
+                                    factories) );
 
   GST_INFO ("Loaded %s version %s generated at %s", moduleName.c_str() ,
             moduleVersion.c_str(), generationTime.c_str() );
@@ -150,8 +181,8 @@ std::list<std::string> split (const std::string &s, char delim)
   return elems;
 }
 
-void
-ModuleManager::loadModules (std::string dirPath)
+static void
+findModules (const std::string &dirPath, std::list<std::string> &modules)
 {
   GST_TRACE ("Looking for modules in %s", dirPath.c_str());
   boost::filesystem::path dir (dirPath);
@@ -171,40 +202,303 @@ ModuleManager::loadModules (std::string dirPath)
 
       if (extension.string() == ".so") {
         GST_INFO ("Found module: %s", itr->path().string().c_str() );
-        loadModule (itr->path().string() );
+        modules.push_back (itr->path().string() );
       }
     } else if (boost::filesystem::is_directory (*itr) ) {
-      this->loadModules (itr->path().string() );
+      findModules (itr->path().string(), modules);
     }
   }
 }
 
 void
-ModuleManager::loadModulesFromDirectories (std::string path)
+ModuleManager::loadModules (std::string dirPath)
+{
+  std::list<std::string> modules;
+
+  findModules (dirPath, modules);
+
+  for (std::string modulePath : modules) {
+    loadModuleUnlocked (modulePath);
+  }
+}
+
+std::string
+ModuleManager::getManifestPath ()
+{
+  const char *path = getenv (MANIFEST_ENV);
+
+  if (path != NULL) {
+    return path;
+  }
+
+  return Glib::build_filename (Glib::get_user_cache_dir (), "kurento",
+                               "modules.manifest");
+}
+
+void
+ModuleManager::addLazyModule (const std::string &modulePath,
+                              Glib::KeyFile &manifest, bool &manifestChanged)
+{
+  std::string moduleFileName;
+  std::string moduleName;
+  std::vector<Glib::ustring> factories;
+  PendingModule pending;
+  gint64 mtime;
+  guint64 size;
+  bool cached = false;
+
+  moduleFileName = boost::filesystem::path (modulePath).filename().string();
+
+  if (loadedModules.find (moduleFileName) != loadedModules.end()
+      || pendingModules.find (moduleFileName) != pendingModules.end() ) {
+    GST_WARNING ("Module named %s already loaded", moduleFileName.c_str() );
+    return;
+  }
+
+  // Group names of a key file cannot contain brackets
+  if (modulePath.find_first_of ("[]") != std::string::npos) {
+    loadModuleUnlocked (modulePath);
+    return;
+  }
+
+  try {
+    mtime = boost::filesystem::last_write_time (modulePath);
+    size = boost::filesystem::file_size (modulePath);
+  } catch (boost::filesystem::filesystem_error &e) {
+    GST_WARNING ("Cannot stat module %s: %s", modulePath.c_str(), e.what() );
+    return;
+  }
+
+  if (manifest.has_group (modulePath) ) {
+    try {
+      if (manifest.get_int64 (modulePath, MANIFEST_MTIME) == mtime
+          && manifest.get_uint64 (modulePath, MANIFEST_SIZE) == size) {
+        // Entries written before these keys existed are refreshed
+        pending.version = manifest.get_string (modulePath, MANIFEST_VERSION);
+        pending.generationTime = manifest.get_string (modulePath,
+                                 MANIFEST_GENERATION_TIME);
+        pending.descriptor = manifest.get_string (modulePath,
+                             MANIFEST_DESCRIPTOR);
+        moduleName = manifest.get_string (modulePath, MANIFEST_NAME);
+        factories = manifest.get_string_list (modulePath, MANIFEST_FACTORIES);
+        cached = true;
+      }
+    } catch (Glib::KeyFileError &e) {
+      GST_WARNING ("Invalid manifest entry for %s: %s", modulePath.c_str(),
+                   e.what().c_str() );
+    }
+  }
+
+  if (!cached) {
+    // The module has to be opened to know its factories
+    if (loadModuleUnlocked (modulePath) != 0) {
+      if (manifest.has_group (modulePath) ) {
+        manifest.remove_group (modulePath);
+        manifestChanged = true;
+      }
+
+      return;
+    }
+
+    std::shared_ptr<ModuleData> data = loadedModules[moduleFileName];
+
+    for (auto it : data->getFactories() ) {
+      factories.push_back (it.first);
+    }
+
+    manifest.set_int64 (modulePath, MANIFEST_MTIME, mtime);
+    manifest.set_uint64 (modulePath, MANIFEST_SIZE, size);
+    manifest.set_string (modulePath, MANIFEST_NAME, data->getName() );
+    manifest.set_string (modulePath, MANIFEST_VERSION, data->getVersion() );
+    manifest.set_string (modulePath, MANIFEST_GENERATION_TIME,
+                         data->getGenerationTime() );
+    manifest.set_string (modulePath, MANIFEST_DESCRIPTOR,
+                         data->getDescriptor() );
+    manifest.set_string_list (modulePath, MANIFEST_FACTORIES, factories);
+    manifestChanged = true;
+
+    return;
+  }
+
+  for (std::string factory : factories) {
+    if (loadedFactories.find (factory) != loadedFactories.end()
+        || pendingFactories.find (factory) != pendingFactories.end() ) {
+      GST_WARNING ("Factory %s is already registered, skiping module %s",
+                   factory.c_str(), modulePath.c_str() );
+      return;
+    }
+  }
+
+  pending.path = modulePath;
+  pending.name = moduleName;
+
+  for (std::string factory : factories) {
+    pending.factories.push_back (factory);
+    pendingFactories[factory] = moduleFileName;
+
+    if (!moduleName.empty() ) {
+      pendingFactories[getFactoryPrefix (moduleName) + "." + factory] =
+        moduleFileName;
+    }
+  }
+
+  pendingModules[moduleFileName] = pending;
+
+  GST_DEBUG ("Module %s deferred until first use", modulePath.c_str() );
+}
+
+void
+ModuleManager::loadPendingModule (const std::string &moduleFileName)
+{
+  auto pending = pendingModules.find (moduleFileName);
+  std::string modulePath;
+
+  if (pending == pendingModules.end() ) {
+    return;
+  }
+
+  modulePath = pending->second.path;
+  pendingModules.erase (pending);
+  pendingModulesData.erase (moduleFileName);
+
+  for (auto it = pendingFactories.begin(); it != pendingFactories.end(); ) {
+    if (it->second == moduleFileName) {
+      it = pendingFactories.erase (it);
+    } else {
+      ++it;
+    }
+  }
+
+  GST_INFO ("Loading module %s on first use", modulePath.c_str() );
+  loadModuleUnlocked (modulePath);
+}
+
+void
+ModuleManager::ensureLoaded ()
+{
+  while (!pendingModules.empty() ) {
+    loadPendingModule (pendingModules.begin()->first);
+  }
+}
+
+void
+ModuleManager::loadModulesFromDirectories (std::string path, bool lazy)
 {
   std::list <std::string> locations;
+  std::list <std::future <std::list <std::string>>> scans;
+  std::string manifestPath;
+  Glib::KeyFile manifest;
+  bool manifestChanged = false;
 
   locations = split (path, ':');
 
+  //try to load modules from the default path
+  locations.push_back (KURENTO_MODULES_DIR);
+
+  if (!lazy) {
+    std::unique_lock <std::recursive_mutex> lock (mutex);
+
+    for (std::string location : locations) {
+      this->loadModules (location);
+    }
+
+    return;
+  }
+
+  // Directories are scanned in parallel, modules are added in the same
+  // order as in the serial mode so conflicts are solved the same way
   for (std::string location : locations) {
-    this->loadModules (location);
+    scans.push_back (std::async (std::launch::async, [location] () {
+      std::list<std::string> modules;
+
+      findModules (location, modules);
+
+      return modules;
+    }) );
   }
 
-  //try to load modules from the default path
-  this->loadModules (KURENTO_MODULES_DIR);
+  manifestPath = getManifestPath ();
+
+  try {
+    manifest.load_from_file (manifestPath);
+  } catch (Glib::Error &e) {
+    GST_INFO ("Cannot read modules manifest %s: %s", manifestPath.c_str(),
+              e.what().c_str() );
+  }
+
+  std::unique_lock <std::recursive_mutex> lock (mutex);
+
+  for (auto &scan : scans) {
+    for (std::string modulePath : scan.get() ) {
+      addLazyModule (modulePath, manifest, manifestChanged);
+    }
+  }
 
-  return;
+  GST_INFO ("%zu modules loaded, %zu deferred until first use",
+            loadedModules.size(), pendingModules.size() );
+
+  lock.unlock ();
+
+  if (!manifestChanged) {
+    return;
+  }
+
+  try {
+    g_mkdir_with_parents (Glib::path_get_dirname (manifestPath).c_str(), 0755);
+    Glib::file_set_contents (manifestPath, manifest.to_data() );
+  } catch (Glib::Error &e) {
+    GST_WARNING ("Cannot write modules manifest %s: %s", manifestPath.c_str(),
+                 e.what().c_str() );
+  }
 }
 
 const std::map <std::string, std::shared_ptr <kurento::Factory > >
 ModuleManager::getLoadedFactories ()
 {
+  std::unique_lock <std::recursive_mutex> lock (mutex);
+
+  ensureLoaded ();
+
   return loadedFactories;
 }
 
+const std::map <std::string, std::shared_ptr <ModuleData>>
+    ModuleManager::getModules () const
+{
+  std::unique_lock <std::recursive_mutex> lock (mutex);
+  std::map <std::string, std::shared_ptr <ModuleData>> modules = loadedModules;
+
+  for (auto &it : pendingModules) {
+    std::shared_ptr<ModuleData> &data = pendingModulesData[it.first];
+
+    if (!data) {
+      std::map <std::string, std::shared_ptr <kurento::Factory > > factories;
+
+      for (std::string factory : it.second.factories) {
+        factories[factory] = nullptr;
+      }
+
+      data = std::shared_ptr<ModuleData> (new ModuleData (it.second.name,
+                                          it.second.version, it.second.generationTime,
+                                          it.second.descriptor, factories) );
+    }
+
+    modules[it.first] = data;
+  }
+
+  return modules;
+}
+
 std::shared_ptr<kurento::Factory>
 ModuleManager::getFactory (std::string factoryName)
 {
+  std::unique_lock <std::recursive_mutex> lock (mutex);
+  auto pending = pendingFactories.find (factoryName);
+
+  if (pending != pendingFactories.end() ) {
+    loadPendingModule (pending->second);
+  }
+
   try {
     return loadedFactories.at (factoryName);
   } catch (std::exception &e) {
@@ -19,9 +19,12 @@
 #define __MODULE_MANAGER_H__
 
 #include <glibmm/module.h>
+#include <glibmm/keyfile.h>
 #include <unordered_set>
+#include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <set>
 #include <FactoryRegistrar.hpp>
@@ -35,7 +38,7 @@ class ModuleData
 public:
   ModuleData (const std::string &name, const std::string &version,
               const std::string &compilationTime,
-              const char *descriptor,
+              const std::string &descriptor,
               const std::map <std::string, std::shared_ptr <kurento::Factory > > &factories) :
     name (name), version (version), generationTime (compilationTime),
     descriptor (descriptor), factories (factories)
@@ -59,13 +62,10 @@ public:
 
   std::string getDescriptor () const
   {
-    if (descriptor == NULL) {
-      return "";
-    } else {
-      return descriptor;
-    }
+    return descriptor;
   }
 
+  /* Factories of deferred modules are NULL until the module is loaded */
   const std::map <std::string, std::shared_ptr <kurento::Factory > >
   &getFactories()
   {
@@ -77,8 +77,8 @@ private:
   std::string name;
   std::string version;
   std::string generationTime;
-  const char *descriptor;
-  const std::map <std::string, std::shared_ptr <kurento::Factory > > &factories;
+  std::string descriptor;
+  const std::map <std::string, std::shared_ptr <kurento::Factory > > factories;
 };
 
 class ModuleManager
@@ -88,21 +88,54 @@ public:
   ~ModuleManager () {};
 
   int loadModule (std::string modulePath);
-  void loadModulesFromDirectories (std::string dirPath);
+
+  /*
+   * When lazy is true, directories are scanned in parallel and modules whose
+   * factories are listed in the manifest cache (see getManifestPath) are not
+   * opened until one of their factories is requested. Modules missing from
+   * the manifest, or modified since it was written, are loaded right away.
+   */
+  void loadModulesFromDirectories (std::string dirPath, bool lazy = false);
   const std::map <std::string, std::shared_ptr <kurento::Factory > >
   getLoadedFactories ();
   std::shared_ptr<kurento::Factory> getFactory (std::string symbolName);
 
-  const std::map <std::string, std::shared_ptr <ModuleData>> getModules () const
-  {
-    return loadedModules;
-  }
+  /* Deferred modules are described from the manifest, without loading them */
+  const std::map <std::string, std::shared_ptr <ModuleData>> getModules () const;
+
+  /* KURENTO_MODULES_MANIFEST or modules.manifest in the user cache dir */
+  static std::string getManifestPath ();
 
 private:
 
+  struct PendingModule {
+    std::string path;
+    std::string name;
+    std::string version;
+    std::string generationTime;
+    std::string descriptor;
+    std::list<std::string> factories;
+  };
+
   std::map <std::string, std::shared_ptr <kurento::Factory > > loadedFactories;
   std::map <std::string, std::shared_ptr <ModuleData>> loadedModules;
+
+  /* Modules known from the manifest but not opened yet, by file name */
+  std::map <std::string, PendingModule> pendingModules;
+  std::map <std::string, std::string> pendingFactories;
+
+  /* Descriptions of pendingModules, built on demand by getModules */
+  mutable std::map <std::string, std::shared_ptr <ModuleData>> pendingModulesData;
+
+  mutable std::recursive_mutex mutex;
+
   void loadModules (std::string path);
+  int loadModuleUnlocked (std::string modulePath);
+  void addLazyModule (const std::string &modulePath, Glib::KeyFile &manifest,
+                      bool &manifestChanged);
+  void loadPendingModule (const std::string &moduleFileName);
+  /* Loads every deferred module */
+  void ensureLoaded ();
 
 
   class StaticConstructor
@@ -1469,6 +1469,278 @@ GST_START_TEST (two_sinks_two_srcs_test)
   fail_if (triggered, "Caps signal should not be triggered");
 }
 
+GST_END_TEST
+/* Above the processing latency that saturates a transcoder */
+#define SLOW_TRANSCODER_DELAY (200 * G_TIME_SPAN_MILLISECOND)
+#define SATURATION_BUFFERS 10
+#define FRAME_WIDTH 320
+#define FRAME_HEIGHT 240
+#define FRAME_DURATION (GST_SECOND / 30)
+typedef struct _SaturationData
+{
+  GstElement *agnosticbin;
+  const gchar *second_caps;
+  gint buffers;
+  GstPad *srcpad;
+  GThread *thread;
+  gint pushing;
+} SaturationData;
+
+static GstPadProbeReturn
+slow_transcoder_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  g_usleep (SLOW_TRANSCODER_DELAY);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+slow_down_transcoder (GstPad * sinkpad)
+{
+  GstPad *target = gst_ghost_pad_get_target (GST_GHOST_PAD (sinkpad));
+
+  /* Added after the load probe, so it counts as processing time */
+  gst_pad_add_probe (target,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      slow_transcoder_probe, NULL, NULL);
+  g_object_unref (target);
+}
+
+static guint
+count_transcoders (GstElement * agnosticbin)
+{
+  GstIterator *it = gst_bin_iterate_elements (GST_BIN (agnosticbin));
+  GValue item = G_VALUE_INIT;
+  guint count = 0;
+
+  while (gst_iterator_next (it, &item) == GST_ITERATOR_OK) {
+    GstElement *element = g_value_get_object (&item);
+    GstElementFactory *factory = gst_element_get_factory (element);
+
+    if (factory != NULL && g_strcmp0 (GST_OBJECT_NAME (factory),
+            "agnosticbin") == 0) {
+      count++;
+    }
+
+    g_value_reset (&item);
+  }
+
+  g_value_unset (&item);
+  gst_iterator_free (it);
+
+  return count;
+}
+
+static void
+second_sink_handoff (GstElement * object, GstBuffer * buff, GstPad * pad,
+    gpointer user_data)
+{
+  g_idle_add (quit_main_loop_idle, NULL);
+}
+
+static gboolean
+link_second_sink (SaturationData * data)
+{
+  GstElement *sink = gst_element_factory_make ("fakesink", NULL);
+  GstCaps *caps = gst_caps_from_string (data->second_caps);
+
+  g_object_set (G_OBJECT (sink), "async", FALSE, "sync", FALSE,
+      "signal-handoffs", TRUE, NULL);
+  g_signal_connect (sink, "handoff", G_CALLBACK (second_sink_handoff), NULL);
+
+  gst_bin_add (GST_BIN (pipeline), sink);
+  gst_element_sync_state_with_parent (sink);
+
+  if (!gst_element_link_pads_filtered (data->agnosticbin, "src_%u", sink,
+          "sink", caps)) {
+    fail ("Could not link agnosticbin to second sink");
+  }
+
+  gst_caps_unref (caps);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+first_sink_handoff (GstElement * object, GstBuffer * buff, GstPad * pad,
+    SaturationData * data)
+{
+  /* Wait for the latency of the first output to be measured */
+  if (g_atomic_int_add (&data->buffers, 1) + 1 == SATURATION_BUFFERS) {
+    g_idle_add ((GSourceFunc) link_second_sink, data);
+  }
+}
+
+static GstBuffer *
+create_raw_frame (GstClockTime pts)
+{
+  gsize size = FRAME_WIDTH * FRAME_HEIGHT * 3 / 2;
+  GstBuffer *buffer = gst_buffer_new_allocate (NULL, size, NULL);
+
+  gst_buffer_memset (buffer, 0, 0, size);
+  GST_BUFFER_PTS (buffer) = pts;
+  GST_BUFFER_DURATION (buffer) = FRAME_DURATION;
+
+  return buffer;
+}
+
+static gpointer
+push_buffer_lists (SaturationData * data)
+{
+  GstClockTime pts = 0;
+
+  while (g_atomic_int_get (&data->pushing)) {
+    GstBufferList *list = gst_buffer_list_new ();
+
+    gst_buffer_list_add (list, create_raw_frame (pts));
+    pts += FRAME_DURATION;
+
+    if (gst_pad_push_list (data->srcpad, list) != GST_FLOW_OK) {
+      break;
+    }
+
+    g_usleep (FRAME_DURATION / GST_USECOND);
+  }
+
+  return NULL;
+}
+
+static void
+start_buffer_lists (SaturationData * data)
+{
+  GstSegment segment;
+  GstCaps *caps;
+
+  caps = gst_caps_new_simple ("video/x-raw", "format", G_TYPE_STRING, "I420",
+      "width", G_TYPE_INT, FRAME_WIDTH, "height", G_TYPE_INT, FRAME_HEIGHT,
+      "framerate", GST_TYPE_FRACTION, 30, 1, NULL);
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+
+  gst_pad_push_event (data->srcpad, gst_event_new_stream_start ("lists"));
+  gst_pad_push_event (data->srcpad, gst_event_new_caps (caps));
+  gst_pad_push_event (data->srcpad, gst_event_new_segment (&segment));
+  gst_caps_unref (caps);
+
+  g_atomic_int_set (&data->pushing, TRUE);
+  data->thread = g_thread_new ("lists", (GThreadFunc) push_buffer_lists,
+      data);
+}
+
+/* Links a slowed down input and a transcoded output with @first_caps. */
+/* Then requests an output with @second_caps and returns the number of */
+/* transcoders used to serve both */
+static guint
+check_saturation (const gchar * first_caps, const gchar * second_caps,
+    gboolean lists)
+{
+  GstElement *agnosticbin = gst_element_factory_make ("agnosticbin3", NULL);
+  GstElement *sink = gst_element_factory_make ("fakesink", NULL);
+  GstCaps *caps = gst_caps_from_string (first_caps);
+  GstElement *source = NULL;
+  SaturationData data;
+  GstPad *sinkpad;
+  GstBus *bus;
+  guint count;
+
+  pipeline = gst_pipeline_new (__FUNCTION__);
+  bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+
+  gst_bus_add_signal_watch (bus);
+  g_signal_connect (bus, "message", G_CALLBACK (bus_msg), pipeline);
+
+  data.agnosticbin = agnosticbin;
+  data.second_caps = second_caps;
+  data.buffers = 0;
+  data.srcpad = NULL;
+  data.thread = NULL;
+  data.pushing = FALSE;
+
+  g_object_set (G_OBJECT (sink), "async", FALSE, "sync", FALSE,
+      "signal-handoffs", TRUE, NULL);
+  g_signal_connect (sink, "handoff", G_CALLBACK (first_sink_handoff), &data);
+
+  loop = g_main_loop_new (NULL, TRUE);
+
+  gst_bin_add_many (GST_BIN (pipeline), agnosticbin, sink, NULL);
+
+  sinkpad = gst_element_get_request_pad (agnosticbin, "sink_%u");
+  slow_down_transcoder (sinkpad);
+
+  if (lists) {
+    data.srcpad = gst_pad_new ("src", GST_PAD_SRC);
+    gst_pad_set_active (data.srcpad, TRUE);
+    fail_unless (gst_pad_link (data.srcpad, sinkpad) == GST_PAD_LINK_OK);
+  } else {
+    GstPad *srcpad;
+
+    source = gst_element_factory_make ("videotestsrc", NULL);
+    g_object_set (G_OBJECT (source), "is-live", TRUE, NULL);
+    gst_bin_add (GST_BIN (pipeline), source);
+
+    srcpad = gst_element_get_static_pad (source, "src");
+    fail_unless (gst_pad_link (srcpad, sinkpad) == GST_PAD_LINK_OK);
+    g_object_unref (srcpad);
+  }
+
+  if (!gst_element_link_pads_filtered (agnosticbin, "src_%u", sink, "sink",
+          caps)) {
+    fail ("Could not link agnosticbin to first sink");
+  }
+
+  gst_caps_unref (caps);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  if (lists) {
+    start_buffer_lists (&data);
+  }
+
+  g_timeout_add_seconds (10, print_timedout_pipeline, NULL);
+
+  g_main_loop_run (loop);
+
+  count = count_transcoders (agnosticbin);
+
+  g_atomic_int_set (&data.pushing, FALSE);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+
+  if (data.thread != NULL) {
+    g_thread_join (data.thread);
+  }
+
+  if (data.srcpad != NULL) {
+    g_object_unref (data.srcpad);
+  }
+
+  g_object_unref (sinkpad);
+  gst_bus_remove_signal_watch (bus);
+  g_object_unref (bus);
+  g_object_unref (pipeline);
+  g_main_loop_unref (loop);
+
+  return count;
+}
+
+GST_START_TEST (saturated_transcoder_spawns_new_one)
+{
+  fail_unless (check_saturation ("video/x-vp8", "video/x-msmpeg",
+          FALSE) == 2);
+}
+
+GST_END_TEST
+GST_START_TEST (saturated_transcoder_spawns_new_one_with_lists)
+{
+  fail_unless (check_saturation ("video/x-vp8", "video/x-msmpeg", TRUE) == 2);
+}
+
+GST_END_TEST
+GST_START_TEST (passthrough_does_not_saturate_transcoder)
+{
+  /* The slow input is only forwarded, so the transcoder is not loaded */
+  fail_unless (check_saturation ("video/x-raw", "video/x-vp8", FALSE) == 1);
+}
+
 GST_END_TEST
 /*
  * End of test cases
@@ -1500,6 +1772,9 @@ agnosticbin3_suite (void)
   tcase_add_test (tc_chain, two_sinks_one_src_test);
   tcase_add_test (tc_chain, two_sinks_two_srcs_test);
   tcase_add_test (tc_chain, connect_two_sources_three_sinks);
+  tcase_add_test (tc_chain, saturated_transcoder_spawns_new_one);
+  tcase_add_test (tc_chain, saturated_transcoder_spawns_new_one_with_lists);
+  tcase_add_test (tc_chain, passthrough_does_not_saturate_transcoder);
 
   return s;
 }
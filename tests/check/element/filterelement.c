@@ -223,6 +223,73 @@ GST_START_TEST (provide_invalid_created_filter)
 
 GST_END_TEST;
 
+GST_START_TEST (filter_worker_drops_oldest)
+{
+  GstElement *pipeline, *worker;
+  GstStructure *stats;
+  guint64 processed, dropped;
+  GstBus *bus;
+  GstMessage *msg;
+
+  /* The filter is much slower than the source, so frames must be dropped */
+  pipeline = gst_parse_launch ("videotestsrc num-buffers=100 ! "
+      "filterworker name=worker max-buffers=2 ! "
+      "identity sleep-time=10000 ! fakesink sync=false", NULL);
+  fail_unless (pipeline != NULL);
+
+  worker = gst_bin_get_by_name (GST_BIN (pipeline), "worker");
+  bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  /* EOS is serialized, so every frame has been accounted when it arrives */
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+
+  g_object_get (worker, "stats", &stats, NULL);
+  GST_DEBUG ("Filter stats: %" GST_PTR_FORMAT, stats);
+
+  fail_unless (gst_structure_get_uint64 (stats, "processed-frames",
+          &processed));
+  fail_unless (gst_structure_get_uint64 (stats, "dropped-frames", &dropped));
+  fail_unless (processed + dropped == 100);
+  fail_unless (dropped > 0);
+  fail_unless (gst_structure_has_field_typed (stats, "processing-time",
+          GST_TYPE_STRUCTURE));
+  gst_structure_free (stats);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+
+  g_object_unref (bus);
+  g_object_unref (worker);
+  gst_object_unref (pipeline);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (filter_worker_stats)
+{
+  GstElement *filterelement;
+  GstStructure *stats;
+
+  filterelement = gst_element_factory_make ("filterelement", NULL);
+
+  g_object_set (filterelement, "filter-worker", TRUE, "frame-budget", 2,
+      "filter-factory", "videoflip", NULL);
+
+  g_signal_emit_by_name (filterelement, "stats", NULL, &stats);
+  GST_DEBUG ("Stats: %" GST_PTR_FORMAT, stats);
+  fail_unless (gst_structure_has_field_typed (stats, "filter-statistics",
+          GST_TYPE_STRUCTURE));
+  gst_structure_free (stats);
+
+  gst_object_unref (filterelement);
+}
+
+GST_END_TEST;
+
 /* Suite initialization */
 static Suite *
 filterelement_suite (void)
@@ -236,6 +303,8 @@ filterelement_suite (void)
   tcase_add_test (tc_chain, check_invalid_factory);
   tcase_add_test (tc_chain, provide_created_filter);
   tcase_add_test (tc_chain, provide_invalid_created_filter);
+  tcase_add_test (tc_chain, filter_worker_drops_oldest);
+  tcase_add_test (tc_chain, filter_worker_stats);
 
   return s;
 }
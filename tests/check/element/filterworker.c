@@ -0,0 +1,153 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+#define FILTER_SRC "filter_src"
+#define FILTER_SINK "filter_sink"
+
+#define N_BUFFERS 20
+
+typedef struct _Worker
+{
+  GstHarness *h;
+  GstElement *filter;
+} Worker;
+
+static void
+setup_worker (Worker * worker)
+{
+  worker->h = gst_harness_new ("filterworker");
+  worker->filter = gst_element_factory_make ("identity", NULL);
+
+  gst_element_set_state (worker->filter, GST_STATE_PLAYING);
+  fail_unless (gst_element_link_pads (worker->h->element, FILTER_SRC,
+          worker->filter, "sink"));
+  fail_unless (gst_element_link_pads (worker->filter, "src",
+          worker->h->element, FILTER_SINK));
+
+  gst_harness_set_src_caps_str (worker->h, "video/x-raw");
+}
+
+static void
+teardown_worker (Worker * worker)
+{
+  gst_harness_teardown (worker->h);
+  gst_element_set_state (worker->filter, GST_STATE_NULL);
+  g_object_unref (worker->filter);
+}
+
+static guint64
+get_processed (Worker * worker)
+{
+  GstStructure *stats;
+  guint64 processed;
+
+  g_object_get (worker->h->element, "stats", &stats, NULL);
+  fail_unless (gst_structure_get_uint64 (stats, "processed-frames",
+          &processed));
+  gst_structure_free (stats);
+
+  return processed;
+}
+
+GST_START_TEST (check_flow)
+{
+  Worker worker;
+  guint i;
+
+  setup_worker (&worker);
+
+  for (i = 0; i < N_BUFFERS; i++) {
+    GstBuffer *buffer;
+
+    fail_unless (gst_harness_push (worker.h,
+            gst_buffer_new ()) == GST_FLOW_OK);
+    buffer = gst_harness_pull (worker.h);
+    fail_if (buffer == NULL);
+    gst_buffer_unref (buffer);
+  }
+
+  fail_unless (get_processed (&worker) == N_BUFFERS);
+
+  teardown_worker (&worker);
+}
+
+GST_END_TEST;
+
+static void
+filter_handoff_cb (GstElement * identity, GstBuffer * buffer,
+    GThread ** filter_thread)
+{
+  *filter_thread = g_thread_self ();
+}
+
+static GstPadProbeReturn
+src_probe_cb (GstPad * pad, GstPadProbeInfo * info, GThread ** src_thread)
+{
+  *src_thread = g_thread_self ();
+
+  return GST_PAD_PROBE_OK;
+}
+
+GST_START_TEST (check_no_thread_hop)
+{
+  GThread *filter_thread = NULL, *src_thread = NULL;
+  GstBuffer *buffer;
+  GstPad *srcpad;
+  Worker worker;
+
+  setup_worker (&worker);
+
+  g_signal_connect (worker.filter, "handoff", G_CALLBACK (filter_handoff_cb),
+      &filter_thread);
+  srcpad = gst_element_get_static_pad (worker.h->element, "src");
+  gst_pad_add_probe (srcpad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) src_probe_cb, &src_thread, NULL);
+  g_object_unref (srcpad);
+
+  fail_unless (gst_harness_push (worker.h, gst_buffer_new ()) == GST_FLOW_OK);
+  buffer = gst_harness_pull (worker.h);
+  fail_if (buffer == NULL);
+  gst_buffer_unref (buffer);
+
+  /* The filter runs in a pool thread, which also pushes its output */
+  fail_if (filter_thread == NULL);
+  fail_if (filter_thread == g_thread_self ());
+  fail_unless (src_thread == filter_thread);
+
+  teardown_worker (&worker);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+filterworker_suite (void)
+{
+  Suite *s = suite_create ("filterworker");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+
+  tcase_add_test (tc_chain, check_flow);
+  tcase_add_test (tc_chain, check_no_thread_hop);
+
+  return s;
+}
+
+GST_CHECK_MAIN (filterworker);
@@ -20,6 +20,8 @@
 
 #include "kmslist.h"
 
+#define N_ENTRIES 10000
+
 GST_START_TEST (list_create)
 {
   KmsList *list;
@@ -124,6 +126,127 @@ GST_START_TEST (list_remove)
   kms_list_unref (list);
 }
 
+GST_END_TEST
+GST_START_TEST (list_scale_str)
+{
+  gpointer key, value;
+  GstClockTime start;
+  KmsListIter iter;
+  KmsList *list;
+  gchar *str;
+  guint i, prev;
+
+  list = kms_list_new_full (g_str_equal, g_free, NULL);
+  start = gst_util_get_timestamp ();
+
+  for (i = 0; i < N_ENTRIES; i++) {
+    kms_list_append (list, g_strdup_printf ("key%u", i), GUINT_TO_POINTER (i));
+  }
+
+  fail_if (kms_list_length (list) != N_ENTRIES);
+
+  for (i = 0; i < N_ENTRIES; i++) {
+    str = g_strdup_printf ("key%u", i);
+    fail_if (GPOINTER_TO_UINT (kms_list_lookup (list, str)) != i);
+    g_free (str);
+  }
+
+  /* Remove odd entries */
+  for (i = 1; i < N_ENTRIES; i += 2) {
+    str = g_strdup_printf ("key%u", i);
+    kms_list_remove (list, str);
+    fail_if (kms_list_contains (list, str));
+    g_free (str);
+  }
+
+  fail_if (kms_list_length (list) != N_ENTRIES / 2);
+
+  /* Insertion order is kept */
+  i = 0;
+  prev = 0;
+  kms_list_iter_init (&iter, list);
+  while (kms_list_iter_next (&iter, &key, &value)) {
+    fail_if (GPOINTER_TO_UINT (value) % 2 != 0);
+    fail_if (i > 0 && GPOINTER_TO_UINT (value) <= prev);
+    prev = GPOINTER_TO_UINT (value);
+    i++;
+  }
+
+  fail_if (i != N_ENTRIES / 2);
+
+  GST_INFO ("%u entries processed in %" GST_TIME_FORMAT, N_ENTRIES,
+      GST_TIME_ARGS (gst_util_get_timestamp () - start));
+
+  kms_list_unref (list);
+}
+
+GST_END_TEST
+GST_START_TEST (list_scale_duplicates)
+{
+  KmsList *list;
+  guint i;
+
+  list = kms_list_new (g_direct_equal);
+
+  for (i = 0; i < N_ENTRIES; i++) {
+    kms_list_append (list, GUINT_TO_POINTER (i % 100), GUINT_TO_POINTER (i));
+  }
+
+  kms_list_prepend (list, GUINT_TO_POINTER (7), GUINT_TO_POINTER (N_ENTRIES));
+
+  fail_if (kms_list_length (list) != N_ENTRIES + 1);
+
+  /* The first entry with a key is found and removed first */
+  fail_if (GPOINTER_TO_UINT (kms_list_lookup (list,
+              GUINT_TO_POINTER (7))) != N_ENTRIES);
+  kms_list_remove (list, GUINT_TO_POINTER (7));
+
+  for (i = 7; i < N_ENTRIES; i += 100) {
+    fail_if (GPOINTER_TO_UINT (kms_list_lookup (list,
+                GUINT_TO_POINTER (7))) != i);
+    kms_list_remove (list, GUINT_TO_POINTER (7));
+  }
+
+  fail_if (kms_list_contains (list, GUINT_TO_POINTER (7)));
+  fail_if (kms_list_length (list) != N_ENTRIES - N_ENTRIES / 100);
+
+  kms_list_unref (list);
+}
+
+GST_END_TEST
+GST_START_TEST (list_lazy_index)
+{
+  KmsList *list;
+  guint i;
+
+  /* Short lists are scanned and get indexed as they grow, lookups must
+   * give the same result either way */
+  list = kms_list_new_full (g_str_equal, g_free, NULL);
+
+  for (i = 0; i < 32; i++) {
+    gchar *key = g_strdup_printf ("key%u", i % 4);
+
+    kms_list_append (list, key, GUINT_TO_POINTER (i));
+    fail_if (GPOINTER_TO_UINT (kms_list_lookup (list, "key0")) != 0);
+    fail_if (GPOINTER_TO_UINT (kms_list_lookup (list, key)) != i % 4);
+  }
+
+  kms_list_prepend (list, g_strdup ("key1"), GUINT_TO_POINTER (100));
+  fail_if (GPOINTER_TO_UINT (kms_list_lookup (list, "key1")) != 100);
+
+  /* Entries with the same key are removed in insertion order */
+  kms_list_remove (list, "key1");
+  for (i = 1; i < 32; i += 4) {
+    fail_if (GPOINTER_TO_UINT (kms_list_lookup (list, "key1")) != i);
+    kms_list_remove (list, "key1");
+  }
+
+  fail_if (kms_list_contains (list, "key1"));
+  fail_if (kms_list_length (list) != 24);
+
+  kms_list_unref (list);
+}
+
 GST_END_TEST static Suite *
 lists_suite (void)
 {
@@ -135,6 +258,9 @@ lists_suite (void)
   tcase_add_test (tc_chain, list_create);
   tcase_add_test (tc_chain, list_add);
   tcase_add_test (tc_chain, list_remove);
+  tcase_add_test (tc_chain, list_scale_str);
+  tcase_add_test (tc_chain, list_scale_duplicates);
+  tcase_add_test (tc_chain, list_lazy_index);
 
   return s;
 }
@@ -24,6 +24,7 @@
 #include <time.h>
 
 #include "kmsbufferlacentymeta.h"
+#include "kmsstats.h"
 
 #define KMS_FACTORY_MAKE_IF_AVAILABLE(factory_name) ({      \
   GstElement *_element;                                     \
@@ -416,7 +417,191 @@ GST_START_TEST (check_metadata_enc)
   }
 }
 
-GST_END_TEST
+GST_END_TEST;
+
+GST_START_TEST (check_latency_marks)
+{
+  GQuark first = g_quark_from_static_string ("first");
+  GQuark last = g_quark_from_static_string ("last");
+  GQuark extra = g_quark_from_static_string ("extra");
+  KmsBufferLatencyMeta *meta, *copy_meta;
+  GstBuffer *buffer, *copy;
+  gint i;
+
+  buffer = gst_buffer_new ();
+  meta = kms_buffer_add_buffer_latency_meta (buffer, 0, TRUE,
+      0 /*No matter media type */ );
+
+  /* Extra data is only created when asked for */
+  fail_unless (meta->data == NULL);
+  fail_if (kms_buffer_latency_meta_get_data (meta) == NULL);
+  fail_unless (kms_buffer_latency_meta_get_data (meta) == meta->data);
+
+  fail_unless (kms_buffer_latency_meta_add_mark (meta, first, 10));
+
+  for (i = 1; i < KMS_BUFFER_LATENCY_MAX_MARKS - 1; i++) {
+    fail_unless (kms_buffer_latency_meta_add_mark (meta, first, 20));
+  }
+
+  fail_unless (kms_buffer_latency_meta_add_mark (meta, last, 30));
+
+  /* Marks that do not fit in the meta are not lost */
+  fail_unless (kms_buffer_latency_meta_add_mark (meta, extra, 40));
+  fail_unless (meta->overflow != NULL);
+
+  fail_unless (kms_buffer_latency_meta_get_mark (meta, first) == 10);
+  fail_unless (kms_buffer_latency_meta_get_mark (meta, last) == 30);
+  fail_unless (kms_buffer_latency_meta_get_mark (meta, extra) == 40);
+
+  copy = gst_buffer_copy (buffer);
+  copy_meta = kms_buffer_get_buffer_latency_meta (copy);
+
+  fail_if (copy_meta == NULL);
+  fail_unless (copy_meta->data == meta->data);
+  fail_unless (kms_buffer_latency_meta_get_mark (copy_meta, first) == 10);
+  fail_unless (kms_buffer_latency_meta_get_mark (copy_meta, last) == 30);
+  fail_unless (kms_buffer_latency_meta_get_mark (copy_meta, extra) == 40);
+
+  gst_buffer_unref (copy);
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST;
+
+static GstFlowReturn
+count_latency_metas_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
+{
+  guint *count = (guint *) pad->chaindata;
+
+  if (kms_buffer_get_buffer_latency_meta (buf) != NULL) {
+    (*count)++;
+  }
+
+  gst_buffer_unref (buf);
+
+  return GST_FLOW_OK;
+}
+
+static guint
+count_sampled_buffers (guint sampling, guint n_buffers)
+{
+  GstPad *srcpad, *sinkpad;
+  GstSegment segment;
+  guint count = 0, i;
+
+  srcpad = gst_pad_new ("src", GST_PAD_SRC);
+  sinkpad = gst_pad_new ("sink", GST_PAD_SINK);
+  gst_pad_set_chain_function_full (sinkpad, count_latency_metas_chain, &count,
+      NULL);
+  fail_unless (gst_pad_link (srcpad, sinkpad) == GST_PAD_LINK_OK);
+  gst_pad_set_active (srcpad, TRUE);
+  gst_pad_set_active (sinkpad, TRUE);
+
+  gst_pad_push_event (srcpad, gst_event_new_stream_start ("test"));
+  gst_pad_push_event (srcpad, gst_event_new_caps (gst_caps_new_any ()));
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (srcpad, gst_event_new_segment (&segment));
+
+  kms_stats_add_buffer_latency_meta_probe_full (srcpad, TRUE,
+      0 /*No matter media type */ , sampling);
+
+  for (i = 0; i < n_buffers; i++) {
+    gst_pad_push (srcpad, gst_buffer_new ());
+  }
+
+  gst_pad_set_active (srcpad, FALSE);
+  gst_pad_set_active (sinkpad, FALSE);
+  g_object_unref (srcpad);
+  g_object_unref (sinkpad);
+
+  return count;
+}
+
+GST_START_TEST (check_latency_sampling)
+{
+  fail_unless (count_sampled_buffers (1, 100) == 100);
+  fail_unless (count_sampled_buffers (10, 100) == 10);
+
+  /* Follows the process-wide sampling */
+  kms_stats_set_latency_sampling (50);
+  fail_unless (kms_stats_get_latency_sampling () == 50);
+  fail_unless (count_sampled_buffers (0, 100) == 2);
+  kms_stats_set_latency_sampling (1);
+}
+
+GST_END_TEST;
+
+static void
+count_stat_marks (GQuark id, GstClockTime ts, KmsRefStruct * data,
+    guint * count)
+{
+  if (data != NULL) {
+    (*count)++;
+  }
+}
+
+GST_START_TEST (check_latency_mark_probe)
+{
+  StreamE2EAvgStat *stat = kms_stats_stream_e2e_avg_stat_new (0);
+  KmsBufferLatencyMeta *meta;
+  GstPad *srcpad, *sinkpad;
+  guint count = 0, received = 0, i;
+  GstSegment segment;
+  GstBuffer *buffer;
+
+  srcpad = gst_pad_new ("src", GST_PAD_SRC);
+  sinkpad = gst_pad_new ("sink", GST_PAD_SINK);
+  gst_pad_set_chain_function_full (sinkpad, count_latency_metas_chain,
+      &received, NULL);
+  fail_unless (gst_pad_link (srcpad, sinkpad) == GST_PAD_LINK_OK);
+  gst_pad_set_active (srcpad, TRUE);
+  gst_pad_set_active (sinkpad, TRUE);
+
+  gst_pad_push_event (srcpad, gst_event_new_stream_start ("test"));
+  gst_pad_push_event (srcpad, gst_event_new_caps (gst_caps_new_any ()));
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (srcpad, gst_event_new_segment (&segment));
+
+  /* Stands for many endpoints fed from the same tee */
+  for (i = 0; i < KMS_BUFFER_LATENCY_MAX_MARKS * 2; i++) {
+    gchar *id = g_strdup_printf ("endpoint%u_sink", i);
+
+    kms_stats_add_buffer_latency_mark_probe (srcpad, id,
+        KMS_REF_STRUCT_CAST (stat));
+    g_free (id);
+  }
+
+  /* Only valid metas are marked */
+  buffer = gst_buffer_new ();
+  meta = kms_buffer_add_buffer_latency_meta (buffer, 0, FALSE, 0);
+  gst_pad_push (srcpad, gst_buffer_ref (buffer));
+  fail_unless (meta->n_marks == 0);
+  gst_buffer_unref (buffer);
+
+  buffer = gst_buffer_new ();
+  meta = kms_buffer_add_buffer_latency_meta (buffer, 0, TRUE, 0);
+  gst_pad_push (srcpad, gst_buffer_ref (buffer));
+  fail_unless (received == 2);
+  kms_buffer_latency_meta_foreach_mark (meta,
+      (KmsBufferLatencyMarkFunc) count_stat_marks, &count);
+  fail_unless (count == KMS_BUFFER_LATENCY_MAX_MARKS * 2);
+
+  /* Marks keep the stat alive */
+  gst_pad_set_active (srcpad, FALSE);
+  gst_pad_set_active (sinkpad, FALSE);
+  g_object_unref (srcpad);
+  g_object_unref (sinkpad);
+  fail_unless (g_atomic_int_get (&stat->ref._count) == 1 +
+      KMS_BUFFER_LATENCY_MAX_MARKS * 2);
+
+  gst_buffer_unref (buffer);
+  fail_unless (g_atomic_int_get (&stat->ref._count) == 1);
+
+  kms_stats_stream_e2e_avg_stat_unref (stat);
+}
+
+GST_END_TEST;
+
 /******************************/
 /* metadata test suite        */
 /******************************/
@@ -429,6 +614,9 @@ metadata_suite (void)
   suite_add_tcase (s, tc_chain);
 
   tcase_add_test (tc_chain, check_metadata_enc);
+  tcase_add_test (tc_chain, check_latency_marks);
+  tcase_add_test (tc_chain, check_latency_sampling);
+  tcase_add_test (tc_chain, check_latency_mark_probe);
 
   return s;
 }
@@ -2067,6 +2067,158 @@ GST_START_TEST (sdp_agent_test_dynamic_pts)
 
 GST_END_TEST;
 
+GST_START_TEST (sdp_agent_payload_manager_bitmap)
+{
+  KmsISdpPayloadManager *ptmanager;
+  GError *err = NULL;
+  gchar *name;
+  gint i, pt;
+
+  ptmanager =
+      KMS_I_SDP_PAYLOAD_MANAGER
+      (kms_sdp_payload_manager_new_same_codec_shares_pt ());
+
+  fail_unless (kms_i_sdp_payload_manager_get_dynamic_pt (ptmanager,
+          "VP8/90000", &err) == 96);
+  fail_unless (kms_i_sdp_payload_manager_get_dynamic_pt (ptmanager,
+          "H264/90000", &err) == 97);
+  fail_unless (kms_i_sdp_payload_manager_get_dynamic_pt (ptmanager,
+          "VP8/90000", &err) == 96);
+
+  /* A codec registered by the remote peer takes its payload type */
+  fail_unless (kms_i_sdp_payload_manager_register_dynamic_payload (ptmanager,
+          100, "H264/90000", &err));
+  fail_unless (kms_i_sdp_payload_manager_get_dynamic_pt (ptmanager,
+          "H264/90000", &err) == 100);
+
+  /* Released payload types are not given again */
+  fail_unless (kms_i_sdp_payload_manager_get_dynamic_pt (ptmanager,
+          "opus/48000/2", &err) == 98);
+  fail_unless (kms_i_sdp_payload_manager_get_dynamic_pt (ptmanager,
+          "VP9/90000", &err) == 99);
+  fail_unless (kms_i_sdp_payload_manager_get_dynamic_pt (ptmanager,
+          "red/90000", &err) == 101);
+
+  for (i = 102; i <= 127; i++) {
+    name = g_strdup_printf ("codec%d/90000", i);
+    pt = kms_i_sdp_payload_manager_get_dynamic_pt (ptmanager, name, &err);
+    fail_unless (pt == i);
+    g_free (name);
+  }
+
+  fail_if (err != NULL);
+  fail_unless (kms_i_sdp_payload_manager_get_dynamic_pt (ptmanager,
+          "ulpfec/90000", &err) < 0);
+  GST_DEBUG ("Expected error: %s", err->message);
+  g_clear_error (&err);
+
+  /* Payload types already given are still found */
+  fail_unless (kms_i_sdp_payload_manager_get_dynamic_pt (ptmanager,
+          "VP8/90000", &err) == 96);
+
+  g_object_unref (ptmanager);
+}
+
+GST_END_TEST;
+
+#define N_CODECS 32
+#define N_FMTP_VARIANTS 16
+
+GST_START_TEST (sdp_agent_large_codec_set)
+{
+  KmsSdpPayloadManager *ptmanager;
+  KmsSdpMediaHandler *handler;
+  KmsSdpAgent *offerer, *answerer;
+  GstSDPMessage *offer, *answer;
+  const GstSDPMedia *media;
+  GError *err = NULL;
+  GstClockTime start;
+  guint i, j, fmtps;
+  gint pt;
+
+  offerer = kms_sdp_agent_new ();
+  handler = KMS_SDP_MEDIA_HANDLER (kms_sdp_rtp_avp_media_handler_new ());
+  ptmanager = kms_sdp_payload_manager_new ();
+  fail_unless (kms_sdp_rtp_avp_media_handler_use_payload_manager
+      (KMS_SDP_RTP_AVP_MEDIA_HANDLER (handler),
+          KMS_I_SDP_PAYLOAD_MANAGER (ptmanager), &err));
+
+  start = gst_util_get_timestamp ();
+
+  for (i = 0; i < N_CODECS; i++) {
+    gchar *name = g_strdup_printf ("H264-%u/90000", i);
+
+    pt = kms_sdp_rtp_avp_media_handler_add_generic_video_payload
+        (KMS_SDP_RTP_AVP_MEDIA_HANDLER (handler), name, &err);
+    fail_unless (pt >= 0);
+    g_free (name);
+
+    for (j = 0; j < N_FMTP_VARIANTS; j++) {
+      gchar *fmtp = g_strdup_printf ("profile-level-id=42e0%02x", j);
+
+      fail_unless (kms_sdp_rtp_avp_media_handler_add_fmtp
+          (KMS_SDP_RTP_AVP_MEDIA_HANDLER (handler), pt, fmtp, &err));
+      g_free (fmtp);
+    }
+  }
+
+  /* Encoding names are case-insensitive */
+  fail_if (kms_sdp_rtp_avp_media_handler_add_video_codec
+      (KMS_SDP_RTP_AVP_MEDIA_HANDLER (handler), "h264-0/90000", &err));
+  GST_DEBUG ("Expected error: %s", err->message);
+  g_clear_error (&err);
+
+  fail_if (kms_sdp_agent_add_proto_handler (offerer, "video", handler,
+          NULL) < 0);
+
+  offer = kms_sdp_agent_create_offer (offerer, &err);
+  fail_if (err != NULL);
+
+  media = gst_sdp_message_get_media (offer, 0);
+  fail_unless (gst_sdp_media_formats_len (media) == N_CODECS);
+
+  for (i = 0, fmtps = 0; i < gst_sdp_media_attributes_len (media); i++) {
+    if (g_strcmp0 (gst_sdp_media_get_attribute (media, i)->key, "fmtp") == 0) {
+      fmtps++;
+    }
+  }
+  fail_unless (fmtps == N_CODECS * N_FMTP_VARIANTS);
+
+  /* Answer with the same codec set */
+  answerer = kms_sdp_agent_new ();
+  handler = KMS_SDP_MEDIA_HANDLER (kms_sdp_rtp_avp_media_handler_new ());
+  ptmanager = kms_sdp_payload_manager_new_same_codec_shares_pt ();
+  fail_unless (kms_sdp_rtp_avp_media_handler_use_payload_manager
+      (KMS_SDP_RTP_AVP_MEDIA_HANDLER (handler),
+          KMS_I_SDP_PAYLOAD_MANAGER (ptmanager), &err));
+  for (i = 0; i < N_CODECS; i++) {
+    gchar *name = g_strdup_printf ("h264-%u/90000", N_CODECS - 1 - i);
+
+    fail_unless (kms_sdp_rtp_avp_media_handler_add_generic_video_payload
+        (KMS_SDP_RTP_AVP_MEDIA_HANDLER (handler), name, &err) >= 0);
+    g_free (name);
+  }
+  fail_if (kms_sdp_agent_add_proto_handler (answerer, "video", handler,
+          NULL) < 0);
+
+  fail_if (!kms_sdp_agent_set_remote_description (answerer, offer, &err));
+  answer = kms_sdp_agent_create_answer (answerer, &err);
+  fail_if (err != NULL);
+
+  GST_INFO ("%u codecs with %u fmtp each negotiated in %" GST_TIME_FORMAT,
+      N_CODECS, N_FMTP_VARIANTS,
+      GST_TIME_ARGS (gst_util_get_timestamp () - start));
+
+  media = gst_sdp_message_get_media (answer, 0);
+  fail_unless (gst_sdp_media_formats_len (media) == N_CODECS);
+
+  gst_sdp_message_free (answer);
+  g_object_unref (answerer);
+  g_object_unref (offerer);
+}
+
+GST_END_TEST;
+
 static const gchar *sdp_offer_str1 = "v=0\r\n"
     "o=- 0 0 IN IP4 0.0.0.0\r\n"
     "s=TestSession\r\n"
@@ -5704,6 +5856,461 @@ GST_START_TEST (sdp_agent_renegotiation_chrome)
 
 GST_END_TEST;
 
+#define N_TEMPLATE_OFFERS 500
+#define OFFER_TEMPLATE_KEY "avpf-audio-video"
+
+static void
+template_on_offer (KmsSdpAgent * agent, KmsSdpMediaHandler * handler,
+    GstSDPMedia * media, gpointer user_data)
+{
+  gchar *ssrc;
+
+  /* Per endpoint attribute */
+  ssrc = g_strdup_printf ("%u cname:%p", g_random_int (), agent);
+  gst_sdp_media_add_attribute (media, "ssrc", ssrc);
+  g_free (ssrc);
+
+  (*(guint *) user_data)++;
+}
+
+static KmsSdpAgent *
+create_template_agent_with_codecs (const gchar * key, guint * offered,
+    gchar ** video_list, guint video_len)
+{
+  KmsSdpAgentCallbacks cb = { 0 };
+  KmsSdpMediaHandler *handler;
+  KmsSdpAgent *agent;
+
+  agent = kms_sdp_agent_new ();
+  g_object_set (agent, "addr", OFFERER_ADDR, "offer-template", key, NULL);
+
+  cb.on_media_offer = template_on_offer;
+  kms_sdp_agent_set_callbacks (agent, &cb, offered, NULL);
+
+  handler = KMS_SDP_MEDIA_HANDLER (kms_sdp_rtp_avpf_media_handler_new ());
+  g_object_set (handler, "rtcp-mux", TRUE, "nack", TRUE, "goog-remb", TRUE,
+      NULL);
+  set_default_codecs (KMS_SDP_RTP_AVP_MEDIA_HANDLER (handler), audio_codecs,
+      G_N_ELEMENTS (audio_codecs), NULL, 0);
+  add_media_handler (agent, "audio", handler);
+
+  handler = KMS_SDP_MEDIA_HANDLER (kms_sdp_rtp_avpf_media_handler_new ());
+  g_object_set (handler, "rtcp-mux", TRUE, "nack", TRUE, "goog-remb", TRUE,
+      NULL);
+  set_default_codecs (KMS_SDP_RTP_AVP_MEDIA_HANDLER (handler), NULL, 0,
+      video_list, video_len);
+
+  /* Same extensions as the ones of KmsBaseRtpEndpoint */
+  fail_unless (kms_sdp_media_handler_add_media_extension (handler,
+          KMS_I_SDP_MEDIA_EXTENSION (kms_sdp_ulp_fec_ext_new ())));
+  fail_unless (kms_sdp_media_handler_add_media_extension (handler,
+          KMS_I_SDP_MEDIA_EXTENSION (kms_sdp_redundant_ext_new ())));
+
+  add_media_handler (agent, "video", handler);
+
+  return agent;
+}
+
+static KmsSdpAgent *
+create_template_agent (const gchar * key, guint * offered)
+{
+  return create_template_agent_with_codecs (key, offered, video_codecs,
+      G_N_ELEMENTS (video_codecs));
+}
+
+static gchar *
+media_without_ssrc_as_text (const GstSDPMedia * media)
+{
+  GstSDPMedia *copy;
+  gchar *text;
+  guint i;
+
+  gst_sdp_media_copy (media, &copy);
+
+  for (i = gst_sdp_media_attributes_len (copy); i > 0; i--) {
+    if (g_strcmp0 (gst_sdp_media_get_attribute (copy, i - 1)->key,
+            "ssrc") == 0) {
+      gst_sdp_media_remove_attribute (copy, i - 1);
+    }
+  }
+
+  text = gst_sdp_media_as_text (copy);
+  gst_sdp_media_free (copy);
+
+  return text;
+}
+
+static gdouble
+bench_offers (const gchar * key, GstSDPMessage ** first)
+{
+  GError *err = NULL;
+  gint64 start, elapsed;
+  guint i, offered = 0;
+
+  start = g_get_monotonic_time ();
+
+  for (i = 0; i < N_TEMPLATE_OFFERS; i++) {
+    KmsSdpAgent *agent;
+    GstSDPMessage *offer;
+
+    agent = create_template_agent (key, &offered);
+    offer = kms_sdp_agent_create_offer (agent, &err);
+    fail_if (err != NULL);
+    fail_unless (gst_sdp_message_medias_len (offer) == 2);
+
+    if (i == 0 && first != NULL) {
+      *first = offer;
+    } else {
+      gst_sdp_message_free (offer);
+    }
+
+    g_object_unref (agent);
+  }
+
+  elapsed = MAX (g_get_monotonic_time () - start, 1);
+
+  /* The callback patches every media, templates included */
+  fail_unless (offered == 2 * N_TEMPLATE_OFFERS);
+
+  return N_TEMPLATE_OFFERS * (gdouble) G_USEC_PER_SEC / elapsed;
+}
+
+GST_START_TEST (sdp_agent_offer_template)
+{
+  GstSDPMessage *plain, *compiled;
+  GError *err = NULL;
+  KmsSdpAgent *agent;
+  guint offered = 0;
+  gdouble no_template, with_template;
+  guint i;
+
+  kms_sdp_agent_clear_offer_templates ();
+
+  no_template = bench_offers (NULL, &plain);
+  bench_offers (OFFER_TEMPLATE_KEY, NULL);
+
+  /* Offers built from the template equal the ones built from scratch */
+  agent = create_template_agent (OFFER_TEMPLATE_KEY, &offered);
+  compiled = kms_sdp_agent_create_offer (agent, &err);
+  fail_if (err != NULL);
+  fail_unless (offered == 2);
+
+  fail_unless (gst_sdp_message_medias_len (compiled) ==
+      gst_sdp_message_medias_len (plain));
+  for (i = 0; i < gst_sdp_message_medias_len (plain); i++) {
+    gchar *p, *c;
+
+    p = media_without_ssrc_as_text (gst_sdp_message_get_media (plain, i));
+    c = media_without_ssrc_as_text (gst_sdp_message_get_media (compiled, i));
+    fail_unless (g_strcmp0 (p, c) == 0);
+    g_free (p);
+    g_free (c);
+  }
+
+  /* Session id is still generated per agent */
+  fail_if (g_strcmp0 (gst_sdp_message_get_origin (plain)->sess_id,
+          gst_sdp_message_get_origin (compiled)->sess_id) == 0);
+
+  gst_sdp_message_free (compiled);
+  gst_sdp_message_free (plain);
+  g_object_unref (agent);
+
+  with_template = bench_offers (OFFER_TEMPLATE_KEY, NULL);
+
+  GST_INFO ("Offers per second: %.0f without template, %.0f with template",
+      no_template, with_template);
+
+  kms_sdp_agent_clear_offer_templates ();
+}
+
+GST_END_TEST;
+
+static gchar *
+create_video_offer_as_text (const gchar * key, gchar ** video_list,
+    guint video_len)
+{
+  GstSDPMessage *offer;
+  GError *err = NULL;
+  KmsSdpAgent *agent;
+  guint offered = 0;
+  gchar *text;
+
+  agent = create_template_agent_with_codecs (key, &offered, video_list,
+      video_len);
+  offer = kms_sdp_agent_create_offer (agent, &err);
+  fail_if (err != NULL);
+
+  text = media_without_ssrc_as_text (gst_sdp_message_get_media (offer, 1));
+
+  gst_sdp_message_free (offer);
+  g_object_unref (agent);
+
+  return text;
+}
+
+GST_START_TEST (sdp_agent_offer_template_payloads)
+{
+  gchar *reversed[G_N_ELEMENTS (video_codecs)];
+  gchar *expected, *offered;
+  guint i;
+
+  kms_sdp_agent_clear_offer_templates ();
+
+  for (i = 0; i < G_N_ELEMENTS (video_codecs); i++) {
+    reversed[i] = video_codecs[G_N_ELEMENTS (video_codecs) - 1 - i];
+  }
+
+  g_free (create_video_offer_as_text (OFFER_TEMPLATE_KEY, video_codecs,
+          G_N_ELEMENTS (video_codecs)));
+
+  /* Payload types of the template do not match this agent, so its offer */
+  /* is built from scratch                                               */
+  expected = create_video_offer_as_text (NULL, reversed,
+      G_N_ELEMENTS (reversed));
+  offered = create_video_offer_as_text (OFFER_TEMPLATE_KEY, reversed,
+      G_N_ELEMENTS (reversed));
+  fail_unless (g_strcmp0 (expected, offered) == 0);
+
+  g_free (expected);
+  g_free (offered);
+
+  kms_sdp_agent_clear_offer_templates ();
+}
+
+GST_END_TEST;
+
+#define SDES_TEMPLATE_KEY "savpf-video-sdes"
+
+static GArray *
+on_template_offer_keys_cb (KmsSdpSdesExt * ext, gpointer data)
+{
+  const gchar *key = data;
+  GValue val = G_VALUE_INIT;
+  GArray *keys;
+
+  keys = g_array_sized_new (FALSE, FALSE, sizeof (GValue), 1);
+  g_array_set_clear_func (keys, (GDestroyNotify) g_value_unset);
+
+  fail_if (!kms_sdp_sdes_ext_create_key (1, key,
+          KMS_SDES_EXT_AES_CM_128_HMAC_SHA1_80, &val));
+  g_array_append_val (keys, val);
+
+  return keys;
+}
+
+static gchar *
+create_sdes_template_offer (const gchar * key)
+{
+  KmsSdpMediaHandler *handler;
+  const GstSDPMedia *media;
+  GstSDPMessage *offer;
+  GError *err = NULL;
+  KmsSdpAgent *agent;
+  KmsSdpSdesExt *ext;
+  gchar *crypto;
+
+  agent = kms_sdp_agent_new ();
+  g_object_set (agent, "addr", OFFERER_ADDR, "offer-template",
+      SDES_TEMPLATE_KEY, NULL);
+
+  handler = KMS_SDP_MEDIA_HANDLER (kms_sdp_rtp_savpf_media_handler_new ());
+  set_default_codecs (KMS_SDP_RTP_AVP_MEDIA_HANDLER (handler), NULL, 0,
+      video_codecs, G_N_ELEMENTS (video_codecs));
+
+  ext = kms_sdp_sdes_ext_new ();
+  fail_if (!kms_sdp_media_handler_add_media_extension (handler,
+          KMS_I_SDP_MEDIA_EXTENSION (ext)));
+  g_signal_connect (ext, "on-offer-keys",
+      G_CALLBACK (on_template_offer_keys_cb), (gpointer) key);
+
+  add_media_handler (agent, "video", handler);
+
+  offer = kms_sdp_agent_create_offer (agent, &err);
+  fail_if (err != NULL);
+
+  media = gst_sdp_message_get_media (offer, 0);
+  crypto = g_strdup (gst_sdp_media_get_attribute_val (media, "crypto"));
+  fail_if (crypto == NULL);
+
+  gst_sdp_message_free (offer);
+  g_object_unref (agent);
+
+  return crypto;
+}
+
+GST_START_TEST (sdp_agent_offer_template_sdes)
+{
+  gchar *crypto1, *crypto2;
+
+  kms_sdp_agent_clear_offer_templates ();
+
+  crypto1 = create_sdes_template_offer ("1abcdefgh");
+  crypto2 = create_sdes_template_offer ("2abcdefgh");
+
+  /* Each agent offers its own master key */
+  fail_unless (g_strrstr (crypto1, "1abcdefgh") != NULL);
+  fail_unless (g_strrstr (crypto2, "2abcdefgh") != NULL);
+  fail_if (g_strcmp0 (crypto1, crypto2) == 0);
+
+  g_free (crypto1);
+  g_free (crypto2);
+
+  kms_sdp_agent_clear_offer_templates ();
+}
+
+GST_END_TEST;
+
+#define N_INDEX_PAYLOADS 32
+#define N_INDEX_SSRCS 256
+
+static const gchar *index_codecs[] = {
+  "VP8/90000", "H264/90000", "unsupported/90000"
+};
+
+static GstSDPMessage *
+create_large_video_offer ()
+{
+  GstSDPMessage *offer;
+  GString *str;
+  guint i;
+
+  str = g_string_new ("v=0\r\n"
+      "o=- 0 0 IN IP4 0.0.0.0\r\n"
+      "s=TestSession\r\n"
+      "c=IN IP4 0.0.0.0\r\n" "t=0 0\r\n" "m=video 1 RTP/AVPF");
+
+  for (i = 0; i < N_INDEX_PAYLOADS; i++) {
+    g_string_append_printf (str, " %u", 96 + i);
+  }
+  g_string_append (str, "\r\n");
+
+  for (i = 0; i < N_INDEX_PAYLOADS; i++) {
+    guint pt = 96 + i;
+
+    g_string_append_printf (str, "a=rtpmap:%u %s\r\n"
+        "a=fmtp:%u profile-level-id=%u\r\n"
+        "a=rtcp-fb:%u nack\r\n"
+        "a=rtcp-fb:%u nack pli\r\n"
+        "a=rtcp-fb:%u ccm fir\r\n"
+        "a=rtcp-fb:%u goog-remb\r\n", pt,
+        index_codecs[i % G_N_ELEMENTS (index_codecs)], pt, i, pt, pt, pt, pt);
+  }
+
+  for (i = 0; i < N_INDEX_SSRCS; i++) {
+    g_string_append_printf (str, "a=ssrc:%u cname:user%u\r\n", 1000 + i, i);
+  }
+
+  fail_unless (gst_sdp_message_new (&offer) == GST_SDP_OK);
+  fail_unless (gst_sdp_message_parse_buffer ((const guint8 *) str->str, -1,
+          offer) == GST_SDP_OK);
+  g_string_free (str, TRUE);
+
+  return offer;
+}
+
+GST_START_TEST (sdp_agent_indexed_media)
+{
+  gchar *video_codecs[] = { "VP8/90000", "H264/90000" };
+  KmsSdpAgent *answerer;
+  KmsSdpMediaHandler *handler;
+  GstSDPMessage *offer, *answer;
+  const GstSDPMedia *media;
+  SdpMediaIndex *index;
+  GError *err = NULL;
+  GstClockTime start;
+  guint i, len;
+
+  offer = create_large_video_offer ();
+  media = gst_sdp_message_get_media (offer, 0);
+
+  /* Lookups through the index are the same as the linear ones */
+  index = sdp_utils_media_index_new (media);
+  fail_unless (sdp_utils_media_index_get_media (index) == media);
+
+  len = gst_sdp_media_formats_len (media);
+  fail_unless (len == N_INDEX_PAYLOADS);
+
+  for (i = 0; i < len; i++) {
+    const gchar *fmt = gst_sdp_media_get_format (media, i);
+
+    fail_unless (sdp_utils_media_index_has_format (index, fmt));
+    fail_unless (sdp_utils_media_index_get_attr_map_value (index, "rtpmap",
+            fmt) == sdp_utils_get_attr_map_value (media, "rtpmap", fmt));
+    fail_unless (sdp_utils_media_index_get_fmtp (index, fmt) ==
+        sdp_utils_sdp_media_get_fmtp (media, fmt));
+    fail_unless (sdp_utils_media_index_get_rtpmap (index, fmt) ==
+        sdp_utils_sdp_media_get_rtpmap (media, fmt));
+  }
+
+  for (i = 0; i < gst_sdp_media_attributes_len (media); i++) {
+    fail_unless (sdp_utils_media_index_has_attribute (index,
+            gst_sdp_media_get_attribute (media, i)));
+  }
+
+  fail_if (sdp_utils_media_index_has_format (index, "9"));
+  fail_unless (sdp_utils_media_index_get_attr_map_value (index, "rtpmap",
+          "9") == NULL);
+  fail_unless (sdp_utils_media_index_get_pt_for_codec_name (index,
+          "H264") == 97);
+  fail_unless (sdp_utils_get_pt_for_codec_name (media, "H264") == 97);
+  fail_unless (sdp_utils_media_index_get_pt_for_codec_name (index,
+          "VP9") == -1);
+
+  sdp_utils_media_index_free (index);
+
+  /* Answer an offer with many payloads, rtcp-fb and ssrc attributes */
+  answerer = kms_sdp_agent_new ();
+  handler = KMS_SDP_MEDIA_HANDLER (kms_sdp_rtp_avpf_media_handler_new ());
+  set_default_codecs (KMS_SDP_RTP_AVP_MEDIA_HANDLER (handler), NULL, 0,
+      video_codecs, G_N_ELEMENTS (video_codecs));
+  fail_if (kms_sdp_agent_add_proto_handler (answerer, "video", handler,
+          NULL) < 0);
+
+  start = gst_util_get_timestamp ();
+  fail_if (!kms_sdp_agent_set_remote_description (answerer, offer, &err));
+  answer = kms_sdp_agent_create_answer (answerer, &err);
+  fail_if (err != NULL);
+
+  GST_INFO ("Answer to %u payloads and %u ssrcs created in %" GST_TIME_FORMAT,
+      N_INDEX_PAYLOADS, N_INDEX_SSRCS,
+      GST_TIME_ARGS (gst_util_get_timestamp () - start));
+
+  media = gst_sdp_message_get_media (answer, 0);
+  len = gst_sdp_media_formats_len (media);
+  fail_unless (len > 0);
+
+  index = sdp_utils_media_index_new (media);
+
+  for (i = 0; i < len; i++) {
+    const gchar *fmt = gst_sdp_media_get_format (media, i);
+
+    /* Unsupported payloads are never answered */
+    fail_unless (g_strcmp0 (sdp_utils_sdp_media_get_rtpmap (media, fmt),
+            "unsupported/90000") != 0);
+  }
+
+  /* Only feedback messages for formats in the answer are kept */
+  for (i = 0;; i++) {
+    const gchar *val;
+    gchar **opts;
+
+    val = gst_sdp_media_get_attribute_val_n (media, "rtcp-fb", i);
+    if (val == NULL) {
+      break;
+    }
+
+    opts = g_strsplit (val, " ", 0);
+    fail_unless (sdp_utils_media_index_has_format (index, opts[0]));
+    g_strfreev (opts);
+  }
+
+  sdp_utils_media_index_free (index);
+  gst_sdp_message_free (answer);
+  g_object_unref (answerer);
+}
+
+GST_END_TEST;
+
 static Suite *
 sdp_agent_suite (void)
 {
@@ -5733,6 +6340,8 @@ sdp_agent_suite (void)
   tcase_add_test (tc_chain, sdp_agent_test_bandwidtth_attrs);
   tcase_add_test (tc_chain, sdp_agent_test_extmap_attrs);
   tcase_add_test (tc_chain, sdp_agent_test_dynamic_pts);
+  tcase_add_test (tc_chain, sdp_agent_payload_manager_bitmap);
+  tcase_add_test (tc_chain, sdp_agent_large_codec_set);
   tcase_add_test (tc_chain, sdp_agent_test_optional_enc_parameters);
   tcase_add_test (tc_chain, sdp_agent_regression_tests);
   tcase_add_test (tc_chain, sdp_agent_udp_tls_rtp_savpf_negotiation);
@@ -5753,6 +6362,10 @@ sdp_agent_suite (void)
   tcase_add_test (tc_chain, sdp_agent_groups);
 
   tcase_add_test (tc_chain, sdp_agent_renegotiation_chrome);
+  tcase_add_test (tc_chain, sdp_agent_offer_template);
+  tcase_add_test (tc_chain, sdp_agent_offer_template_payloads);
+  tcase_add_test (tc_chain, sdp_agent_offer_template_sdes);
+  tcase_add_test (tc_chain, sdp_agent_indexed_media);
 
   return s;
 }
@@ -0,0 +1,204 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/gst.h>
+
+#include "kmsserializablemeta.h"
+
+#define N_BRANCHES 8
+#define N_BUFFERS 300
+
+static GMutex count_mutex;
+static guint handoffs;
+
+GST_START_TEST (check_copy_on_write)
+{
+  const GstStructure *data, *merged;
+  GstStructure *writable;
+  GstBuffer *buffer, *copy;
+  guint copies;
+  gint value;
+
+  buffer = gst_buffer_new ();
+  kms_buffer_add_serializable_meta (buffer,
+      gst_structure_new ("metadata", "value", G_TYPE_INT, 1, NULL));
+  data = kms_serializable_meta_peek_metadata (buffer);
+
+  copies = kms_serializable_meta_get_structure_copies ();
+  copy = gst_buffer_copy (buffer);
+  fail_unless (kms_serializable_meta_peek_metadata (copy) == data);
+  fail_unless (kms_serializable_meta_get_structure_copies () == copies);
+
+  /* Changing the copy does not change the original */
+  writable = kms_serializable_meta_get_writable_metadata (copy);
+  fail_if (writable == data);
+  fail_unless (kms_serializable_meta_get_structure_copies () == copies + 1);
+  gst_structure_set (writable, "value", G_TYPE_INT, 2, NULL);
+
+  fail_unless (gst_structure_get_int (data, "value", &value));
+  fail_unless (value == 1);
+
+  /* Merging into a shared meta keeps the old fields */
+  gst_buffer_unref (copy);
+  copy = gst_buffer_copy (buffer);
+  kms_buffer_add_serializable_meta (copy,
+      gst_structure_new ("other", "extra", G_TYPE_INT, 3, NULL));
+
+  merged = kms_serializable_meta_peek_metadata (copy);
+  fail_if (merged == data);
+  fail_unless (gst_structure_has_name (merged, "metadata"));
+  fail_unless (gst_structure_get_int (merged, "value", &value));
+  fail_unless (value == 1);
+  fail_unless (gst_structure_get_int (merged, "extra", &value));
+  fail_unless (value == 3);
+  fail_if (gst_structure_has_field (data, "extra"));
+
+  /* Not shared anymore, it is modified in place */
+  gst_buffer_unref (copy);
+  fail_unless (kms_serializable_meta_get_writable_metadata (buffer) == data);
+
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST;
+
+static GstPadProbeReturn
+add_metadata (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+  buffer = gst_buffer_make_writable (buffer);
+  kms_buffer_add_serializable_meta (buffer,
+      gst_structure_new ("metadata", "offset", G_TYPE_UINT64,
+          GST_BUFFER_OFFSET (buffer), "source", G_TYPE_STRING, "test", NULL));
+  GST_PAD_PROBE_INFO_DATA (info) = buffer;
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+fakesink_hand_off (GstElement * fakesink, GstBuffer * buf, GstPad * pad,
+    gpointer data)
+{
+  GstBuffer *copy;
+
+  /* Same as any element making the buffer writable */
+  copy = gst_buffer_copy (buf);
+  fail_unless (kms_serializable_meta_peek_metadata (copy) != NULL);
+  gst_buffer_unref (copy);
+
+  g_mutex_lock (&count_mutex);
+  handoffs++;
+  g_mutex_unlock (&count_mutex);
+}
+
+static void
+bus_msg (GstBus * bus, GstMessage * msg, gpointer loop)
+{
+  switch (GST_MESSAGE_TYPE (msg)) {
+    case GST_MESSAGE_ERROR:
+      fail ("Error received on bus");
+      break;
+    case GST_MESSAGE_EOS:
+      g_main_loop_quit (loop);
+      break;
+    default:
+      break;
+  }
+}
+
+GST_START_TEST (benchmark_agnosticbin_fan_out)
+{
+  GMainLoop *loop = g_main_loop_new (NULL, FALSE);
+  GstElement *pipeline = gst_pipeline_new (__FUNCTION__);
+  GstElement *videotestsrc = gst_element_factory_make ("videotestsrc", NULL);
+  GstElement *agnosticbin = gst_element_factory_make ("agnosticbin", NULL);
+  GstBus *bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+  GstClockTime start, elapsed;
+  guint i, copies;
+  GstPad *pad;
+
+  handoffs = 0;
+
+  g_object_set (videotestsrc, "num-buffers", N_BUFFERS, NULL);
+  pad = gst_element_get_static_pad (videotestsrc, "src");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, add_metadata, NULL, NULL);
+  g_object_unref (pad);
+
+  gst_bus_add_signal_watch (bus);
+  g_signal_connect (bus, "message", G_CALLBACK (bus_msg), loop);
+
+  gst_bin_add_many (GST_BIN (pipeline), videotestsrc, agnosticbin, NULL);
+  fail_unless (gst_element_link (videotestsrc, agnosticbin));
+
+  for (i = 0; i < N_BRANCHES; i++) {
+    GstElement *fakesink = gst_element_factory_make ("fakesink", NULL);
+
+    g_object_set (fakesink, "sync", FALSE, "async", FALSE,
+        "signal-handoffs", TRUE, NULL);
+    g_signal_connect (fakesink, "handoff", G_CALLBACK (fakesink_hand_off),
+        NULL);
+    gst_bin_add (GST_BIN (pipeline), fakesink);
+    fail_unless (gst_element_link (agnosticbin, fakesink));
+  }
+
+  copies = kms_serializable_meta_get_structure_copies ();
+  start = gst_util_get_timestamp ();
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  g_main_loop_run (loop);
+  elapsed = gst_util_get_timestamp () - start;
+  /* Counts every copy made inside agnosticbin too, not only the sinks' */
+  copies = kms_serializable_meta_get_structure_copies () - copies;
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+
+  GST_INFO ("%u branches, %u buffers: %u handoffs, %.2f metadata "
+      "allocations per buffer, %" G_GUINT64_FORMAT " ns per buffer",
+      N_BRANCHES, N_BUFFERS, handoffs, (gdouble) copies / N_BUFFERS,
+      elapsed / N_BUFFERS);
+
+  fail_unless (handoffs > 0);
+  /* Copies share the metadata of the buffer they come from */
+  fail_unless (copies == 0);
+
+  gst_bus_remove_signal_watch (bus);
+  g_object_unref (bus);
+  g_object_unref (pipeline);
+  g_main_loop_unref (loop);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+serializablemeta_suite (void)
+{
+  Suite *s = suite_create ("serializablemeta");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_copy_on_write);
+  tcase_add_test (tc_chain, benchmark_agnosticbin_fan_out);
+
+  return s;
+}
+
+GST_CHECK_MAIN (serializablemeta);
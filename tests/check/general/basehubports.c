@@ -0,0 +1,329 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <gst/check/gstcheck.h>
+
+#include "kmsbasehub.h"
+#include "kmshubport.h"
+
+/* Ids not handled by the hub, so their pads are linked by the test */
+#define UNHANDLED_ID 1000
+#define UNHANDLED_PAD "video_src_1000"
+
+typedef struct _RetargetData
+{
+  GstElement *pipe;
+  KmsBaseHub *hub;
+  GstElement *tees[3];
+  GstPad *srcpad;
+  GstPad *sinkpad;
+  GstPad *gp;
+  gulong probe;
+  GThread *thread;
+
+  GMutex mutex;
+  GCond cond;
+  gboolean blocked;
+} RetargetData;
+
+static gboolean
+sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  gst_event_unref (event);
+
+  return TRUE;
+}
+
+static GstFlowReturn
+sink_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  gst_buffer_unref (buffer);
+
+  return GST_FLOW_OK;
+}
+
+static GstPadProbeReturn
+block_probe_cb (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  RetargetData *data = user_data;
+
+  g_mutex_lock (&data->mutex);
+  data->blocked = TRUE;
+  g_cond_signal (&data->cond);
+  g_mutex_unlock (&data->mutex);
+
+  /* Keeps the buffer inside the old target until the probe is removed */
+  return GST_PAD_PROBE_OK;
+}
+
+static gpointer
+push_buffer (gpointer user_data)
+{
+  RetargetData *data = user_data;
+
+  gst_pad_push (data->srcpad, gst_buffer_new ());
+
+  return NULL;
+}
+
+static void
+setup_retarget (RetargetData * data)
+{
+  GstSegment segment;
+  GstPad *teesink;
+  guint i;
+
+  data->pipe = gst_pipeline_new (NULL);
+  data->hub = g_object_new (KMS_TYPE_BASE_HUB, NULL);
+  gst_bin_add (GST_BIN (data->pipe), GST_ELEMENT (data->hub));
+
+  for (i = 0; i < G_N_ELEMENTS (data->tees); i++) {
+    data->tees[i] = gst_element_factory_make ("tee", NULL);
+    gst_bin_add (GST_BIN (data->hub), data->tees[i]);
+  }
+
+  g_mutex_init (&data->mutex);
+  g_cond_init (&data->cond);
+  data->blocked = FALSE;
+
+  gst_element_set_state (data->pipe, GST_STATE_PLAYING);
+
+  fail_unless (kms_base_hub_link_video_src (data->hub, UNHANDLED_ID,
+          data->tees[0], "src_%u", FALSE));
+  data->gp = gst_element_get_static_pad (GST_ELEMENT (data->hub),
+      UNHANDLED_PAD);
+  fail_if (data->gp == NULL);
+
+  data->sinkpad = gst_pad_new ("sink", GST_PAD_SINK);
+  gst_pad_set_event_function (data->sinkpad, sink_event);
+  gst_pad_set_chain_function (data->sinkpad, sink_chain);
+  gst_pad_set_active (data->sinkpad, TRUE);
+  fail_unless (gst_pad_link (data->gp, data->sinkpad) == GST_PAD_LINK_OK);
+
+  data->srcpad = gst_pad_new ("src", GST_PAD_SRC);
+  gst_pad_set_active (data->srcpad, TRUE);
+  teesink = gst_element_get_static_pad (data->tees[0], "sink");
+  fail_unless (gst_pad_link (data->srcpad, teesink) == GST_PAD_LINK_OK);
+  g_object_unref (teesink);
+
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (data->srcpad, gst_event_new_stream_start ("test"));
+  gst_pad_push_event (data->srcpad,
+      gst_event_new_caps (gst_caps_new_empty_simple ("video/x-raw")));
+  gst_pad_push_event (data->srcpad, gst_event_new_segment (&segment));
+
+  /* The old target stays busy while the buffer is blocked downstream */
+  data->probe = gst_pad_add_probe (data->sinkpad,
+      GST_PAD_PROBE_TYPE_BLOCK | GST_PAD_PROBE_TYPE_BUFFER, block_probe_cb,
+      data, NULL);
+  data->thread = g_thread_new ("push", push_buffer, data);
+
+  g_mutex_lock (&data->mutex);
+  while (!data->blocked) {
+    g_cond_wait (&data->cond, &data->mutex);
+  }
+  g_mutex_unlock (&data->mutex);
+}
+
+static void
+unblock_retarget (RetargetData * data)
+{
+  gst_pad_remove_probe (data->sinkpad, data->probe);
+  g_thread_join (data->thread);
+}
+
+static void
+teardown_retarget (RetargetData * data)
+{
+  gst_element_set_state (data->pipe, GST_STATE_NULL);
+
+  g_object_unref (data->gp);
+  g_object_unref (data->srcpad);
+  g_object_unref (data->sinkpad);
+  g_object_unref (data->pipe);
+
+  g_mutex_clear (&data->mutex);
+  g_cond_clear (&data->cond);
+}
+
+static GstElement *
+get_target_element (GstPad * gp)
+{
+  GstPad *target = gst_ghost_pad_get_target (GST_GHOST_PAD (gp));
+  GstElement *element;
+
+  if (target == NULL) {
+    return NULL;
+  }
+
+  element = gst_pad_get_parent_element (target);
+  g_object_unref (target);
+  g_object_unref (element);
+
+  return element;
+}
+
+GST_START_TEST (retarget_superseded)
+{
+  RetargetData data;
+
+  setup_retarget (&data);
+
+  fail_unless (kms_base_hub_link_video_src (data.hub, UNHANDLED_ID,
+          data.tees[1], "src_%u", FALSE));
+  fail_unless (kms_base_hub_link_video_src (data.hub, UNHANDLED_ID,
+          data.tees[2], "src_%u", FALSE));
+
+  /* Both wait for the old target to be idle */
+  fail_unless (get_target_element (data.gp) == data.tees[0]);
+
+  unblock_retarget (&data);
+
+  /* Only the last call is applied */
+  fail_unless (get_target_element (data.gp) == data.tees[2]);
+
+  teardown_retarget (&data);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (retarget_cancelled_by_unlink)
+{
+  RetargetData data;
+
+  setup_retarget (&data);
+
+  fail_unless (kms_base_hub_link_video_src (data.hub, UNHANDLED_ID,
+          data.tees[1], "src_%u", FALSE));
+  fail_unless (kms_base_hub_unlink_video_src (data.hub, UNHANDLED_ID));
+  fail_unless (get_target_element (data.gp) == NULL);
+
+  unblock_retarget (&data);
+
+  /* The pending retarget does not link the pad again */
+  fail_unless (get_target_element (data.gp) == NULL);
+
+  teardown_retarget (&data);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (retarget_failure_is_reported)
+{
+  RetargetData data;
+  GstElement *sink = gst_element_factory_make ("fakesink", NULL);
+
+  setup_retarget (&data);
+
+  /* A sink pad cannot be the target of a source ghost pad */
+  gst_bin_add (GST_BIN (data.hub), sink);
+  fail_if (kms_base_hub_link_video_src (data.hub, UNHANDLED_ID, sink,
+          "sink", FALSE));
+
+  unblock_retarget (&data);
+
+  fail_unless (get_target_element (data.gp) == data.tees[0]);
+
+  teardown_retarget (&data);
+}
+
+GST_END_TEST;
+
+#define N_PORTS 500
+
+/* KmsHubPort stands for the ports of the hubs, which live in other
+ * modules */
+GST_START_TEST (benchmark_port_churn)
+{
+  GstElement *pipe = gst_pipeline_new (NULL);
+  KmsBaseHub *hub = g_object_new (KMS_TYPE_BASE_HUB, NULL);
+  GstElement *tee = gst_element_factory_make ("tee", NULL);
+  GstElement *other_tee = gst_element_factory_make ("tee", NULL);
+  GstElement *funnel = gst_element_factory_make ("funnel", NULL);
+  GstElement *ports[N_PORTS];
+  gint ids[N_PORTS];
+  GstClockTime start, join, retarget, leave;
+  guint i;
+
+  gst_bin_add (GST_BIN (pipe), GST_ELEMENT (hub));
+  gst_bin_add_many (GST_BIN (hub), tee, other_tee, funnel, NULL);
+
+  start = gst_util_get_timestamp ();
+  for (i = 0; i < N_PORTS; i++) {
+    ports[i] = g_object_new (KMS_TYPE_HUB_PORT, NULL);
+    gst_bin_add (GST_BIN (pipe), ports[i]);
+
+    g_signal_emit_by_name (hub, "handle-port", ports[i], &ids[i]);
+    fail_unless (ids[i] >= 0);
+
+    fail_unless (kms_base_hub_link_video_src (hub, ids[i], tee, "src_%u",
+            TRUE));
+    fail_unless (kms_base_hub_link_video_sink (hub, ids[i], funnel,
+            "sink_%u", TRUE));
+  }
+  join = gst_util_get_timestamp () - start;
+
+  fail_unless (GST_ELEMENT (hub)->numsrcpads == N_PORTS);
+  fail_unless (tee->numsrcpads == N_PORTS);
+
+  start = gst_util_get_timestamp ();
+  for (i = 0; i < N_PORTS; i++) {
+    fail_unless (kms_base_hub_link_video_src (hub, ids[i], other_tee,
+            "src_%u", TRUE));
+  }
+  retarget = gst_util_get_timestamp () - start;
+
+  /* Nothing is flowing, so every old target was idle and released */
+  fail_unless (tee->numsrcpads == 0);
+  fail_unless (other_tee->numsrcpads == N_PORTS);
+
+  start = gst_util_get_timestamp ();
+  for (i = 0; i < N_PORTS; i++) {
+    fail_unless (kms_base_hub_unlink_video_src (hub, ids[i]));
+    g_signal_emit_by_name (hub, "unhandle-port", ids[i]);
+    gst_bin_remove (GST_BIN (pipe), ports[i]);
+  }
+  leave = gst_util_get_timestamp () - start;
+
+  fail_unless (GST_ELEMENT (hub)->numpads == 0);
+  fail_unless (other_tee->numsrcpads == 0);
+
+  GST_INFO ("%d ports: join %" G_GUINT64_FORMAT " ns, retarget %"
+      G_GUINT64_FORMAT " ns, leave %" G_GUINT64_FORMAT " ns per port",
+      N_PORTS, join / N_PORTS, retarget / N_PORTS, leave / N_PORTS);
+
+  g_object_unref (pipe);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+basehubports_suite (void)
+{
+  Suite *s = suite_create ("basehubports");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, retarget_superseded);
+  tcase_add_test (tc_chain, retarget_cancelled_by_unlink);
+  tcase_add_test (tc_chain, retarget_failure_is_reported);
+  tcase_add_test (tc_chain, benchmark_port_churn);
+
+  return s;
+}
+
+GST_CHECK_MAIN (basehubports);
@@ -0,0 +1,399 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/rtp/gstrtpbuffer.h>
+
+#include "kmsbasertpendpoint.h"
+#include "kmsbasertpsession.h"
+#include "sdpagent/kmssdprtpavpfmediahandler.h"
+#include "sdp_utils.h"
+#include "constants.h"
+
+#define SSRC 0x12345678
+#define VIDEO_PT 96
+#define FRAME_DURATION (33 * GST_MSECOND)
+#define LOST_SEQNUM 2
+#define MAX_CRANKS 50
+
+#define NACK_OFFER \
+  "v=0\r\n" \
+  "o=- 0 0 IN IP4 127.0.0.1\r\n" \
+  "s=-\r\n" \
+  "c=IN IP4 127.0.0.1\r\n" \
+  "t=0 0\r\n" \
+  "m=video 5004 RTP/AVPF 96\r\n" \
+  "a=rtpmap:96 VP8/90000\r\n" \
+  "a=rtcp-fb:96 nack\r\n" \
+  "a=ssrc:305419896 cname:test\r\n"
+
+/* Minimal endpoint able to negotiate, connections are not created */
+typedef struct _KmsTestRtpEndpoint
+{
+  KmsBaseRtpEndpoint parent;
+} KmsTestRtpEndpoint;
+
+typedef struct _KmsTestRtpEndpointClass
+{
+  KmsBaseRtpEndpointClass parent_class;
+} KmsTestRtpEndpointClass;
+
+static GType kms_test_rtp_endpoint_get_type (void);
+
+G_DEFINE_TYPE (KmsTestRtpEndpoint, kms_test_rtp_endpoint,
+    KMS_TYPE_BASE_RTP_ENDPOINT);
+
+static void
+kms_test_rtp_endpoint_create_session_internal (KmsBaseSdpEndpoint * base_sdp,
+    gint id, KmsSdpSession ** sess)
+{
+  *sess = KMS_SDP_SESSION (kms_base_rtp_session_new (base_sdp, id,
+          KMS_I_RTP_SESSION_MANAGER (base_sdp)));
+
+  KMS_BASE_SDP_ENDPOINT_CLASS
+      (kms_test_rtp_endpoint_parent_class)->create_session_internal (base_sdp,
+      id, sess);
+}
+
+static void
+kms_test_rtp_endpoint_create_media_handler (KmsBaseSdpEndpoint * base_sdp,
+    const gchar * media, KmsSdpMediaHandler ** handler)
+{
+  *handler = KMS_SDP_MEDIA_HANDLER (kms_sdp_rtp_avpf_media_handler_new ());
+
+  KMS_BASE_SDP_ENDPOINT_CLASS
+      (kms_test_rtp_endpoint_parent_class)->create_media_handler (base_sdp,
+      media, handler);
+}
+
+static void
+kms_test_rtp_endpoint_class_init (KmsTestRtpEndpointClass * klass)
+{
+  KmsBaseSdpEndpointClass *base_sdp_class = KMS_BASE_SDP_ENDPOINT_CLASS (klass);
+
+  base_sdp_class->create_session_internal =
+      kms_test_rtp_endpoint_create_session_internal;
+  base_sdp_class->create_media_handler =
+      kms_test_rtp_endpoint_create_media_handler;
+}
+
+static void
+kms_test_rtp_endpoint_init (KmsTestRtpEndpoint * self)
+{
+}
+
+static GstElement *
+get_rtpbin (GstElement * endpoint)
+{
+  GstIterator *it = gst_bin_iterate_elements (GST_BIN (endpoint));
+  GstElement *rtpbin = NULL;
+  GValue item = G_VALUE_INIT;
+
+  while (rtpbin == NULL && gst_iterator_next (it, &item) == GST_ITERATOR_OK) {
+    GstElement *element = g_value_get_object (&item);
+    GstElementFactory *factory = gst_element_get_factory (element);
+
+    if (factory != NULL && g_strcmp0 (GST_OBJECT_NAME (factory),
+            "rtpbin") == 0) {
+      rtpbin = gst_object_ref (element);
+    }
+
+    g_value_reset (&item);
+  }
+
+  g_value_unset (&item);
+  gst_iterator_free (it);
+
+  fail_if (rtpbin == NULL);
+
+  return rtpbin;
+}
+
+/* Configures a new jitter buffer as rtpbin does for a new SSRC */
+static GstElement *
+new_jitterbuffer (gboolean bypass, guint session)
+{
+  GstElement *endpoint, *rtpbin, *jitterbuffer;
+
+  endpoint = g_object_new (KMS_TYPE_BASE_RTP_ENDPOINT, "jitter-buffer-bypass",
+      bypass, NULL);
+  rtpbin = get_rtpbin (endpoint);
+  jitterbuffer = gst_element_factory_make ("rtpjitterbuffer", NULL);
+  fail_if (jitterbuffer == NULL);
+
+  g_signal_emit_by_name (rtpbin, "new-jitterbuffer", jitterbuffer, session,
+      SSRC);
+
+  g_object_unref (rtpbin);
+  g_object_unref (endpoint);
+
+  return jitterbuffer;
+}
+
+GST_START_TEST (check_bypass_property)
+{
+  GstElement *endpoint;
+  gboolean bypass;
+
+  endpoint = g_object_new (KMS_TYPE_BASE_RTP_ENDPOINT, NULL);
+
+  g_object_get (endpoint, "jitter-buffer-bypass", &bypass, NULL);
+  fail_if (bypass);
+
+  g_object_set (endpoint, "jitter-buffer-bypass", TRUE, NULL);
+  g_object_get (endpoint, "jitter-buffer-bypass", &bypass, NULL);
+  fail_unless (bypass);
+
+  g_object_unref (endpoint);
+}
+
+GST_END_TEST;
+
+static void
+append_codec (GArray * array, const gchar * codec)
+{
+  GValue v = G_VALUE_INIT;
+  GstStructure *st;
+
+  g_value_init (&v, GST_TYPE_STRUCTURE);
+  st = gst_structure_new_empty (codec);
+  gst_value_set_structure (&v, st);
+  gst_structure_free (st);
+  g_array_append_val (array, v);
+}
+
+/* Returns an endpoint that answered an offer negotiating NACK for video */
+static GstElement *
+new_nack_endpoint (gboolean bypass)
+{
+  GstSDPMessage *offer, *answer = NULL;
+  GstElement *endpoint;
+  GArray *codecs;
+  gchar *sess_id = NULL;
+  guint i;
+  gboolean nack = FALSE;
+
+  codecs = g_array_new (FALSE, TRUE, sizeof (GValue));
+  append_codec (codecs, "VP8/90000");
+
+  endpoint = g_object_new (kms_test_rtp_endpoint_get_type (),
+      "jitter-buffer-bypass", bypass, "rtcp-nack", TRUE, "num-audio-medias", 0,
+      "num-video-medias", 1, NULL);
+  gst_object_ref_sink (endpoint);
+  g_object_set (endpoint, "video-codecs", codecs, NULL);
+
+  g_signal_emit_by_name (endpoint, "create-session", &sess_id);
+  fail_if (sess_id == NULL);
+
+  fail_unless (gst_sdp_message_new (&offer) == GST_SDP_OK);
+  fail_unless (gst_sdp_message_parse_buffer ((const guint8 *) NACK_OFFER,
+          -1, offer) == GST_SDP_OK);
+
+  g_signal_emit_by_name (endpoint, "process-offer", sess_id, offer, &answer);
+  fail_if (answer == NULL);
+
+  for (i = 0; i < gst_sdp_message_medias_len (answer); i++) {
+    nack |= sdp_utils_media_has_rtcp_nack (gst_sdp_message_get_media (answer,
+            i));
+  }
+  fail_unless (nack);
+
+  gst_sdp_message_free (answer);
+  gst_sdp_message_free (offer);
+  g_free (sess_id);
+
+  return endpoint;
+}
+
+static GstBuffer *
+create_rtp_buffer (guint16 seqnum)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstBuffer *buffer;
+
+  buffer = gst_rtp_buffer_new_allocate (16, 0, 0);
+  gst_rtp_buffer_map (buffer, GST_MAP_WRITE, &rtp);
+  gst_rtp_buffer_set_ssrc (&rtp, SSRC);
+  gst_rtp_buffer_set_payload_type (&rtp, VIDEO_PT);
+  gst_rtp_buffer_set_seq (&rtp, seqnum);
+  gst_rtp_buffer_set_timestamp (&rtp, seqnum * 3000);
+  gst_rtp_buffer_unmap (&rtp);
+
+  /* Arrival time */
+  GST_BUFFER_DTS (buffer) = seqnum * FRAME_DURATION;
+
+  return buffer;
+}
+
+static gboolean
+has_rtx_request (GstHarness * h, guint seqnum)
+{
+  gboolean found = FALSE;
+  GstEvent *event;
+
+  while ((event = gst_harness_try_pull_upstream_event (h)) != NULL) {
+    const GstStructure *st = gst_event_get_structure (event);
+    guint requested;
+
+    if (GST_EVENT_TYPE (event) == GST_EVENT_CUSTOM_UPSTREAM
+        && gst_structure_has_name (st, "GstRTPRetransmissionRequest")
+        && gst_structure_get_uint (st, "seqnum", &requested)
+        && requested == seqnum) {
+      found = TRUE;
+    }
+
+    gst_event_unref (event);
+  }
+
+  return found;
+}
+
+/* Drops a packet and checks that its retransmission is requested */
+static void
+check_lost_packet_requested (gboolean bypass)
+{
+  GstElement *endpoint, *rtpbin, *jitterbuffer;
+  gboolean requested = FALSE;
+  GstHarness *h;
+  guint16 seqnum;
+  guint i;
+
+  endpoint = new_nack_endpoint (bypass);
+  rtpbin = get_rtpbin (endpoint);
+  jitterbuffer = gst_element_factory_make ("rtpjitterbuffer", NULL);
+  fail_if (jitterbuffer == NULL);
+
+  g_signal_emit_by_name (rtpbin, "new-jitterbuffer", jitterbuffer,
+      VIDEO_RTP_SESSION, SSRC);
+
+  h = gst_harness_new_with_element (jitterbuffer, "sink", "src");
+  gst_harness_set_src_caps_str (h, "application/x-rtp, media=video, "
+      "clock-rate=90000, encoding-name=VP8, payload=96");
+
+  for (seqnum = 0; seqnum <= LOST_SEQNUM + 1; seqnum++) {
+    if (seqnum == LOST_SEQNUM) {
+      continue;
+    }
+
+    gst_harness_set_time (h, seqnum * FRAME_DURATION);
+    fail_unless (gst_harness_push (h, create_rtp_buffer (seqnum)) ==
+        GST_FLOW_OK);
+  }
+
+  /* Requests are sent when the timers of the jitter buffer expire */
+  requested = has_rtx_request (h, LOST_SEQNUM);
+  for (i = 0; i < MAX_CRANKS && !requested; i++) {
+    if (!gst_harness_wait_for_clock_id_waits (h, 1, 1)) {
+      break;
+    }
+
+    gst_harness_crank_single_clock_wait (h);
+    requested = has_rtx_request (h, LOST_SEQNUM);
+  }
+
+  fail_unless (requested);
+
+  gst_harness_teardown (h);
+  g_object_unref (jitterbuffer);
+  g_object_unref (rtpbin);
+  g_object_unref (endpoint);
+}
+
+GST_START_TEST (check_bypass_video_jitterbuffer)
+{
+  GstElement *bypassed;
+  gboolean do_lost;
+  guint latency;
+  gint mode;
+
+  bypassed = new_jitterbuffer (TRUE, VIDEO_RTP_SESSION);
+
+  g_object_get (bypassed, "mode", &mode, "latency", &latency, "do-lost",
+      &do_lost, NULL);
+
+  fail_unless (mode == 0);
+  /* Reordered packets are not taken as lost */
+  fail_unless (latency > 0);
+  fail_unless (do_lost);
+
+  g_object_unref (bypassed);
+
+  /* Losses are still requested as negotiated */
+  check_lost_packet_requested (TRUE);
+  check_lost_packet_requested (FALSE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_bypass_audio_jitterbuffer)
+{
+  GstElement *jitterbuffer;
+  gboolean do_lost;
+  guint latency;
+  gint mode;
+
+  jitterbuffer = new_jitterbuffer (TRUE, AUDIO_RTP_SESSION);
+
+  g_object_get (jitterbuffer, "mode", &mode, "latency", &latency, "do-lost",
+      &do_lost, NULL);
+
+  fail_unless (mode == 0);
+  fail_unless (latency > 0);
+  fail_if (do_lost);
+
+  g_object_unref (jitterbuffer);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_fec_generation_property)
+{
+  GstElement *endpoint;
+  gboolean fec_generation;
+
+  endpoint = g_object_new (KMS_TYPE_BASE_RTP_ENDPOINT, NULL);
+
+  /* Off until browsers interoperability is verified */
+  g_object_get (endpoint, "fec-generation", &fec_generation, NULL);
+  fail_if (fec_generation);
+
+  g_object_set (endpoint, "fec-generation", TRUE, NULL);
+  g_object_get (endpoint, "fec-generation", &fec_generation, NULL);
+  fail_unless (fec_generation);
+
+  g_object_unref (endpoint);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+basertpendpoint_suite (void)
+{
+  Suite *s = suite_create ("basertpendpoint");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_bypass_property);
+  tcase_add_test (tc_chain, check_bypass_video_jitterbuffer);
+  tcase_add_test (tc_chain, check_bypass_audio_jitterbuffer);
+  tcase_add_test (tc_chain, check_fec_generation_property);
+
+  return s;
+}
+
+GST_CHECK_MAIN (basertpendpoint);
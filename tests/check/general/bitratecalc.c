@@ -0,0 +1,109 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "kmsbitratecalc.h"
+
+#include <gst/check/gstcheck.h>
+#include <glib.h>
+
+GST_START_TEST (check_constant_bitrate)
+{
+  KmsBitrateCalc calc;
+  guint i;
+
+  kms_bitrate_calc_init (&calc, GST_SECOND);
+  fail_unless (kms_bitrate_calc_get_bitrate (&calc) == 0);
+
+  /* 1000 bytes every 100ms: 80000 bps */
+  for (i = 0; i < 50; i++) {
+    kms_bitrate_calc_update (&calc, i * 100 * GST_MSECOND, 1000);
+  }
+
+  /* 11 samples over 1 second, 10 intervals of 1000 bytes */
+  fail_unless (kms_bitrate_calc_get_bitrate (&calc) == 80000);
+
+  kms_bitrate_calc_reset (&calc);
+  fail_unless (kms_bitrate_calc_get_bitrate (&calc) == 0);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_window_overflow)
+{
+  KmsBitrateCalc calc;
+  guint i;
+
+  kms_bitrate_calc_init (&calc, GST_SECOND);
+
+  /* More samples than the ring can hold inside the interval */
+  for (i = 0; i < 4 * KMS_BITRATE_CALC_WINDOW_SIZE; i++) {
+    kms_bitrate_calc_update (&calc, i * GST_MSECOND, 100);
+  }
+
+  /* Only the last KMS_BITRATE_CALC_WINDOW_SIZE samples are kept, 100 bytes
+   * every millisecond */
+  fail_unless (kms_bitrate_calc_get_bitrate (&calc) == 800000);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_buffer_list)
+{
+  KmsBitrateCalc calc;
+  GstBufferList *list;
+  GstBuffer *buffer;
+  guint i;
+
+  kms_bitrate_calc_init (&calc, GST_SECOND);
+
+  for (i = 0; i < 3; i++) {
+    list = gst_buffer_list_new ();
+
+    /* Only the first buffer of each list is timestamped */
+    buffer = gst_buffer_new_allocate (NULL, 500, NULL);
+    GST_BUFFER_PTS (buffer) = i * 500 * GST_MSECOND;
+    gst_buffer_list_add (list, buffer);
+
+    buffer = gst_buffer_new_allocate (NULL, 500, NULL);
+    gst_buffer_list_add (list, buffer);
+
+    kms_bitrate_calc_update_buffer_list (&calc, list);
+    gst_buffer_list_unref (list);
+  }
+
+  /* 1000 bytes every 500ms */
+  fail_unless (kms_bitrate_calc_get_bitrate (&calc) == 16000);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+bitratecalc_suite (void)
+{
+  Suite *s = suite_create ("bitratecalc");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_constant_bitrate);
+  tcase_add_test (tc_chain, check_window_overflow);
+  tcase_add_test (tc_chain, check_buffer_list);
+
+  return s;
+}
+
+GST_CHECK_MAIN (bitratecalc);
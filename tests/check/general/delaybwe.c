@@ -0,0 +1,221 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "kmsdelaybwe.h"
+
+#include <gst/check/gstcheck.h>
+#include <glib.h>
+#include <stdio.h>
+
+/*
+ * Offline simulator: a sender paced at the rate fed back by the estimator
+ * goes through a single bottleneck queue. Everything runs on simulated
+ * time so results are deterministic.
+ */
+
+#define PACKET_SIZE 1200
+#define PROPAGATION_DELAY (20 * GST_MSECOND)
+#define FEEDBACK_INTERVAL (100 * GST_MSECOND)
+#define SENDER_START_BITRATE 300000
+#define SENDER_MAX_BITRATE 5000000
+/* Ramp up used by the sender until the estimator limits it */
+#define SENDER_PROBE_FACTOR 1.1
+
+/* Environment variable pointing to a "send_ns arrival_ns size" trace */
+#define TRACE_ENV "KMS_DELAY_BWE_TRACE"
+
+typedef struct _Simulation
+{
+  KmsDelayBwe *bwe;
+  GstClockTime now;
+  GstClockTime link_free;
+  GstClockTime next_feedback;
+  guint send_bitrate;
+  GstClockTime max_queue_delay;
+} Simulation;
+
+static void
+simulation_init (Simulation * sim)
+{
+  sim->bwe = kms_delay_bwe_new (30000, 0);
+  sim->now = 0;
+  sim->link_free = 0;
+  sim->next_feedback = FEEDBACK_INTERVAL;
+  sim->send_bitrate = SENDER_START_BITRATE;
+  sim->max_queue_delay = 0;
+}
+
+static void
+simulation_run (Simulation * sim, GstClockTime duration, guint capacity)
+{
+  GstClockTime end = sim->now + duration;
+
+  while (sim->now < end) {
+    GstClockTime start, arrival;
+    guint estimate;
+
+    start = MAX (sim->now, sim->link_free);
+    sim->link_free = start +
+        gst_util_uint64_scale (PACKET_SIZE * 8, GST_SECOND, capacity);
+    arrival = sim->link_free + PROPAGATION_DELAY;
+    sim->max_queue_delay = MAX (sim->max_queue_delay, start - sim->now);
+
+    kms_delay_bwe_incoming_packet (sim->bwe, sim->now, arrival, PACKET_SIZE);
+
+    sim->now += gst_util_uint64_scale (PACKET_SIZE * 8, GST_SECOND,
+        sim->send_bitrate);
+
+    if (sim->now < sim->next_feedback) {
+      continue;
+    }
+
+    sim->next_feedback += FEEDBACK_INTERVAL;
+    estimate = kms_delay_bwe_get_estimate (sim->bwe);
+
+    if (estimate > 0) {
+      sim->send_bitrate = estimate;
+    } else {
+      sim->send_bitrate *= SENDER_PROBE_FACTOR;
+    }
+
+    sim->send_bitrate = MIN (sim->send_bitrate, SENDER_MAX_BITRATE);
+  }
+}
+
+static void
+simulation_clear (Simulation * sim)
+{
+  kms_delay_bwe_free (sim->bwe);
+}
+
+GST_START_TEST (check_no_congestion)
+{
+  Simulation sim;
+
+  simulation_init (&sim);
+
+  /* The sender never reaches the capacity of the link */
+  simulation_run (&sim, 30 * GST_SECOND, 20 * SENDER_MAX_BITRATE);
+
+  fail_unless (kms_delay_bwe_get_estimate (sim.bwe) == 0);
+  fail_unless (kms_delay_bwe_get_usage (sim.bwe) == KMS_DELAY_BWE_NORMAL);
+
+  simulation_clear (&sim);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_bottleneck)
+{
+  Simulation sim;
+  guint estimate;
+
+  simulation_init (&sim);
+
+  simulation_run (&sim, 60 * GST_SECOND, 1000000);
+  estimate = kms_delay_bwe_get_estimate (sim.bwe);
+  GST_DEBUG ("Estimate: %u, max queue delay: %" GST_TIME_FORMAT,
+      estimate, GST_TIME_ARGS (sim.max_queue_delay));
+
+  fail_unless (estimate >= 600000);
+  fail_unless (estimate <= 1100000);
+
+  /* Once converged, queues must stay short */
+  sim.max_queue_delay = 0;
+  simulation_run (&sim, 30 * GST_SECOND, 1000000);
+  GST_DEBUG ("Max queue delay after convergence: %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (sim.max_queue_delay));
+  fail_unless (sim.max_queue_delay < 300 * GST_MSECOND);
+
+  simulation_clear (&sim);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_capacity_drop)
+{
+  Simulation sim;
+  guint estimate;
+
+  simulation_init (&sim);
+
+  simulation_run (&sim, 30 * GST_SECOND, 2000000);
+  fail_unless (kms_delay_bwe_get_estimate (sim.bwe) > 1000000);
+
+  /* Handover to a worse network */
+  simulation_run (&sim, 3 * GST_SECOND, 500000);
+  estimate = kms_delay_bwe_get_estimate (sim.bwe);
+  GST_DEBUG ("Estimate after drop: %u", estimate);
+  fail_unless (estimate <= 600000);
+
+  simulation_clear (&sim);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_trace)
+{
+  const gchar *path = g_getenv (TRACE_ENV);
+  guint64 send_time, arrival_time;
+  KmsDelayBwe *bwe;
+  guint size, lines = 0;
+  FILE *trace;
+
+  if (path == NULL) {
+    GST_INFO ("Set " TRACE_ENV " to replay a packet trace");
+    return;
+  }
+
+  trace = fopen (path, "r");
+  fail_unless (trace != NULL);
+
+  bwe = kms_delay_bwe_new (30000, 0);
+
+  while (fscanf (trace, "%" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT " %u",
+          &send_time, &arrival_time, &size) == 3) {
+    kms_delay_bwe_incoming_packet (bwe, send_time, arrival_time, size);
+
+    if (++lines % 100 == 0) {
+      g_print ("%" G_GUINT64_FORMAT " %u %u %d\n", arrival_time,
+          kms_delay_bwe_get_incoming_bitrate (bwe),
+          kms_delay_bwe_get_estimate (bwe), kms_delay_bwe_get_usage (bwe));
+    }
+  }
+
+  fclose (trace);
+  kms_delay_bwe_free (bwe);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+delaybwe_suite (void)
+{
+  Suite *s = suite_create ("delaybwe");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_no_congestion);
+  tcase_add_test (tc_chain, check_bottleneck);
+  tcase_add_test (tc_chain, check_capacity_drop);
+  tcase_add_test (tc_chain, check_trace);
+
+  return s;
+}
+
+GST_CHECK_MAIN (delaybwe);
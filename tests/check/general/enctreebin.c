@@ -0,0 +1,222 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <gst/check/gstcheck.h>
+
+#include "kmsenctreebin.h"
+
+#define TARGET_BITRATE 300000
+#define MAX_THREADS 64
+
+#define VP8_DEFAULT_DEADLINE G_GINT64_CONSTANT (200000)
+#define VP8_REALTIME_DEADLINE G_GINT64_CONSTANT (1)
+
+/* Encoding time above the duration of a 30 fps frame */
+#define SLOW_ENCODING_DELAY (50 * G_TIME_SPAN_MILLISECOND)
+#define CONTROLLER_WAIT (4 * G_TIME_SPAN_SECOND)
+
+static GstStructure *
+create_controller_config (gboolean enabled, gint max_threads)
+{
+  GstStructure *config, *controller;
+
+  controller = gst_structure_new ("encoder-controller", "enabled",
+      G_TYPE_BOOLEAN, enabled, "max-threads", G_TYPE_INT, max_threads, NULL);
+  config = gst_structure_new ("codec-config", "encoder-controller",
+      GST_TYPE_STRUCTURE, controller, NULL);
+  gst_structure_free (controller);
+
+  return config;
+}
+
+static KmsEncTreeBin *
+create_vp8_tree_bin (GstStructure * config)
+{
+  GstCaps *caps = gst_caps_from_string ("video/x-vp8");
+  KmsEncTreeBin *enc;
+
+  enc = kms_enc_tree_bin_new (caps, TARGET_BITRATE, 0, G_MAXINT, config);
+  fail_if (enc == NULL);
+  gst_caps_unref (caps);
+
+  return enc;
+}
+
+static GstElement *
+get_encoder (KmsEncTreeBin * enc)
+{
+  GstIterator *it = gst_bin_iterate_elements (GST_BIN (enc));
+  GstElement *encoder = NULL;
+  GValue item = G_VALUE_INIT;
+
+  while (encoder == NULL && gst_iterator_next (it, &item) == GST_ITERATOR_OK) {
+    GstElement *element = g_value_get_object (&item);
+    GstElementFactory *factory = gst_element_get_factory (element);
+
+    if (factory != NULL && g_strcmp0 (GST_OBJECT_NAME (factory),
+            "vp8enc") == 0) {
+      encoder = element;
+    }
+
+    g_value_reset (&item);
+  }
+
+  g_value_unset (&item);
+  gst_iterator_free (it);
+
+  fail_if (encoder == NULL);
+
+  return encoder;
+}
+
+static gint
+get_threads (KmsEncTreeBin * enc)
+{
+  gint threads;
+
+  g_object_get (get_encoder (enc), "threads", &threads, NULL);
+
+  return threads;
+}
+
+static gint
+expected_threads (guint encoders)
+{
+  return CLAMP ((gint) (g_get_num_processors () / encoders), 1, MAX_THREADS);
+}
+
+GST_START_TEST (check_default_threads)
+{
+  KmsEncTreeBin *enc = create_vp8_tree_bin (NULL);
+
+  fail_unless (get_threads (enc) == 1);
+
+  g_object_unref (enc);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_threads_rebalanced)
+{
+  GstStructure *config = create_controller_config (FALSE, MAX_THREADS);
+  KmsEncTreeBin *first, *second;
+
+  first = create_vp8_tree_bin (config);
+  fail_unless (get_threads (first) == expected_threads (1));
+
+  second = create_vp8_tree_bin (config);
+  fail_unless (get_threads (first) == expected_threads (2));
+  fail_unless (get_threads (second) == expected_threads (2));
+
+  /* Threads released by the second encoder go back to the first one */
+  g_object_unref (second);
+  fail_unless (get_threads (first) == expected_threads (1));
+
+  g_object_unref (first);
+  gst_structure_free (config);
+}
+
+GST_END_TEST;
+
+static GstPadProbeReturn
+slow_encoding_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  g_usleep (SLOW_ENCODING_DELAY);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Encodes with a slowed down encoder and returns its final deadline */
+static gint64
+run_slow_encoder (GstStructure * config)
+{
+  GstElement *pipeline = gst_pipeline_new (NULL);
+  GstElement *src = gst_element_factory_make ("videotestsrc", NULL);
+  GstElement *sink = gst_element_factory_make ("fakesink", NULL);
+  KmsEncTreeBin *enc = create_vp8_tree_bin (config);
+  GstElement *encoder = get_encoder (enc);
+  GstCaps *caps;
+  GstPad *pad;
+  gint64 deadline, end_time;
+
+  g_object_set (src, "is-live", TRUE, NULL);
+  g_object_set (sink, "async", FALSE, "sync", FALSE, NULL);
+  gst_bin_add_many (GST_BIN (pipeline), src, GST_ELEMENT (enc), sink, NULL);
+
+  caps = gst_caps_from_string ("video/x-raw,width=320,height=240,"
+      "framerate=30/1");
+  fail_unless (gst_element_link_filtered (src,
+          kms_tree_bin_get_input_element (KMS_TREE_BIN (enc)), caps));
+  gst_caps_unref (caps);
+  fail_unless (gst_element_link_pads (kms_tree_bin_get_output_tee
+          (KMS_TREE_BIN (enc)), "src_%u", sink, "sink"));
+
+  /* Added after the controller probe, so it counts as encoding time */
+  pad = gst_element_get_static_pad (encoder, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, slow_encoding_probe,
+      NULL, NULL);
+  g_object_unref (pad);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  end_time = g_get_monotonic_time () + CONTROLLER_WAIT;
+  do {
+    g_usleep (100 * G_TIME_SPAN_MILLISECOND);
+    g_object_get (encoder, "deadline", &deadline, NULL);
+  } while (deadline != VP8_REALTIME_DEADLINE
+      && g_get_monotonic_time () < end_time);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  g_object_unref (pipeline);
+
+  return deadline;
+}
+
+GST_START_TEST (check_controller_disabled_by_default)
+{
+  fail_unless (run_slow_encoder (NULL) == VP8_DEFAULT_DEADLINE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_controller_degrades_speed)
+{
+  GstStructure *config = create_controller_config (TRUE, 1);
+
+  fail_unless (run_slow_encoder (config) == VP8_REALTIME_DEADLINE);
+
+  gst_structure_free (config);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+enctreebin_suite (void)
+{
+  Suite *s = suite_create ("enctreebin");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_default_threads);
+  tcase_add_test (tc_chain, check_threads_rebalanced);
+  tcase_add_test (tc_chain, check_controller_disabled_by_default);
+  tcase_add_test (tc_chain, check_controller_degrades_speed);
+
+  return s;
+}
+
+GST_CHECK_MAIN (enctreebin);
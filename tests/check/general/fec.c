@@ -0,0 +1,521 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/rtp/gstrtpbuffer.h>
+#include <string.h>
+#include <time.h>
+
+#include "kmsfec.h"
+#include "kmsfecenc.h"
+#include "kmsfecdec.h"
+
+#define MEDIA_PT 96
+#define FEC_PT 100
+#define SSRC 0x12345678
+#define OTHER_SSRC 0x87654321
+
+#define N_PACKETS 5000
+#define PAYLOAD_SIZE 1200
+#define LOSS_PERCENTAGE 5
+
+static GstBuffer *
+create_ssrc_rtp_buffer (guint32 ssrc, guint16 seq, gsize payload_size,
+    gboolean marker)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstBuffer *buf;
+  guint8 *payload;
+  gsize i;
+
+  buf = gst_rtp_buffer_new_allocate (payload_size, 0, 0);
+  gst_rtp_buffer_map (buf, GST_MAP_WRITE, &rtp);
+  gst_rtp_buffer_set_payload_type (&rtp, MEDIA_PT);
+  gst_rtp_buffer_set_seq (&rtp, seq);
+  gst_rtp_buffer_set_timestamp (&rtp, seq / 10 * 3000);
+  gst_rtp_buffer_set_ssrc (&rtp, ssrc);
+  gst_rtp_buffer_set_marker (&rtp, marker);
+
+  payload = gst_rtp_buffer_get_payload (&rtp);
+  for (i = 0; i < payload_size; i++) {
+    payload[i] = seq * 7 + ssrc + i;
+  }
+
+  gst_rtp_buffer_unmap (&rtp);
+
+  return buf;
+}
+
+static GstBuffer *
+create_rtp_buffer (guint16 seq, gsize payload_size, gboolean marker)
+{
+  return create_ssrc_rtp_buffer (SSRC, seq, payload_size, marker);
+}
+
+static guint
+get_pt (GstBuffer * buf)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  guint pt;
+
+  fail_unless (gst_rtp_buffer_map (buf, GST_MAP_READ, &rtp));
+  pt = gst_rtp_buffer_get_payload_type (&rtp);
+  gst_rtp_buffer_unmap (&rtp);
+
+  return pt;
+}
+
+static guint16
+get_seq (GstBuffer * buf)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  guint16 seq;
+
+  fail_unless (gst_rtp_buffer_map (buf, GST_MAP_READ, &rtp));
+  seq = gst_rtp_buffer_get_seq (&rtp);
+  gst_rtp_buffer_unmap (&rtp);
+
+  return seq;
+}
+
+static gboolean
+buffers_equal (GstBuffer * a, GstBuffer * b)
+{
+  GstMapInfo ma, mb;
+  gboolean equal;
+
+  gst_buffer_map (a, &ma, GST_MAP_READ);
+  gst_buffer_map (b, &mb, GST_MAP_READ);
+  equal = ma.size == mb.size && memcmp (ma.data, mb.data, ma.size) == 0;
+  gst_buffer_unmap (a, &ma);
+  gst_buffer_unmap (b, &mb);
+
+  return equal;
+}
+
+static GstHarness *
+setup_harness (GstElement * element)
+{
+  GstHarness *h;
+
+  h = gst_harness_new_with_element (element, "sink", "src");
+  gst_harness_set_src_caps_str (h, "application/x-rtp");
+  gst_object_unref (element);
+
+  return h;
+}
+
+static GstHarness *
+setup_encoder (guint percentage)
+{
+  return setup_harness (g_object_new (KMS_TYPE_FEC_ENC, "pt", FEC_PT,
+          "percentage", percentage, NULL));
+}
+
+static GstHarness *
+setup_decoder (void)
+{
+  return setup_harness (g_object_new (KMS_TYPE_FEC_DEC, "pt", FEC_PT, NULL));
+}
+
+static guint64
+get_dec_stat (GstHarness * h, const gchar * name)
+{
+  GstStructure *stats;
+  guint64 value;
+
+  g_object_get (h->element, "stats", &stats, NULL);
+  fail_unless (gst_structure_get_uint64 (stats, name, &value));
+  gst_structure_free (stats);
+
+  return value;
+}
+
+GST_START_TEST (check_xor_impls)
+{
+  KmsFecImpl best = kms_fec_get_impl ();
+  guint8 src[1024 + 3], dst[1024 + 3], expected[1024 + 3];
+  gsize len, offset, i;
+  gint impl;
+
+  for (i = 0; i < sizeof (src); i++) {
+    src[i] = g_random_int ();
+    dst[i] = g_random_int ();
+  }
+
+  for (len = 0; len <= 1024; len += 13) {
+    for (offset = 0; offset < 3; offset++) {
+      memcpy (expected, dst, sizeof (dst));
+      for (i = 0; i < len; i++) {
+        expected[offset + i] ^= src[offset + i];
+      }
+
+      for (impl = KMS_FEC_SCALAR; impl <= best; impl++) {
+        guint8 out[sizeof (dst)];
+
+        fail_unless (kms_fec_set_impl (impl) == impl);
+        memcpy (out, dst, sizeof (dst));
+        kms_fec_xor (out + offset, src + offset, len);
+        fail_unless (memcmp (out, expected, sizeof (out)) == 0,
+            "%s kernel failed for %" G_GSIZE_FORMAT " bytes",
+            kms_fec_impl_get_name (impl), len);
+      }
+    }
+  }
+
+  kms_fec_set_impl (best);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_recover_single_loss)
+{
+  GstHarness *enc = setup_encoder (25);
+  GstHarness *dec = setup_decoder ();
+  GPtrArray *sent = g_ptr_array_new_with_free_func (
+      (GDestroyNotify) gst_buffer_unref);
+  GHashTable *received = g_hash_table_new (NULL, NULL);
+  GstBuffer *buf;
+  guint i, media = 0, fec = 0, lost = 0, in_group = 0;
+
+  /* Different sizes, so lengths are recovered too */
+  for (i = 0; i < 40; i++) {
+    gst_harness_push (enc, create_rtp_buffer (i, 100 + 10 * i, i % 10 == 9));
+  }
+
+  while ((buf = gst_harness_try_pull (enc)) != NULL) {
+    /* Sequence numbers leave room for FEC packets */
+    fail_unless (get_seq (buf) == sent->len);
+    g_ptr_array_add (sent, buf);
+  }
+
+  for (i = 0; i < sent->len; i++) {
+    buf = g_ptr_array_index (sent, i);
+
+    if (get_pt (buf) == FEC_PT) {
+      fec++;
+      in_group = 0;
+    } else {
+      media++;
+
+      if (in_group++ == 1) {
+        /* One loss per group */
+        lost++;
+        continue;
+      }
+    }
+
+    gst_harness_push (dec, gst_buffer_ref (buf));
+  }
+
+  /* Groups of 4, closed by markers after 2 packets or carried on with 6 */
+  fail_unless (fec == 10);
+  fail_unless (lost == fec);
+
+  /* Recovered packets come after the rest of their group */
+  while ((buf = gst_harness_try_pull (dec)) != NULL) {
+    guint16 seq = get_seq (buf);
+
+    fail_unless (seq < sent->len);
+    fail_unless (buffers_equal (buf, g_ptr_array_index (sent, seq)));
+    fail_if (g_hash_table_contains (received, GUINT_TO_POINTER (seq)));
+    g_hash_table_add (received, GUINT_TO_POINTER (seq));
+    gst_buffer_unref (buf);
+  }
+
+  fail_unless (g_hash_table_size (received) == media);
+
+  fail_unless (get_dec_stat (dec, "fec-packets") == fec);
+  fail_unless (get_dec_stat (dec, "recovered") == lost);
+  fail_unless (get_dec_stat (dec, "unrecoverable") == 0);
+
+  g_hash_table_unref (received);
+  g_ptr_array_unref (sent);
+  gst_harness_teardown (enc);
+  gst_harness_teardown (dec);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_two_losses_are_not_recovered)
+{
+  GstBuffer *packets[4], *fec;
+  guint i;
+
+  for (i = 0; i < 4; i++) {
+    packets[i] = create_rtp_buffer (65534 + i, 50, FALSE);
+  }
+
+  /* Sequence numbers wrap inside the group */
+  fec = kms_fec_protect (packets, 4, FEC_PT, 2);
+  fail_if (fec == NULL);
+
+  {
+    GstHarness *dec = setup_decoder ();
+
+    gst_harness_push (dec, gst_buffer_ref (packets[0]));
+    gst_harness_push (dec, gst_buffer_ref (packets[3]));
+    gst_harness_push (dec, fec);
+
+    fail_unless (gst_harness_buffers_received (dec) == 2);
+    fail_unless (get_dec_stat (dec, "unrecoverable") == 1);
+
+    gst_harness_teardown (dec);
+  }
+
+  for (i = 0; i < 4; i++) {
+    gst_buffer_unref (packets[i]);
+  }
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_two_ssrcs)
+{
+  GstHarness *dec = setup_decoder ();
+  GstBuffer *packets[4], *other[4], *fec, *buf;
+  guint i;
+
+  for (i = 0; i < 4; i++) {
+    packets[i] = create_ssrc_rtp_buffer (SSRC, i, 50, i == 3);
+    other[i] = create_ssrc_rtp_buffer (OTHER_SSRC, i, 60 + i, i == 3);
+  }
+
+  fec = kms_fec_protect (other, 4, FEC_PT, 4);
+  fail_if (fec == NULL);
+
+  /* Same sequence numbers in both streams, the lost one only in other */
+  for (i = 0; i < 4; i++) {
+    gst_harness_push (dec, gst_buffer_ref (packets[i]));
+  }
+  gst_harness_push (dec, gst_buffer_ref (other[0]));
+  gst_harness_push (dec, gst_buffer_ref (other[2]));
+  gst_harness_push (dec, gst_buffer_ref (other[3]));
+  gst_harness_push (dec, fec);
+
+  fail_unless (gst_harness_buffers_received (dec) == 8);
+  fail_unless (get_dec_stat (dec, "recovered") == 1);
+
+  for (i = 0; i < 7; i++) {
+    gst_buffer_unref (gst_harness_pull (dec));
+  }
+
+  buf = gst_harness_pull (dec);
+  fail_unless (buffers_equal (buf, other[1]));
+  gst_buffer_unref (buf);
+
+  for (i = 0; i < 4; i++) {
+    gst_buffer_unref (packets[i]);
+    gst_buffer_unref (other[i]);
+  }
+
+  gst_harness_teardown (dec);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_buffer_list)
+{
+  GstHarness *enc = setup_encoder (50);
+  GstBufferList *list = gst_buffer_list_new ();
+  guint i;
+
+  for (i = 0; i < 10; i++) {
+    gst_buffer_list_add (list, create_rtp_buffer (i, 100, i == 9));
+  }
+
+  fail_unless (gst_pad_push_list (enc->srcpad, list) == GST_FLOW_OK);
+
+  /* 5 groups of 2 packets, each followed by its FEC packet */
+  fail_unless (gst_harness_buffers_received (enc) == 15);
+
+  for (i = 0; i < 15; i++) {
+    GstBuffer *buf = gst_harness_pull (enc);
+
+    fail_unless (get_seq (buf) == i);
+    fail_unless ((get_pt (buf) == FEC_PT) == (i % 3 == 2));
+    gst_buffer_unref (buf);
+  }
+
+  gst_harness_teardown (enc);
+}
+
+GST_END_TEST;
+
+static void
+check_overhead (guint percentage, guint frame_packets)
+{
+  GstHarness *enc = setup_encoder (percentage);
+  guint i, media = 0, fec = 0, current;
+  gdouble ratio;
+  GstBuffer *buf;
+
+  for (i = 0; i < N_PACKETS; i++) {
+    gst_harness_push (enc, create_rtp_buffer (i, 100,
+            i % frame_packets == frame_packets - 1));
+
+    while ((buf = gst_harness_try_pull (enc)) != NULL) {
+      if (get_pt (buf) == FEC_PT) {
+        fec++;
+      } else {
+        media++;
+      }
+      gst_buffer_unref (buf);
+    }
+  }
+
+  g_object_get (enc->element, "current-percentage", &current, NULL);
+  ratio = 100.0 * fec / media;
+
+  GST_INFO ("%u packets per frame: %u media and %u FEC packets, %.1f%% for "
+      "%u%% protection", frame_packets, media, fec, ratio, current);
+
+  fail_unless (media == N_PACKETS);
+  fail_unless (ABS (ratio - current) <= 1.0,
+      "%.1f%% FEC packets for %u%% protection", ratio, current);
+
+  gst_harness_teardown (enc);
+}
+
+GST_START_TEST (check_small_frames_overhead)
+{
+  /* One FEC packet per frame would be 100% and 50% */
+  check_overhead (10, 1);
+  check_overhead (10, 2);
+  check_overhead (25, 3);
+  check_overhead (20, 10);
+}
+
+GST_END_TEST;
+
+static guint
+simulated_loss (gpointer user_data)
+{
+  return (LOSS_PERCENTAGE * 256 + 99) / 100;
+}
+
+static gdouble
+get_cpu_time (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+run_loss_simulation (KmsFecImpl impl)
+{
+  GstHarness *enc = setup_encoder (0);
+  GstHarness *dec = setup_decoder ();
+  GRand *rand = g_rand_new_with_seed (42);
+  guint media = 0, fec = 0, lost = 0, received = 0, percentage;
+  gdouble cpu, mbits;
+  GstBuffer *buf;
+  guint i;
+
+  kms_fec_set_impl (impl);
+  kms_fec_enc_set_loss_func (KMS_FEC_ENC (enc->element), simulated_loss,
+      NULL, NULL);
+
+  cpu = get_cpu_time ();
+
+  for (i = 0; i < N_PACKETS; i++) {
+    gst_harness_push (enc, create_rtp_buffer (i, PAYLOAD_SIZE,
+            i % 10 == 9));
+
+    while ((buf = gst_harness_try_pull (enc)) != NULL) {
+      if (get_pt (buf) == FEC_PT) {
+        fec++;
+      } else {
+        media++;
+      }
+
+      if (g_rand_int_range (rand, 0, 100) < LOSS_PERCENTAGE) {
+        lost += get_pt (buf) != FEC_PT;
+        gst_buffer_unref (buf);
+        continue;
+      }
+
+      gst_harness_push (dec, buf);
+    }
+
+    while ((buf = gst_harness_try_pull (dec)) != NULL) {
+      received++;
+      gst_buffer_unref (buf);
+    }
+  }
+
+  cpu = get_cpu_time () - cpu;
+  mbits = (gdouble) (media + fec) * (PAYLOAD_SIZE + 12) * 8 / 1e6;
+
+  g_object_get (enc->element, "current-percentage", &percentage, NULL);
+
+  GST_INFO ("%s: %u%% protection, %u media and %u FEC packets, %u lost, %"
+      G_GUINT64_FORMAT " recovered, residual loss %.2f%%, %.1f us of CPU "
+      "per Mbit", kms_fec_impl_get_name (impl), percentage, media, fec, lost,
+      get_dec_stat (dec, "recovered"),
+      100.0 * (media - received) / media, cpu * 1e6 / mbits);
+
+  fail_unless (media == N_PACKETS);
+  fail_unless (percentage == 2 * LOSS_PERCENTAGE);
+  fail_unless (fec > 0);
+  fail_unless (get_dec_stat (dec, "recovered") > 0);
+  fail_unless (received == media - lost + get_dec_stat (dec, "recovered"));
+  /* Groups with several losses cannot be recovered */
+  fail_unless (media - received < lost);
+
+  g_rand_free (rand);
+  gst_harness_teardown (enc);
+  gst_harness_teardown (dec);
+}
+
+GST_START_TEST (benchmark_loss_simulation)
+{
+  KmsFecImpl best = kms_fec_get_impl ();
+  gint impl;
+
+  for (impl = KMS_FEC_SCALAR; impl <= best; impl++) {
+    run_loss_simulation (impl);
+  }
+
+  kms_fec_set_impl (best);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+fec_suite (void)
+{
+  Suite *s = suite_create ("fec");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_xor_impls);
+  tcase_add_test (tc_chain, check_recover_single_loss);
+  tcase_add_test (tc_chain, check_two_losses_are_not_recovered);
+  tcase_add_test (tc_chain, check_two_ssrcs);
+  tcase_add_test (tc_chain, check_buffer_list);
+  tcase_add_test (tc_chain, check_small_frames_overhead);
+  tcase_add_test (tc_chain, benchmark_loss_simulation);
+
+  return s;
+}
+
+GST_CHECK_MAIN (fec);
@@ -0,0 +1,138 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <gst/check/gstcheck.h>
+#include <glib.h>
+
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "kmsioreactor.h"
+
+#define N_SOCKETS 64
+#define N_PACKETS 100
+
+/* Stops watching after the first batch */
+#define ONE_SHOT_SOCKET 7
+
+typedef struct _SocketData
+{
+  gint fds[2];
+  guint id;
+  gint received;
+} SocketData;
+
+static SocketData sockets[N_SOCKETS];
+static gint destroyed;
+
+static gboolean
+read_cb (gint fd, gpointer user_data)
+{
+  SocketData *data = user_data;
+  gchar buf[16];
+
+  while (recv (fd, buf, sizeof (buf), MSG_DONTWAIT) > 0) {
+    g_atomic_int_inc (&data->received);
+  }
+
+  return data != &sockets[ONE_SHOT_SOCKET];
+}
+
+static void
+destroy_cb (gpointer user_data)
+{
+  g_atomic_int_inc (&destroyed);
+}
+
+GST_START_TEST (check_many_sockets)
+{
+  KmsIoReactor *reactor;
+  gint64 end_time;
+  guint i, j, total;
+
+  reactor = kms_io_reactor_new (3);
+  fail_unless (kms_io_reactor_get_n_threads (reactor) == 3);
+  destroyed = 0;
+
+  for (i = 0; i < N_SOCKETS; i++) {
+    fail_if (socketpair (AF_UNIX, SOCK_DGRAM, 0, sockets[i].fds) < 0);
+    sockets[i].received = 0;
+    sockets[i].id = kms_io_reactor_add_fd (reactor, sockets[i].fds[1],
+        read_cb, &sockets[i], destroy_cb);
+    fail_if (sockets[i].id == 0);
+  }
+
+  for (j = 0; j < N_PACKETS; j++) {
+    for (i = 0; i < N_SOCKETS; i++) {
+      fail_unless (send (sockets[i].fds[0], "x", 1, 0) == 1);
+    }
+  }
+
+  /* Every socket is served by some of the 3 threads */
+  end_time = g_get_monotonic_time () + 5 * G_TIME_SPAN_SECOND;
+  do {
+    g_usleep (10 * G_TIME_SPAN_MILLISECOND);
+
+    for (i = 0, total = 0; i < N_SOCKETS; i++) {
+      if (i != ONE_SHOT_SOCKET) {
+        total += g_atomic_int_get (&sockets[i].received);
+      }
+    }
+  } while (total < (N_SOCKETS - 1) * N_PACKETS
+      && g_get_monotonic_time () < end_time);
+
+  for (i = 0; i < N_SOCKETS; i++) {
+    if (i == ONE_SHOT_SOCKET) {
+      fail_unless (sockets[i].received > 0);
+      fail_unless (sockets[i].received <= N_PACKETS);
+    } else {
+      fail_unless (sockets[i].received == N_PACKETS);
+    }
+  }
+
+  /* Returning FALSE from the callback releases the source */
+  fail_unless (g_atomic_int_get (&destroyed) == 1);
+
+  for (i = 0; i < N_SOCKETS; i++) {
+    kms_io_reactor_remove (reactor, sockets[i].id);
+  }
+
+  fail_unless (g_atomic_int_get (&destroyed) == N_SOCKETS);
+
+  kms_io_reactor_free (reactor);
+
+  for (i = 0; i < N_SOCKETS; i++) {
+    close (sockets[i].fds[0]);
+    close (sockets[i].fds[1]);
+  }
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+ioreactor_suite (void)
+{
+  Suite *s = suite_create ("ioreactor");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_many_sockets);
+
+  return s;
+}
+
+GST_CHECK_MAIN (ioreactor);
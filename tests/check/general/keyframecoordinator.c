@@ -0,0 +1,193 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/video/video-event.h>
+
+#include "kmskeyframecoordinator.h"
+
+#define WINDOW (100 * GST_MSECOND)
+#define N_VIEWERS 20
+
+static GstHarness *
+setup_harness (void)
+{
+  GstHarness *h;
+  GstPad *sinkpad;
+
+  h = gst_harness_new ("identity");
+  sinkpad = gst_element_get_static_pad (h->element, "sink");
+  kms_keyframe_coordinator_attach (sinkpad, WINDOW);
+  g_object_unref (sinkpad);
+
+  gst_harness_set_src_caps_str (h, "video/x-vp8");
+
+  return h;
+}
+
+static void
+request_keyframe (GstHarness * h)
+{
+  fail_unless (gst_harness_push_upstream_event (h,
+          gst_video_event_new_upstream_force_key_unit (GST_CLOCK_TIME_NONE,
+              TRUE, 0)));
+}
+
+static guint
+count_forwarded_requests (GstHarness * h)
+{
+  GstEvent *event;
+  guint count = 0;
+
+  while ((event = gst_harness_try_pull_upstream_event (h)) != NULL) {
+    if (gst_video_event_is_force_key_unit (event)) {
+      count++;
+    }
+    gst_event_unref (event);
+  }
+
+  return count;
+}
+
+static void
+push_frame (GstHarness * h, gboolean keyframe)
+{
+  GstBuffer *buf = gst_buffer_new ();
+
+  if (!keyframe) {
+    GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT);
+  }
+
+  fail_unless (gst_harness_push (h, buf) == GST_FLOW_OK);
+  gst_buffer_unref (gst_harness_pull (h));
+}
+
+static void
+check_stats (GstHarness * h, guint64 requests, guint64 forwarded,
+    guint64 coalesced, guint64 served)
+{
+  GstStructure *stats;
+  GstPad *sinkpad;
+  guint64 value;
+
+  sinkpad = gst_element_get_static_pad (h->element, "sink");
+  stats = kms_keyframe_coordinator_get_stats (sinkpad);
+  g_object_unref (sinkpad);
+
+  fail_if (stats == NULL);
+  GST_DEBUG ("Stats: %" GST_PTR_FORMAT, stats);
+
+  fail_unless (gst_structure_get_uint64 (stats, "requests", &value));
+  fail_unless (value == requests);
+  fail_unless (gst_structure_get_uint64 (stats, "forwarded", &value));
+  fail_unless (value == forwarded);
+  fail_unless (gst_structure_get_uint64 (stats, "coalesced", &value));
+  fail_unless (value == coalesced);
+  fail_unless (gst_structure_get_uint64 (stats, "served", &value));
+  fail_unless (value == served);
+
+  gst_structure_free (stats);
+}
+
+GST_START_TEST (check_storm_is_coalesced)
+{
+  GstHarness *h = setup_harness ();
+  guint i;
+
+  /* Many viewers joining at once */
+  for (i = 0; i < N_VIEWERS; i++) {
+    request_keyframe (h);
+  }
+
+  fail_unless (count_forwarded_requests (h) == 1);
+
+  /* Held requests are not sent before the window expires */
+  push_frame (h, FALSE);
+  fail_unless (count_forwarded_requests (h) == 0);
+
+  g_usleep (2 * WINDOW / GST_USECOND);
+
+  push_frame (h, FALSE);
+  fail_unless (count_forwarded_requests (h) == 1);
+
+  push_frame (h, TRUE);
+  check_stats (h, N_VIEWERS, 2, N_VIEWERS - 1, 1);
+
+  /* Nothing else is pending */
+  g_usleep (2 * WINDOW / GST_USECOND);
+  push_frame (h, FALSE);
+  fail_unless (count_forwarded_requests (h) == 0);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_keyframe_serves_held_requests)
+{
+  GstHarness *h = setup_harness ();
+
+  request_keyframe (h);
+  request_keyframe (h);
+  fail_unless (count_forwarded_requests (h) == 1);
+
+  /* The keyframe asked by the first request is enough for both */
+  push_frame (h, TRUE);
+
+  g_usleep (2 * WINDOW / GST_USECOND);
+  push_frame (h, FALSE);
+  fail_unless (count_forwarded_requests (h) == 0);
+
+  check_stats (h, 2, 1, 1, 1);
+
+  /* A new window forwards the next request right away */
+  request_keyframe (h);
+  fail_unless (count_forwarded_requests (h) == 1);
+  check_stats (h, 3, 2, 1, 1);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_no_coordinator)
+{
+  GstPad *pad = gst_pad_new ("src", GST_PAD_SRC);
+
+  fail_unless (kms_keyframe_coordinator_get_stats (pad) == NULL);
+
+  g_object_unref (pad);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+keyframecoordinator_suite (void)
+{
+  Suite *s = suite_create ("keyframecoordinator");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_storm_is_coalesced);
+  tcase_add_test (tc_chain, check_keyframe_serves_held_requests);
+  tcase_add_test (tc_chain, check_no_coordinator);
+
+  return s;
+}
+
+GST_CHECK_MAIN (keyframecoordinator);
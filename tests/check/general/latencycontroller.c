@@ -0,0 +1,136 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "kmslatencycontroller.h"
+
+#include <gst/check/gstcheck.h>
+#include <glib.h>
+
+#define CLOCK_RATE 90000
+#define FRAME_DURATION (33 * GST_MSECOND)
+#define RTP_TS_PER_FRAME 2970
+
+/* Feeds one packet per frame, delaying every 'period' frame by 'extra' */
+static GstClockTime
+feed_frames (KmsLatencyController * ctl, GstClockTime start, guint frames,
+    guint period, GstClockTime extra, guint * updates, guint * last_latency)
+{
+  GstClockTime now = start;
+  guint i, latency;
+
+  for (i = 0; i < frames; i++) {
+    guint32 ts = (guint32) (now / FRAME_DURATION) * RTP_TS_PER_FRAME;
+    GstClockTime arrival = now;
+
+    if (period > 0 && i % period == 0) {
+      arrival += extra;
+    }
+
+    kms_latency_controller_process_packet (ctl, arrival, ts, CLOCK_RATE);
+
+    if (kms_latency_controller_update (ctl, now, &latency)) {
+      (*updates)++;
+      *last_latency = latency;
+    }
+
+    now += FRAME_DURATION;
+  }
+
+  return now;
+}
+
+GST_START_TEST (check_good_network)
+{
+  KmsLatencyController *ctl;
+  guint updates = 0, latency = 0;
+
+  ctl = kms_latency_controller_new (20, 1000, 500);
+
+  /* Almost no jitter: latency must shrink from 500 ms close to the minimum */
+  feed_frames (ctl, 0, 3000, 0, 0, &updates, &latency);
+
+  fail_unless (updates > 0);
+  fail_unless (latency < 50);
+  fail_unless (kms_latency_controller_get_latency (ctl) == latency);
+
+  kms_latency_controller_free (ctl);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_bad_network)
+{
+  KmsLatencyController *ctl;
+  guint updates = 0, latency = 0;
+  GstClockTime now;
+
+  ctl = kms_latency_controller_new (20, 1000, 100);
+
+  /* One frame of every ten arrives 300 ms late */
+  now = feed_frames (ctl, 0, 300, 10, 300 * GST_MSECOND, &updates, &latency);
+
+  fail_unless (updates > 0);
+  fail_unless (latency >= 300);
+
+  /* Bounded by the configured maximum */
+  feed_frames (ctl, now, 300, 5, 2 * GST_SECOND, &updates, &latency);
+  fail_unless (kms_latency_controller_get_latency (ctl) <= 1000);
+
+  kms_latency_controller_free (ctl);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_retransmissions)
+{
+  KmsLatencyController *ctl;
+  guint updates = 0, latency = 0, base;
+  GstClockTime now;
+
+  ctl = kms_latency_controller_new (20, 1000, 20);
+
+  now = feed_frames (ctl, 0, 300, 0, 0, &updates, &latency);
+  base = kms_latency_controller_get_latency (ctl);
+
+  /* Half of the retransmissions are lost: leave room for more rounds */
+  kms_latency_controller_process_rtx_stats (ctl, 10, 5, 100 * GST_MSECOND);
+  kms_latency_controller_process_rtx_stats (ctl, 20, 10, 100 * GST_MSECOND);
+  feed_frames (ctl, now, 100, 0, 0, &updates, &latency);
+
+  fail_unless (kms_latency_controller_get_latency (ctl) >= base + 150);
+
+  kms_latency_controller_free (ctl);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+latencycontroller_suite (void)
+{
+  Suite *s = suite_create ("latencycontroller");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_good_network);
+  tcase_add_test (tc_chain, check_bad_network);
+  tcase_add_test (tc_chain, check_retransmissions);
+
+  return s;
+}
+
+GST_CHECK_MAIN (latencycontroller);
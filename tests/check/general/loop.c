@@ -0,0 +1,189 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <gst/check/gstcheck.h>
+#include <glib.h>
+
+#include "kmsloop.h"
+
+#define POOL_SIZE 2
+#define N_LOOPS 50
+#define N_CALLBACKS 20
+
+typedef struct _LoopData
+{
+  KmsLoop *loop;
+  gint next;
+  gboolean ordered;
+  gboolean current_thread;
+} LoopData;
+
+typedef struct _CallbackData
+{
+  LoopData *loop_data;
+  gint index;
+} CallbackData;
+
+static GMutex mutex;
+static GCond cond;
+static guint done;
+static GHashTable *threads;
+
+static gboolean
+ordered_cb (CallbackData * data)
+{
+  LoopData *loop_data = data->loop_data;
+
+  g_mutex_lock (&mutex);
+
+  loop_data->ordered &= (loop_data->next == data->index);
+  loop_data->current_thread &= kms_loop_is_current_thread (loop_data->loop);
+  loop_data->next++;
+  g_hash_table_add (threads, g_thread_self ());
+
+  done++;
+  g_cond_signal (&cond);
+
+  g_mutex_unlock (&mutex);
+
+  return G_SOURCE_REMOVE;
+}
+
+GST_START_TEST (check_pooled_ordering)
+{
+  LoopData loops[N_LOOPS];
+  CallbackData callbacks[N_LOOPS][N_CALLBACKS];
+  gint64 end_time;
+  guint i, j;
+
+  threads = g_hash_table_new (NULL, NULL);
+  done = 0;
+
+  for (i = 0; i < N_LOOPS; i++) {
+    loops[i].loop = kms_loop_new_pooled ();
+    loops[i].next = 0;
+    loops[i].ordered = TRUE;
+    loops[i].current_thread = TRUE;
+  }
+
+  /* Interleave sources of every loop */
+  for (j = 0; j < N_CALLBACKS; j++) {
+    for (i = 0; i < N_LOOPS; i++) {
+      callbacks[i][j].loop_data = &loops[i];
+      callbacks[i][j].index = j;
+      fail_if (kms_loop_idle_add (loops[i].loop, (GSourceFunc) ordered_cb,
+              &callbacks[i][j]) == 0);
+    }
+  }
+
+  end_time = g_get_monotonic_time () + 5 * G_TIME_SPAN_SECOND;
+  g_mutex_lock (&mutex);
+  while (done < N_LOOPS * N_CALLBACKS) {
+    if (!g_cond_wait_until (&cond, &mutex, end_time)) {
+      break;
+    }
+  }
+  g_mutex_unlock (&mutex);
+
+  fail_unless (done == N_LOOPS * N_CALLBACKS);
+
+  for (i = 0; i < N_LOOPS; i++) {
+    fail_unless (loops[i].ordered);
+    fail_unless (loops[i].current_thread);
+    fail_if (kms_loop_is_current_thread (loops[i].loop));
+    g_object_unref (loops[i].loop);
+  }
+
+  /* Every loop runs on one of the pool threads */
+  GST_INFO ("%u loops used %u threads", N_LOOPS, g_hash_table_size (threads));
+  fail_unless (g_hash_table_size (threads) <= POOL_SIZE);
+
+  g_hash_table_unref (threads);
+}
+
+GST_END_TEST;
+
+static gint called;
+static gint destroyed;
+
+static gboolean
+timeout_cb (gpointer data)
+{
+  g_atomic_int_inc (&called);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+destroy_cb (gpointer data)
+{
+  g_atomic_int_inc (&destroyed);
+}
+
+GST_START_TEST (check_pooled_dispose)
+{
+  KmsLoop *loop, *other;
+  guint id;
+
+  called = destroyed = 0;
+
+  loop = kms_loop_new_pooled ();
+  other = kms_loop_new_pooled ();
+
+  kms_loop_timeout_add_full (loop, G_PRIORITY_DEFAULT, 10, timeout_cb, NULL,
+      destroy_cb);
+  kms_loop_timeout_add_full (loop, G_PRIORITY_DEFAULT, 100000, timeout_cb,
+      NULL, destroy_cb);
+  id = kms_loop_timeout_add_full (other, G_PRIORITY_DEFAULT, 100000,
+      timeout_cb, NULL, destroy_cb);
+
+  g_usleep (100 * G_TIME_SPAN_MILLISECOND);
+  fail_unless (g_atomic_int_get (&called) > 0);
+
+  /* Disposing a loop releases its sources but not the ones of other loops */
+  g_object_unref (loop);
+  fail_unless (g_atomic_int_get (&destroyed) == 2);
+
+  called = 0;
+  g_usleep (50 * G_TIME_SPAN_MILLISECOND);
+  fail_unless (g_atomic_int_get (&called) == 0);
+
+  fail_unless (kms_loop_remove (other, id));
+  fail_unless (g_atomic_int_get (&destroyed) == 3);
+
+  g_object_unref (other);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+loop_suite (void)
+{
+  Suite *s = suite_create ("loop");
+  TCase *tc_chain = tcase_create ("element");
+
+  /* Must be set before the first pooled loop is created */
+  g_setenv ("KURENTO_LOOP_POOL_SIZE", G_STRINGIFY (POOL_SIZE), TRUE);
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_pooled_ordering);
+  tcase_add_test (tc_chain, check_pooled_dispose);
+
+  return s;
+}
+
+GST_CHECK_MAIN (loop);
@@ -130,6 +130,53 @@ GST_START_TEST (check_take_into_account_after_clear_time)
 
 GST_END_TEST;
 
+GST_START_TEST (check_min_br_many_ssrcs)
+{
+  GstPad *pad;
+  RembEventManager *manager;
+  GstEvent *event;
+  guint min_br = 0, i;
+
+  pad = gst_pad_new (NULL, GST_PAD_SRC);
+  gst_pad_set_active (pad, TRUE);
+  manager = kms_utils_remb_event_manager_create (pad);
+  kms_utils_remb_event_manager_set_callback (manager, bitrate_cb, &min_br,
+      NULL);
+
+  for (i = 1; i <= 500; i++) {
+    event = kms_utils_remb_event_upstream_new (1000 + (i * 37) % 500, i);
+    gst_pad_send_event (pad, event);
+  }
+  fail_unless (min_br == 1000);
+  fail_unless (kms_utils_remb_event_manager_get_min (manager) == 1000);
+
+  /* Raise every SSRC over the current min, in increasing order */
+  for (i = 1; i <= 500; i++) {
+    event = kms_utils_remb_event_upstream_new (2000 + i, i);
+    gst_pad_send_event (pad, event);
+
+    if (i < 500) {
+      fail_unless (min_br <= 1000 + 499);
+    }
+  }
+  fail_unless (min_br == 2001);
+
+  /* Lower one SSRC in the middle of the heap */
+  event = kms_utils_remb_event_upstream_new (1500, 250);
+  gst_pad_send_event (pad, event);
+  fail_unless (min_br == 1500);
+
+  /* Raise it again: the next min comes from another SSRC */
+  event = kms_utils_remb_event_upstream_new (3000, 250);
+  gst_pad_send_event (pad, event);
+  fail_unless (min_br == 2001);
+
+  kms_utils_remb_event_manager_destroy (manager);
+  g_object_unref (pad);
+}
+
+GST_END_TEST;
+
 /* Suite initialization */
 static Suite *
 rembmanager_suite (void)
@@ -140,6 +187,7 @@ rembmanager_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, check_min_br_update);
   tcase_add_test (tc_chain, check_take_into_account_after_clear_time);
+  tcase_add_test (tc_chain, check_min_br_many_ssrcs);
 
   return s;
 }
@@ -0,0 +1,313 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <gst/check/gstcheck.h>
+#include <gst/rtp/gstrtpbuffer.h>
+
+#include "kmsrtpallocator.h"
+
+#define MEM_SIZE 100
+#define PAYLOAD_SIZE 100
+#define SEQ 1000
+
+static GstAllocator *
+create_allocator (void)
+{
+  GstAllocator *allocator = g_object_new (KMS_TYPE_RTP_ALLOCATOR, NULL);
+
+  gst_object_ref_sink (allocator);
+
+  return allocator;
+}
+
+static gint
+get_free_chunks (GstAllocator * allocator)
+{
+  gint free_chunks;
+
+  g_object_get (allocator, "free-chunks", &free_chunks, NULL);
+
+  return free_chunks;
+}
+
+static GstMemory *
+alloc_filled (GstAllocator * allocator)
+{
+  GstMemory *mem = gst_allocator_alloc (allocator, MEM_SIZE, NULL);
+  GstMapInfo info;
+  guint i;
+
+  fail_if (mem == NULL);
+  fail_unless (gst_memory_map (mem, &info, GST_MAP_WRITE));
+  for (i = 0; i < MEM_SIZE; i++) {
+    info.data[i] = i;
+  }
+  gst_memory_unmap (mem, &info);
+
+  return mem;
+}
+
+GST_START_TEST (check_chunks_recycled)
+{
+  GstAllocator *allocator = create_allocator ();
+  GstMemory *mem, *recycled;
+  GstMapInfo info;
+
+  mem = gst_allocator_alloc (allocator, MEM_SIZE, NULL);
+  fail_unless (gst_memory_is_type (mem, KMS_RTP_ALLOCATOR_NAME));
+  fail_unless (mem->maxsize == KMS_RTP_ALLOCATOR_CHUNK_SIZE);
+  fail_unless (mem->size == MEM_SIZE);
+
+  fail_unless (gst_memory_map (mem, &info, GST_MAP_READ));
+  fail_unless (((guintptr) info.data & KMS_RTP_ALLOCATOR_ALIGN) == 0);
+  gst_memory_unmap (mem, &info);
+
+  fail_unless (get_free_chunks (allocator) == 0);
+  gst_memory_unref (mem);
+  fail_unless (get_free_chunks (allocator) == 1);
+
+  /* The freed chunk is handed out again instead of a new one */
+  recycled = gst_allocator_alloc (allocator, MEM_SIZE, NULL);
+  fail_unless (recycled == mem);
+  fail_unless (get_free_chunks (allocator) == 0);
+
+  gst_memory_unref (recycled);
+  gst_object_unref (allocator);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_big_memory_not_served)
+{
+  GstAllocator *allocator = create_allocator ();
+  GstMemory *mem;
+
+  mem = gst_allocator_alloc (allocator, KMS_RTP_ALLOCATOR_CHUNK_SIZE + 1,
+      NULL);
+  fail_if (gst_memory_is_type (mem, KMS_RTP_ALLOCATOR_NAME));
+  gst_memory_unref (mem);
+
+  fail_unless (get_free_chunks (allocator) == 0);
+
+  gst_object_unref (allocator);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_free_chunks_limit)
+{
+  GstAllocator *allocator = create_allocator ();
+  guint n = KMS_RTP_ALLOCATOR_MAX_FREE_CHUNKS + 10;
+  GstMemory **mems = g_new (GstMemory *, n);
+  guint i;
+
+  for (i = 0; i < n; i++) {
+    mems[i] = gst_allocator_alloc (allocator, MEM_SIZE, NULL);
+  }
+
+  for (i = 0; i < n; i++) {
+    gst_memory_unref (mems[i]);
+  }
+
+  /* Chunks freed above the limit go back to the system */
+  fail_unless (get_free_chunks (allocator) ==
+      KMS_RTP_ALLOCATOR_MAX_FREE_CHUNKS);
+
+  g_free (mems);
+  gst_object_unref (allocator);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_share)
+{
+  GstAllocator *allocator = create_allocator ();
+  GstMemory *mem = alloc_filled (allocator);
+  GstMemory *sub;
+  GstMapInfo info;
+
+  sub = gst_memory_share (mem, 10, 20);
+  fail_unless (sub->parent == mem);
+  fail_unless (sub->size == 20);
+  fail_if (gst_memory_is_writable (sub));
+
+  fail_unless (gst_memory_map (sub, &info, GST_MAP_READ));
+  fail_unless (info.size == 20);
+  fail_unless (info.data[0] == 10);
+  fail_unless (info.data[19] == 29);
+  gst_memory_unmap (sub, &info);
+
+  /* Shared memory does not own the chunk */
+  gst_memory_unref (sub);
+  fail_unless (get_free_chunks (allocator) == 0);
+
+  gst_memory_unref (mem);
+  fail_unless (get_free_chunks (allocator) == 1);
+
+  gst_object_unref (allocator);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_copy)
+{
+  GstAllocator *allocator = create_allocator ();
+  GstMemory *mem = alloc_filled (allocator);
+  GstMapInfo info, copy_info;
+  GstMemory *copy;
+
+  copy = gst_memory_copy (mem, 10, 20);
+  fail_unless (gst_memory_is_type (copy, KMS_RTP_ALLOCATOR_NAME));
+  fail_unless (copy->parent == NULL);
+  fail_unless (copy->size == 20);
+
+  fail_unless (gst_memory_map (mem, &info, GST_MAP_READ));
+  fail_unless (gst_memory_map (copy, &copy_info, GST_MAP_READ));
+  fail_if (copy_info.data == info.data + 10);
+  fail_unless (memcmp (copy_info.data, info.data + 10, 20) == 0);
+  gst_memory_unmap (copy, &copy_info);
+  gst_memory_unmap (mem, &info);
+
+  gst_memory_unref (copy);
+  gst_memory_unref (mem);
+  fail_unless (get_free_chunks (allocator) == 2);
+
+  gst_object_unref (allocator);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_is_span)
+{
+  GstAllocator *allocator = create_allocator ();
+  GstMemory *mem = alloc_filled (allocator);
+  GstMemory *first, *second, *other;
+  gsize offset;
+
+  first = gst_memory_share (mem, 10, 20);
+  second = gst_memory_share (mem, 30, 20);
+  other = gst_memory_share (mem, 60, 20);
+
+  fail_unless (gst_memory_is_span (first, second, &offset));
+  fail_unless (offset == 10);
+  fail_if (gst_memory_is_span (first, other, &offset));
+
+  gst_memory_unref (first);
+  gst_memory_unref (second);
+  gst_memory_unref (other);
+  gst_memory_unref (mem);
+  gst_object_unref (allocator);
+}
+
+GST_END_TEST;
+
+static GstBuffer *
+create_rtp_buffer (void)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstBuffer *buffer;
+  guint8 *payload;
+  guint i;
+
+  buffer = gst_rtp_buffer_new_allocate (PAYLOAD_SIZE, 0, 0);
+  gst_rtp_buffer_map (buffer, GST_MAP_WRITE, &rtp);
+  gst_rtp_buffer_set_seq (&rtp, SEQ);
+  payload = gst_rtp_buffer_get_payload (&rtp);
+  for (i = 0; i < PAYLOAD_SIZE; i++) {
+    payload[i] = i;
+  }
+  gst_rtp_buffer_unmap (&rtp);
+
+  return buffer;
+}
+
+GST_START_TEST (check_make_header_writable_shared)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstBuffer *buffer = create_rtp_buffer ();
+  guint8 *payload, *out_payload;
+  GstMapInfo info;
+  GstBuffer *out;
+  guint i;
+
+  gst_rtp_buffer_map (buffer, GST_MAP_READ, &rtp);
+  payload = gst_rtp_buffer_get_payload (&rtp);
+  gst_rtp_buffer_unmap (&rtp);
+
+  /* Still referenced by the caller, so it cannot be modified */
+  out = kms_rtp_buffer_make_header_writable (gst_buffer_ref (buffer));
+  fail_if (out == buffer);
+  fail_unless (gst_buffer_is_writable (out));
+  fail_unless (gst_memory_is_type (gst_buffer_peek_memory (out, 0),
+          KMS_RTP_ALLOCATOR_NAME));
+  fail_unless (gst_buffer_get_size (out) == gst_buffer_get_size (buffer));
+
+  /* The payload is shared, not copied */
+  fail_unless (gst_buffer_n_memory (out) == 2);
+  fail_unless (gst_buffer_map_range (out, 1, 1, &info, GST_MAP_READ));
+  out_payload = info.data;
+  fail_unless (out_payload == payload);
+  for (i = 0; i < PAYLOAD_SIZE; i++) {
+    fail_unless (out_payload[i] == i);
+  }
+  gst_buffer_unmap (out, &info);
+
+  /* Only the header chunk is written, the sequence number is at byte 2 */
+  fail_unless (gst_buffer_map_range (out, 0, 1, &info, GST_MAP_WRITE));
+  fail_unless (GST_READ_UINT16_BE (info.data + 2) == SEQ);
+  GST_WRITE_UINT16_BE (info.data + 2, SEQ + 1);
+  gst_buffer_unmap (out, &info);
+
+  gst_rtp_buffer_map (out, GST_MAP_READ, &rtp);
+  fail_unless (gst_rtp_buffer_get_seq (&rtp) == SEQ + 1);
+  gst_rtp_buffer_unmap (&rtp);
+
+  /* The original header is untouched */
+  gst_rtp_buffer_map (buffer, GST_MAP_READ, &rtp);
+  fail_unless (gst_rtp_buffer_get_seq (&rtp) == SEQ);
+  gst_rtp_buffer_unmap (&rtp);
+
+  /* Once it is a RTP chunk, the buffer is modified in place */
+  fail_unless (kms_rtp_buffer_make_header_writable (out) == out);
+  gst_buffer_unref (out);
+
+  /* Not shared any more, so it is not copied either */
+  fail_unless (kms_rtp_buffer_make_header_writable (buffer) == buffer);
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+rtpallocator_suite (void)
+{
+  Suite *s = suite_create ("rtpallocator");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_chunks_recycled);
+  tcase_add_test (tc_chain, check_big_memory_not_served);
+  tcase_add_test (tc_chain, check_free_chunks_limit);
+  tcase_add_test (tc_chain, check_share);
+  tcase_add_test (tc_chain, check_copy);
+  tcase_add_test (tc_chain, check_is_span);
+  tcase_add_test (tc_chain, check_make_header_writable_shared);
+
+  return s;
+}
+
+GST_CHECK_MAIN (rtpallocator);
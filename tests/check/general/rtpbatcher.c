@@ -0,0 +1,217 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <gst/check/gstcheck.h>
+#include <gst/rtp/gstrtpbuffer.h>
+#include <glib.h>
+
+#include "kmsrtpbatcher.h"
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-rtp"));
+
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-rtp"));
+
+static GList *received_lists;
+
+static GstFlowReturn
+check_chain_list_func (GstPad * pad, GstObject * parent, GstBufferList * list)
+{
+  received_lists = g_list_append (received_lists, list);
+
+  return GST_FLOW_OK;
+}
+
+static GstBuffer *
+create_rtp_buffer (guint16 seq, guint32 ts, gboolean marker)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstBuffer *buf;
+
+  buf = gst_rtp_buffer_new_allocate (100, 0, 0);
+  gst_rtp_buffer_map (buf, GST_MAP_WRITE, &rtp);
+  gst_rtp_buffer_set_payload_type (&rtp, 96);
+  gst_rtp_buffer_set_seq (&rtp, seq);
+  gst_rtp_buffer_set_timestamp (&rtp, ts);
+  gst_rtp_buffer_set_marker (&rtp, marker);
+  gst_rtp_buffer_unmap (&rtp);
+
+  return buf;
+}
+
+static void
+clear_received (void)
+{
+  g_list_free_full (received_lists, (GDestroyNotify) gst_buffer_list_unref);
+  received_lists = NULL;
+
+  g_list_free_full (buffers, (GDestroyNotify) gst_buffer_unref);
+  buffers = NULL;
+}
+
+static GstElement *
+setup_batcher (GstPad ** srcpad, GstPad ** sinkpad)
+{
+  GstElement *batcher;
+  GstCaps *caps;
+
+  batcher = g_object_new (KMS_TYPE_RTP_BATCHER, NULL);
+
+  *srcpad = gst_check_setup_src_pad (batcher, &srctemplate);
+  *sinkpad = gst_check_setup_sink_pad (batcher, &sinktemplate);
+  gst_pad_set_chain_list_function (*sinkpad, check_chain_list_func);
+  gst_pad_set_active (*srcpad, TRUE);
+  gst_pad_set_active (*sinkpad, TRUE);
+
+  fail_unless (gst_element_set_state (batcher, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_SUCCESS);
+
+  caps = gst_caps_from_string ("application/x-rtp");
+  gst_check_setup_events (*srcpad, batcher, caps, GST_FORMAT_TIME);
+  gst_caps_unref (caps);
+
+  return batcher;
+}
+
+static void
+teardown_batcher (GstElement * batcher)
+{
+  clear_received ();
+
+  gst_check_teardown_src_pad (batcher);
+  gst_check_teardown_sink_pad (batcher);
+  gst_check_teardown_element (batcher);
+}
+
+GST_START_TEST (check_frame_batching)
+{
+  GstPad *srcpad, *sinkpad;
+  GstElement *batcher;
+  GstBufferList *list;
+
+  batcher = setup_batcher (&srcpad, &sinkpad);
+
+  GST_DEBUG ("Packets are kept until the marker");
+  fail_unless (gst_pad_push (srcpad, create_rtp_buffer (1, 1000,
+              FALSE)) == GST_FLOW_OK);
+  fail_unless (gst_pad_push (srcpad, create_rtp_buffer (2, 1000,
+              FALSE)) == GST_FLOW_OK);
+  fail_unless (received_lists == NULL);
+  fail_unless (buffers == NULL);
+
+  fail_unless (gst_pad_push (srcpad, create_rtp_buffer (3, 1000,
+              TRUE)) == GST_FLOW_OK);
+  fail_unless (g_list_length (received_lists) == 1);
+  list = received_lists->data;
+  fail_unless (gst_buffer_list_length (list) == 3);
+  clear_received ();
+
+  GST_DEBUG ("A timestamp change closes a frame without marker");
+  gst_pad_push (srcpad, create_rtp_buffer (4, 2000, FALSE));
+  gst_pad_push (srcpad, create_rtp_buffer (5, 2000, FALSE));
+  gst_pad_push (srcpad, create_rtp_buffer (6, 3000, FALSE));
+  fail_unless (g_list_length (received_lists) == 1);
+  list = received_lists->data;
+  fail_unless (gst_buffer_list_length (list) == 2);
+  clear_received ();
+
+  GST_DEBUG ("Serialized events push pending packets first");
+  fail_unless (gst_pad_push_event (srcpad, gst_event_new_eos ()));
+  fail_unless (g_list_length (received_lists) == 1);
+  list = received_lists->data;
+  fail_unless (gst_buffer_list_length (list) == 1);
+
+  teardown_batcher (batcher);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_max_packets)
+{
+  GstPad *srcpad, *sinkpad;
+  GstElement *batcher;
+  GList *l;
+  guint i;
+
+  batcher = setup_batcher (&srcpad, &sinkpad);
+  g_object_set (batcher, "max-packets", 4, NULL);
+
+  for (i = 0; i < 10; i++) {
+    gst_pad_push (srcpad, create_rtp_buffer (i, 1000, i == 9));
+  }
+
+  fail_unless (g_list_length (received_lists) == 3);
+  l = received_lists;
+  fail_unless (gst_buffer_list_length (l->data) == 4);
+  l = l->next;
+  fail_unless (gst_buffer_list_length (l->data) == 4);
+  l = l->next;
+  fail_unless (gst_buffer_list_length (l->data) == 2);
+
+  teardown_batcher (batcher);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_list_passthrough)
+{
+  GstPad *srcpad, *sinkpad;
+  GstElement *batcher;
+  GstBufferList *list;
+  guint i;
+
+  batcher = setup_batcher (&srcpad, &sinkpad);
+
+  gst_pad_push (srcpad, create_rtp_buffer (1, 1000, FALSE));
+
+  list = gst_buffer_list_new ();
+  for (i = 0; i < 5; i++) {
+    gst_buffer_list_add (list, create_rtp_buffer (2 + i, 2000, i == 4));
+  }
+
+  fail_unless (gst_pad_push_list (srcpad, list) == GST_FLOW_OK);
+
+  /* Pending packet first, then the same list */
+  fail_unless (g_list_length (received_lists) == 2);
+  fail_unless (gst_buffer_list_length (received_lists->data) == 1);
+  fail_unless (received_lists->next->data == list);
+
+  teardown_batcher (batcher);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+rtpbatcher_suite (void)
+{
+  Suite *s = suite_create ("rtpbatcher");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_frame_batching);
+  tcase_add_test (tc_chain, check_max_packets);
+  tcase_add_test (tc_chain, check_list_passthrough);
+
+  return s;
+}
+
+GST_CHECK_MAIN (rtpbatcher);
@@ -0,0 +1,354 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <gst/check/gstcheck.h>
+#include <glib.h>
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "kmsudpbatchsrc.h"
+
+#define N_PACKETS 100
+#define PACKET_SIZE 1200
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static GMutex received_mutex;
+static GCond received_cond;
+static guint received_packets;
+static guint received_lists;
+static gboolean received_ok;
+
+static GstFlowReturn
+check_chain_list_func (GstPad * pad, GstObject * parent, GstBufferList * list)
+{
+  guint i, len = gst_buffer_list_length (list);
+
+  g_mutex_lock (&received_mutex);
+
+  for (i = 0; i < len; i++) {
+    GstBuffer *buffer = gst_buffer_list_get (list, i);
+    guint8 first;
+
+    /* Each packet is filled with its index */
+    gst_buffer_extract (buffer, 0, &first, 1);
+    if (gst_buffer_get_size (buffer) != PACKET_SIZE
+        || first != (guint8) received_packets) {
+      received_ok = FALSE;
+    }
+
+    received_packets++;
+  }
+
+  received_lists++;
+  g_cond_signal (&received_cond);
+  g_mutex_unlock (&received_mutex);
+
+  gst_buffer_list_unref (list);
+
+  return GST_FLOW_OK;
+}
+
+static GThread *push_thread;
+
+static GstFlowReturn
+thread_chain_list_func (GstPad * pad, GstObject * parent,
+    GstBufferList * list)
+{
+  g_mutex_lock (&received_mutex);
+  push_thread = g_thread_self ();
+  g_mutex_unlock (&received_mutex);
+
+  return check_chain_list_func (pad, parent, list);
+}
+
+static gint
+bind_socket (struct sockaddr_in *addr)
+{
+  socklen_t addr_len = sizeof (*addr);
+  gint fd;
+
+  fd = socket (AF_INET, SOCK_DGRAM, 0);
+  fail_if (fd < 0);
+
+  memset (addr, 0, sizeof (*addr));
+  addr->sin_family = AF_INET;
+  addr->sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  fail_if (bind (fd, (struct sockaddr *) addr, sizeof (*addr)) < 0);
+  fail_if (getsockname (fd, (struct sockaddr *) addr, &addr_len) < 0);
+
+  return fd;
+}
+
+static void
+send_packets (gint send_fd, struct sockaddr_in *addr, guint first, guint n)
+{
+  guint8 data[PACKET_SIZE];
+  guint i;
+
+  for (i = first; i < first + n; i++) {
+    memset (data, i, sizeof (data));
+    fail_unless (sendto (send_fd, data, sizeof (data), 0,
+            (struct sockaddr *) addr, sizeof (*addr)) == sizeof (data));
+  }
+}
+
+static gboolean
+wait_packets (guint n)
+{
+  gint64 end_time = g_get_monotonic_time () + 5 * G_TIME_SPAN_SECOND;
+  gboolean ret;
+
+  g_mutex_lock (&received_mutex);
+  while (received_packets < n) {
+    if (!g_cond_wait_until (&received_cond, &received_mutex, end_time)) {
+      break;
+    }
+  }
+  ret = received_packets == n;
+  g_mutex_unlock (&received_mutex);
+
+  return ret;
+}
+
+static GstElement *
+setup_src (gint recv_fd, gboolean use_reactor, GstPadChainListFunction func)
+{
+  GstElement *src;
+  GstPad *sinkpad;
+
+  src = kms_udp_batch_src_new (recv_fd, NULL);
+  g_object_set (src, "use-reactor", use_reactor, NULL);
+  sinkpad = gst_check_setup_sink_pad (src, &sinktemplate);
+  gst_pad_set_chain_list_function (sinkpad, func);
+  gst_pad_set_active (sinkpad, TRUE);
+
+  return src;
+}
+
+static void
+teardown_src (GstElement * src)
+{
+  gst_check_teardown_sink_pad (src);
+  gst_check_teardown_element (src);
+}
+
+static void
+receive_packets (gboolean gro, gboolean use_reactor)
+{
+  struct sockaddr_in addr;
+  GstElement *src;
+  gint recv_fd, send_fd;
+
+  recv_fd = bind_socket (&addr);
+  send_fd = socket (AF_INET, SOCK_DGRAM, 0);
+  fail_if (send_fd < 0);
+
+  received_packets = 0;
+  received_lists = 0;
+  received_ok = TRUE;
+
+  src = setup_src (recv_fd, use_reactor, check_chain_list_func);
+  g_object_set (src, "gro", gro, NULL);
+
+  /* Queued in the socket before the source starts, to read them in batches */
+  send_packets (send_fd, &addr, 0, N_PACKETS);
+
+  fail_if (gst_element_set_state (src, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+
+  wait_packets (N_PACKETS);
+
+  GST_DEBUG ("Received %u packets in %u lists", received_packets,
+      received_lists);
+
+  fail_unless (received_packets == N_PACKETS);
+  fail_unless (received_ok);
+  /* Default batch is 32 packets */
+  fail_unless (received_lists < N_PACKETS);
+
+  teardown_src (src);
+
+  close (send_fd);
+  close (recv_fd);
+}
+
+static void
+pause_stops_reading (gboolean use_reactor)
+{
+  struct sockaddr_in addr;
+  GstElement *src;
+  gint recv_fd, send_fd;
+
+  recv_fd = bind_socket (&addr);
+  send_fd = socket (AF_INET, SOCK_DGRAM, 0);
+  fail_if (send_fd < 0);
+
+  received_packets = 0;
+  received_lists = 0;
+  received_ok = TRUE;
+
+  src = setup_src (recv_fd, use_reactor, check_chain_list_func);
+  fail_if (gst_element_set_state (src, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+
+  send_packets (send_fd, &addr, 0, 1);
+  fail_unless (wait_packets (1));
+
+  fail_if (gst_element_set_state (src, GST_STATE_PAUSED) ==
+      GST_STATE_CHANGE_FAILURE);
+
+  send_packets (send_fd, &addr, 1, N_PACKETS - 1);
+  g_usleep (200 * G_TIME_SPAN_MILLISECOND);
+
+  g_mutex_lock (&received_mutex);
+  fail_unless (received_packets == 1);
+  g_mutex_unlock (&received_mutex);
+
+  /* Packets waited in the socket */
+  fail_if (gst_element_set_state (src, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+  fail_unless (wait_packets (N_PACKETS));
+  fail_unless (received_ok);
+
+  teardown_src (src);
+
+  close (send_fd);
+  close (recv_fd);
+}
+
+GST_START_TEST (check_batched_receive)
+{
+  receive_packets (FALSE, TRUE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_own_thread_receive)
+{
+  receive_packets (FALSE, FALSE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_gro_receive)
+{
+  /* Falls back to plain recvmmsg when the kernel has no UDP GRO */
+  receive_packets (TRUE, TRUE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_pause_stops_reading)
+{
+  pause_stops_reading (FALSE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_reactor_pause_stops_reading)
+{
+  pause_stops_reading (TRUE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_reactor_pushes)
+{
+  struct sockaddr_in addr;
+  GstElement *src;
+  GstPad *srcpad;
+  gint recv_fd, send_fd;
+
+  recv_fd = bind_socket (&addr);
+  send_fd = socket (AF_INET, SOCK_DGRAM, 0);
+  fail_if (send_fd < 0);
+
+  push_thread = NULL;
+  received_packets = 0;
+  received_lists = 0;
+  received_ok = TRUE;
+
+  src = setup_src (recv_fd, TRUE, thread_chain_list_func);
+  fail_if (gst_element_set_state (src, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+
+  send_packets (send_fd, &addr, 0, N_PACKETS);
+  fail_unless (wait_packets (N_PACKETS));
+  fail_unless (received_ok);
+
+  /* Lists are pushed by a reactor thread, no streaming task is started */
+  srcpad = gst_element_get_static_pad (src, "src");
+  fail_unless (GST_PAD_TASK (srcpad) == NULL);
+  gst_object_unref (srcpad);
+
+  g_mutex_lock (&received_mutex);
+  fail_if (push_thread == NULL);
+  fail_if (push_thread == g_thread_self ());
+  g_mutex_unlock (&received_mutex);
+
+  teardown_src (src);
+
+  close (send_fd);
+  close (recv_fd);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_no_socket)
+{
+  GstElement *src;
+
+  /* Registered by kmscore, so it can be created by name */
+  src = gst_element_factory_make ("udpbatchsrc", NULL);
+  fail_unless (KMS_IS_UDP_BATCH_SRC (src));
+
+  fail_unless (gst_element_set_state (src, GST_STATE_READY) ==
+      GST_STATE_CHANGE_FAILURE);
+
+  gst_element_set_state (src, GST_STATE_NULL);
+  gst_object_unref (src);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+udpbatchsrc_suite (void)
+{
+  Suite *s = suite_create ("udpbatchsrc");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_batched_receive);
+  tcase_add_test (tc_chain, check_own_thread_receive);
+  tcase_add_test (tc_chain, check_gro_receive);
+  tcase_add_test (tc_chain, check_pause_stops_reading);
+  tcase_add_test (tc_chain, check_reactor_pause_stops_reading);
+  tcase_add_test (tc_chain, check_reactor_pushes);
+  tcase_add_test (tc_chain, check_no_socket);
+
+  return s;
+}
+
+GST_CHECK_MAIN (udpbatchsrc);
@@ -16,6 +16,7 @@
  */
 #include "kmsutils.h"
 #include "sdp_utils.h"
+#include "kmsagnosticcaps.h"
 
 #include <gst/check/gstcheck.h>
 #include <gst/check/gstharness.h>
@@ -380,6 +381,79 @@ GST_START_TEST (check_kms_utils_drop_until_keyframe_bufferlist)
 
 GST_END_TEST;
 
+static const gchar *classify_caps[] = {
+  "video/x-raw",
+  "video/x-raw(memory:GLMemory)",
+  "audio/x-raw,rate=48000,channels=2",
+  "application/x-rtp,media=video,encoding-name=VP8",
+  "application/x-rtp(memory:GLMemory)",
+  "video/x-vp8",
+  "video/x-h264,stream-format=avc",
+  "audio/x-opus",
+  "audio/mpeg,mpegversion=4",
+  "audio/mpeg,mpegversion=1,layer=1",
+  "audio/AMR,rate=8000,channels=1",
+  "audio/AMR,rate=44100,channels=1",
+  "video/x-h263,variant=itu,h263version=h263p",
+  "video/x-h263,variant=itu,h263version=h263pp",
+  "video/x-raw;audio/x-raw",
+  "video/x-raw;video/x-vp8",
+  "application/x-rtp;video/x-raw",
+  "application/data",
+  "ANY",
+  "EMPTY",
+};
+
+static gboolean
+reference_can_intersect (const GstCaps * caps, const gchar * ref)
+{
+  GstCaps *aux = gst_caps_from_string (ref);
+  gboolean ret = gst_caps_can_intersect (caps, aux);
+
+  gst_caps_unref (aux);
+
+  return ret;
+}
+
+static gboolean
+reference_is_subset (const GstCaps * caps, const gchar * ref)
+{
+  GstCaps *aux = gst_caps_from_string (ref);
+  gboolean ret = gst_caps_is_always_compatible (caps, aux);
+
+  gst_caps_unref (aux);
+
+  return ret;
+}
+
+GST_START_TEST (check_kms_utils_caps_classify)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (classify_caps); i++) {
+    GstCaps *caps = gst_caps_from_string (classify_caps[i]);
+    KmsCapsClass caps_class = kms_utils_caps_classify (caps);
+
+    GST_DEBUG ("Checking %" GST_PTR_FORMAT, caps);
+
+    fail_unless (!!(caps_class & KMS_CAPS_CLASS_AUDIO) ==
+        reference_can_intersect (caps, KMS_AGNOSTIC_AUDIO_CAPS));
+    fail_unless (!!(caps_class & KMS_CAPS_CLASS_VIDEO) ==
+        reference_can_intersect (caps, KMS_AGNOSTIC_VIDEO_CAPS));
+    fail_unless (!!(caps_class & KMS_CAPS_CLASS_RAW) ==
+        reference_is_subset (caps, "video/x-raw; video/x-raw(ANY); "
+            "audio/x-raw; audio/x-raw(ANY);"));
+    fail_unless (!!(caps_class & KMS_CAPS_CLASS_RTP) ==
+        reference_is_subset (caps, KMS_AGNOSTIC_RTP_CAPS));
+
+    gst_caps_unref (caps);
+  }
+
+  fail_unless (kms_utils_caps_classify (NULL) == 0);
+}
+
+GST_END_TEST;
+
 /* Suite initialization */
 static Suite *
 utils_suite (void)
@@ -397,6 +471,7 @@ utils_suite (void)
 
   tcase_add_test (tc_chain, check_kms_utils_drop_until_keyframe_buffer);
   tcase_add_test (tc_chain, check_kms_utils_drop_until_keyframe_bufferlist);
+  tcase_add_test (tc_chain, check_kms_utils_caps_classify);
 
   return s;
 }
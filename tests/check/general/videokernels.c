@@ -0,0 +1,447 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "kmsvideokernels.h"
+
+#include <gst/check/gstcheck.h>
+#include <glib.h>
+#include <string.h>
+
+/* Environment variable setting the frames converted by the benchmark */
+#define BENCHMARK_ENV "KMS_VIDEO_KERNELS_BENCHMARK_FRAMES"
+#define BENCHMARK_DEFAULT_FRAMES 20
+#define BENCHMARK_WIDTH 1280
+#define BENCHMARK_HEIGHT 720
+
+/* Padding added to strides so kernels cannot assume packed planes */
+#define STRIDE_PADDING 13
+
+typedef struct _Image
+{
+  guint8 *data[3];
+  gint stride[3];
+} Image;
+
+typedef enum
+{
+  FORMAT_I420,
+  FORMAT_NV12,
+  FORMAT_RGBX
+} Format;
+
+static void
+image_init (Image * img, Format format, gint width, gint height)
+{
+  gint cw = (width + 1) / 2, ch = (height + 1) / 2;
+  guint i;
+
+  memset (img, 0, sizeof (Image));
+
+  switch (format) {
+    case FORMAT_I420:
+      img->stride[0] = width + STRIDE_PADDING;
+      img->stride[1] = img->stride[2] = cw + STRIDE_PADDING;
+      img->data[0] = g_malloc (img->stride[0] * height);
+      img->data[1] = g_malloc (img->stride[1] * ch);
+      img->data[2] = g_malloc (img->stride[2] * ch);
+      break;
+    case FORMAT_NV12:
+      img->stride[0] = width + STRIDE_PADDING;
+      img->stride[1] = 2 * cw + STRIDE_PADDING;
+      img->data[0] = g_malloc (img->stride[0] * height);
+      img->data[1] = g_malloc (img->stride[1] * ch);
+      break;
+    case FORMAT_RGBX:
+      img->stride[0] = 4 * width + STRIDE_PADDING;
+      img->data[0] = g_malloc (img->stride[0] * height);
+      break;
+  }
+
+  /* Deterministic contents, padding included */
+  for (i = 0; i < 3; i++) {
+    gint rows = i == 0 ? height : ch, j;
+
+    if (img->data[i] == NULL) {
+      continue;
+    }
+
+    for (j = 0; j < img->stride[i] * rows; j++) {
+      img->data[i][j] = (j * 7 + i * 31 + (j / img->stride[i]) * 13) & 0xff;
+    }
+  }
+}
+
+static gboolean
+image_equal (Image * a, Image * b, Format format, gint width, gint height)
+{
+  gint cw = (width + 1) / 2, ch = (height + 1) / 2;
+  gint row_bytes[3] = { width, 0, 0 }, rows[3] = { height, ch, ch };
+  guint i;
+  gint y;
+
+  switch (format) {
+    case FORMAT_I420:
+      row_bytes[1] = row_bytes[2] = cw;
+      break;
+    case FORMAT_NV12:
+      row_bytes[1] = 2 * cw;
+      break;
+    case FORMAT_RGBX:
+      row_bytes[0] = 4 * width;
+      break;
+  }
+
+  for (i = 0; i < 3; i++) {
+    for (y = 0; y < rows[i] && row_bytes[i] > 0; y++) {
+      if (memcmp (a->data[i] + y * a->stride[i], b->data[i] + y * b->stride[i],
+              row_bytes[i]) != 0) {
+        return FALSE;
+      }
+    }
+  }
+
+  return TRUE;
+}
+
+static void
+image_clear (Image * img)
+{
+  guint i;
+
+  for (i = 0; i < 3; i++) {
+    g_free (img->data[i]);
+  }
+}
+
+static void
+convert (Format in, Format out, Image * src, Image * dst, gint width,
+    gint height)
+{
+  if (in == FORMAT_I420 && out == FORMAT_NV12) {
+    kms_video_kernels_i420_to_nv12 (src->data, src->stride, dst->data,
+        dst->stride, width, height);
+  } else if (in == FORMAT_NV12 && out == FORMAT_I420) {
+    kms_video_kernels_nv12_to_i420 (src->data, src->stride, dst->data,
+        dst->stride, width, height);
+  } else if (in == FORMAT_I420 && out == FORMAT_RGBX) {
+    kms_video_kernels_i420_to_rgbx (src->data, src->stride, dst->data[0],
+        dst->stride[0], width, height);
+  } else if (in == FORMAT_NV12 && out == FORMAT_RGBX) {
+    kms_video_kernels_nv12_to_rgbx (src->data, src->stride, dst->data[0],
+        dst->stride[0], width, height);
+  } else if (in == FORMAT_RGBX && out == FORMAT_I420) {
+    kms_video_kernels_rgbx_to_i420 (src->data[0], src->stride[0], dst->data,
+        dst->stride, width, height);
+  } else if (in == FORMAT_RGBX && out == FORMAT_NV12) {
+    kms_video_kernels_rgbx_to_nv12 (src->data[0], src->stride[0], dst->data,
+        dst->stride, width, height);
+  } else {
+    fail ("Unexpected conversion");
+  }
+}
+
+static const Format conversions[][2] = {
+  {FORMAT_I420, FORMAT_NV12},
+  {FORMAT_NV12, FORMAT_I420},
+  {FORMAT_I420, FORMAT_RGBX},
+  {FORMAT_NV12, FORMAT_RGBX},
+  {FORMAT_RGBX, FORMAT_I420},
+  {FORMAT_RGBX, FORMAT_NV12}
+};
+
+static const gint sizes[][2] = {
+  {1, 1}, {2, 2}, {17, 9}, {33, 5}, {64, 32}, {95, 47}, {321, 241}
+};
+
+GST_START_TEST (check_simd_matches_scalar)
+{
+  KmsVideoKernelsImpl best = kms_video_kernels_get_impl ();
+  KmsVideoKernelsImpl impl;
+  guint c, s;
+
+  GST_INFO ("Best implementation: %s",
+      kms_video_kernels_impl_get_name (best));
+
+  for (c = 0; c < G_N_ELEMENTS (conversions); c++) {
+    Format in = conversions[c][0], out = conversions[c][1];
+
+    for (s = 0; s < G_N_ELEMENTS (sizes); s++) {
+      gint width = sizes[s][0], height = sizes[s][1];
+      Image src, ref, dst;
+
+      image_init (&src, in, width, height);
+      image_init (&ref, out, width, height);
+
+      kms_video_kernels_set_impl (KMS_VIDEO_KERNELS_SCALAR);
+      convert (in, out, &src, &ref, width, height);
+
+      for (impl = KMS_VIDEO_KERNELS_SSE41; impl <= best; impl++) {
+        image_init (&dst, out, width, height);
+        kms_video_kernels_set_impl (impl);
+        convert (in, out, &src, &dst, width, height);
+        fail_unless (image_equal (&ref, &dst, out, width, height),
+            "Conversion %u differs for %s at %dx%d", c,
+            kms_video_kernels_impl_get_name (impl), width, height);
+        image_clear (&dst);
+      }
+
+      image_clear (&src);
+      image_clear (&ref);
+    }
+  }
+
+  kms_video_kernels_set_impl (best);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_downscale)
+{
+  KmsVideoKernelsImpl best = kms_video_kernels_get_impl ();
+  KmsVideoKernelsImpl impl;
+  guint s, factor;
+
+  for (factor = 2; factor <= 4; factor += 2) {
+    for (s = 0; s < G_N_ELEMENTS (sizes); s++) {
+      gint width = sizes[s][0] * 4, height = sizes[s][1] * 4;
+      gint dw = width / factor, dh = height / factor;
+      Image src, ref, dst;
+
+      image_init (&src, FORMAT_I420, width, height);
+      image_init (&ref, FORMAT_I420, dw, dh);
+
+      kms_video_kernels_set_impl (KMS_VIDEO_KERNELS_SCALAR);
+      kms_video_kernels_downscale_plane (src.data[0], src.stride[0],
+          ref.data[0], ref.stride[0], width, height, factor);
+
+      for (impl = KMS_VIDEO_KERNELS_SSE41; impl <= best; impl++) {
+        gint y;
+
+        image_init (&dst, FORMAT_I420, dw, dh);
+        kms_video_kernels_set_impl (impl);
+        kms_video_kernels_downscale_plane (src.data[0], src.stride[0],
+            dst.data[0], dst.stride[0], width, height, factor);
+
+        for (y = 0; y < dh; y++) {
+          fail_unless (memcmp (ref.data[0] + y * ref.stride[0],
+                  dst.data[0] + y * dst.stride[0], dw) == 0);
+        }
+
+        image_clear (&dst);
+      }
+
+      image_clear (&src);
+      image_clear (&ref);
+    }
+  }
+
+  kms_video_kernels_set_impl (best);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_colors)
+{
+  /* Black, white, red, green and blue */
+  static const guint8 rgb[][3] = {
+    {0, 0, 0}, {255, 255, 255}, {255, 0, 0}, {0, 255, 0}, {0, 0, 255}
+  };
+  static const guint8 yuv[][3] = {
+    {16, 128, 128}, {235, 128, 128}, {82, 90, 240}, {144, 54, 34},
+    {41, 240, 110}
+  };
+  guint i, c;
+
+  for (i = 0; i < G_N_ELEMENTS (rgb); i++) {
+    guint8 pixels[2 * 2 * 4], back[2 * 2 * 4];
+    guint8 y[4], u, v;
+    guint8 *planes[3] = { y, &u, &v };
+    gint strides[3] = { 2, 1, 1 };
+
+    for (c = 0; c < 4; c++) {
+      memcpy (pixels + 4 * c, rgb[i], 3);
+      pixels[4 * c + 3] = 0;
+    }
+
+    kms_video_kernels_rgbx_to_i420 (pixels, 8, planes, strides, 2, 2);
+
+    GST_DEBUG ("RGB %u %u %u -> YUV %u %u %u", rgb[i][0], rgb[i][1],
+        rgb[i][2], y[0], u, v);
+    fail_unless (ABS (y[0] - yuv[i][0]) <= 1);
+    fail_unless (ABS (u - yuv[i][1]) <= 2);
+    fail_unless (ABS (v - yuv[i][2]) <= 2);
+
+    kms_video_kernels_i420_to_rgbx (planes, strides, back, 8, 2, 2);
+
+    for (c = 0; c < 3; c++) {
+      fail_unless (ABS (back[c] - rgb[i][c]) <= 4,
+          "Color %u channel %u: %u != %u", i, c, back[c], rgb[i][c]);
+    }
+  }
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_luma_histogram)
+{
+  guint32 histogram[256], expected[256];
+  gint width = 123, height = 45, x, y;
+  guint64 total = 0;
+  Image img;
+  guint i;
+
+  image_init (&img, FORMAT_I420, width, height);
+  memset (expected, 0, sizeof (expected));
+
+  for (y = 0; y < height; y++) {
+    for (x = 0; x < width; x++) {
+      expected[img.data[0][y * img.stride[0] + x]]++;
+    }
+  }
+
+  kms_video_kernels_luma_histogram (img.data[0], img.stride[0], width, height,
+      histogram);
+
+  for (i = 0; i < 256; i++) {
+    fail_unless (histogram[i] == expected[i]);
+    total += histogram[i];
+  }
+
+  fail_unless (total == (guint64) width * height);
+
+  image_clear (&img);
+}
+
+GST_END_TEST;
+
+static void
+benchmark_conversion (Format in, Format out, const gchar * name, guint frames)
+{
+  KmsVideoKernelsImpl best = kms_video_kernels_get_impl ();
+  KmsVideoKernelsImpl impl;
+  Image src, dst;
+
+  image_init (&src, in, BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+  image_init (&dst, out, BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+
+  for (impl = KMS_VIDEO_KERNELS_SCALAR; impl <= best; impl++) {
+    gint64 start, elapsed;
+    guint i;
+
+    kms_video_kernels_set_impl (impl);
+
+    start = g_get_monotonic_time ();
+    for (i = 0; i < frames; i++) {
+      convert (in, out, &src, &dst, BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+    }
+    elapsed = g_get_monotonic_time () - start;
+
+    g_print ("%-14s %-7s %8.1f us/frame\n", name,
+        kms_video_kernels_impl_get_name (impl), (gdouble) elapsed / frames);
+  }
+
+  kms_video_kernels_set_impl (best);
+  image_clear (&src);
+  image_clear (&dst);
+}
+
+static void
+benchmark_plane (const gchar * name, guint factor, guint frames)
+{
+  KmsVideoKernelsImpl best = kms_video_kernels_get_impl ();
+  KmsVideoKernelsImpl impl;
+  guint32 histogram[256];
+  Image src, dst;
+
+  image_init (&src, FORMAT_I420, BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+  image_init (&dst, FORMAT_I420, BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+
+  for (impl = KMS_VIDEO_KERNELS_SCALAR; impl <= best; impl++) {
+    gint64 start, elapsed;
+    guint i;
+
+    kms_video_kernels_set_impl (impl);
+
+    start = g_get_monotonic_time ();
+    for (i = 0; i < frames; i++) {
+      if (factor == 0) {
+        kms_video_kernels_luma_histogram (src.data[0], src.stride[0],
+            BENCHMARK_WIDTH, BENCHMARK_HEIGHT, histogram);
+      } else if (factor == 1) {
+        kms_video_kernels_copy_plane (src.data[0], src.stride[0], dst.data[0],
+            dst.stride[0], BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+      } else {
+        kms_video_kernels_downscale_plane (src.data[0], src.stride[0],
+            dst.data[0], dst.stride[0], BENCHMARK_WIDTH, BENCHMARK_HEIGHT,
+            factor);
+      }
+    }
+    elapsed = g_get_monotonic_time () - start;
+
+    g_print ("%-14s %-7s %8.1f us/frame\n", name,
+        kms_video_kernels_impl_get_name (impl), (gdouble) elapsed / frames);
+  }
+
+  kms_video_kernels_set_impl (best);
+  image_clear (&src);
+  image_clear (&dst);
+}
+
+GST_START_TEST (benchmark)
+{
+  const gchar *env = g_getenv (BENCHMARK_ENV);
+  guint frames = BENCHMARK_DEFAULT_FRAMES;
+
+  if (env != NULL) {
+    frames = MAX (1, atoi (env));
+  }
+
+  g_print ("Raw video kernels, %dx%d, %u frames\n", BENCHMARK_WIDTH,
+      BENCHMARK_HEIGHT, frames);
+
+  benchmark_conversion (FORMAT_I420, FORMAT_NV12, "i420-to-nv12", frames);
+  benchmark_conversion (FORMAT_NV12, FORMAT_I420, "nv12-to-i420", frames);
+  benchmark_conversion (FORMAT_I420, FORMAT_RGBX, "i420-to-rgbx", frames);
+  benchmark_conversion (FORMAT_NV12, FORMAT_RGBX, "nv12-to-rgbx", frames);
+  benchmark_conversion (FORMAT_RGBX, FORMAT_I420, "rgbx-to-i420", frames);
+  benchmark_conversion (FORMAT_RGBX, FORMAT_NV12, "rgbx-to-nv12", frames);
+  benchmark_plane ("copy-plane", 1, frames);
+  benchmark_plane ("downscale-2", 2, frames);
+  benchmark_plane ("downscale-4", 4, frames);
+  benchmark_plane ("luma-histogram", 0, frames);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+videokernels_suite (void)
+{
+  Suite *s = suite_create ("videokernels");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_simd_matches_scalar);
+  tcase_add_test (tc_chain, check_downscale);
+  tcase_add_test (tc_chain, check_colors);
+  tcase_add_test (tc_chain, check_luma_histogram);
+  tcase_add_test (tc_chain, benchmark);
+
+  return s;
+}
+
+GST_CHECK_MAIN (videokernels);
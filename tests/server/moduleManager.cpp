@@ -18,12 +18,18 @@
 #define BOOST_TEST_DYN_LINK
 #define BOOST_TEST_MODULE ModuleManager
 #include <boost/test/unit_test.hpp>
+#include <algorithm>
 #include <ModuleManager.hpp>
 #include <KurentoException.hpp>
 #include <jsonrpc/JsonSerializer.hpp>
 #include <Error.hpp>
 #include <gst/gst.h>
+#include <glib/gstdio.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/keyfile.h>
+#include <glibmm/miscutils.h>
 #include <MediaSet.hpp>
+#include <unistd.h>
 
 #include <config.h>
 
@@ -108,3 +114,137 @@ BOOST_AUTO_TEST_CASE (load_modules)
 
   BOOST_CHECK (! data->getGenerationTime().empty() );
 }
+
+static std::string
+findModuleGroup (Glib::KeyFile &manifest, const std::string &fileName)
+{
+  for (Glib::ustring group : manifest.get_groups() ) {
+    if (Glib::path_get_basename (group) == fileName) {
+      return group;
+    }
+  }
+
+  return "";
+}
+
+BOOST_AUTO_TEST_CASE (lazy_load_modules)
+{
+  std::string modulesDir = "../../src/server";
+  gchar *tmpDir = g_dir_make_tmp ("kms-modules-XXXXXX", NULL);
+  std::string manifestPath = Glib::build_filename (tmpDir, "modules.manifest");
+  Glib::KeyFile manifest;
+  std::string group;
+
+  gst_init (NULL, NULL);
+
+  BOOST_REQUIRE (tmpDir != NULL);
+  g_setenv ("KURENTO_MODULES_MANIFEST", manifestPath.c_str(), TRUE);
+  BOOST_CHECK (ModuleManager::getManifestPath () == manifestPath);
+
+  // Modules not in the manifest are loaded and added to it
+  std::shared_ptr <ModuleManager> first (new ModuleManager() );
+  first->loadModulesFromDirectories (modulesDir, true);
+  BOOST_CHECK (first->getFactory ("kurento.MediaPipeline") );
+
+  manifest.load_from_file (manifestPath);
+  group = findModuleGroup (manifest, "libkmscoremodule.so");
+  BOOST_REQUIRE (!group.empty() );
+  BOOST_CHECK (manifest.get_string (group, "name") == "core");
+
+  std::vector<Glib::ustring> factories = manifest.get_string_list (group,
+                                         "factories");
+  BOOST_CHECK (std::find (factories.begin(), factories.end(),
+                          "MediaPipeline") != factories.end() );
+
+  // Modules in the manifest are loaded on first use
+  std::shared_ptr <ModuleManager> second (new ModuleManager() );
+  second->loadModulesFromDirectories (modulesDir, true);
+
+  // They are described from the manifest without loading them
+  const ModuleManager &deferredManager = *second;
+  auto deferred = deferredManager.getModules ().at ("libkmscoremodule.so");
+  BOOST_CHECK (deferred->getName() == "core");
+  BOOST_CHECK (deferred->getVersion() == VERSION);
+  BOOST_CHECK (!deferred->getDescriptor().empty() );
+  BOOST_CHECK (deferred->getFactories().at ("MediaPipeline") == nullptr);
+
+  BOOST_CHECK (second->getFactory ("MediaPipeline") );
+  BOOST_CHECK (second->getFactory ("kurento.MediaPipeline") );
+  BOOST_CHECK (second->getModules().at ("libkmscoremodule.so")->getName() ==
+               "core");
+
+  BOOST_CHECK_THROW (second->getFactory ("NotExistingFactory"),
+                     KurentoException);
+
+  // Entries of modified modules are not trusted
+  manifest.set_int64 (group, "mtime", 0);
+  manifest.set_string_list (group, "factories",
+                            std::vector<Glib::ustring> {"NotExistingFactory"});
+  Glib::file_set_contents (manifestPath, manifest.to_data() );
+
+  std::shared_ptr <ModuleManager> third (new ModuleManager() );
+  third->loadModulesFromDirectories (modulesDir, true);
+  BOOST_CHECK (third->getFactory ("MediaPipeline") );
+  BOOST_CHECK_THROW (third->getFactory ("NotExistingFactory"),
+                     KurentoException);
+
+  manifest.load_from_file (manifestPath);
+  BOOST_CHECK (manifest.get_int64 (group, "mtime") != 0);
+
+  g_unsetenv ("KURENTO_MODULES_MANIFEST");
+  g_remove (manifestPath.c_str() );
+  g_rmdir (tmpDir);
+  g_free (tmpDir);
+}
+
+BOOST_AUTO_TEST_CASE (lazy_load_conflicting_modules)
+{
+  std::string modulePath = Glib::build_filename (Glib::get_current_dir (),
+                           "../../src/server", "libkmscoremodule.so");
+  gchar *tmpDir = g_dir_make_tmp ("kms-modules-XXXXXX", NULL);
+  std::string manifestPath = Glib::build_filename (tmpDir, "modules.manifest");
+  std::string cachedDir = Glib::build_filename (tmpDir, "cached");
+  std::string uncachedDir = Glib::build_filename (tmpDir, "uncached");
+  std::string cachedPath = Glib::build_filename (cachedDir,
+                           "libkmscoremodule.so");
+  std::string uncachedPath = Glib::build_filename (uncachedDir,
+                             "libkmscoremodulecopy.so");
+
+  gst_init (NULL, NULL);
+
+  BOOST_REQUIRE (tmpDir != NULL);
+  g_setenv ("KURENTO_MODULES_MANIFEST", manifestPath.c_str(), TRUE);
+
+  // Links, so both names share the already loaded library
+  BOOST_REQUIRE (g_mkdir (cachedDir.c_str(), 0755) == 0);
+  BOOST_REQUIRE (g_mkdir (uncachedDir.c_str(), 0755) == 0);
+  BOOST_REQUIRE (symlink (modulePath.c_str(), cachedPath.c_str() ) == 0);
+
+  std::shared_ptr <ModuleManager> first (new ModuleManager() );
+  first->loadModulesFromDirectories (cachedDir, true);
+  BOOST_REQUIRE (first->getFactory ("MediaPipeline") );
+
+  // Same factories, but only the first one is in the manifest
+  BOOST_REQUIRE (symlink (modulePath.c_str(), uncachedPath.c_str() ) == 0);
+
+  std::shared_ptr <ModuleManager> second (new ModuleManager() );
+  second->loadModulesFromDirectories (cachedDir + ":" + uncachedDir, true);
+
+  // The deferred module owns the factory, as it would have been loaded first
+  BOOST_CHECK (second->getFactory ("MediaPipeline") );
+
+  const ModuleManager &manager = *second;
+  auto modules = manager.getModules ();
+
+  BOOST_CHECK (modules.find ("libkmscoremodule.so") != modules.end() );
+  BOOST_CHECK (modules.find ("libkmscoremodulecopy.so") == modules.end() );
+
+  g_unsetenv ("KURENTO_MODULES_MANIFEST");
+  g_remove (uncachedPath.c_str() );
+  g_remove (cachedPath.c_str() );
+  g_remove (manifestPath.c_str() );
+  g_rmdir (uncachedDir.c_str() );
+  g_rmdir (cachedDir.c_str() );
+  g_rmdir (tmpDir);
+  g_free (tmpDir);
+}